@@ -0,0 +1,123 @@
+#!/usr/bin/env bash
+
+# Compare the string hash functions in util/hash.c on generated mapping keys
+# that share a long common prefix, reporting the time per key and how many
+# keys land in an already occupied bucket of a power of two table.
+
+if [ 1 -lt $# ]; then
+    echo "usage: $(basename $0) [key count]"
+    exit 1
+fi
+
+KEYS=${1:-1000000}
+RUNS=${RUNS:-5}
+CC=${CC:-cc}
+
+ROOT=$(cd $(dirname $0)/.. && pwd)
+WORK=$(mktemp -d -t kanabo_benchmark_XXXXXX)
+trap "rm -rf $WORK" EXIT
+
+cat > $WORK/driver.c <<'EOF'
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "hash.h"
+
+typedef hashcode (*buffer_hash_function)(const uint8_t *key, size_t length);
+
+struct candidate
+{
+    const char           *name;
+    buffer_hash_function  function;
+};
+
+static const struct candidate CANDIDATES[] =
+{
+    {"wyhash", wyhash_string_buffer_hash},
+    {"fnv1a",  fnv1a_string_buffer_hash},
+    {"djb",    djb_string_buffer_hash},
+    {"sdbm",   sdbm_string_buffer_hash},
+    {"sax",    shift_add_xor_string_buffer_hash},
+};
+
+static double now(void)
+{
+    struct timespec spec;
+    clock_gettime(CLOCK_MONOTONIC, &spec);
+    return (double)spec.tv_sec + (double)spec.tv_nsec / 1e9;
+}
+
+int main(int argc, char **argv)
+{
+    size_t count = 3 > argc ? 0 : strtoul(argv[1], NULL, 10);
+    int runs = 3 > argc ? 0 : atoi(argv[2]);
+    if(0 == count || 0 >= runs)
+    {
+        return EXIT_FAILURE;
+    }
+
+    hash_set_seed(0);
+    char *keys = calloc(count, 32);
+    size_t *lengths = calloc(count, sizeof(size_t));
+    size_t buckets = 1;
+    while(buckets < count * 2)
+    {
+        buckets <<= 1;
+    }
+    unsigned char *occupied = calloc(buckets, 1);
+    if(NULL == keys || NULL == lengths || NULL == occupied)
+    {
+        return EXIT_FAILURE;
+    }
+    for(size_t i = 0; i < count; i++)
+    {
+        lengths[i] = (size_t)snprintf(keys + i * 32, 32, "service_%06zu", i);
+    }
+
+    printf("%-8s %10s %12s\n", "function", "ns/key", "collisions");
+    for(size_t c = 0; c < sizeof(CANDIDATES) / sizeof(CANDIDATES[0]); c++)
+    {
+        buffer_hash_function function = CANDIDATES[c].function;
+        volatile hashcode sink = 0;
+        double best = 0.0;
+        for(int run = 0; run < runs; run++)
+        {
+            double start = now();
+            for(size_t i = 0; i < count; i++)
+            {
+                sink ^= function((const uint8_t *)keys + i * 32, lengths[i]);
+            }
+            double elapsed = now() - start;
+            if(0 == run || elapsed < best)
+            {
+                best = elapsed;
+            }
+        }
+
+        size_t collisions = 0;
+        memset(occupied, 0, buckets);
+        for(size_t i = 0; i < count; i++)
+        {
+            size_t bucket = function((const uint8_t *)keys + i * 32, lengths[i]) & (buckets - 1);
+            collisions += occupied[bucket];
+            occupied[bucket] = 1;
+        }
+        printf("%-8s %10.2f %12zu\n", CANDIDATES[c].name, best * 1e9 / (double)count, collisions);
+    }
+
+    free(occupied);
+    free(lengths);
+    free(keys);
+    return EXIT_SUCCESS;
+}
+EOF
+
+$CC -std=c11 -O2 -I$ROOT/src/main/c/include -o $WORK/driver $WORK/driver.c $ROOT/src/main/c/util/hash.c || exit 1
+
+echo "input: $KEYS keys of the form service_NNNNNN, best of $RUNS runs"
+echo "collisions are counted in the low bits of a table with at least twice as many buckets as keys"
+$WORK/driver $KEYS $RUNS
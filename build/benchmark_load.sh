@@ -0,0 +1,55 @@
+#!/usr/bin/env bash
+
+# Compare the streaming loader (stdin) against the memory mapped loader (named
+# file) on a generated document, reporting wall time and peak RSS of each.
+
+if [ 1 -gt $# ] || [ 2 -lt $# ]; then
+    echo "usage: $(basename $0) <kanabo binary> [record count]"
+    exit 1
+fi
+
+KANABO=$1
+RECORDS=${2:-200000}
+RUNS=${RUNS:-5}
+TIME=${TIME:-/usr/bin/time}
+
+if [ ! -x "$TIME" ]; then
+    echo "$(basename $0): GNU time is required, set TIME to its location"
+    exit 1
+fi
+
+INPUT=$(mktemp -t kanabo_benchmark_XXXXXX)
+trap "rm -f $INPUT" EXIT
+
+for ((i = 0; i < RECORDS; i++)); do
+    echo "record$i:"
+    echo "  name: \"item number $i\""
+    echo "  sku: SKU-$i-XYZ"
+    echo "  price: $i.99"
+    echo "  quantity: $i"
+    echo "  tags: [red, green, blue]"
+    echo "  description: a plain scalar description for record $i"
+done > $INPUT
+
+echo "input: $(du -h $INPUT | cut -f1) in $RECORDS records, best of $RUNS runs"
+
+measure()
+{
+    local label=$1
+    shift
+    local best_time=
+    local best_rss=
+    for ((run = 0; run < RUNS; run++)); do
+        read -r elapsed rss < <($TIME -f "%e %M" "$@" 2>&1 >/dev/null | tail -n 1)
+        if [ -z "$best_time" ] || [ 1 -eq $(echo "$elapsed < $best_time" | bc) ]; then
+            best_time=$elapsed
+        fi
+        if [ -z "$best_rss" ] || [ "$rss" -lt "$best_rss" ]; then
+            best_rss=$rss
+        fi
+    done
+    printf "%-8s %8ss %10s KiB\n" "$label" "$best_time" "$best_rss"
+}
+
+measure stream sh -c "$KANABO -q '\$.record0.sku' < $INPUT"
+measure mapped $KANABO -q '$.record0.sku' $INPUT
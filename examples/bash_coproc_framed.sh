@@ -0,0 +1,56 @@
+#!/usr/bin/env bash
+
+TAX_RATE=0.08875
+
+# start kanabo as a named coprocess, in framed interactive mode loading the file from the 1st argument
+coproc kanabo { kanabo --framed $1 ;}
+
+# read one response, setting the variables status, id, count and body
+read_response() {
+  local length
+  read -ru ${kanabo[0]} status id count length || return 1
+  body=
+  if [ 0 -lt "$length" ]; then
+    # `read -N' counts characters, so the C locale is used to have it count the bytes the header gives
+    local LC_ALL=C
+    read -r -N "$length" -u ${kanabo[0]} body
+  fi
+}
+
+# send both queries at once, each with an id to match it to its response
+printf 'titles\t$.store.book[*].title\n' >&${kanabo[1]}
+printf 'prices\t$.store.book[*].price\n' >&${kanabo[1]}
+
+for i in 1 2
+do
+  read_response || exit 1
+  if [ "error" == "$status" ]; then
+    echo "the query for the $id failed: $body" >&2
+    exit 1
+  fi
+  # the results of the default output format are quoted as bash words, one per line
+  declare -a "$id=(${body})"
+done
+
+choices=()
+for (( i = 0; i < ${#titles[@]}; i++ ))
+do
+  choices+=("\"${titles[i]}\" for \$${prices[i]}")
+done
+
+echo
+echo "Welcome to our bookstore!"
+echo "Please make your selection from these fine books:"
+echo
+PS3="Your choice: "
+select book in "${choices[@]}"
+do
+    price=${prices[$((REPLY - 1))]}
+    echo
+    # bash doesn't support floating point arithmetic, so we use bc
+    printf "Thank you, with tax your total comes to: \$%.2f\n" $(bc <<< "${price} * ${TAX_RATE} + ${price}")
+    break
+done
+
+# close the stdin fd for the coprocess, causing it to exit
+eval "exec ${kanabo[1]}>&-"
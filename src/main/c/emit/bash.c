@@ -41,34 +41,34 @@
 #include "emit/shell.h"
 #include "log.h"
 
-static bool emit_mapping_item(Node *key, Node *value, void *context);
+static bool emit_mapping_item(Cursor key, Cursor value, void *context);
 
-bool emit_bash(const nodelist *list)
+bool emit_bash(Evaluation *results)
 {
-    log_debug("bash", "emitting %zd items...", nodelist_length(list));
+    log_debug("bash", "emitting...");
     emit_context context = {
             .emit_mapping_item = emit_mapping_item,
             .wrap_collections = true
     };
 
-    return nodelist_iterate(list, emit_node, &context);
+    return evaluation_iterate(results, emit_node, &context);
 }
 
-static bool emit_mapping_item(Node *key, Node *value, void *context __attribute__((unused)))
+static bool emit_mapping_item(Cursor key, Cursor value, void *context __attribute__((unused)))
 {
-    if(is_scalar(value))
+    if(cursor_is_scalar(value))
     {
         log_trace("bash", "emitting mapping item");
         EMIT("[");
         log_trace("bash", "emitting mapping item key");
-        if(!emit_raw_scalar(scalar(key)))
+        if(!emit_raw_scalar(key))
         {
             log_error("bash", "uh oh! couldn't emit mapping key");
             return false;
         }
         EMIT("]=");
         log_trace("bash", "emitting mapping item value");
-        if(!emit_scalar(scalar(value)))
+        if(!emit_scalar(value))
         {
             log_error("bash", "uh oh! couldn't emit mapping value");
             return false;
@@ -82,3 +82,4 @@ static bool emit_mapping_item(Node *key, Node *value, void *context __attribute_
 
     return true;
 }
+
@@ -39,27 +39,28 @@
 #include <stdio.h>
 
 #include "emit/json.h"
+#include "emit/output.h"
 #include "log.h"
 
 
 #define component "json"
 
-#define EMIT(STR) if(EOF == fputs((STR), stdout))                       \
+#define EMIT(STR) if(EOF == fputs((STR), emit_output()))                       \
     {                                                                   \
         log_error(component, "uh oh! couldn't emit literal %s", (STR)); \
         return false;                                                   \
     }
 
-#define QEMIT(STR) if(EOF == fputs((STR), stdout))                      \
+#define QEMIT(STR) if(EOF == fputs((STR), emit_output()))                      \
     {                                                                   \
         log_error(component, "uh oh! couldn't emit literal %s", (STR)); \
     }
 
 
-static bool emit_json_node(Node *each, void *context __attribute__((unused)));
+static bool emit_json_node(Cursor each, void *context __attribute__((unused)));
 
 
-static bool emit_json_sequence_item(Node *each, void *context)
+static bool emit_json_sequence_item(Cursor each, void *context)
 {
     log_trace(component, "emitting sequence item");
     size_t *count = (size_t *)context;
@@ -70,24 +71,24 @@ static bool emit_json_sequence_item(Node *each, void *context)
     return emit_json_node(each, NULL);
 }
 
-bool emit_json(const nodelist *list)
+bool emit_json(Evaluation *results)
 {
     log_debug(component, "emitting...");
     size_t count = 0;
     QEMIT("[");
-    bool result = nodelist_iterate(list, emit_json_sequence_item, &count);
+    bool result = evaluation_iterate(results, emit_json_sequence_item, &count);
     QEMIT("]");
     QEMIT("\n");
 
     return result;
 }
 
-static bool emit_json_raw_scalar(const Scalar *each)
+static bool emit_json_raw_scalar(Cursor each)
 {
-    return 1 == fwrite(scalar_value(each), node_size(each), 1, stdout);
+    return 1 == fwrite(cursor_value(each), cursor_size(each), 1, emit_output());
 }
 
-static bool emit_json_quoted_scalar(const Scalar *each)
+static bool emit_json_quoted_scalar(Cursor each)
 {
     EMIT("\"");
     if(!emit_json_raw_scalar(each))
@@ -100,10 +101,10 @@ static bool emit_json_quoted_scalar(const Scalar *each)
     return true;
 }
 
-static bool emit_json_scalar(const Scalar *each)
+static bool emit_json_scalar(Cursor each)
 {
-    if(SCALAR_STRING == scalar_kind(each) ||
-       SCALAR_TIMESTAMP == scalar_kind(each))
+    if(SCALAR_STRING == cursor_scalar_kind(each) ||
+       SCALAR_TIMESTAMP == cursor_scalar_kind(each))
     {
         log_trace(component, "emitting quoted scalar");
         return emit_json_quoted_scalar(each);
@@ -115,7 +116,7 @@ static bool emit_json_scalar(const Scalar *each)
     }
 }
 
-static bool emit_json_mapping_item(Node *key, Node *value, void *context)
+static bool emit_json_mapping_item(Cursor key, Cursor value, void *context)
 {
     log_trace(component, "emitting mapping item");
     size_t *count = (size_t *)context;
@@ -123,7 +124,7 @@ static bool emit_json_mapping_item(Node *key, Node *value, void *context)
     {
         EMIT(",");
     }
-    if(!emit_json_quoted_scalar(scalar(key)))
+    if(!emit_json_quoted_scalar(key))
     {
         return false;
     }
@@ -131,35 +132,35 @@ static bool emit_json_mapping_item(Node *key, Node *value, void *context)
     return emit_json_node(value, NULL);
 }
 
-static bool emit_json_node(Node *each, void *context __attribute__((unused)))
+static bool emit_json_node(Cursor each, void *context __attribute__((unused)))
 {
     bool result = true;
     size_t sequence_count = 0;
     size_t mapping_count = 0;
-    switch(node_kind(each))
+    switch(cursor_kind(each))
     {
         case DOCUMENT:
             log_trace(component, "emitting document");
-            result = emit_json_node(document_root(document(each)), context);
+            result = emit_json_node(cursor_document_root(each), context);
             break;
         case SCALAR:
-            result = emit_json_scalar(scalar(each));
+            result = emit_json_scalar(each);
             break;
         case SEQUENCE:
             log_trace(component, "emitting seqence");
             EMIT("[");
-            result = sequence_iterate(sequence(each), emit_json_sequence_item, &sequence_count);
+            result = cursor_sequence_iterate(each, emit_json_sequence_item, &sequence_count);
             EMIT("]");
             break;
         case MAPPING:
             log_trace(component, "emitting mapping");
             EMIT("{");
-            result = mapping_iterate(mapping(each), emit_json_mapping_item, &mapping_count);
+            result = cursor_mapping_iterate(each, emit_json_mapping_item, &mapping_count);
             EMIT("}");
             break;
         case ALIAS:
             log_trace(component, "resolving alias");
-            result = emit_json_node(alias_target(alias(each)), context);
+            result = emit_json_node(cursor_alias_target(each), context);
             break;
     }
 
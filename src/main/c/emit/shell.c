@@ -48,49 +48,49 @@
         EMIT((STR));                                    \
     }
 
-bool emit_node(Node *each, void *argument)
+bool emit_node(Cursor each, void *argument)
 {
     emit_context *context = (emit_context *)argument;
 
     log_debug("shell", "emitting node...");
     bool result = true;
-    switch(node_kind(each))
+    switch(cursor_kind(each))
     {
         case DOCUMENT:
             log_trace("shell", "emitting document");
-            result = emit_node(document_root(document(each)), NULL);
+            result = emit_node(cursor_document_root(each), argument);
             break;
         case SCALAR:
-            result = emit_scalar(scalar(each));
+            result = emit_scalar(each);
             EMIT("\n");
             break;
         case SEQUENCE:
             log_trace("shell", "emitting seqence");
             MAYBE_EMIT("(");
-            result = sequence_iterate(sequence(each), emit_sequence_item, NULL);
+            result = cursor_sequence_iterate(each, emit_sequence_item, NULL);
             MAYBE_EMIT(")");
             EMIT("\n");
             break;
         case MAPPING:
             log_trace("shell", "emitting mapping");
             MAYBE_EMIT("(");
-            result = mapping_iterate(mapping(each), context->emit_mapping_item, NULL);
+            result = cursor_mapping_iterate(each, context->emit_mapping_item, NULL);
             MAYBE_EMIT(")");
             EMIT("\n");
             break;
         case ALIAS:
             log_trace("shell", "resolving alias");
-            result = emit_node(alias_target(alias(each)), NULL);
+            result = emit_node(cursor_alias_target(each), argument);
             break;
     }
 
     return result;
 }
 
-static bool scalar_contains_space(const Scalar *each)
+static bool scalar_contains_space(Cursor each)
 {
-    uint8_t *value = scalar_value(each);
-    for(size_t i = 0; i < node_size(each); i++)
+    const uint8_t *value = cursor_value(each);
+    for(size_t i = 0; i < cursor_size(each); i++)
     {
         if(isspace(*(value + i)))
         {
@@ -101,9 +101,9 @@ static bool scalar_contains_space(const Scalar *each)
     return false;
 }
 
-bool emit_scalar(const Scalar *each)
+bool emit_scalar(Cursor each)
 {
-    if(SCALAR_STRING == scalar_kind(each) && scalar_contains_space(each))
+    if(SCALAR_STRING == cursor_scalar_kind(each) && scalar_contains_space(each))
     {
         log_trace("shell", "emitting quoted scalar");
         return emit_quoted_scalar(each);
@@ -115,7 +115,7 @@ bool emit_scalar(const Scalar *each)
     }
 }
 
-bool emit_quoted_scalar(const Scalar *each)
+bool emit_quoted_scalar(Cursor each)
 {
     EMIT("'");
     if(!emit_raw_scalar(each))
@@ -128,17 +128,17 @@ bool emit_quoted_scalar(const Scalar *each)
     return true;
 }
 
-bool emit_raw_scalar(const Scalar *each)
+bool emit_raw_scalar(Cursor each)
 {
-    return 1 == fwrite(scalar_value(each), node_size(each), 1, stdout);
+    return 1 == fwrite(cursor_value(each), cursor_size(each), 1, emit_output());
 }
 
-bool emit_sequence_item(Node *each, void *context __attribute__((unused)))
+bool emit_sequence_item(Cursor each, void *context __attribute__((unused)))
 {
-    if(is_scalar(each))
+    if(cursor_is_scalar(each))
     {
         log_trace("shell", "emitting sequence item");
-        if(!emit_scalar(scalar(each)))
+        if(!emit_scalar(each))
         {
             return false;
         }
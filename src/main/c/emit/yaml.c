@@ -39,6 +39,7 @@
 #include <yaml.h>
 
 #include "emit/yaml.h"
+#include "emit/output.h"
 #include "log.h"
 
 
@@ -46,10 +47,10 @@
 #define trace_string(FORMAT, VALUE, LENGTH, ...) log_string(LVL_TRACE, component, FORMAT, VALUE, LENGTH, ##__VA_ARGS__)
 
 
-static bool emit_node(Node *each, void *context);
+static bool emit_node(Cursor each, void *context);
 
 
-static bool emit_document(Document *value, void *context)
+static bool emit_document(Cursor value, void *context)
 {
     log_trace(component, "emitting document");
     yaml_emitter_t *emitter = (yaml_emitter_t *)context;
@@ -59,7 +60,7 @@ static bool emit_document(Document *value, void *context)
     if (!yaml_emitter_emit(emitter, &event))
         return false;
 
-    if(!emit_node(document_root(value), context))
+    if(!emit_node(cursor_document_root(value), context))
     {
         return false;
     }
@@ -71,26 +72,26 @@ static bool emit_document(Document *value, void *context)
     return true;
 }
 
-static bool emit_sequence_item(Node *each, void *context)
+static bool emit_sequence_item(Cursor each, void *context)
 {
     log_trace(component, "emitting sequence item");
     return emit_node(each, context);
 }
 
-static bool emit_sequence(Sequence *value, void *context)
+static bool emit_sequence(Cursor value, void *context)
 {
     log_trace(component, "emitting seqence");
     yaml_emitter_t *emitter = (yaml_emitter_t *)context;
     yaml_event_t event;
 
     log_trace(component, "seqence start");
-    uint8_t *name = node_name((Node *)value);
+    const uint8_t *name = cursor_tag(value);
     yaml_char_t *tag = NULL == name ? (yaml_char_t *)YAML_DEFAULT_SEQUENCE_TAG : (yaml_char_t *)name;
     yaml_sequence_start_event_initialize(&event, NULL, tag, NULL == name, YAML_BLOCK_SEQUENCE_STYLE);
     if (!yaml_emitter_emit(emitter, &event))
         return false;
 
-    if(!sequence_iterate(value, emit_sequence_item, context))
+    if(!cursor_sequence_iterate(value, emit_sequence_item, context))
     {
         return false;
     }
@@ -103,44 +104,44 @@ static bool emit_sequence(Sequence *value, void *context)
     return true;
 }
 
-static bool emit_tagged_scalar(const Scalar *value, yaml_char_t *tag, yaml_scalar_style_t style, int implicit, void *context)
+static bool emit_tagged_scalar(Cursor value, yaml_char_t *tag, yaml_scalar_style_t style, int implicit, void *context)
 {
-    trace_string("emitting scalar \"%s\"", scalar_value(value), node_size(value));
+    trace_string("emitting scalar \"%s\"", cursor_value(value), cursor_size(value));
     yaml_emitter_t *emitter = (yaml_emitter_t *)context;
     yaml_event_t event;
 
-    yaml_scalar_event_initialize(&event, NULL, tag, scalar_value(value),
-                                 (int)node_size(value), implicit, implicit, style);
+    yaml_scalar_event_initialize(&event, NULL, tag, cursor_value(value),
+                                 (int)cursor_size(value), implicit, implicit, style);
     if (!yaml_emitter_emit(emitter, &event))
         return false;
 
     return true;
 }
 
-static bool emit_mapping_item(Node *key, Node *value, void *context)
+static bool emit_mapping_item(Cursor key, Cursor value, void *context)
 {
     log_trace(component, "emitting mapping item");
-    if(!emit_tagged_scalar(scalar(key), (yaml_char_t *)YAML_STR_TAG, YAML_PLAIN_SCALAR_STYLE, 1, context))
+    if(!emit_tagged_scalar(key, (yaml_char_t *)YAML_STR_TAG, YAML_PLAIN_SCALAR_STYLE, 1, context))
     {
         return false;
     }
     return emit_node(value, context);
 }
 
-static bool emit_mapping(Mapping *value, void *context)
+static bool emit_mapping(Cursor value, void *context)
 {
     log_trace(component, "emitting mapping");
     yaml_emitter_t *emitter = (yaml_emitter_t *)context;
     yaml_event_t event;
 
     log_trace(component, "mapping start");
-    uint8_t *name = node_name((Node *)value);
+    const uint8_t *name = cursor_tag(value);
     yaml_char_t *tag = NULL == name ? (yaml_char_t *)YAML_DEFAULT_MAPPING_TAG : (yaml_char_t *)name;
     yaml_mapping_start_event_initialize(&event, NULL, tag, NULL == name, YAML_BLOCK_MAPPING_STYLE);
     if (!yaml_emitter_emit(emitter, &event))
         return false;
 
-    if(!mapping_iterate(value, emit_mapping_item, context))
+    if(!cursor_mapping_iterate(value, emit_mapping_item, context))
     {
         return false;
     }
@@ -153,13 +154,13 @@ static bool emit_mapping(Mapping *value, void *context)
     return true;
 }
 
-static bool emit_scalar(const Scalar *each, void *context)
+static bool emit_scalar(Cursor each, void *context)
 {
     yaml_char_t *tag = NULL;
     yaml_scalar_style_t style = YAML_PLAIN_SCALAR_STYLE;
-    uint8_t *name = node_name((Node *)each);
+    yaml_char_t *name = (yaml_char_t *)cursor_tag(each);
 
-    switch(scalar_kind(each))
+    switch(cursor_scalar_kind(each))
     {
         case SCALAR_STRING:
             tag = NULL == name ? (yaml_char_t *)YAML_STR_TAG : name;
@@ -180,39 +181,42 @@ static bool emit_scalar(const Scalar *each, void *context)
         case SCALAR_NULL:
             tag = NULL == name ? (yaml_char_t *)YAML_NULL_TAG : name;
             break;
+        case SCALAR_UNRESOLVED:
+            // scalar_kind() always resolves the kind before returning it
+            break;
     }
 
     return emit_tagged_scalar(each, tag, style, NULL == name, context);
 }
 
-static bool emit_node(Node *each, void *context)
+static bool emit_node(Cursor each, void *context)
 {
     bool result = true;
-    switch(node_kind(each))
+    switch(cursor_kind(each))
     {
         case DOCUMENT:
-            result = emit_document(document(each), context);
+            result = emit_document(each, context);
             break;
         case SCALAR:
-            result = emit_scalar(scalar(each), context);
+            result = emit_scalar(each, context);
             break;
         case SEQUENCE:
-            result = emit_sequence(sequence(each), context);
+            result = emit_sequence(each, context);
             break;
         case MAPPING:
-            result = emit_mapping(mapping(each), context);
+            result = emit_mapping(each, context);
             break;
         case ALIAS:
-            result = emit_node(alias_target(alias(each)), context);
+            result = emit_node(cursor_alias_target(each), context);
             break;
     }
 
     return result;
 }
 
-static bool emit_nodelist(const nodelist *list, yaml_emitter_t *emitter)
+static bool emit_results(Evaluation *results, yaml_emitter_t *emitter)
 {
-    log_trace(component, "emitting nodelist");
+    log_trace(component, "emitting results");
     yaml_event_t event;
 
     log_trace(component, "seqence start");
@@ -220,7 +224,7 @@ static bool emit_nodelist(const nodelist *list, yaml_emitter_t *emitter)
     if (!yaml_emitter_emit(emitter, &event))
         return false;
 
-    if(!nodelist_iterate(list, emit_sequence_item, emitter))
+    if(!evaluation_iterate(results, emit_sequence_item, emitter))
     {
         return false;
     }
@@ -233,7 +237,7 @@ static bool emit_nodelist(const nodelist *list, yaml_emitter_t *emitter)
     return true;
 }
 
-bool emit_yaml(const nodelist *list)
+bool emit_yaml(Evaluation *results)
 {
     log_debug(component, "emitting...");
     yaml_emitter_t emitter;
@@ -241,7 +245,7 @@ bool emit_yaml(const nodelist *list)
     bool result = true;
 
     yaml_emitter_initialize(&emitter);
-    yaml_emitter_set_output_file(&emitter, stdout);
+    yaml_emitter_set_output_file(&emitter, emit_output());
     yaml_emitter_set_unicode(&emitter, 1);
 
     log_trace(component, "stream start");
@@ -260,7 +264,7 @@ bool emit_yaml(const nodelist *list)
         goto end;
     }
 
-    if(!emit_nodelist(list, &emitter))
+    if(!emit_results(results, &emitter))
     {
         result = false;
         goto end;
@@ -41,9 +41,9 @@
 #include "emit/shell.h"
 #include "log.h"
 
-static bool emit_mapping_item(Node *key, Node *value, void *context);
+static bool emit_mapping_item(Cursor key, Cursor value, void *context);
 
-bool emit_zsh(const nodelist *list)
+bool emit_zsh(Evaluation *results)
 {
     log_debug("zsh", "emitting...");
     emit_context context =
@@ -52,21 +52,21 @@ bool emit_zsh(const nodelist *list)
             .wrap_collections = false
         };
 
-    return nodelist_iterate(list, emit_node, &context);
+    return evaluation_iterate(results, emit_node, &context);
 }
 
-static bool emit_mapping_item(Node *key, Node *value, void * context __attribute__((unused)))
+static bool emit_mapping_item(Cursor key, Cursor value, void * context __attribute__((unused)))
 {
-    if(is_scalar(value))
+    if(cursor_is_scalar(value))
     {
         log_trace("zsh", "emitting mapping item");
-        if(!emit_scalar(scalar(key)))
+        if(!emit_scalar(key))
         {
             log_error("zsh", "uh oh! couldn't emit mapping key");
             return false;
         }
         EMIT(" ");
-        if(!emit_scalar(scalar(value)))
+        if(!emit_scalar(value))
         {
             log_error("zsh", "uh oh! couldn't emit mapping value");
             return false;
@@ -80,3 +80,4 @@ static bool emit_mapping_item(Node *key, Node *value, void * context __attribute
 
     return true;
 }
+
@@ -44,26 +44,315 @@
 #define nothing(CODE) (MaybeNodelist){.tag=NOTHING, .nothing={(CODE), evaluator_status_message((CODE))}}
 #define just(NODELIST) (MaybeNodelist){.tag=JUST, .just=(NODELIST)}
 
-#define PRECOND_ELSE_NOTHING(COND, CODE) ENSURE_THAT(nothing(CODE), EINVAL, (COND))
-#define PRECOND_NONNULL_ELSE_NOTHING(VALUE, CODE) ENSURE_NONNULL(nothing(CODE), EINVAL, (VALUE))
-#define PRECOND_NONZERO_ELSE_NOTHING(VALUE, CODE) ENSURE_THAT(nothing(CODE), EINVAL, 0 != (VALUE))
+#define PRECOND_ELSE_CODE(COND, CODE) ENSURE_THAT((CODE), EINVAL, (COND))
+#define PRECOND_NONNULL_ELSE_CODE(VALUE, CODE) ENSURE_NONNULL((CODE), EINVAL, (VALUE))
+#define PRECOND_NONZERO_ELSE_CODE(VALUE, CODE) ENSURE_THAT((CODE), EINVAL, 0 != (VALUE))
 
 
+static size_t document_count(const DocumentModel *model, const Tape *tape)
+{
+    return NULL != model ? model_size(model) : tape_size(tape);
+}
+
+static Cursor document_at(const DocumentModel *model, const Tape *tape, size_t index)
+{
+    return NULL != model ? cursor_of(model_document(model, index)) : tape_document(tape, index);
+}
+
+static evaluator_status_code check_arguments(const DocumentModel *model, const Tape *tape, const jsonpath *path)
+{
+    PRECOND_ELSE_CODE(NULL != model || NULL != tape, ERR_MODEL_IS_NULL);
+    PRECOND_NONNULL_ELSE_CODE(path, ERR_PATH_IS_NULL);
+    PRECOND_NONZERO_ELSE_CODE(document_count(model, tape), ERR_NO_DOCUMENT_IN_MODEL);
+    PRECOND_ELSE_CODE(!cursor_is_none(cursor_document_root(document_at(model, tape, 0))), ERR_NO_ROOT_IN_DOCUMENT);
+    PRECOND_ELSE_CODE(ABSOLUTE_PATH == path_kind(path), ERR_PATH_IS_NOT_ABSOLUTE);
+    PRECOND_NONZERO_ELSE_CODE(path_length(path), ERR_PATH_IS_EMPTY);
+
+    return EVALUATOR_SUCCESS;
+}
+
+/* hands the nodes of a model's document on to an iterator of cursors, or the other way around */
+struct cursor_sink
+{
+    cursor_iterator iterator;
+    void           *context;
+};
+
+struct node_sink
+{
+    nodelist_iterator iterator;
+    void             *context;
+};
+
+static bool as_cursor_iterator(Node *each, void *context)
+{
+    struct cursor_sink *sink = (struct cursor_sink *)context;
+    return sink->iterator(cursor_of(each), sink->context);
+}
+
+static bool as_node_iterator(Cursor each, void *context)
+{
+    struct node_sink *sink = (struct node_sink *)context;
+    return sink->iterator(each.node, sink->context);
+}
+
+evaluator_status_code evaluate_document(const DocumentModel *model, const jsonpath *path, const program *code,
+                                        Document *document, nodelist_iterator sink, void *context)
+{
+    if(NULL == code)
+    {
+        return evaluate_steps(model, document, path, sink, context);
+    }
+    return execute_program(code, model, cursor_of(document), as_node_iterator, &(struct node_sink){sink, context});
+}
+
+/* a pool hands on results only once all of them are found, which a limited evaluation would waste */
+static inline bool runs_in_pool(const Evaluation *evaluation, const program *code)
+{
+    return NULL != evaluation->model && 0 == evaluation->limit && 1 != evaluator_threads(evaluation->threads)
+        && program_descends(code);
+}
+
+static evaluator_status_code run_document(const Evaluation *evaluation, const program *code, Cursor document,
+                                          cursor_iterator sink, void *context)
+{
+    if(NULL != code && !runs_in_pool(evaluation, code))
+    {
+        return execute_program(code, evaluation->model, document, sink, context);
+    }
+
+    struct cursor_sink adapter = {sink, context};
+    if(NULL == code)
+    {
+        return evaluate_steps(evaluation->model, document(document.node), evaluation->path, as_cursor_iterator, &adapter);
+    }
+    task_pool *pool = make_task_pool(evaluator_threads(evaluation->threads));
+    if(NULL == pool)
+    {
+        return ERR_EVALUATOR_OUT_OF_MEMORY;
+    }
+    evaluator_status_code result = execute_program_in_pool(code, evaluation->model, document(document.node), pool,
+                                                           as_cursor_iterator, &adapter);
+    task_pool_free(pool);
+    return result;
+}
+
+static evaluator_status_code run_documents(const Evaluation *evaluation, const program *code, cursor_iterator sink, void *context)
+{
+    const DocumentModel *model = evaluation->model;
+    const Tape *tape = evaluation->tape;
+    if(!evaluation->all_documents)
+    {
+        return run_document(evaluation, code, document_at(model, tape, 0), sink, context);
+    }
+
+    size_t count = document_count(model, tape);
+    if(NULL != model && 1 != evaluation->threads && 1 < count)
+    {
+        return evaluate_documents(model, evaluation->path, code, evaluation->threads, evaluation->limit,
+                                  as_cursor_iterator, &(struct cursor_sink){sink, context});
+    }
+    evaluator_debug("evaluating %zd documents in turn", count);
+    for(size_t i = 0; i < count; i++)
+    {
+        Cursor each = document_at(model, tape, i);
+        if(cursor_is_none(cursor_document_root(each)))
+        {
+            continue;
+        }
+        evaluator_status_code result = run_document(evaluation, code, each, sink, context);
+        if(EVALUATOR_SUCCESS != result)
+        {
+            return result;
+        }
+    }
+    return EVALUATOR_SUCCESS;
+}
+
+static evaluator_status_code run(const Evaluation *evaluation, cursor_iterator sink, void *context)
+{
+    // N.B. - the step interpreter only walks a model
+    if(evaluation->interpret && NULL != evaluation->model)
+    {
+        return run_documents(evaluation, NULL, sink, context);
+    }
+    // N.B. - the program is compiled once and shared by every document
+    program *code = compile_path(evaluation->model, evaluation->path);
+    if(NULL == code)
+    {
+        return ERR_EVALUATOR_OUT_OF_MEMORY;
+    }
+    evaluator_status_code result = run_documents(evaluation, code, sink, context);
+    program_free(code);
+    return result;
+}
+
+static bool collect_result(Cursor each, void *context)
+{
+    return nodelist_add((nodelist *)context, each.node);
+}
+
 MaybeNodelist evaluate(const DocumentModel *model, const jsonpath *path)
 {
-    PRECOND_NONNULL_ELSE_NOTHING(model, ERR_MODEL_IS_NULL);
-    PRECOND_NONNULL_ELSE_NOTHING(path, ERR_PATH_IS_NULL);
-    PRECOND_NONNULL_ELSE_NOTHING(model_document(model, 0), ERR_NO_DOCUMENT_IN_MODEL);
-    PRECOND_NONNULL_ELSE_NOTHING(model_document_root(model, 0), ERR_NO_ROOT_IN_DOCUMENT);
-    PRECOND_ELSE_NOTHING(ABSOLUTE_PATH == path_kind(path), ERR_PATH_IS_NOT_ABSOLUTE);
-    PRECOND_NONZERO_ELSE_NOTHING(path_length(path), ERR_PATH_IS_EMPTY);
+    evaluator_status_code code = check_arguments(model, NULL, path);
+    if(EVALUATOR_SUCCESS != code)
+    {
+        return nothing(code);
+    }
 
-    nodelist *list = NULL;
-    evaluator_status_code code = evaluate_steps(model, path, &list);
+    nodelist *list = make_nodelist();
+    if(NULL == list)
+    {
+        evaluator_debug("uh oh! out of memory, can't allocate the result nodelist");
+        return nothing(ERR_EVALUATOR_OUT_OF_MEMORY);
+    }
+    Evaluation evaluation = make_evaluation(model, path);
+    code = run(&evaluation, collect_result, list);
     if(EVALUATOR_SUCCESS != code)
     {
         nodelist_free(list);
-        return nothing(code);
+        // N.B. - the only way the list refuses a node is by running out of memory
+        return nothing(ERR_EVALUATION_STOPPED == code ? ERR_EVALUATOR_OUT_OF_MEMORY : code);
     }
     return just(list);
 }
+
+Evaluation make_evaluation(const DocumentModel *model, const jsonpath *path)
+{
+    return (Evaluation){model, NULL, path, false, false, 0, 0, NULL, 0, EVALUATOR_SUCCESS};
+}
+
+Evaluation make_tape_evaluation(const Tape *tape, const jsonpath *path)
+{
+    return (Evaluation){NULL, tape, path, false, false, 0, 0, NULL, 0, EVALUATOR_SUCCESS};
+}
+
+struct limiter
+{
+    cursor_iterator iterator;
+    void           *context;
+    /** stop after this many results, or never when zero */
+    size_t          limit;
+    size_t          handed;
+};
+
+static bool limit_iterator(Cursor each, void *context)
+{
+    struct limiter *limit = (struct limiter *)context;
+    if(!limit->iterator(each, limit->context))
+    {
+        return false;
+    }
+    // N.B. - stopping on the last result, rather than refusing the one after it, spares finding that one
+    return ++limit->handed != limit->limit;
+}
+
+bool evaluation_iterate(Evaluation *evaluation, cursor_iterator iterator, void *context)
+{
+    PRECOND_NONNULL_ELSE_FALSE(evaluation, iterator);
+
+    evaluation->count = 0;
+    evaluation->code = check_arguments(evaluation->model, evaluation->tape, evaluation->path);
+    if(EVALUATOR_SUCCESS != evaluation->code)
+    {
+        return false;
+    }
+    if(NULL != evaluation->found)
+    {
+        // N.B. - the batch that found these has already applied the limit
+        struct limiter counter = {iterator, context, 0, 0};
+        const Selection *found = evaluation->found;
+        bool more = true;
+        for(size_t i = 0; more && i < found->length; i++)
+        {
+            more = limit_iterator(found->cursors[i], &counter);
+        }
+        evaluation->code = more ? EVALUATOR_SUCCESS : ERR_EVALUATION_STOPPED;
+        evaluation->count = counter.handed;
+        return EVALUATOR_SUCCESS == evaluation->code;
+    }
+
+    struct limiter limit = {iterator, context, evaluation->limit, 0};
+    evaluation->code = run(evaluation, limit_iterator, &limit);
+    evaluation->count = limit.handed;
+    if(ERR_EVALUATION_STOPPED == evaluation->code && 0 != limit.limit && limit.limit == limit.handed)
+    {
+        evaluator_debug("stopped after the limit of %zd results", evaluation->limit);
+        evaluation->code = EVALUATOR_SUCCESS;
+    }
+    return EVALUATOR_SUCCESS == evaluation->code;
+}
+
+void selection_release(Selection *selection)
+{
+    PRECOND_NONNULL_ELSE_VOID(selection);
+
+    free(selection->cursors);
+    *selection = (Selection){NULL, 0, 0};
+}
+
+static void release_results(Selection *results, size_t count)
+{
+    for(size_t i = 0; i < count; i++)
+    {
+        selection_release(results + i);
+    }
+}
+
+static evaluator_status_code run_batch(const DocumentModel *model, const Tape *tape, const jsonpath * const *paths, size_t count,
+                                       bool all_documents, size_t limit, Selection *results)
+{
+    PRECOND_NONNULL_ELSE_CODE(paths, ERR_PATH_IS_NULL);
+    PRECOND_NONNULL_ELSE_CODE(results, ERR_EVALUATOR_OUT_OF_MEMORY);
+    for(size_t i = 0; i < count; i++)
+    {
+        results[i] = (Selection){NULL, 0, 0};
+    }
+    for(size_t i = 0; i < count; i++)
+    {
+        evaluator_status_code code = check_arguments(model, tape, paths[i]);
+        if(EVALUATOR_SUCCESS != code)
+        {
+            return code;
+        }
+    }
+    if(0 == count)
+    {
+        return EVALUATOR_SUCCESS;
+    }
+
+    program *code = compile_batch(model, paths, count);
+    if(NULL == code)
+    {
+        return ERR_EVALUATOR_OUT_OF_MEMORY;
+    }
+
+    evaluator_status_code result = EVALUATOR_SUCCESS;
+    size_t documents = all_documents ? document_count(model, tape) : 1;
+    for(size_t i = 0; i < documents && EVALUATOR_SUCCESS == result; i++)
+    {
+        Cursor each = document_at(model, tape, i);
+        if(!cursor_is_none(cursor_document_root(each)))
+        {
+            result = execute_batch(code, model, each, limit, results);
+        }
+    }
+    program_free(code);
+    if(EVALUATOR_SUCCESS != result)
+    {
+        release_results(results, count);
+    }
+    return result;
+}
+
+evaluator_status_code evaluate_batch(const DocumentModel *model, const jsonpath * const *paths, size_t count,
+                                     bool all_documents, size_t limit, Selection *results)
+{
+    return run_batch(model, NULL, paths, count, all_documents, limit, results);
+}
+
+evaluator_status_code evaluate_tape_batch(const Tape *tape, const jsonpath * const *paths, size_t count,
+                                          bool all_documents, size_t limit, Selection *results)
+{
+    return run_batch(NULL, tape, paths, count, all_documents, limit, results);
+}
@@ -35,6 +35,7 @@
  * [license]: http://www.opensource.org/licenses/ncsa
  */
 
+
 #ifdef __linux__
 #define _POSIX_C_SOURCE 200809L
 #define _GNU_SOURCE
@@ -57,147 +58,153 @@
 #include "log.h"
 #include "conditions.h"
 
-struct meta_context
+/*
+ * The steps of a path form a pipeline: each node a step produces is handed
+ * straight to the next step, and the last step hands it to the sink, so no
+ * list of intermediate results is ever built.  A stage is a position in that
+ * pipeline, either a step's test or its predicate.
+ */
+struct stage
 {
     evaluator_context *context;
-    nodelist *target;
+    size_t             step;
+    bool               predicate;
 };
 
-typedef struct meta_context meta_context;
+typedef struct stage stage;
 
-static bool evaluate_step(step* each, void *context);
-static bool evaluate_root_step(evaluator_context *context);
-static bool evaluate_single_step(evaluator_context *context);
-static bool evaluate_recursive_step(evaluator_context *context);
-static bool evaluate_predicate(evaluator_context *context);
+static bool evaluate_stage(const stage *at, Node *each);
+static bool advance(const stage *at, Node *value);
+static bool evaluate_root_step(const stage *at, Node *each);
 
-static bool apply_node_test(Node *each, void *argument, nodelist *target);
-static bool apply_recursive_node_test(Node *each, void *argument, nodelist *target);
+static bool apply_node_test(Node *each, const stage *at);
+static bool apply_recursive_node_test(Node *each, const stage *at);
 static bool recursive_test_sequence_iterator(Node *each, void *context);
 static bool recursive_test_map_iterator(Node *key, Node *value, void *context);
-static bool apply_greedy_wildcard_test(const Node *each, void *argument, nodelist *target);
-static bool apply_recursive_wildcard_test(const Node *each, void *argument, nodelist *target);
-static bool apply_type_test(const Node *each, void *argument, nodelist *target);
-static bool apply_name_test(const Node *each, void *argument, nodelist *target);
-
-static bool apply_predicate(Node *value, void *argument, nodelist *target);
-static bool apply_wildcard_predicate(const Node *value, evaluator_context *context, nodelist *target);
-static bool apply_subscript_predicate(const Sequence *value, evaluator_context *context, nodelist *target);
-static bool apply_slice_predicate(const Sequence *value, evaluator_context *context, nodelist *target);
-static bool apply_join_predicate(const Node *value, evaluator_context *context, nodelist *target);
-
-static bool add_to_nodelist_sequence_iterator(Node *each, void *context);
-static bool add_values_to_nodelist_map_iterator(Node *key, Node *value, void *context);
+static bool apply_greedy_wildcard_test(const Node *each, const stage *at);
+static bool apply_recursive_wildcard_test(const Node *each, const stage *at);
+static bool apply_type_test(const Node *each, const stage *at);
+static bool apply_name_test(const Node *each, const stage *at);
+
+static bool apply_predicate(Node *value, const stage *at);
+static bool apply_wildcard_predicate(const Node *value, const stage *at);
+static bool apply_subscript_predicate(const Sequence *value, const stage *at);
+static bool apply_slice_predicate(const Sequence *value, const stage *at);
+static bool apply_join_predicate(const Node *value, const stage *at);
+static bool apply_filter_predicate(Node *value, const stage *at);
+static bool filter_sequence_iterator(Node *each, void *context);
+
+static bool advance_sequence_iterator(Node *each, void *context);
+static bool advance_mapping_values_iterator(Node *key, Node *value, void *context);
 static void normalize_interval(const Sequence *value, predicate *slice, int *from, int *to, int *step);
 
-#define current_step(CONTEXT) path_get((CONTEXT)->path, (CONTEXT)->current_step)
-#define guard(EXPR) EXPR ? true : (context->code = ERR_EVALUATOR_OUT_OF_MEMORY, false)
+#define step_at(AT) path_get((AT)->context->path, (AT)->step)
 
 
-evaluator_status_code evaluate_steps(const DocumentModel *model, const jsonpath *path, nodelist **list)
+evaluator_status_code evaluate_steps(const DocumentModel *model, Document *document, const jsonpath *path, nodelist_iterator sink, void *argument)
 {
-    evaluator_debug("beginning evaluation of %d steps", path_length(path));
+    size_t length = path_length(path);
+    evaluator_debug("beginning evaluation of %zd steps", length);
 
-    evaluator_context context;
-    memset(&context, 0, sizeof(evaluator_context));
-
-    *list = NULL;
-    context.list = make_nodelist();
-    if(NULL == context.list)
+    const Scalar *names[length];
+    evaluator_context context =
+        {
+            .code = EVALUATOR_SUCCESS,
+            .model = model,
+            .path = path,
+            .names = names,
+            .sink = sink,
+            .sink_context = argument
+        };
+    for(size_t i = 0; i < length; i++)
     {
-        evaluator_debug("uh oh! out of memory, can't allocate the result nodelist");
-        return ERR_EVALUATOR_OUT_OF_MEMORY;
+        step *each = path_get(path, i);
+        // N.B. - resolve each key once for the whole evaluation rather than hashing it at every mapping
+        names[i] = ROOT != step_kind(each) && NAME_TEST == step_test_kind(each)
+            ? model_symbol(model, name_test_step_name(each), name_test_step_length(each))
+            : NULL;
     }
 
-    context.model = model;
-    context.path = path;
-
-    nodelist_add(context.list, model_document(model, 0));
-
-    if(!path_iterate(path, evaluate_step, &context))
+    if(!evaluate_stage(&(stage){&context, 0, false}, node(document)))
     {
-        evaluator_error("aborted, step: %d, code: %d (%s)", context.current_step, context.code, evaluator_status_message(context.code));
+        if(ERR_EVALUATION_STOPPED == context.code)
+        {
+            evaluator_debug("stopped at step %zd by the sink", context.current_step);
+            return context.code;
+        }
+        evaluator_error("aborted, step: %zd, code: %d (%s)", context.current_step, context.code, evaluator_status_message(context.code));
         return context.code;
     }
 
-    evaluator_debug("done, found %d matching nodes", nodelist_length(context.list));
-    *list = context.list;
+    evaluator_debug("done");
     return context.code;
 }
 
-static bool evaluate_step(step* each, void *argument)
+static bool evaluate_stage(const stage *at, Node *each)
 {
-    evaluator_context *context = (evaluator_context *)argument;
-    evaluator_trace("step: %zd", context->current_step);
+    evaluator_context *context = at->context;
+    context->current_step = at->step;
+    step *current = step_at(at);
 
-    bool result = false;
-    switch(step_kind(each))
+    if(at->predicate)
+    {
+        evaluator_trace("step: %zd, predicate: %s", at->step, predicate_kind_name(predicate_kind(step_predicate(current))));
+        return apply_predicate(each, at);
+    }
+    evaluator_trace("step: %zd, test: %s", at->step, test_kind_name(step_test_kind(current)));
+    switch(step_kind(current))
     {
         case ROOT:
-            result = evaluate_root_step(context);
-            break;
+            return evaluate_root_step(at, each);
         case SINGLE:
-            result = evaluate_single_step(context);
-            break;
+            return apply_node_test(each, at);
         case RECURSIVE:
-            result = evaluate_recursive_step(context);
-            break;
+            return apply_recursive_node_test(each, at);
     }
-    if(result && step_has_predicate(current_step(context)))
+    return false;
+}
+
+/*
+ * Hand a node produced by the stage `at` on to the stage after it, or to the
+ * sink once the last step is done with it.
+ */
+static bool advance(const stage *at, Node *value)
+{
+    evaluator_context *context = at->context;
+    stage next = {context, at->step, true};
+    if(at->predicate || !step_has_predicate(step_at(at)))
     {
-        result = evaluate_predicate(context);
+        next.step++;
+        next.predicate = false;
     }
-    if(result)
+    if(path_length(context->path) == next.step)
     {
-        context->current_step++;
+        if(!context->sink(value, context->sink_context))
+        {
+            evaluator_debug("the sink refused node (%p), stopping", value);
+            context->code = ERR_EVALUATION_STOPPED;
+            return false;
+        }
+        return true;
     }
-    return result;
+    return evaluate_stage(&next, value);
 }
 
-static bool evaluate_root_step(evaluator_context *context)
+static bool evaluate_root_step(const stage *at, Node *each)
 {
     evaluator_trace("evaluating root step");
-    Document *doc = nodelist_get(context->list, 0);
-    Node *root = document_root(doc);
-    evaluator_trace("root test: adding root node (%p) from document (%p)", root, doc);
-    return nodelist_set(context->list, root, 0);
-}
-
-#define evaluate_nodelist(NAME, TEST, FUNCTION)                         \
-    evaluator_trace("evaluating %s across %zd nodes", (NAME), nodelist_length(context->list)); \
-    nodelist *result = nodelist_map(context->list, (FUNCTION), context); \
-    evaluator_trace("%s: %s", (TEST), NULL == result ? "failed" : "completed"); \
-    evaluator_trace("%s: added %zd nodes", (NAME), nodelist_length(result)); \
-    return NULL == result ? false : (nodelist_free(context->list), context->list = result, true);
-
-static bool evaluate_recursive_step(evaluator_context *context)
-{
-    evaluate_nodelist("recursive step",
-                      test_kind_name(step_test_kind(current_step(context))),
-                      apply_recursive_node_test);
+    Node *root = document_root(document(each));
+    evaluator_trace("root test: adding root node (%p) from document (%p)", root, each);
+    return advance(at, root);
 }
 
-static bool evaluate_single_step(evaluator_context *context)
+static bool apply_recursive_node_test(Node *each, const stage *at)
 {
-    evaluate_nodelist("step",
-                      test_kind_name(step_test_kind(current_step(context))),
-                      apply_node_test);
-}
-
-static bool evaluate_predicate(evaluator_context *context)
-{
-    evaluate_nodelist("predicate",
-                      predicate_kind_name(predicate_kind(step_predicate(current_step(context)))),
-                      apply_predicate);
-}
-
-static bool apply_recursive_node_test(Node *each, void *argument, nodelist *target)
-{
-    evaluator_context *context = (evaluator_context *)argument;
+    evaluator_context *context = at->context;
     bool result = true;
     if(!is_alias(each))
     {
-        result = apply_node_test(each, argument, target);
+        result = apply_node_test(each, at);
     }
     if(result)
     {
@@ -206,15 +213,12 @@ static bool apply_recursive_node_test(Node *each, void *argument, nodelist *targ
             case MAPPING:
                 evaluator_trace("recursive step: processing %zd mapping values (%p)",
                                 node_size(each), each);
-                result = mapping_iterate(mapping(each), recursive_test_map_iterator,
-
-&(meta_context){context, target});
+                result = mapping_iterate(mapping(each), recursive_test_map_iterator, (void *)at);
                 break;
             case SEQUENCE:
                 evaluator_trace("recursive step: processing %zd sequence items (%p)",
                                 node_size(each), each);
-                result = sequence_iterate(sequence(each), recursive_test_sequence_iterator,
-                                          &(meta_context){context, target});
+                result = sequence_iterate(sequence(each), recursive_test_sequence_iterator, (void *)at);
                 break;
             case SCALAR:
                 evaluator_trace("recursive step: found scalar, recursion finished on this path (%p)", each);
@@ -227,7 +231,7 @@ static bool apply_recursive_node_test(Node *each, void *argument, nodelist *targ
                 break;
             case ALIAS:
                 evaluator_trace("recursive step: resolving alias (%p)", each);
-                result = apply_recursive_node_test(alias_target(alias(each)), argument, target);
+                result = apply_recursive_node_test(alias_target(alias(each)), at);
                 break;
         }
     }
@@ -237,66 +241,59 @@ static bool apply_recursive_node_test(Node *each, void *argument, nodelist *targ
 
 static bool recursive_test_sequence_iterator(Node *each, void *context)
 {
-    meta_context *iterator_context = (meta_context *)context;
-    return apply_recursive_node_test(each, iterator_context->context, iterator_context->target);
+    return apply_recursive_node_test(each, (const stage *)context);
 }
 
 static bool recursive_test_map_iterator(Node *key __attribute__((unused)), Node *value, void *context)
 {
-    meta_context *iterator_context = (meta_context *)context;
-    return apply_recursive_node_test(value, iterator_context->context, iterator_context->target);
+    return apply_recursive_node_test(value, (const stage *)context);
 }
 
-static bool apply_node_test(Node *each, void *argument, nodelist *target)
+static bool apply_node_test(Node *each, const stage *at)
 {
     bool result = false;
-    evaluator_context *context = (evaluator_context *)argument;
-    switch(step_test_kind(current_step(context)))
+    switch(step_test_kind(step_at(at)))
     {
         case WILDCARD_TEST:
-            if(RECURSIVE == step_kind(current_step(context)))
+            if(RECURSIVE == step_kind(step_at(at)))
             {
-                result = apply_recursive_wildcard_test(each, argument, target);
+                result = apply_recursive_wildcard_test(each, at);
             }
             else
             {
-                result = apply_greedy_wildcard_test(each, argument, target);
+                result = apply_greedy_wildcard_test(each, at);
             }
             break;
         case TYPE_TEST:
-            result = apply_type_test(each, argument, target);
+            result = apply_type_test(each, at);
             break;
         case NAME_TEST:
-            result = apply_name_test(each, argument, target);
+            result = apply_name_test(each, at);
             break;
     }
     return result;
 }
 
-static bool apply_greedy_wildcard_test(const Node *each, void *argument, nodelist *target)
+static bool apply_greedy_wildcard_test(const Node *each, const stage *at)
 {
-    evaluator_context *context = (evaluator_context *)argument;
+    evaluator_context *context = at->context;
     bool result = false;
     switch(node_kind(each))
     {
         case MAPPING:
             evaluator_trace("wildcard test: adding %zd mapping values (%p)",
                             node_size(each), each);
-            result = guard(mapping_iterate(mapping((Node *)each),
-                                           add_values_to_nodelist_map_iterator,
-                                           &(meta_context){context, target}));
+            result = mapping_iterate(mapping((Node *)each), advance_mapping_values_iterator, (void *)at);
             break;
         case SEQUENCE:
             evaluator_trace("wildcard test: adding %zd sequence items (%p)",
                             node_size(each), each);
-            result = guard(sequence_iterate(sequence((Node *)each),
-                                            add_to_nodelist_sequence_iterator,
-                                            target));
+            result = sequence_iterate(sequence((Node *)each), advance_sequence_iterator, (void *)at);
             break;
         case SCALAR:
             trace_string("wildcard test: adding scalar: '%s' (%p)",
                          scalar_value(scalar((Node *)each)), node_size(each), each);
-            result = guard(nodelist_add(target, each));
+            result = advance(at, (Node *)each);
             break;
         case DOCUMENT:
             evaluator_error("wildcard test: uh-oh! found a document node somehow (%p), aborting...", each);
@@ -304,30 +301,30 @@ static bool apply_greedy_wildcard_test(const Node *each, void *argument, nodelis
             break;
         case ALIAS:
             evaluator_trace("wildcard test: resolving alias (%p)", each);
-            result = apply_greedy_wildcard_test(alias_target(alias((Node *)each)), argument, target);
+            result = apply_greedy_wildcard_test(alias_target(alias((Node *)each)), at);
             break;
     }
     return result;
 }
 
-static bool apply_recursive_wildcard_test(const Node *each, void *argument, nodelist *target)
+static bool apply_recursive_wildcard_test(const Node *each, const stage *at)
 {
-    evaluator_context *context = (evaluator_context *)argument;
+    evaluator_context *context = at->context;
     bool result = false;
     switch(node_kind(each))
     {
         case MAPPING:
             evaluator_trace("recurisve wildcard test: adding mapping node (%p)", each);
-            result = guard(nodelist_add(target, each));
+            result = advance(at, (Node *)each);
             break;
         case SEQUENCE:
             evaluator_trace("recurisve wildcard test: adding sequence node (%p)", each);
-            result = guard(nodelist_add(target, each));
+            result = advance(at, (Node *)each);
             break;
         case SCALAR:
             trace_string("recurisve wildcard test: adding scalar: '%s' (%p)",
                          scalar_value(scalar((Node *)each)), node_size(each), each);
-            result = guard(nodelist_add(target, each));
+            result = advance(at, (Node *)each);
             break;
         case DOCUMENT:
             evaluator_error("recurisve wildcard test: uh oh! found a document node somehow (%p), aborting...", each);
@@ -335,23 +332,22 @@ static bool apply_recursive_wildcard_test(const Node *each, void *argument, node
             break;
         case ALIAS:
             evaluator_trace("recurisve wildcard test: resolving alias (%p)", each);
-            result = apply_recursive_wildcard_test(alias_target(alias((Node *)each)), argument, target);
+            result = apply_recursive_wildcard_test(alias_target(alias((Node *)each)), at);
             break;
     }
     return result;
 }
 
-static bool apply_type_test(const Node *each, void *argument, nodelist *target)
+static bool apply_type_test(const Node *each, const stage *at)
 {
     bool match = false;
     if(is_alias(each))
     {
         evaluator_trace("type test: resolved alias from: (%p) to: (%p)",
                         each, alias_target((alias((Node *)each))));
-        return apply_type_test(alias_target(alias((Node *)each)), argument, target);
+        return apply_type_test(alias_target(alias((Node *)each)), at);
     }
-    evaluator_context *context = (evaluator_context *)argument;
-    switch(type_test_step_kind(current_step(context)))
+    switch(type_test_step_kind(step_at(at)))
     {
         case OBJECT_TEST:
             evaluator_trace("type test: testing for an object");
@@ -381,7 +377,7 @@ static bool apply_type_test(const Node *each, void *argument, nodelist *target)
     if(match)
     {
         evaluator_trace("type test: match! adding node (%p)", each);
-        return nodelist_add(target, each) ? true : (context->code = ERR_EVALUATOR_OUT_OF_MEMORY, false);
+        return advance(at, (Node *)each);
     }
     else
     {
@@ -391,10 +387,9 @@ static bool apply_type_test(const Node *each, void *argument, nodelist *target)
     }
 }
 
-static bool apply_name_test(const Node *each, void *argument, nodelist *target)
+static bool apply_name_test(const Node *each, const stage *at)
 {
-    evaluator_context *context = (evaluator_context *)argument;
-    step *context_step = current_step(context);
+    step *context_step = step_at(at);
     trace_string("name test: using key '%s'", name_test_step_name(context_step), name_test_step_length(context_step));
 
     if(!is_mapping(each))
@@ -403,7 +398,10 @@ static bool apply_name_test(const Node *each, void *argument, nodelist *target)
         return true;
     }
     Mapping *map = mapping((Node *)each);
-    Node *value = mapping_get(map, name_test_step_name(context_step), name_test_step_length(context_step));
+    const Scalar *name = at->context->names[at->step];
+    Node *value = NULL != name
+        ? mapping_get_key(map, name)
+        : mapping_get(map, name_test_step_name(context_step), name_test_step_length(context_step));
     if(NULL == value)
     {
         evaluator_trace("name test: key not found in mapping, dropping (%p)", each);
@@ -416,18 +414,17 @@ static bool apply_name_test(const Node *each, void *argument, nodelist *target)
                         value, alias_target(alias((Node *)value)));
         value = alias_target(alias((Node *)value));
     }
-    return nodelist_add(target, value) ? true : (context->code = ERR_EVALUATOR_OUT_OF_MEMORY, false);
+    return advance(at, value);
 }
 
-static bool apply_predicate(Node *each, void *argument, nodelist *target)
+static bool apply_predicate(Node *each, const stage *at)
 {
-    evaluator_context *context = (evaluator_context *)argument;
     bool result = false;
-    switch(predicate_kind(step_predicate(current_step(context))))
+    switch(predicate_kind(step_predicate(step_at(at))))
     {
         case WILDCARD:
             evaluator_trace("evaluating wildcard predicate");
-            result = apply_wildcard_predicate(each, context, target);
+            result = apply_wildcard_predicate(each, at);
             break;
         case SUBSCRIPT:
             evaluator_trace("evaluating subscript predicate");
@@ -438,7 +435,7 @@ static bool apply_predicate(Node *each, void *argument, nodelist *target)
             }
             else
             {
-                result = apply_subscript_predicate(sequence(each), context, target);
+                result = apply_subscript_predicate(sequence(each), at);
             }
             break;
         case SLICE:
@@ -450,36 +447,40 @@ static bool apply_predicate(Node *each, void *argument, nodelist *target)
             }
             else
             {
-                result = apply_slice_predicate(sequence(each), context, target);
+                result = apply_slice_predicate(sequence(each), at);
             }
             break;
+        case FILTER:
+            evaluator_trace("evaluating filter predicate");
+            result = apply_filter_predicate(each, at);
+            break;
         case JOIN:
             evaluator_trace("evaluating join predicate");
-            result = apply_join_predicate(each, context, target);
+            result = apply_join_predicate(each, at);
             break;
     }
     return result;
 }
 
-static bool apply_wildcard_predicate(const Node *value, evaluator_context *context, nodelist *target)
+static bool apply_wildcard_predicate(const Node *value, const stage *at)
 {
+    evaluator_context *context = at->context;
     bool result = false;
     switch(node_kind(value))
     {
         case SCALAR:
             trace_string("wildcard predicate: adding scalar '%s' (%p)",
                          scalar_value(scalar((Node *)value)), node_size(value), value);
-            result = guard(nodelist_add(target, value));
+            result = advance(at, (Node *)value);
             break;
         case MAPPING:
             evaluator_trace("wildcard predicate: adding mapping (%p)", value);
-            result = guard(nodelist_add(target, value));
+            result = advance(at, (Node *)value);
             break;
         case SEQUENCE:
             evaluator_trace("wildcard predicate: adding %zd sequence (%p) items",
                             node_size(value), value);
-            result = guard(
-                sequence_iterate(sequence((Node *)value), add_to_nodelist_sequence_iterator, target));
+            result = sequence_iterate(sequence((Node *)value), advance_sequence_iterator, (void *)at);
             break;
         case DOCUMENT:
             evaluator_error("wildcard predicate: uh-oh! found a document node (%p), aborting...", value);
@@ -487,17 +488,17 @@ static bool apply_wildcard_predicate(const Node *value, evaluator_context *conte
             break;
         case ALIAS:
             evaluator_trace("wildcard predicate: resolving alias (%p)", value);
-            result = apply_wildcard_predicate(alias_target(alias((Node *)value)), context, target);
+            result = apply_wildcard_predicate(alias_target(alias((Node *)value)), at);
             break;
     }
     return result;
 }
 
-static bool apply_subscript_predicate(const Sequence *value, evaluator_context *context, nodelist *target)
+static bool apply_subscript_predicate(const Sequence *value, const stage *at)
 {
-    predicate *subscript = step_predicate(current_step(context));
+    predicate *subscript = step_predicate(step_at(at));
     size_t index = subscript_predicate_index(subscript);
-    if(index > node_size(value))
+    if(index >= node_size(value))
     {
         evaluator_trace("subscript predicate: index %zd not valid for sequence (length: %zd), dropping (%p)",
                         index, node_size(value), value);
@@ -506,12 +507,13 @@ static bool apply_subscript_predicate(const Sequence *value, evaluator_context *
     Node *selected = sequence_get(value, index);
     evaluator_trace("subscript predicate: adding index %zd (%p) from sequence (%p) of %zd items",
                     index, selected, value, node_size(value));
-    return nodelist_add(target, selected) ? true : (context->code = ERR_EVALUATOR_OUT_OF_MEMORY, false);
+    return advance(at, selected);
 }
 
-static bool apply_slice_predicate(const Sequence *value, evaluator_context *context, nodelist *target)
+static bool apply_slice_predicate(const Sequence *value, const stage *at)
 {
-    predicate *slice = step_predicate(current_step(context));
+    evaluator_context *context = at->context;
+    predicate *slice = step_predicate(step_at(at));
     int from = 0, to = 0, increment = 0;
     normalize_interval(value, slice, &from, &to, &increment);
     evaluator_trace("slice predicate: using normalized interval [%d:%d:%d]", from, to, increment);
@@ -519,74 +521,114 @@ static bool apply_slice_predicate(const Sequence *value, evaluator_context *cont
     for(int i = from; 0 > increment ? i >= to : i < to; i += increment)
     {
         Node *selected = sequence_get(value, (size_t)i);
-        if(NULL == selected || !nodelist_add(target, selected))
+        if(NULL == selected)
         {
-            evaluator_error("slice predicate: uh oh! out of memory, aborting. index: %d, selected: %p",
-                            i, selected);
+            evaluator_error("slice predicate: uh oh! no item at index: %d, aborting", i);
             context->code = ERR_EVALUATOR_OUT_OF_MEMORY;
             return false;
         }
         evaluator_trace("slice predicate: adding index: %d (%p)", i, selected);
+        if(!advance(at, selected))
+        {
+            return false;
+        }
     }
     return true;
 }
 
-static bool apply_join_predicate(const Node *value __attribute__((unused)), evaluator_context *context, nodelist *target __attribute__((unused)))
+static bool apply_join_predicate(const Node *value __attribute__((unused)), const stage *at)
 {
     evaluator_trace("join predicate: evaluating axes (_, _)");
 
     // xxx - implement me!
     evaluator_error("join predicate: uh-oh! not implemented yet, aborting...");
-    context->code = ERR_UNSUPPORTED_PATH;
+    at->context->code = ERR_UNSUPPORTED_PATH;
     return false;
 }
 
+static bool apply_filter_predicate(Node *value, const stage *at)
+{
+    const filter *expression = filter_predicate_expression(step_predicate(step_at(at)));
+    bool result = false;
+    switch(node_kind(value))
+    {
+        case SEQUENCE:
+            evaluator_trace("filter predicate: testing %zd sequence (%p) items", node_size(value), value);
+            result = sequence_iterate(sequence(value), filter_sequence_iterator, (void *)at);
+            break;
+        case SCALAR:
+        case MAPPING:
+            evaluator_trace("filter predicate: testing %s (%p)", node_kind_name(value), value);
+            result = !filter_matches(expression, cursor_of(value)) || advance(at, value);
+            break;
+        case ALIAS:
+            evaluator_trace("filter predicate: resolving alias (%p)", value);
+            result = apply_filter_predicate(alias_target(alias(value)), at);
+            break;
+        case DOCUMENT:
+            evaluator_error("filter predicate: uh-oh! found a document node (%p), aborting...", value);
+            at->context->code = ERR_UNEXPECTED_DOCUMENT_NODE;
+            break;
+    }
+    return result;
+}
+
+static bool filter_sequence_iterator(Node *each, void *context)
+{
+    const stage *at = (const stage *)context;
+    Node *value = is_alias(each) ? alias_target(alias(each)) : each;
+    if(!filter_matches(filter_predicate_expression(step_predicate(step_at(at))), cursor_of(value)))
+    {
+        evaluator_trace("filter predicate: dropping (%p)", value);
+        return true;
+    }
+    evaluator_trace("filter predicate: match! adding (%p)", value);
+    return advance(at, value);
+}
+
 /*
  * Utility Functions
  * =================
  */
 
-static bool add_to_nodelist_sequence_iterator(Node *each, void *context)
+static bool advance_sequence_iterator(Node *each, void *context)
 {
-    nodelist *list = (nodelist *)context;
     Node *value = each;
     if(is_alias(each))
     {
         value = alias_target(alias(each));
     }
-    return nodelist_add(list, value);
+    return advance((const stage *)context, value);
 }
 
-static bool add_values_to_nodelist_map_iterator(Node *key __attribute__((unused)), Node *value, void *context)
+static bool advance_mapping_values_iterator(Node *key __attribute__((unused)), Node *value, void *context)
 {
-    meta_context *iterator_context = (meta_context *)context;
+    const stage *at = (const stage *)context;
     bool result = false;
     switch(node_kind(value))
     {
         case SCALAR:
             trace_string("wildcard test: adding scalar mapping value: '%s' (%p)",
                          scalar_value(scalar(value)), node_size(value), value);
-            result = nodelist_add(iterator_context->target, value);
+            result = advance(at, value);
             break;
         case MAPPING:
             evaluator_trace("wildcard test: adding mapping mapping value (%p)", value);
-            result = nodelist_add(iterator_context->target, value);
+            result = advance(at, value);
             break;
         case SEQUENCE:
             evaluator_trace("wildcard test: adding %zd sequence mapping values (%p) items",
                             node_size(value), value);
-            result = sequence_iterate(sequence(value),
-                                      add_to_nodelist_sequence_iterator,
-                                      iterator_context->target);
+            result = sequence_iterate(sequence(value), advance_sequence_iterator, context);
             break;
         case DOCUMENT:
             evaluator_error("wildcard test: uh-oh! found a document node (%p), aborting...", value);
-            iterator_context->context->code = ERR_UNEXPECTED_DOCUMENT_NODE;
+            at->context->code = ERR_UNEXPECTED_DOCUMENT_NODE;
             result = false;
             break;
         case ALIAS:
             evaluator_trace("wildcard test: resolving alias (%p)", value);
-            result = add_values_to_nodelist_map_iterator(key, alias_target(alias(value)), context);
+            result = advance_mapping_values_iterator(key, alias_target(alias(value)), context);
             break;
     }
     return result;
@@ -0,0 +1,403 @@
+/*
+ * 金棒 (kanabō)
+ * Copyright (c) 2012 Kevin Birch <kmb@pobox.com>.  All rights reserved.
+ *
+ * 金棒 is a tool to bludgeon YAML and JSON files from the shell: the strong
+ * made stronger.
+ *
+ * For more information, consult the README file in the project root.
+ *
+ * Distributed under an [MIT-style][license] license.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal with
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * - Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimers.
+ * - Redistributions in binary form must reproduce the above copyright notice, this
+ *   list of conditions and the following disclaimers in the documentation and/or
+ *   other materials provided with the distribution.
+ * - Neither the names of the copyright holders, nor the names of the authors, nor
+ *   the names of other contributors may be used to endorse or promote products
+ *   derived from this Software without specific prior written permission.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE CONTRIBUTORS
+ * OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS WITH THE SOFTWARE.
+ *
+ * [license]: http://www.opensource.org/licenses/ncsa
+ */
+
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "evaluator/private.h"
+#include "model/private.h"
+
+/*
+ * Filter values follow the usual JSONPath rules: values of different kinds
+ * are never equal, only numbers and strings are ordered, and a path that
+ * selects nothing is a value of its own that is equal only to another one.
+ * So `!=' is true wherever `==' is false, while the ordering operators are
+ * false for anything that isn't ordered.
+ */
+enum value_kind
+{
+    NOTHING_VALUE,
+    NODE_VALUE,
+    NUMBER_VALUE,
+    STRING_VALUE,
+    BOOLEAN_VALUE,
+    NULL_VALUE
+};
+
+struct value
+{
+    enum value_kind kind;
+    union
+    {
+        Cursor  node;
+        double  number;
+        bool    boolean;
+        struct
+        {
+            const uint8_t *bytes;
+            size_t         length;
+        } string;
+    };
+};
+
+typedef struct value value;
+
+static inline Cursor resolve(Cursor each)
+{
+    return cursor_is_none(each) ? each : cursor_resolve(each);
+}
+
+static value node_value(Cursor each)
+{
+    each = resolve(each);
+    if(cursor_is_none(each))
+    {
+        return (value){.kind=NOTHING_VALUE};
+    }
+    if(!cursor_is_scalar(each))
+    {
+        return (value){.kind=NODE_VALUE, .node=each};
+    }
+
+    switch(cursor_scalar_kind(each))
+    {
+        case SCALAR_INTEGER:
+        case SCALAR_REAL:
+        {
+            double number;
+            if(cursor_number(each, &number))
+            {
+                return (value){.kind=NUMBER_VALUE, .number=number};
+            }
+            break;
+        }
+        case SCALAR_BOOLEAN:
+            return (value){.kind=BOOLEAN_VALUE, .boolean=cursor_boolean_is_true(each)};
+        case SCALAR_NULL:
+            return (value){.kind=NULL_VALUE};
+        case SCALAR_STRING:
+        case SCALAR_TIMESTAMP:
+        case SCALAR_UNRESOLVED:
+            break;
+    }
+    return (value){.kind=STRING_VALUE, .string={cursor_value(each), cursor_size(each)}};
+}
+
+static Cursor follow_path(const jsonpath *path, Cursor each)
+{
+    for(size_t i = 0; !cursor_is_none(each) && i < path_length(path); i++)
+    {
+        each = cursor_resolve(each);
+        if(!cursor_is_mapping(each))
+        {
+            return cursor_none_like(each);
+        }
+        step *name = path_get(path, i);
+        each = cursor_mapping_get(each, name_test_step_name(name), name_test_step_length(name));
+    }
+    return resolve(each);
+}
+
+static value constant_value(const operand *term)
+{
+    switch(operand_kind(term))
+    {
+        case PATH_OPERAND:
+            break;
+        case NUMBER_OPERAND:
+            return (value){.kind=NUMBER_VALUE, .number=number_operand(term)};
+        case STRING_OPERAND:
+            return (value){.kind=STRING_VALUE, .string={string_operand(term), string_operand_length(term)}};
+        case BOOLEAN_OPERAND:
+            return (value){.kind=BOOLEAN_VALUE, .boolean=boolean_operand(term)};
+        case NULL_OPERAND:
+            return (value){.kind=NULL_VALUE};
+    }
+    return (value){.kind=NOTHING_VALUE};
+}
+
+static value operand_value(const operand *term, Cursor each)
+{
+    if(PATH_OPERAND == operand_kind(term))
+    {
+        return node_value(follow_path(path_operand(term), each));
+    }
+    return constant_value(term);
+}
+
+// N.B. - comparing doubles exactly is what `==' in a filter means, as in the block kernel below
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wfloat-equal"
+
+static bool compare_numbers(enum comparison_operator op, double left, double right)
+{
+    switch(op)
+    {
+        case EQUAL_TO:
+            return left == right;
+        case NOT_EQUAL_TO:
+            return left != right;
+        case LESS_THAN:
+            return left < right;
+        case LESS_THAN_OR_EQUAL_TO:
+            return left <= right;
+        case GREATER_THAN:
+            return left > right;
+        case GREATER_THAN_OR_EQUAL_TO:
+            return left >= right;
+    }
+    return false;
+}
+
+static bool values_equal(const value *left, const value *right)
+{
+    if(left->kind != right->kind)
+    {
+        return false;
+    }
+    switch(left->kind)
+    {
+        case NOTHING_VALUE:
+        case NULL_VALUE:
+            return true;
+        case NODE_VALUE:
+            return cursor_equals(left->node, right->node);
+        case NUMBER_VALUE:
+            return left->number == right->number;
+        case STRING_VALUE:
+            return left->string.length == right->string.length
+                && 0 == memcmp(left->string.bytes, right->string.bytes, left->string.length);
+        case BOOLEAN_VALUE:
+            return left->boolean == right->boolean;
+    }
+    return false;
+}
+
+#pragma GCC diagnostic pop
+
+static int compare_strings(const value *left, const value *right)
+{
+    size_t length = left->string.length < right->string.length ? left->string.length : right->string.length;
+    int result = memcmp(left->string.bytes, right->string.bytes, length);
+    if(0 != result)
+    {
+        return result;
+    }
+    return left->string.length < right->string.length ? -1 : left->string.length > right->string.length ? 1 : 0;
+}
+
+static bool compare_values(enum comparison_operator op, const value *left, const value *right)
+{
+    if(EQUAL_TO == op)
+    {
+        return values_equal(left, right);
+    }
+    if(NOT_EQUAL_TO == op)
+    {
+        return !values_equal(left, right);
+    }
+    if(NUMBER_VALUE == left->kind && NUMBER_VALUE == right->kind)
+    {
+        return compare_numbers(op, left->number, right->number);
+    }
+    if(STRING_VALUE == left->kind && STRING_VALUE == right->kind)
+    {
+        return compare_numbers(op, compare_strings(left, right), 0);
+    }
+    return false;
+}
+
+bool filter_matches(const filter *expression, Cursor each)
+{
+    switch(filter_kind(expression))
+    {
+        case OR_FILTER:
+            return filter_matches(filter_left(expression), each) || filter_matches(filter_right(expression), each);
+        case AND_FILTER:
+            return filter_matches(filter_left(expression), each) && filter_matches(filter_right(expression), each);
+        case NOT_FILTER:
+            return !filter_matches(filter_negated(expression), each);
+        case EXISTS_FILTER:
+            return !cursor_is_none(follow_path(path_operand(exists_filter_operand(expression)), each));
+        case COMPARISON_FILTER:
+        {
+            value left = operand_value(comparison_filter_left(expression), each);
+            value right = operand_value(comparison_filter_right(expression), each);
+            return compare_values(comparison_filter_operator(expression), &left, &right);
+        }
+    }
+    return false;
+}
+
+static enum comparison_operator mirror(enum comparison_operator op)
+{
+    switch(op)
+    {
+        case LESS_THAN:
+            return GREATER_THAN;
+        case LESS_THAN_OR_EQUAL_TO:
+            return GREATER_THAN_OR_EQUAL_TO;
+        case GREATER_THAN:
+            return LESS_THAN;
+        case GREATER_THAN_OR_EQUAL_TO:
+            return LESS_THAN_OR_EQUAL_TO;
+        case EQUAL_TO:
+        case NOT_EQUAL_TO:
+            break;
+    }
+    return op;
+}
+
+bool compile_field_comparison(field_comparison *target, const DocumentModel *model, const filter *expression)
+{
+    if(COMPARISON_FILTER != filter_kind(expression))
+    {
+        return false;
+    }
+    const operand *field = comparison_filter_left(expression);
+    const operand *number = comparison_filter_right(expression);
+    target->op = comparison_filter_operator(expression);
+    if(NUMBER_OPERAND == operand_kind(field) && PATH_OPERAND == operand_kind(number))
+    {
+        const operand *swap = field;
+        field = number;
+        number = swap;
+        target->op = mirror(target->op);
+    }
+    if(PATH_OPERAND != operand_kind(field) || NUMBER_OPERAND != operand_kind(number) || 1 < path_length(path_operand(field)))
+    {
+        return false;
+    }
+    target->number = number_operand(number);
+
+    target->key = NULL;
+    if(1 == path_length(path_operand(field)))
+    {
+        step *name = path_get(path_operand(field), 0);
+        target->key = NULL == model ? NULL : model_symbol(model, name_test_step_name(name), name_test_step_length(name));
+        if(NULL == target->key)
+        {
+            scalar_init_probe(&target->probe, name_test_step_name(name), name_test_step_length(name));
+            target->key = &target->probe;
+        }
+    }
+    return true;
+}
+
+void gather_field(const field_comparison *test, const Cursor *items, size_t count, double *values)
+{
+    for(size_t i = 0; i < count; i++)
+    {
+        Cursor each = resolve(items[i]);
+        if(NULL != test->key)
+        {
+            each = resolve(cursor_mapping_get_key(each, test->key));
+        }
+        // N.B. - NaN compares false with everything but `!=', just as values of another kind do
+        values[i] = NAN;
+        if(!cursor_is_none(each) && cursor_is_number(each))
+        {
+            double number;
+            if(cursor_number(each, &number))
+            {
+                values[i] = number;
+            }
+        }
+    }
+}
+
+/*
+ * The comparison is made four lanes at a time with the compiler's vector
+ * extensions where they are available, and one value at a time for the rest
+ * of the block or with other compilers.
+ */
+#if defined(__GNUC__) && !defined(NO_VECTOR_EXTENSIONS)
+#define USE_VECTOR_EXTENSIONS
+#endif
+
+#ifdef USE_VECTOR_EXTENSIONS
+#define LANES 4
+typedef double  lanes __attribute__((vector_size(LANES * sizeof(double))));
+typedef int64_t lane_mask __attribute__((vector_size(LANES * sizeof(int64_t))));
+
+#define COMPARE_LANES(OPERATOR)                                         \
+    for(; i + LANES <= count; i += LANES)                               \
+    {                                                                   \
+        lanes each;                                                     \
+        memcpy(&each, values + i, sizeof(each));                        \
+        lane_mask result = each OPERATOR limit;                         \
+        for(size_t j = 0; j < LANES; j++)                               \
+        {                                                               \
+            keep[i + j] = (uint8_t)(result[j] & 1);                     \
+        }                                                               \
+    }                                                                   \
+    break
+#endif
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wfloat-equal"
+
+void compare_field_block(enum comparison_operator op, double number, const double *values, size_t count, uint8_t *keep)
+{
+    size_t i = 0;
+#ifdef USE_VECTOR_EXTENSIONS
+    lanes limit = {number, number, number, number};
+    switch(op)
+    {
+        case EQUAL_TO:
+            COMPARE_LANES(==);
+        case NOT_EQUAL_TO:
+            COMPARE_LANES(!=);
+        case LESS_THAN:
+            COMPARE_LANES(<);
+        case LESS_THAN_OR_EQUAL_TO:
+            COMPARE_LANES(<=);
+        case GREATER_THAN:
+            COMPARE_LANES(>);
+        case GREATER_THAN_OR_EQUAL_TO:
+            COMPARE_LANES(>=);
+    }
+#endif
+    for(; i < count; i++)
+    {
+        keep[i] = compare_numbers(op, values[i], number);
+    }
+}
+
+#pragma GCC diagnostic pop
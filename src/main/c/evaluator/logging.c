@@ -50,6 +50,7 @@ static const char * const MESSAGES[] =
     "Out of memory",
     "Found a document node embedded in the tree",
     "The path is not supported",
+    "Stopped by the consumer of the results",
 };
 
 
@@ -0,0 +1,232 @@
+/*
+ * 金棒 (kanabō)
+ * Copyright (c) 2012 Kevin Birch <kmb@pobox.com>.  All rights reserved.
+ *
+ * 金棒 is a tool to bludgeon YAML and JSON files from the shell: the strong
+ * made stronger.
+ *
+ * For more information, consult the README file in the project root.
+ *
+ * Distributed under an [MIT-style][license] license.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal with
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * - Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimers.
+ * - Redistributions in binary form must reproduce the above copyright notice, this
+ *   list of conditions and the following disclaimers in the documentation and/or
+ *   other materials provided with the distribution.
+ * - Neither the names of the copyright holders, nor the names of the authors, nor
+ *   the names of other contributors may be used to endorse or promote products
+ *   derived from this Software without specific prior written permission.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE CONTRIBUTORS
+ * OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS WITH THE SOFTWARE.
+ *
+ * [license]: http://www.opensource.org/licenses/ncsa
+ */
+
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <unistd.h>
+
+#include "evaluator/private.h"
+
+/*
+ * Documents are independent of each other, so each worker thread claims the
+ * next unclaimed document, evaluates it into a nodelist of its own and moves
+ * on.  The calling thread waits for the documents in order and hands their
+ * results to the sink as each one completes, so the output is the same as
+ * evaluating the documents in turn while later documents are still being
+ * evaluated.
+ */
+
+struct document_results
+{
+    nodelist              *list;
+    evaluator_status_code  code;
+    bool                   done;
+};
+
+struct document_queue
+{
+    const DocumentModel     *model;
+    const jsonpath          *path;
+    const program           *code;
+    size_t                   limit;
+    size_t                   count;
+    /** the next document to be claimed by a worker */
+    atomic_size_t            next;
+    /** set when the results are no longer wanted, so workers stop claiming documents */
+    atomic_bool              stopped;
+    pthread_mutex_t          lock;
+    pthread_cond_t           finished;
+    struct document_results *results;
+};
+
+struct collector
+{
+    nodelist *list;
+    size_t    remaining;
+};
+
+static bool collect_iterator(Node *each, void *context)
+{
+    struct collector *collector = (struct collector *)context;
+    if(!nodelist_add(collector->list, each))
+    {
+        return false;
+    }
+    // N.B. - no document needs more results than the whole evaluation will hand on
+    return 0 != --collector->remaining;
+}
+
+static evaluator_status_code collect_document(struct document_queue *queue, size_t index, nodelist *list)
+{
+    Document *document = model_document(queue->model, index);
+    if(NULL == document_root(document))
+    {
+        return EVALUATOR_SUCCESS;
+    }
+    struct collector collector = {list, 0 == queue->limit ? SIZE_MAX : queue->limit};
+    evaluator_status_code code = evaluate_document(queue->model, queue->path, queue->code, document, collect_iterator, &collector);
+    if(ERR_EVALUATION_STOPPED == code)
+    {
+        // N.B. - the only other way the list refuses a node is by running out of memory
+        code = 0 == collector.remaining ? EVALUATOR_SUCCESS : ERR_EVALUATOR_OUT_OF_MEMORY;
+    }
+    return code;
+}
+
+static void *document_worker(void *argument)
+{
+    struct document_queue *queue = (struct document_queue *)argument;
+    while(!atomic_load(&queue->stopped))
+    {
+        size_t index = atomic_fetch_add(&queue->next, 1);
+        if(index >= queue->count)
+        {
+            break;
+        }
+        nodelist *list = make_nodelist();
+        evaluator_status_code code = NULL == list ? ERR_EVALUATOR_OUT_OF_MEMORY : collect_document(queue, index, list);
+
+        pthread_mutex_lock(&queue->lock);
+        queue->results[index] = (struct document_results){list, code, true};
+        pthread_cond_broadcast(&queue->finished);
+        pthread_mutex_unlock(&queue->lock);
+    }
+    return NULL;
+}
+
+size_t evaluator_threads(size_t threads)
+{
+    if(0 == threads)
+    {
+        long online = sysconf(_SC_NPROCESSORS_ONLN);
+        threads = 0 < online ? (size_t)online : 1;
+    }
+    return threads;
+}
+
+static evaluator_status_code hand_on(struct document_queue *queue, nodelist_iterator sink, void *context)
+{
+    for(size_t i = 0; i < queue->count; i++)
+    {
+        pthread_mutex_lock(&queue->lock);
+        while(!queue->results[i].done)
+        {
+            pthread_cond_wait(&queue->finished, &queue->lock);
+        }
+        struct document_results each = queue->results[i];
+        pthread_mutex_unlock(&queue->lock);
+
+        if(EVALUATOR_SUCCESS != each.code)
+        {
+            evaluator_debug("aborted at document %zd", i);
+            return each.code;
+        }
+        bool accepted = nodelist_iterate(each.list, sink, context);
+        // N.B. - a document that has been handed on won't be claimed again, so its list can go now
+        nodelist_free(each.list);
+        queue->results[i].list = NULL;
+        if(!accepted)
+        {
+            evaluator_debug("stopped at document %zd by the sink", i);
+            return ERR_EVALUATION_STOPPED;
+        }
+    }
+    return EVALUATOR_SUCCESS;
+}
+
+evaluator_status_code evaluate_documents(const DocumentModel *model, const jsonpath *path, const program *code,
+                                         size_t threads, size_t limit, nodelist_iterator sink, void *context)
+{
+    size_t count = model_size(model);
+    struct document_queue queue =
+        {
+            .model = model,
+            .path = path,
+            .code = code,
+            .limit = limit,
+            .count = count,
+            .results = calloc(count, sizeof(struct document_results))
+        };
+    if(NULL == queue.results)
+    {
+        return ERR_EVALUATOR_OUT_OF_MEMORY;
+    }
+    atomic_init(&queue.next, 0);
+    atomic_init(&queue.stopped, false);
+    pthread_mutex_init(&queue.lock, NULL);
+    pthread_cond_init(&queue.finished, NULL);
+
+    size_t wanted = evaluator_threads(threads);
+    wanted = wanted < count ? wanted : count;
+    pthread_t *workers = calloc(wanted, sizeof(pthread_t));
+    size_t started = 0;
+    for(; NULL != workers && started < wanted; started++)
+    {
+        if(0 != pthread_create(workers + started, NULL, document_worker, &queue))
+        {
+            break;
+        }
+    }
+    evaluator_debug("evaluating %zd documents on %zd threads", count, started);
+    if(0 == started)
+    {
+        // N.B. - without any workers the calling thread evaluates every document itself first
+        document_worker(&queue);
+    }
+
+    evaluator_status_code result = hand_on(&queue, sink, context);
+
+    atomic_store(&queue.stopped, true);
+    for(size_t i = 0; i < started; i++)
+    {
+        pthread_join(workers[i], NULL);
+    }
+    free(workers);
+    for(size_t i = 0; i < count; i++)
+    {
+        nodelist_free(queue.results[i].list);
+    }
+    pthread_cond_destroy(&queue.finished);
+    pthread_mutex_destroy(&queue.lock);
+    free(queue.results);
+
+    return result;
+}
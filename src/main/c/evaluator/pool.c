@@ -0,0 +1,433 @@
+/*
+ * 金棒 (kanabō)
+ * Copyright (c) 2012 Kevin Birch <kmb@pobox.com>.  All rights reserved.
+ *
+ * 金棒 is a tool to bludgeon YAML and JSON files from the shell: the strong
+ * made stronger.
+ *
+ * For more information, consult the README file in the project root.
+ *
+ * Distributed under an [MIT-style][license] license.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal with
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * - Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimers.
+ * - Redistributions in binary form must reproduce the above copyright notice, this
+ *   list of conditions and the following disclaimers in the documentation and/or
+ *   other materials provided with the distribution.
+ * - Neither the names of the copyright holders, nor the names of the authors, nor
+ *   the names of other contributors may be used to endorse or promote products
+ *   derived from this Software without specific prior written permission.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE CONTRIBUTORS
+ * OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS WITH THE SOFTWARE.
+ *
+ * [license]: http://www.opensource.org/licenses/ncsa
+ */
+
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <string.h>
+
+#include "evaluator/private.h"
+
+/*
+ * Ordered fork/join on a work-stealing pool.
+ *
+ * Each worker owns a deque of tasks.  A task that forks pushes the new task
+ * on the bottom of its worker's deque, and the worker takes its next task
+ * from the bottom too, so it carries on with the most recently forked, and
+ * most local, work.  An idle worker steals from the top of another worker's
+ * deque, taking the oldest and usually largest task there.
+ *
+ * Results are not handed to the sink while tasks are running.  A task's
+ * output is a sequence of pieces, each either a node it emitted or a task it
+ * forked at that point, so once every task has finished the pieces are walked
+ * depth first and the nodes come out in the order a single thread would have
+ * found them.
+ */
+
+struct piece
+{
+    Node *node;
+    task *child;
+};
+
+struct task
+{
+    task_function  function;
+    void          *argument;
+    /** the worker running the task, whose deque its forks are pushed on */
+    size_t         worker;
+    struct piece  *pieces;
+    size_t         length;
+    size_t         capacity;
+};
+
+struct deque
+{
+    pthread_mutex_t lock;
+    task          **tasks;
+    /** tasks are stolen from `top' and pushed and popped at `bottom' */
+    size_t          top;
+    size_t          bottom;
+    size_t          capacity;
+};
+
+struct task_pool
+{
+    size_t                threads;
+    size_t                started;
+    pthread_t            *workers;
+    struct deque         *deques;
+    /** tasks forked but not finished yet, the pool is done when none are left */
+    atomic_size_t         pending;
+    /** tasks waiting in a deque, which idle workers sleep until there are some of */
+    atomic_size_t         queued;
+    /** the first failure of any task, after which the rest skip their work */
+    _Atomic int           code;
+    pthread_mutex_t       lock;
+    pthread_cond_t        work;
+};
+
+struct worker_start
+{
+    task_pool *pool;
+    size_t     id;
+};
+
+static void *worker_main(void *argument);
+
+static task *make_task(task_function function, void *argument)
+{
+    task *result = calloc(1, sizeof(task));
+    if(NULL != result)
+    {
+        result->function = function;
+        result->argument = argument;
+    }
+    return result;
+}
+
+static void task_free(task *self)
+{
+    for(size_t i = 0; i < self->length; i++)
+    {
+        if(NULL != self->pieces[i].child)
+        {
+            task_free(self->pieces[i].child);
+        }
+    }
+    free(self->pieces);
+    free(self->argument);
+    free(self);
+}
+
+static bool add_piece(task *self, Node *each, task *child)
+{
+    if(self->length == self->capacity)
+    {
+        size_t capacity = 0 == self->capacity ? 16 : self->capacity * 2;
+        struct piece *pieces = realloc(self->pieces, capacity * sizeof(struct piece));
+        if(NULL == pieces)
+        {
+            return false;
+        }
+        self->pieces = pieces;
+        self->capacity = capacity;
+    }
+    self->pieces[self->length++] = (struct piece){each, child};
+    return true;
+}
+
+static bool push(struct deque *self, task *each)
+{
+    pthread_mutex_lock(&self->lock);
+    if(self->bottom == self->capacity)
+    {
+        // N.B. - slide the live tasks down before growing, stolen tasks leave a gap at the top
+        size_t live = self->bottom - self->top;
+        if(0 != live)
+        {
+            memmove(self->tasks, self->tasks + self->top, live * sizeof(task *));
+        }
+        self->top = 0;
+        self->bottom = live;
+        if(live == self->capacity)
+        {
+            size_t capacity = 0 == self->capacity ? 64 : self->capacity * 2;
+            task **tasks = realloc(self->tasks, capacity * sizeof(task *));
+            if(NULL == tasks)
+            {
+                pthread_mutex_unlock(&self->lock);
+                return false;
+            }
+            self->tasks = tasks;
+            self->capacity = capacity;
+        }
+    }
+    self->tasks[self->bottom++] = each;
+    pthread_mutex_unlock(&self->lock);
+    return true;
+}
+
+static task *pop(struct deque *self)
+{
+    task *result = NULL;
+    pthread_mutex_lock(&self->lock);
+    if(self->bottom > self->top)
+    {
+        result = self->tasks[--self->bottom];
+    }
+    pthread_mutex_unlock(&self->lock);
+    return result;
+}
+
+static task *steal(struct deque *self)
+{
+    task *result = NULL;
+    pthread_mutex_lock(&self->lock);
+    if(self->bottom > self->top)
+    {
+        result = self->tasks[self->top++];
+    }
+    pthread_mutex_unlock(&self->lock);
+    return result;
+}
+
+static void fail(task_pool *pool, evaluator_status_code code)
+{
+    int expected = EVALUATOR_SUCCESS;
+    atomic_compare_exchange_strong(&pool->code, &expected, (int)code);
+}
+
+static task *find_task(task_pool *pool, size_t id)
+{
+    task *result = pop(pool->deques + id);
+    for(size_t i = 1; NULL == result && i < pool->threads; i++)
+    {
+        result = steal(pool->deques + (id + i) % pool->threads);
+    }
+    if(NULL != result)
+    {
+        atomic_fetch_sub(&pool->queued, 1);
+    }
+    return result;
+}
+
+static void run_task(task_pool *pool, size_t id, task *each)
+{
+    each->worker = id;
+    if(!task_pool_failed(pool))
+    {
+        evaluator_status_code code = each->function(pool, each, each->argument);
+        if(EVALUATOR_SUCCESS != code)
+        {
+            fail(pool, code);
+        }
+    }
+    if(1 == atomic_fetch_sub(&pool->pending, 1))
+    {
+        pthread_mutex_lock(&pool->lock);
+        pthread_cond_broadcast(&pool->work);
+        pthread_mutex_unlock(&pool->lock);
+    }
+}
+
+static void work(task_pool *pool, size_t id)
+{
+    for(;;)
+    {
+        task *each = find_task(pool, id);
+        if(NULL != each)
+        {
+            run_task(pool, id, each);
+            continue;
+        }
+        pthread_mutex_lock(&pool->lock);
+        while(0 == atomic_load(&pool->queued) && 0 != atomic_load(&pool->pending))
+        {
+            pthread_cond_wait(&pool->work, &pool->lock);
+        }
+        pthread_mutex_unlock(&pool->lock);
+        if(0 == atomic_load(&pool->pending))
+        {
+            return;
+        }
+    }
+}
+
+static void *worker_main(void *argument)
+{
+    struct worker_start *start = (struct worker_start *)argument;
+    work(start->pool, start->id);
+    free(start);
+    return NULL;
+}
+
+static void start_workers(task_pool *pool)
+{
+    pool->workers = calloc(pool->threads, sizeof(pthread_t));
+    if(NULL == pool->workers)
+    {
+        return;
+    }
+    // N.B. - the calling thread is worker zero
+    for(size_t id = 1; id < pool->threads; id++)
+    {
+        struct worker_start *start = malloc(sizeof(struct worker_start));
+        if(NULL == start)
+        {
+            break;
+        }
+        *start = (struct worker_start){pool, id};
+        if(0 != pthread_create(pool->workers + id, NULL, worker_main, start))
+        {
+            free(start);
+            break;
+        }
+        pool->started = id;
+    }
+    evaluator_debug("started %zd workers to share the evaluation", pool->started);
+}
+
+task_pool *make_task_pool(size_t threads)
+{
+    task_pool *result = calloc(1, sizeof(task_pool));
+    if(NULL == result)
+    {
+        return NULL;
+    }
+    result->threads = 0 == threads ? 1 : threads;
+    result->deques = calloc(result->threads, sizeof(struct deque));
+    if(NULL == result->deques)
+    {
+        free(result);
+        return NULL;
+    }
+    for(size_t i = 0; i < result->threads; i++)
+    {
+        pthread_mutex_init(&result->deques[i].lock, NULL);
+    }
+    atomic_init(&result->pending, 0);
+    atomic_init(&result->queued, 0);
+    atomic_init(&result->code, EVALUATOR_SUCCESS);
+    pthread_mutex_init(&result->lock, NULL);
+    pthread_cond_init(&result->work, NULL);
+    return result;
+}
+
+void task_pool_free(task_pool *self)
+{
+    if(NULL == self)
+    {
+        return;
+    }
+    for(size_t i = 0; i < self->threads; i++)
+    {
+        free(self->deques[i].tasks);
+        pthread_mutex_destroy(&self->deques[i].lock);
+    }
+    free(self->deques);
+    free(self->workers);
+    pthread_cond_destroy(&self->work);
+    pthread_mutex_destroy(&self->lock);
+    free(self);
+}
+
+bool task_pool_failed(task_pool *self)
+{
+    return EVALUATOR_SUCCESS != atomic_load(&self->code);
+}
+
+bool task_emit(task *self, Node *each)
+{
+    return add_piece(self, each, NULL);
+}
+
+bool task_fork(task_pool *pool, task *self, task_function function, void *argument)
+{
+    task *child = make_task(function, argument);
+    if(NULL == child)
+    {
+        free(argument);
+        return false;
+    }
+    if(!add_piece(self, NULL, child))
+    {
+        task_free(child);
+        return false;
+    }
+    // N.B. - workers are only started by the first fork, which is always made on the calling thread
+    if(NULL == pool->workers && 1 < pool->threads)
+    {
+        start_workers(pool);
+    }
+    atomic_fetch_add(&pool->pending, 1);
+    if(!push(pool->deques + self->worker, child))
+    {
+        // N.B. - the child is already in the output, so it is finished without being run
+        atomic_fetch_sub(&pool->pending, 1);
+        return false;
+    }
+    atomic_fetch_add(&pool->queued, 1);
+    pthread_mutex_lock(&pool->lock);
+    pthread_cond_signal(&pool->work);
+    pthread_mutex_unlock(&pool->lock);
+    return true;
+}
+
+static bool hand_on(const task *self, nodelist_iterator sink, void *context)
+{
+    for(size_t i = 0; i < self->length; i++)
+    {
+        const struct piece *each = self->pieces + i;
+        if(NULL != each->child ? !hand_on(each->child, sink, context) : !sink(each->node, context))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+evaluator_status_code task_pool_run(task_pool *self, task_function function, void *argument, nodelist_iterator sink, void *context)
+{
+    task *root = make_task(function, argument);
+    if(NULL == root)
+    {
+        free(argument);
+        return ERR_EVALUATOR_OUT_OF_MEMORY;
+    }
+    atomic_store(&self->code, EVALUATOR_SUCCESS);
+    atomic_store(&self->pending, 1);
+    run_task(self, 0, root);
+    work(self, 0);
+    for(size_t id = 1; id <= self->started; id++)
+    {
+        pthread_join(self->workers[id], NULL);
+    }
+    free(self->workers);
+    self->workers = NULL;
+    self->started = 0;
+
+    evaluator_status_code result = (evaluator_status_code)atomic_load(&self->code);
+    if(EVALUATOR_SUCCESS == result && !hand_on(root, sink, context))
+    {
+        result = ERR_EVALUATION_STOPPED;
+    }
+    task_free(root);
+    return result;
+}
@@ -0,0 +1,424 @@
+/*
+ * 金棒 (kanabō)
+ * Copyright (c) 2012 Kevin Birch <kmb@pobox.com>.  All rights reserved.
+ *
+ * 金棒 is a tool to bludgeon YAML and JSON files from the shell: the strong
+ * made stronger.
+ *
+ * For more information, consult the README file in the project root.
+ *
+ * Distributed under an [MIT-style][license] license.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal with
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * - Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimers.
+ * - Redistributions in binary form must reproduce the above copyright notice, this
+ *   list of conditions and the following disclaimers in the documentation and/or
+ *   other materials provided with the distribution.
+ * - Neither the names of the copyright holders, nor the names of the authors, nor
+ *   the names of other contributors may be used to endorse or promote products
+ *   derived from this Software without specific prior written permission.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE CONTRIBUTORS
+ * OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS WITH THE SOFTWARE.
+ *
+ * [license]: http://www.opensource.org/licenses/ncsa
+ */
+
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "evaluator/private.h"
+#include "model/private.h"
+#include "conditions.h"
+
+
+static size_t instruction_count(const jsonpath *path)
+{
+    size_t result = 1;  // the closing yield
+    for(size_t i = 0; i < path_length(path); i++)
+    {
+        step *each = path_get(path, i);
+        result += RECURSIVE == step_kind(each) ? 2 : 1;
+        if(step_has_predicate(each))
+        {
+            result++;
+        }
+    }
+    return result;
+}
+
+static void compile_name(instruction *target, enum opcode opcode, const DocumentModel *model, step *each)
+{
+    uint8_t *name = name_test_step_name(each);
+    size_t length = name_test_step_length(each);
+
+    target->opcode = opcode;
+    // N.B. - with the model's own key, finding the name in a mapping never has to hash or compare its bytes
+    target->operand.name.key = NULL == model ? NULL : model_symbol(model, name, length);
+    if(NULL == target->operand.name.key)
+    {
+        scalar_init_probe(&target->operand.name.probe, name, length);
+        target->operand.name.key = &target->operand.name.probe;
+    }
+}
+
+/*
+ * Building the name index costs a few walks of the model, so the first query
+ * walks it and the index is built for the second, as in interactive mode.  A
+ * model shared by threads has its index built, or found unavailable, up front,
+ * and is then never written.
+ */
+static bool use_name_index(const DocumentModel *model)
+{
+    if(NULL == model)
+    {
+        return false;
+    }
+    if(NAME_INDEX_UNBUILT != model->names.state)
+    {
+        return NAME_INDEX_READY == model->names.state;
+    }
+    // N.B. - the model is left unchanged besides the index and its count of queries wanting it
+    DocumentModel *indexed = (DocumentModel *)model;
+    return 0 < indexed->names.wanted++ && model_index_names(indexed);
+}
+
+static instruction *compile_test(instruction *target, const DocumentModel *model, step *each)
+{
+    if(ROOT == step_kind(each))
+    {
+        target->opcode = OP_ROOT;
+        return target + 1;
+    }
+    if(RECURSIVE == step_kind(each) && NAME_TEST == step_test_kind(each) && use_name_index(model))
+    {
+        compile_name(target, OP_FIND, model, each);
+        return target + 1;
+    }
+    if(RECURSIVE == step_kind(each))
+    {
+        target->opcode = OP_DESCEND;
+        target++;
+    }
+    switch(step_test_kind(each))
+    {
+        case WILDCARD_TEST:
+            target->opcode = RECURSIVE == step_kind(each) ? OP_SELF : OP_CHILDREN;
+            break;
+        case NAME_TEST:
+            compile_name(target, OP_NAME, model, each);
+            break;
+        case TYPE_TEST:
+            target->opcode = OP_TYPE;
+            target->operand.type = type_test_step_kind(each);
+            break;
+    }
+    return target + 1;
+}
+
+static instruction *compile_predicate(instruction *target, const DocumentModel *model, const predicate *value)
+{
+    switch(predicate_kind(value))
+    {
+        case WILDCARD:
+            target->opcode = OP_ITEMS;
+            break;
+        case SUBSCRIPT:
+            target->opcode = OP_SUBSCRIPT;
+            target->operand.index = subscript_predicate_index(value);
+            break;
+        case SLICE:
+            target->opcode = OP_SLICE;
+            target->operand.slice.has_from = slice_predicate_has_from(value);
+            target->operand.slice.has_to = slice_predicate_has_to(value);
+            target->operand.slice.has_step = slice_predicate_has_step(value);
+            target->operand.slice.from = slice_predicate_from(value);
+            target->operand.slice.to = slice_predicate_to(value);
+            target->operand.slice.step = slice_predicate_has_step(value) ? slice_predicate_step(value) : 1;
+            break;
+        case FILTER:
+            target->opcode = OP_FILTER;
+            target->operand.filter.expression = filter_predicate_expression(value);
+            target->operand.filter.by_block = compile_field_comparison(&target->operand.filter.field, model, target->operand.filter.expression);
+            break;
+        case JOIN:
+            target->opcode = OP_JOIN;
+            break;
+    }
+    return target + 1;
+}
+
+program *compile_path(const DocumentModel *model, const jsonpath *path)
+{
+    PRECOND_NONNULL_ELSE_NULL(path);
+
+    size_t length = instruction_count(path);
+    program *result = calloc(1, sizeof(program) + length * sizeof(instruction));
+    if(NULL == result)
+    {
+        evaluator_debug("uh oh! out of memory, can't allocate a program of %zd instructions", length);
+        return NULL;
+    }
+
+    instruction *cursor = result->code;
+    for(size_t i = 0; i < path_length(path); i++)
+    {
+        step *each = path_get(path, i);
+        cursor = compile_test(cursor, model, each);
+        if(step_has_predicate(each))
+        {
+            cursor = compile_predicate(cursor, model, step_predicate(each));
+        }
+    }
+    cursor->opcode = OP_YIELD;
+    result->length = (size_t)(cursor - result->code) + 1;
+    evaluator_debug("compiled %zd steps into %zd instructions", path_length(path), result->length);
+
+    return result;
+}
+
+static bool same_name(const instruction *a, const instruction *b)
+{
+    const Scalar *x = a->operand.name.key;
+    const Scalar *y = b->operand.name.key;
+    return x == y || (x->length == y->length && 0 == memcmp(scalar_bytes(x), scalar_bytes(y), x->length));
+}
+
+/*
+ * Two paths parsed apart never share a filter, so filters are only the same
+ * instruction when they are the same expression.
+ */
+static bool same_instruction(const instruction *a, const instruction *b)
+{
+    if(a->opcode != b->opcode)
+    {
+        return false;
+    }
+    switch(a->opcode)
+    {
+        case OP_NAME:
+        case OP_FIND:
+            return same_name(a, b);
+        case OP_TYPE:
+            return a->operand.type == b->operand.type;
+        case OP_SUBSCRIPT:
+        case OP_COLLECT:
+            return a->operand.index == b->operand.index;
+        case OP_SLICE:
+            return a->operand.slice.has_from == b->operand.slice.has_from
+                && a->operand.slice.has_to == b->operand.slice.has_to
+                && a->operand.slice.from == b->operand.slice.from
+                && a->operand.slice.to == b->operand.slice.to
+                && a->operand.slice.step == b->operand.slice.step;
+        case OP_FILTER:
+            return a->operand.filter.expression == b->operand.filter.expression;
+        case OP_BRANCH:
+            return false;
+        case OP_ROOT:
+        case OP_DESCEND:
+        case OP_CHILDREN:
+        case OP_SELF:
+        case OP_ITEMS:
+        case OP_JOIN:
+        case OP_YIELD:
+            return true;
+    }
+    return false;
+}
+
+static void copy_instruction(instruction *target, const instruction *source)
+{
+    *target = *source;
+    // N.B. - a key or field that isn't the model's own is a probe inside the instruction, which must move with it
+    if((OP_NAME == source->opcode || OP_FIND == source->opcode) && source->operand.name.key == &source->operand.name.probe)
+    {
+        target->operand.name.key = &target->operand.name.probe;
+    }
+    if(OP_FILTER == source->opcode && source->operand.filter.by_block
+       && source->operand.filter.field.key == &source->operand.filter.field.probe)
+    {
+        target->operand.filter.field.key = &target->operand.filter.field.probe;
+    }
+}
+
+/*
+ * Lay out the instructions of the `count' programs in `members' from
+ * `depth' on, which all of them share up to there.  A run of instructions
+ * they all share is copied once; where they diverge, the programs are grouped
+ * by their next instruction and each group but the last is preceded by a
+ * branch to the one after it.  Each group is gathered in order at the front
+ * of what is left of `members', using `spare', which has room for as many,
+ * to hold the rest meanwhile.
+ */
+static instruction *merge_programs(instruction *cursor, program * const *parts, size_t *members, size_t count, size_t depth, size_t *spare)
+{
+    while(true)
+    {
+        const instruction *next = parts[members[0]]->code + depth;
+        bool shared = true;
+        for(size_t i = 1; shared && i < count; i++)
+        {
+            shared = same_instruction(next, parts[members[i]]->code + depth);
+        }
+        if(!shared)
+        {
+            break;
+        }
+        copy_instruction(cursor++, next);
+        if(OP_COLLECT == next->opcode)
+        {
+            return cursor;
+        }
+        depth++;
+    }
+
+    size_t *group = members;
+    size_t remaining = count;
+    while(0 != remaining)
+    {
+        const instruction *next = parts[group[0]]->code + depth;
+        size_t length = 0, rest = 0;
+        for(size_t i = 0; i < remaining; i++)
+        {
+            if(same_instruction(next, parts[group[i]]->code + depth))
+            {
+                group[length++] = group[i];
+            }
+            else
+            {
+                spare[rest++] = group[i];
+            }
+        }
+        memcpy(group + length, spare, rest * sizeof(size_t));
+        remaining = rest;
+        instruction *branch = NULL;
+        if(0 != remaining)
+        {
+            branch = cursor++;
+            branch->opcode = OP_BRANCH;
+        }
+        cursor = merge_programs(cursor, parts, group, length, depth, spare);
+        if(NULL != branch)
+        {
+            branch->operand.offset = (size_t)(cursor - branch);
+        }
+        group += length;
+    }
+    return cursor;
+}
+
+static void free_programs(program **parts, size_t count)
+{
+    for(size_t i = 0; i < count; i++)
+    {
+        program_free(parts[i]);
+    }
+}
+
+program *compile_batch(const DocumentModel *model, const jsonpath * const *paths, size_t count)
+{
+    PRECOND_NONNULL_ELSE_NULL(paths);
+    PRECOND_ELSE_NULL(0 != count);
+
+    // N.B. - a batch may hold a great many queries, so its work space is on the heap rather than the stack
+    program **parts = calloc(count, sizeof(program *));
+    size_t *members = calloc(count * 2, sizeof(size_t));
+    if(NULL == parts || NULL == members)
+    {
+        evaluator_debug("uh oh! out of memory, can't allocate the work space to merge %zd programs", count);
+        free(parts);
+        free(members);
+        return NULL;
+    }
+
+    size_t length = 0;
+    for(size_t i = 0; i < count; i++)
+    {
+        parts[i] = compile_path(model, paths[i]);
+        if(NULL == parts[i])
+        {
+            free_programs(parts, i);
+            free(parts);
+            free(members);
+            return NULL;
+        }
+        instruction *last = parts[i]->code + parts[i]->length - 1;
+        last->opcode = OP_COLLECT;
+        last->operand.index = i;
+        members[i] = i;
+        length += parts[i]->length;
+    }
+
+    // N.B. - the programs diverge fewer than `count' times, each costing a branch
+    length += count;
+    program *result = calloc(1, sizeof(program) + length * sizeof(instruction));
+    if(NULL == result)
+    {
+        evaluator_debug("uh oh! out of memory, can't allocate a batch program of %zd instructions", length);
+    }
+    else
+    {
+        instruction *end = merge_programs(result->code, parts, members, count, 0, members + count);
+        result->length = (size_t)(end - result->code);
+        evaluator_debug("merged %zd programs of %zd instructions into %zd", count, length - count, result->length);
+    }
+
+    free_programs(parts, count);
+    free(parts);
+    free(members);
+    return result;
+}
+
+void program_free(program *value)
+{
+    free(value);
+}
+
+bool program_descends(const program *code)
+{
+    for(size_t i = 0; i < code->length; i++)
+    {
+        if(OP_DESCEND == code->code[i].opcode)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+/*
+ * A single query of a tape loses out to a model wherever compiling with the
+ * model would use the name index (see `use_name_index'), or running would
+ * split the path across a pool (see `run_document' in api.c).
+ */
+bool paths_want_model(const jsonpath * const *paths, size_t count, size_t threads, size_t limit)
+{
+    size_t names = 0;
+    bool descends = false;
+    for(size_t i = 0; i < count; i++)
+    {
+        for(size_t j = 0; j < path_length(paths[i]); j++)
+        {
+            step *each = path_get(paths[i], j);
+            if(RECURSIVE != step_kind(each))
+            {
+                continue;
+            }
+            descends = true;
+            names += NAME_TEST == step_test_kind(each) ? 1 : 0;
+        }
+    }
+    return 1 < names || (1 == count && descends && 0 == limit && 1 != evaluator_threads(threads));
+}
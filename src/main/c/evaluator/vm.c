@@ -0,0 +1,704 @@
+/*
+ * 金棒 (kanabō)
+ * Copyright (c) 2012 Kevin Birch <kmb@pobox.com>.  All rights reserved.
+ *
+ * 金棒 is a tool to bludgeon YAML and JSON files from the shell: the strong
+ * made stronger.
+ *
+ * For more information, consult the README file in the project root.
+ *
+ * Distributed under an [MIT-style][license] license.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal with
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * - Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimers.
+ * - Redistributions in binary form must reproduce the above copyright notice, this
+ *   list of conditions and the following disclaimers in the documentation and/or
+ *   other materials provided with the distribution.
+ * - Neither the names of the copyright holders, nor the names of the authors, nor
+ *   the names of other contributors may be used to endorse or promote products
+ *   derived from this Software without specific prior written permission.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE CONTRIBUTORS
+ * OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS WITH THE SOFTWARE.
+ *
+ * [license]: http://www.opensource.org/licenses/ncsa
+ */
+
+
+#include "evaluator/private.h"
+#include "conditions.h"
+
+/*
+ * Instructions are dispatched through a table of label addresses where the
+ * compiler supports it, so that each one jumps straight to the next rather
+ * than back through a single switch.
+ */
+#if defined(__GNUC__) && !defined(NO_COMPUTED_GOTO)
+#define USE_COMPUTED_GOTO
+#endif
+
+#ifdef USE_COMPUTED_GOTO
+#define TARGET(OP) TARGET_##OP:
+#define DISPATCH() goto *TARGETS[pc->opcode]
+#else
+#define TARGET(OP) case OP:
+#define DISPATCH() goto dispatch
+#endif
+
+/* select a single node and carry on with the next instruction without a call */
+#define NEXT(VALUE) do { each = (VALUE); pc++; DISPATCH(); } while(0)
+/* carry on with the same instruction on an alias's target */
+#define RESOLVE() do { each = cursor_alias_target(each); DISPATCH(); } while(0)
+
+struct machine
+{
+    evaluator_status_code code;
+    /** the model whose nodes are selected, or NULL for a tape's records */
+    const DocumentModel  *model;
+    cursor_iterator       sink;
+    void                 *sink_context;
+    /** when not NULL, wide descents are split into tasks on this pool, forked from `task' */
+    task_pool            *pool;
+    task                 *task;
+    /** in a batch, the results collected for each path and how many of them each may have, or any number when zero */
+    Selection            *results;
+    size_t                limit;
+};
+
+typedef struct machine machine;
+
+/* where to carry on with each node selected by an iteration */
+struct continuation
+{
+    machine           *vm;
+    const instruction *pc;
+};
+
+typedef struct continuation continuation;
+
+static bool execute(machine *vm, const instruction *pc, Cursor each);
+static bool descend(machine *vm, const instruction *pc, Cursor each);
+static bool execute_slice(machine *vm, const instruction *pc, Cursor value);
+static bool execute_filter(machine *vm, const instruction *pc, Cursor value);
+
+
+evaluator_status_code execute_program(const program *code, const DocumentModel *model, Cursor document, cursor_iterator sink, void *context)
+{
+    evaluator_debug("executing a program of %zd instructions", code->length);
+    machine vm = {EVALUATOR_SUCCESS, model, sink, context, NULL, NULL, NULL, 0};
+    if(!execute(&vm, code->code, document))
+    {
+        if(ERR_EVALUATION_STOPPED == vm.code)
+        {
+            evaluator_debug("stopped by the sink");
+            return vm.code;
+        }
+        evaluator_error("aborted, code: %d (%s)", vm.code, evaluator_status_message(vm.code));
+        return EVALUATOR_SUCCESS == vm.code ? ERR_EVALUATOR_OUT_OF_MEMORY : vm.code;
+    }
+
+    evaluator_debug("done");
+    return vm.code;
+}
+
+evaluator_status_code execute_batch(const program *code, const DocumentModel *model, Cursor document, size_t limit, Selection *results)
+{
+    evaluator_debug("executing a batch program of %zd instructions", code->length);
+    machine vm = {EVALUATOR_SUCCESS, model, NULL, NULL, NULL, NULL, results, limit};
+    if(!execute(&vm, code->code, document))
+    {
+        evaluator_error("aborted, code: %d (%s)", vm.code, evaluator_status_message(vm.code));
+        return EVALUATOR_SUCCESS == vm.code ? ERR_EVALUATOR_OUT_OF_MEMORY : vm.code;
+    }
+
+    evaluator_debug("done");
+    return vm.code;
+}
+
+/*
+ * In a pool, the program's results are emitted into the task that found
+ * them, and a descent into a sequence or mapping at least this wide forks a
+ * task for each run of this many of its children.
+ */
+#define DESCENT_SPLIT_WIDTH 1024
+#define DESCENT_CHUNK 256
+
+struct program_start
+{
+    const program       *code;
+    const DocumentModel *model;
+    Document            *document;
+};
+
+struct descent_chunk
+{
+    const DocumentModel *model;
+    const instruction   *pc;
+    size_t               count;
+    Cursor               children[];
+};
+
+static bool emit_iterator(Cursor each, void *context)
+{
+    return task_emit((task *)context, each.node);
+}
+
+static evaluator_status_code task_status(const machine *vm)
+{
+    // N.B. - a task's output only refuses a node when it runs out of memory
+    return EVALUATOR_SUCCESS == vm->code || ERR_EVALUATION_STOPPED == vm->code ? ERR_EVALUATOR_OUT_OF_MEMORY : vm->code;
+}
+
+static evaluator_status_code run_program_task(task_pool *pool, task *self, void *argument)
+{
+    struct program_start *start = (struct program_start *)argument;
+    machine vm = {EVALUATOR_SUCCESS, start->model, emit_iterator, self, pool, self, NULL, 0};
+    return execute(&vm, start->code->code, cursor_of(start->document)) ? EVALUATOR_SUCCESS : task_status(&vm);
+}
+
+static evaluator_status_code descend_chunk(task_pool *pool, task *self, void *argument)
+{
+    struct descent_chunk *chunk = (struct descent_chunk *)argument;
+    machine vm = {EVALUATOR_SUCCESS, chunk->model, emit_iterator, self, pool, self, NULL, 0};
+    for(size_t i = 0; i < chunk->count && !task_pool_failed(pool); i++)
+    {
+        if(!descend(&vm, chunk->pc, chunk->children[i]))
+        {
+            return task_status(&vm);
+        }
+    }
+    return EVALUATOR_SUCCESS;
+}
+
+evaluator_status_code execute_program_in_pool(const program *code, const DocumentModel *model, Document *document,
+                                              task_pool *pool, nodelist_iterator sink, void *context)
+{
+    evaluator_debug("executing a program of %zd instructions in a pool", code->length);
+    struct program_start *start = malloc(sizeof(struct program_start));
+    if(NULL == start)
+    {
+        return ERR_EVALUATOR_OUT_OF_MEMORY;
+    }
+    *start = (struct program_start){code, model, document};
+    evaluator_status_code result = task_pool_run(pool, run_program_task, start, sink, context);
+    if(ERR_EVALUATION_STOPPED == result)
+    {
+        evaluator_debug("stopped by the sink");
+    }
+    else if(EVALUATOR_SUCCESS != result)
+    {
+        evaluator_error("aborted, code: %d (%s)", result, evaluator_status_message(result));
+    }
+    return result;
+}
+
+static bool unexpected_document(machine *vm, Cursor each __attribute__((unused)))
+{
+    evaluator_error("uh oh! found a document node embedded in the tree (%p), aborting...", NULL == each.tape ? (void *)each.node : (void *)each.index);
+    vm->code = ERR_UNEXPECTED_DOCUMENT_NODE;
+    return false;
+}
+
+static bool resolved_sequence_iterator(Cursor each, void *context)
+{
+    continuation *next = (continuation *)context;
+    return execute(next->vm, next->pc, cursor_resolve(each));
+}
+
+static bool mapping_values_iterator(Cursor key, Cursor value, void *context)
+{
+    continuation *next = (continuation *)context;
+    switch(cursor_kind(value))
+    {
+        case SCALAR:
+        case MAPPING:
+            return execute(next->vm, next->pc, value);
+        case SEQUENCE:
+            // N.B. - the items of a sequence valued key are selected, rather than the sequence
+            return cursor_sequence_iterate(value, resolved_sequence_iterator, context);
+        case ALIAS:
+            return mapping_values_iterator(key, cursor_alias_target(value), context);
+        case DOCUMENT:
+            return unexpected_document(next->vm, value);
+    }
+    return false;
+}
+
+static bool found_key_iterator(Node *key __attribute__((unused)), Node *value, void *context)
+{
+    continuation *next = (continuation *)context;
+    return execute(next->vm, next->pc, cursor_resolve(cursor_of(value)));
+}
+
+static bool descend_sequence_iterator(Cursor each, void *context)
+{
+    continuation *next = (continuation *)context;
+    return descend(next->vm, next->pc, each);
+}
+
+static bool descend_mapping_iterator(Cursor key __attribute__((unused)), Cursor value, void *context)
+{
+    continuation *next = (continuation *)context;
+    return descend(next->vm, next->pc, value);
+}
+
+struct splitter
+{
+    machine              *vm;
+    const instruction    *pc;
+    struct descent_chunk *chunk;
+};
+
+static bool fork_chunk(struct splitter *split)
+{
+    struct descent_chunk *chunk = split->chunk;
+    split->chunk = NULL;
+    if(!task_fork(split->vm->pool, split->vm->task, descend_chunk, chunk))
+    {
+        split->vm->code = ERR_EVALUATOR_OUT_OF_MEMORY;
+        return false;
+    }
+    return true;
+}
+
+static bool split_child(Cursor each, struct splitter *split)
+{
+    if(NULL == split->chunk)
+    {
+        split->chunk = malloc(sizeof(struct descent_chunk) + DESCENT_CHUNK * sizeof(Cursor));
+        if(NULL == split->chunk)
+        {
+            split->vm->code = ERR_EVALUATOR_OUT_OF_MEMORY;
+            return false;
+        }
+        split->chunk->model = split->vm->model;
+        split->chunk->pc = split->pc;
+        split->chunk->count = 0;
+    }
+    split->chunk->children[split->chunk->count++] = each;
+    return DESCENT_CHUNK != split->chunk->count || fork_chunk(split);
+}
+
+static bool split_sequence_iterator(Cursor each, void *context)
+{
+    return split_child(each, (struct splitter *)context);
+}
+
+static bool split_mapping_iterator(Cursor key __attribute__((unused)), Cursor value, void *context)
+{
+    return split_child(value, (struct splitter *)context);
+}
+
+/* descend into the children of a wide sequence or mapping on the pool's workers */
+static bool split_descent(machine *vm, const instruction *pc, Cursor each)
+{
+    struct splitter split = {vm, pc, NULL};
+    bool result = cursor_is_mapping(each)
+        ? cursor_mapping_iterate(each, split_mapping_iterator, &split)
+        : cursor_sequence_iterate(each, split_sequence_iterator, &split);
+    if(!result)
+    {
+        free(split.chunk);
+        return false;
+    }
+    return NULL == split.chunk || fork_chunk(&split);
+}
+
+static inline bool splits(const machine *vm, Cursor each)
+{
+    return NULL != vm->pool && DESCENT_SPLIT_WIDTH <= cursor_size(each);
+}
+
+static bool descend(machine *vm, const instruction *pc, Cursor each)
+{
+    switch(cursor_kind(each))
+    {
+        case ALIAS:
+            return descend(vm, pc, cursor_alias_target(each));
+        case DOCUMENT:
+            return unexpected_document(vm, each);
+        case SCALAR:
+            return execute(vm, pc, each);
+        case MAPPING:
+            return execute(vm, pc, each)
+                && (splits(vm, each) ? split_descent(vm, pc, each)
+                    : cursor_mapping_iterate(each, descend_mapping_iterator, &(continuation){vm, pc}));
+        case SEQUENCE:
+            return execute(vm, pc, each)
+                && (splits(vm, each) ? split_descent(vm, pc, each)
+                    : cursor_sequence_iterate(each, descend_sequence_iterator, &(continuation){vm, pc}));
+    }
+    return false;
+}
+
+static bool type_matches(Cursor each, enum type_test_kind type)
+{
+    switch(type)
+    {
+        case OBJECT_TEST:
+            return cursor_is_mapping(each);
+        case ARRAY_TEST:
+            return cursor_is_sequence(each);
+        case STRING_TEST:
+            return cursor_is_string(each);
+        case NUMBER_TEST:
+            return cursor_is_number(each);
+        case BOOLEAN_TEST:
+            return cursor_is_boolean(each);
+        case NULL_TEST:
+            return cursor_is_null(each);
+    }
+    return false;
+}
+
+static bool collect(machine *vm, Selection *selection, Cursor each)
+{
+    // N.B. - a path that has all its results stops collecting, but the others sharing its walk carry on
+    if(0 != vm->limit && vm->limit <= selection->length)
+    {
+        return true;
+    }
+    if(selection->length == selection->capacity)
+    {
+        size_t capacity = 0 == selection->capacity ? 16 : selection->capacity * 2;
+        Cursor *larger = realloc(selection->cursors, capacity * sizeof(Cursor));
+        if(NULL == larger)
+        {
+            evaluator_debug("uh oh! out of memory, can't collect a node");
+            vm->code = ERR_EVALUATOR_OUT_OF_MEMORY;
+            return false;
+        }
+        selection->cursors = larger;
+        selection->capacity = capacity;
+    }
+    selection->cursors[selection->length++] = each;
+    return true;
+}
+
+static bool execute(machine *vm, const instruction *pc, Cursor each)
+{
+#ifdef USE_COMPUTED_GOTO
+    static const void * const TARGETS[] =
+    {
+        [OP_ROOT]      = &&TARGET_OP_ROOT,
+        [OP_DESCEND]   = &&TARGET_OP_DESCEND,
+        [OP_NAME]      = &&TARGET_OP_NAME,
+        [OP_FIND]      = &&TARGET_OP_FIND,
+        [OP_CHILDREN]  = &&TARGET_OP_CHILDREN,
+        [OP_SELF]      = &&TARGET_OP_SELF,
+        [OP_TYPE]      = &&TARGET_OP_TYPE,
+        [OP_ITEMS]     = &&TARGET_OP_ITEMS,
+        [OP_SUBSCRIPT] = &&TARGET_OP_SUBSCRIPT,
+        [OP_SLICE]     = &&TARGET_OP_SLICE,
+        [OP_FILTER]    = &&TARGET_OP_FILTER,
+        [OP_JOIN]      = &&TARGET_OP_JOIN,
+        [OP_YIELD]     = &&TARGET_OP_YIELD,
+        [OP_BRANCH]    = &&TARGET_OP_BRANCH,
+        [OP_COLLECT]   = &&TARGET_OP_COLLECT
+    };
+#endif
+
+    DISPATCH();
+#ifndef USE_COMPUTED_GOTO
+  dispatch:
+    switch(pc->opcode)
+    {
+#endif
+    TARGET(OP_ROOT)
+    {
+        evaluator_trace("root: selecting the root of a document");
+        NEXT(cursor_document_root(each));
+    }
+    TARGET(OP_DESCEND)
+    {
+        evaluator_trace("descend: visiting a node and everything below it");
+        return descend(vm, pc + 1, each);
+    }
+    TARGET(OP_NAME)
+    {
+        if(!cursor_is_mapping(each))
+        {
+            return true;
+        }
+        Cursor value = cursor_mapping_get_key(each, pc->operand.name.key);
+        if(cursor_is_none(value))
+        {
+            return true;
+        }
+        NEXT(cursor_resolve(value));
+    }
+    TARGET(OP_FIND)
+    {
+        // N.B. - only a program compiled with a model finds names in its index, so `each' is one of its nodes
+        evaluator_trace("find: looking up the mappings at or below (%p) in the name index", each.node);
+        return model_find_key(vm->model, each.node, pc->operand.name.key, found_key_iterator, &(continuation){vm, pc + 1});
+    }
+    TARGET(OP_CHILDREN)
+    {
+        switch(cursor_kind(each))
+        {
+            case MAPPING:
+                return cursor_mapping_iterate(each, mapping_values_iterator, &(continuation){vm, pc + 1});
+            case SEQUENCE:
+                return cursor_sequence_iterate(each, resolved_sequence_iterator, &(continuation){vm, pc + 1});
+            case SCALAR:
+                NEXT(each);
+            case ALIAS:
+                RESOLVE();
+            case DOCUMENT:
+                return unexpected_document(vm, each);
+        }
+        return false;
+    }
+    TARGET(OP_SELF)
+    {
+        switch(cursor_kind(each))
+        {
+            case ALIAS:
+                RESOLVE();
+            case DOCUMENT:
+                return unexpected_document(vm, each);
+            case SCALAR:
+            case SEQUENCE:
+            case MAPPING:
+                NEXT(each);
+        }
+        return false;
+    }
+    TARGET(OP_TYPE)
+    {
+        if(cursor_is_alias(each))
+        {
+            RESOLVE();
+        }
+        if(!type_matches(each, pc->operand.type))
+        {
+            return true;
+        }
+        NEXT(each);
+    }
+    TARGET(OP_ITEMS)
+    {
+        switch(cursor_kind(each))
+        {
+            case SEQUENCE:
+                return cursor_sequence_iterate(each, resolved_sequence_iterator, &(continuation){vm, pc + 1});
+            case ALIAS:
+                RESOLVE();
+            case DOCUMENT:
+                return unexpected_document(vm, each);
+            case SCALAR:
+            case MAPPING:
+                NEXT(each);
+        }
+        return false;
+    }
+    TARGET(OP_SUBSCRIPT)
+    {
+        if(!cursor_is_sequence(each) || pc->operand.index >= cursor_size(each))
+        {
+            return true;
+        }
+        NEXT(cursor_sequence_get(each, pc->operand.index));
+    }
+    TARGET(OP_SLICE)
+    {
+        if(!cursor_is_sequence(each))
+        {
+            return true;
+        }
+        return execute_slice(vm, pc, each);
+    }
+    TARGET(OP_FILTER)
+    {
+        switch(cursor_kind(each))
+        {
+            case SEQUENCE:
+                return execute_filter(vm, pc, each);
+            case ALIAS:
+                RESOLVE();
+            case DOCUMENT:
+                return unexpected_document(vm, each);
+            case SCALAR:
+            case MAPPING:
+                if(!filter_matches(pc->operand.filter.expression, each))
+                {
+                    return true;
+                }
+                NEXT(each);
+        }
+        return false;
+    }
+    TARGET(OP_JOIN)
+    {
+        evaluator_error("join predicate: uh-oh! not implemented yet, aborting...");
+        vm->code = ERR_UNSUPPORTED_PATH;
+        return false;
+    }
+    TARGET(OP_YIELD)
+    {
+        if(!vm->sink(each, vm->sink_context))
+        {
+            evaluator_debug("the sink refused a node, stopping");
+            vm->code = ERR_EVALUATION_STOPPED;
+            return false;
+        }
+        return true;
+    }
+    TARGET(OP_BRANCH)
+    {
+        if(!execute(vm, pc + 1, each))
+        {
+            return false;
+        }
+        pc += pc->operand.offset;
+        DISPATCH();
+    }
+    TARGET(OP_COLLECT)
+    {
+        return collect(vm, vm->results + pc->operand.index, each);
+    }
+#ifndef USE_COMPUTED_GOTO
+    }
+    return false;
+#endif
+}
+
+static int normalize_extent(bool specified, int_fast32_t given, int fallback, int limit)
+{
+    if(!specified)
+    {
+        return fallback;
+    }
+    int result = 0 > given ? (int)given + limit : (int)given;
+    return 0 > result ? 0 : limit < result ? limit : result;
+}
+
+struct item_gatherer
+{
+    Cursor *items;
+    size_t  length;
+};
+
+static bool gather_item(Cursor each, void *context)
+{
+    struct item_gatherer *gatherer = (struct item_gatherer *)context;
+    gatherer->items[gatherer->length++] = each;
+    return true;
+}
+
+static bool execute_slice(machine *vm, const instruction *pc, Cursor value)
+{
+    int length = (int)cursor_size(value);
+    int increment = (int)pc->operand.slice.step;
+    int from = normalize_extent(pc->operand.slice.has_from, pc->operand.slice.from, 0, length);
+    int to = normalize_extent(pc->operand.slice.has_to, pc->operand.slice.to, length, length);
+    if(0 > increment)
+    {
+        int swap = from;
+        from = to - 1;
+        to = swap;
+    }
+    evaluator_trace("slice: using normalized interval [%d:%d:%d]", from, to, increment);
+
+    if(NULL == value.tape)
+    {
+        for(int i = from; 0 > increment ? i >= to : i < to; i += increment)
+        {
+            if(!execute(vm, pc + 1, cursor_sequence_get(value, (size_t)i)))
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+    if(0 == length)
+    {
+        return true;
+    }
+
+    // N.B. - a tape's items are found once up front, since it can only walk a sequence forwards
+    struct item_gatherer gatherer = {malloc((size_t)length * sizeof(Cursor)), 0};
+    if(NULL == gatherer.items)
+    {
+        vm->code = ERR_EVALUATOR_OUT_OF_MEMORY;
+        return false;
+    }
+    cursor_sequence_iterate(value, gather_item, &gatherer);
+
+    bool result = true;
+    for(int i = from; result && (0 > increment ? i >= to : i < to); i += increment)
+    {
+        result = execute(vm, pc + 1, gatherer.items[i]);
+    }
+    free(gatherer.items);
+    return result;
+}
+
+static bool filter_item_iterator(Cursor each, void *context)
+{
+    continuation *next = (continuation *)context;
+    each = cursor_resolve(each);
+    return !filter_matches(next->pc->operand.filter.expression, each) || execute(next->vm, next->pc + 1, each);
+}
+
+/* a block of a sequence's items, tested together once it is full */
+struct filter_block
+{
+    machine           *vm;
+    const instruction *pc;
+    size_t             count;
+    Cursor             items[FILTER_BLOCK_SIZE];
+};
+
+static bool run_block(struct filter_block *block)
+{
+    const field_comparison *test = &block->pc->operand.filter.field;
+    double values[FILTER_BLOCK_SIZE];
+    uint8_t keep[FILTER_BLOCK_SIZE];
+    gather_field(test, block->items, block->count, values);
+    compare_field_block(test->op, test->number, values, block->count, keep);
+
+    size_t count = block->count;
+    block->count = 0;
+    for(size_t i = 0; i < count; i++)
+    {
+        if(keep[i] && !execute(block->vm, block->pc + 1, cursor_resolve(block->items[i])))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool block_item_iterator(Cursor each, void *context)
+{
+    struct filter_block *block = (struct filter_block *)context;
+    block->items[block->count++] = each;
+    return FILTER_BLOCK_SIZE != block->count || run_block(block);
+}
+
+static bool execute_filter(machine *vm, const instruction *pc, Cursor value)
+{
+    if(!pc->operand.filter.by_block)
+    {
+        return cursor_sequence_iterate(value, filter_item_iterator, &(continuation){vm, pc});
+    }
+
+    struct filter_block block;
+    block.vm = vm;
+    block.pc = pc;
+    block.count = 0;
+    return cursor_sequence_iterate(value, block_item_iterator, &block) && (0 == block.count || run_block(&block));
+}
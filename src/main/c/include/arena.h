@@ -0,0 +1,75 @@
+/*
+ * Copyright (c) 2014 Kevin Birch <kmb@pobox.com>.  All rights reserved.
+ *
+ * Distributed under an [MIT-style][license] license.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal with
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * - Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimers.
+ * - Redistributions in binary form must reproduce the above copyright notice, this
+ *   list of conditions and the following disclaimers in the documentation and/or
+ *   other materials provided with the distribution.
+ * - Neither the names of the copyright holders, nor the names of the authors, nor
+ *   the names of other contributors may be used to endorse or promote products
+ *   derived from this Software without specific prior written permission.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE CONTRIBUTORS
+ * OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS WITH THE SOFTWARE.
+ *
+ * [license]: http://www.opensource.org/licenses/ncsa
+ */
+
+#pragma once
+
+#include <stdlib.h>
+
+/*
+ * A bump allocator.  Memory is carved out of large chunks in allocation order
+ * and is never returned individually, everything is released at once by
+ * `arena_free`.  Allocations are zeroed and aligned for any type.
+ */
+
+typedef struct arena_s Arena;
+
+struct arena_stats_s
+{
+    /** count of chunks obtained from the system */
+    size_t chunks;
+    /** total bytes held by those chunks */
+    size_t reserved;
+    /** bytes handed out, including alignment padding and abandoned blocks */
+    size_t used;
+    /** count of blocks handed out */
+    size_t allocations;
+};
+
+typedef struct arena_stats_s ArenaStats;
+
+/* Constructors */
+Arena *make_arena(void);
+Arena *make_arena_with_chunk_size(size_t chunk_size);
+
+/* Destructor */
+void   arena_free(Arena *arena);
+
+/* Allocation API */
+void  *arena_alloc(Arena *arena, size_t size);
+/*
+ * Grow or shrink a block previously returned by this arena.  The most recent
+ * allocation is resized in place when its chunk has room, otherwise a new
+ * block is allocated and the contents copied, abandoning the old block.
+ */
+void  *arena_resize(Arena *arena, void *block, size_t old_size, size_t new_size);
+
+/* Statistics API */
+ArenaStats arena_stats(const Arena *arena);
@@ -0,0 +1,128 @@
+/*
+ * 金棒 (kanabō)
+ * Copyright (c) 2012 Kevin Birch <kmb@pobox.com>.  All rights reserved.
+ * 
+ * 金棒 is a tool to bludgeon YAML and JSON files from the shell: the strong
+ * made stronger.
+ *
+ * For more information, consult the README file in the project root.
+ *
+ * Distributed under an [MIT-style][license] license.
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal with
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * - Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimers.
+ * - Redistributions in binary form must reproduce the above copyright notice, this
+ *   list of conditions and the following disclaimers in the documentation and/or
+ *   other materials provided with the distribution.
+ * - Neither the names of the copyright holders, nor the names of the authors, nor
+ *   the names of other contributors may be used to endorse or promote products
+ *   derived from this Software without specific prior written permission.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE CONTRIBUTORS
+ * OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS WITH THE SOFTWARE.
+ *
+ * [license]: http://www.opensource.org/licenses/ncsa
+ */
+
+#pragma once
+
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "model.h"
+#include "tape.h"
+
+/*
+ * A cursor reads a node in the same way whether it is a node of a model or
+ * a record of a tape, so that the evaluator and the emitters are written
+ * once for both.  It is passed by value: a tape and the index of one of its
+ * records, or no tape and a model's node.  Each function below does as the
+ * model's function of the same name does, whichever a cursor reads.
+ */
+struct cursor_s
+{
+    /** the tape of a record, or NULL for a node of a model */
+    const Tape *tape;
+    union
+    {
+        size_t  index;
+        Node   *node;
+    };
+};
+
+typedef struct cursor_s Cursor;
+
+#define cursor_at(TAPE, INDEX) ((Cursor){.tape=(TAPE), .index=(INDEX)})
+#define cursor_of(NODE) ((Cursor){.tape=NULL, .node=node((NODE))})
+
+/* a lookup that fails finds no record of a tape, or a NULL node of a model */
+#define cursor_none_like(CURSOR) (NULL == (CURSOR).tape ? cursor_of(NULL) : cursor_at((CURSOR).tape, TAPE_NONE))
+bool        cursor_is_none(Cursor cursor);
+
+Cursor      tape_document(const Tape *tape, size_t index);
+Cursor      tape_document_root(const Tape *tape, size_t index);
+
+NodeKind    cursor_kind(Cursor cursor);
+/* the number of bytes of a scalar, the items or entries of a container, or roots of a document */
+size_t      cursor_size(Cursor cursor);
+/* a tag is NUL terminated, and NULL for nodes without one */
+const uint8_t *cursor_tag(Cursor cursor);
+bool        cursor_equals(Cursor one, Cursor two);
+
+Cursor      cursor_document_root(Cursor document);
+
+const uint8_t *cursor_value(Cursor scalar);
+ScalarKind  cursor_scalar_kind(Cursor scalar);
+bool        cursor_boolean_is_true(Cursor scalar);
+/* as `scalar_integer` and `scalar_number`, though a tape's text is parsed on every call */
+bool        cursor_integer(Cursor scalar, int64_t *result);
+bool        cursor_number(Cursor scalar, double *result);
+
+#define cursor_is_document(CURSOR) (DOCUMENT == cursor_kind((CURSOR)))
+#define cursor_is_scalar(CURSOR) (SCALAR == cursor_kind((CURSOR)))
+#define cursor_is_sequence(CURSOR) (SEQUENCE == cursor_kind((CURSOR)))
+#define cursor_is_mapping(CURSOR) (MAPPING == cursor_kind((CURSOR)))
+#define cursor_is_alias(CURSOR) (ALIAS == cursor_kind((CURSOR)))
+#define cursor_is_string(CURSOR) (cursor_is_scalar((CURSOR)) && SCALAR_STRING == cursor_scalar_kind((CURSOR)))
+#define cursor_is_integer(CURSOR) (cursor_is_scalar((CURSOR)) && SCALAR_INTEGER == cursor_scalar_kind((CURSOR)))
+#define cursor_is_real(CURSOR) (cursor_is_scalar((CURSOR)) && SCALAR_REAL == cursor_scalar_kind((CURSOR)))
+#define cursor_is_number(CURSOR) (cursor_is_integer((CURSOR)) || cursor_is_real((CURSOR)))
+#define cursor_is_boolean(CURSOR) (cursor_is_scalar((CURSOR)) && SCALAR_BOOLEAN == cursor_scalar_kind((CURSOR)))
+#define cursor_is_null(CURSOR) (cursor_is_scalar((CURSOR)) && SCALAR_NULL == cursor_scalar_kind((CURSOR)))
+
+Cursor      cursor_alias_target(Cursor alias);
+/* the alias's target, or any other cursor itself */
+Cursor      cursor_resolve(Cursor cursor);
+
+/*
+ * A tape finds an item by walking the sequence, so `cursor_sequence_get`
+ * takes time in proportion to the index there.  Iterating visits each item
+ * in turn.
+ */
+Cursor      cursor_sequence_get(Cursor sequence, size_t index);
+
+typedef bool (*cursor_iterator)(Cursor each, void *context);
+bool cursor_sequence_iterate(Cursor sequence, cursor_iterator iterator, void *context);
+
+/*
+ * A tape finds a key by comparing the keys in turn, and visits the entries
+ * in the order their keys first appeared.  A model's own interned key, see
+ * `model_symbol`, finds a value in a mapping of that model without hashing.
+ */
+Cursor      cursor_mapping_get(Cursor mapping, const uint8_t *key, size_t length);
+Cursor      cursor_mapping_get_key(Cursor mapping, const Scalar *key);
+
+typedef bool (*cursor_entry_iterator)(Cursor key, Cursor value, void *context);
+bool cursor_mapping_iterate(Cursor mapping, cursor_entry_iterator iterator, void *context);
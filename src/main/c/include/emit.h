@@ -39,5 +39,8 @@
 #include "emit/zsh.h"
 #include "emit/json.h"
 #include "emit/yaml.h"
+#include "emit/output.h"
 
-typedef bool (*emit_function)(const nodelist *list);
+typedef bool (*emit_function)(Evaluation *results);
+
+emit_function emitter_for(enum emit_mode mode);
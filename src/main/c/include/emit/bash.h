@@ -37,7 +37,7 @@
 
 #pragma once
 
-#include "nodelist.h"
+#include "evaluator.h"
 #include "options.h"
 
-bool emit_bash(const nodelist *list);
+bool emit_bash(Evaluation *results);
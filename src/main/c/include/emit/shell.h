@@ -39,23 +39,24 @@
 
 #include <stdbool.h>
 
-#include "model.h"
+#include "cursor.h"
+#include "emit/output.h"
 
-bool emit_node(Node *value, void *context);
-bool emit_scalar(const Scalar *each);
-bool emit_quoted_scalar(const Scalar *each);
-bool emit_raw_scalar(const Scalar *each);
-bool emit_sequence_item(Node *each, void *context);
+bool emit_node(Cursor value, void *context);
+bool emit_scalar(Cursor each);
+bool emit_quoted_scalar(Cursor each);
+bool emit_raw_scalar(Cursor each);
+bool emit_sequence_item(Cursor each, void *context);
 
 struct emit_context
 {
-    mapping_iterator emit_mapping_item;
+    cursor_entry_iterator emit_mapping_item;
     bool wrap_collections;
 };
 
 typedef struct emit_context emit_context;
 
-#define EMIT(STR) if(EOF == fputs((STR), stdout))                       \
+#define EMIT(STR) if(EOF == fputs((STR), emit_output()))                       \
     {                                                                   \
         log_error("shell", "uh oh! couldn't emit literal %s", (STR));   \
         return false;                                                   \
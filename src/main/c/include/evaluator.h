@@ -39,6 +39,8 @@
 
 #include "maybe.h"
 #include "model.h"
+#include "tape.h"
+#include "cursor.h"
 #include "jsonpath.h"
 #include "nodelist.h"
 
@@ -54,6 +56,7 @@ enum evaluator_status_code
     ERR_EVALUATOR_OUT_OF_MEMORY,   // unable to allocate memory
     ERR_UNEXPECTED_DOCUMENT_NODE,  // a document node was found embedded inside another document tree
     ERR_UNSUPPORTED_PATH,          // the jsonpath provided is not supported
+    ERR_EVALUATION_STOPPED,        // the consumer of the results asked to stop
 };
 
 typedef enum evaluator_status_code evaluator_status_code;
@@ -75,3 +78,73 @@ struct maybe_nodelist_s
 typedef struct maybe_nodelist_s MaybeNodelist;
 
 MaybeNodelist evaluate(const DocumentModel *model, const jsonpath *path);
+
+/* the results of one path of a batch, see `evaluate_batch' */
+struct selection_s
+{
+    Cursor *cursors;
+    size_t  length;
+    size_t  capacity;
+};
+
+typedef struct selection_s Selection;
+
+void selection_release(Selection *selection);
+
+/*
+ * An evaluation that has not been run yet.  Iterating it runs the path,
+ * handing each result to the iterator as soon as it is found instead of
+ * collecting them all in a nodelist first.
+ *
+ * The path is evaluated against either a model or a tape, see tape.h, and
+ * selects the same nodes in the same order from both.  A tape is always
+ * evaluated on the calling thread and without a name index.
+ */
+struct evaluation_s
+{
+    /** exactly one of the model and the tape is not NULL */
+    const DocumentModel   *model;
+    const Tape            *tape;
+    const jsonpath        *path;
+    /** walk the path with the step interpreter instead of compiling it, for differential testing */
+    bool                   interpret;
+    /** evaluate the path against every document in turn, rather than only the first */
+    bool                   all_documents;
+    /** stop as soon as this many results have been handed on, or never when zero */
+    size_t                 limit;
+    /** how many threads may share the evaluation, or one per online processor when zero */
+    size_t                 threads;
+    /** results already found by a batch, handed on instead of running the path when not NULL */
+    const Selection       *found;
+    /** how many results the last iteration handed on */
+    size_t                 count;
+    /** how the last iteration ended */
+    evaluator_status_code  code;
+};
+
+typedef struct evaluation_s Evaluation;
+
+Evaluation  make_evaluation(const DocumentModel *model, const jsonpath *path);
+Evaluation  make_tape_evaluation(const Tape *tape, const jsonpath *path);
+bool        evaluation_iterate(Evaluation *evaluation, cursor_iterator iterator, void *context);
+const char *evaluator_status_message(evaluator_status_code code);
+
+/*
+ * Evaluate several paths against the model in one walk.  Paths that begin
+ * with the same steps share them, so a common prefix such as `$.store.book'
+ * is evaluated once and the walk only fans out where the paths diverge.  The
+ * results of each path are collected into the selection at the same index
+ * of `results', up to `limit' of them when that is not zero, and are left
+ * empty when the batch fails.
+ */
+evaluator_status_code evaluate_batch(const DocumentModel *model, const jsonpath * const *paths, size_t count,
+                                     bool all_documents, size_t limit, Selection *results);
+evaluator_status_code evaluate_tape_batch(const Tape *tape, const jsonpath * const *paths, size_t count,
+                                          bool all_documents, size_t limit, Selection *results);
+
+/*
+ * Would evaluating the paths against a model rather than a tape pay off,
+ * either because the model's name index would be built for them or because
+ * a single path would be split across `threads' workers.
+ */
+bool paths_want_model(const jsonpath * const *paths, size_t count, size_t threads, size_t limit);
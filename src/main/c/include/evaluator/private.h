@@ -38,6 +38,7 @@
 #pragma once
 
 #include "evaluator.h"
+#include "cursor.h"
 #include "log.h"
 
 struct evaluator_context
@@ -46,13 +47,194 @@ struct evaluator_context
     size_t                     current_step;
     const DocumentModel       *model;
     const jsonpath            *path;
-    nodelist                  *list;
+    /** the model's interned key for each name test step, NULL where it has none */
+    const Scalar             **names;
+    /** receives each node produced by the last step */
+    nodelist_iterator          sink;
+    void                      *sink_context;
 };
 
 typedef struct evaluator_context evaluator_context;
 
-evaluator_status_code evaluate_steps(const DocumentModel *model, const jsonpath *path, nodelist **list);
-const char *evaluator_status_message(evaluator_status_code code);
+/*
+ * The step interpreter, which walks the parsed path directly.  It is the
+ * reference the compiled program is tested against.
+ */
+evaluator_status_code evaluate_steps(const DocumentModel *model, Document *document, const jsonpath *path, nodelist_iterator sink, void *context);
+
+/* does the node pass a filter predicate's test, shared by the interpreter and the compiled program */
+bool filter_matches(const filter *expression, Cursor each);
+
+/*
+ * The common filter that compares one field of each item, or the item itself,
+ * against a number, such as `[?(@.price < 10)]'.  The compiled program tests
+ * these a block of items at a time: the field's values are gathered into an
+ * array of doubles, with NaN for anything that isn't a number, and compared
+ * with the number in one pass.
+ */
+#define FILTER_BLOCK_SIZE 256
+
+struct field_comparison
+{
+    /** the model's interned key, `probe', or NULL to compare the item itself */
+    const Scalar            *key;
+    Scalar                   probe;
+    enum comparison_operator op;
+    double                   number;
+};
+
+typedef struct field_comparison field_comparison;
+
+bool compile_field_comparison(field_comparison *target, const DocumentModel *model, const filter *expression);
+void gather_field(const field_comparison *test, const Cursor *items, size_t count, double *values);
+void compare_field_block(enum comparison_operator op, double number, const double *values, size_t count, uint8_t *keep);
+
+/*
+ * A path lowered into a flat array of instructions, one per step test or
+ * predicate, with their operands resolved ahead of time.  Each instruction
+ * passes the nodes it selects to the one after it, and the last one hands
+ * them to the sink.
+ */
+enum opcode
+{
+    OP_ROOT,        // the document's root node
+    OP_DESCEND,     // the node and each node below it, following aliases
+    OP_NAME,        // the value of a key in a mapping
+    OP_FIND,        // the value of a key in the mappings at or below the node, from the model's name index
+    OP_CHILDREN,    // the values of a mapping, items of a sequence or a scalar itself
+    OP_SELF,        // the node itself, the wildcard test of a recursive step
+    OP_TYPE,        // the node if it is of a given type
+    OP_ITEMS,       // the items of a sequence, or any other node itself
+    OP_SUBSCRIPT,   // one item of a sequence
+    OP_SLICE,       // an interval of the items of a sequence
+    OP_FILTER,      // the items of a sequence, or any other node itself, that pass a test
+    OP_JOIN,        // not supported yet
+    OP_YIELD,       // hand the node to the sink
+    OP_BRANCH,      // carry on with the next instruction, then again from the alternative `offset' further on
+    OP_COLLECT      // add the node to the results of one path of a batch
+};
+
+struct instruction
+{
+    enum opcode opcode;
+    union
+    {
+        struct
+        {
+            /** the model's interned key, or else `probe` */
+            const Scalar *key;
+            Scalar        probe;
+        } name;
+        enum type_test_kind type;
+        /** the sequence index, or the batch path whose results are collected */
+        size_t              index;
+        /** how far on the alternative of a branch starts */
+        size_t              offset;
+        struct
+        {
+            bool         has_from;
+            bool         has_to;
+            bool         has_step;
+            int_fast32_t from;
+            int_fast32_t to;
+            int_fast32_t step;
+        } slice;
+        struct
+        {
+            const filter    *expression;
+            /** can the filter be tested a block of items at a time with `field` */
+            bool             by_block;
+            field_comparison field;
+        } filter;
+    } operand;
+};
+
+typedef struct instruction instruction;
+
+struct program
+{
+    size_t      length;
+    instruction code[];
+};
+
+typedef struct program program;
+
+/*
+ * The program borrows the path's names, and the model's keys when it has
+ * them.  Without a model, as for a tape, every name is matched by its bytes.
+ */
+program *compile_path(const DocumentModel *model, const jsonpath *path);
+void     program_free(program *value);
+
+/*
+ * Run the program over a document of the model it was compiled for, or of a
+ * tape when `model' is NULL.  The machine reads both through cursors, so the
+ * same nodes are selected in the same order either way.
+ */
+evaluator_status_code execute_program(const program *code, const DocumentModel *model, Cursor document, cursor_iterator sink, void *context);
+
+/*
+ * The programs of a batch of paths merged into one, whose instructions form
+ * a trie: the paths share the instructions of a common prefix, and a branch
+ * hands each node to every way the paths diverge after it.  Each path ends
+ * by collecting its results into the selection at its own index, up to
+ * `limit' of them when that is not zero.
+ */
+program *compile_batch(const DocumentModel *model, const jsonpath * const *paths, size_t count);
+
+evaluator_status_code execute_batch(const program *code, const DocumentModel *model, Cursor document, size_t limit, Selection *results);
+
+/*
+ * Evaluate the path against one document of the model, with the compiled
+ * program when `code' is not NULL and with the step interpreter otherwise.
+ * Neither changes the program or the model's shared state, so different
+ * documents can be evaluated on different threads at once.
+ */
+evaluator_status_code evaluate_document(const DocumentModel *model, const jsonpath *path, const program *code,
+                                        Document *document, nodelist_iterator sink, void *context);
+
+/*
+ * Evaluate the path against every document of the model on up to `threads'
+ * worker threads, or one per online processor when zero.  Each document's
+ * results are collected, up to `limit' of them when that is not zero, and
+ * handed to the sink in document order on the calling thread.
+ */
+evaluator_status_code evaluate_documents(const DocumentModel *model, const jsonpath *path, const program *code,
+                                         size_t threads, size_t limit, nodelist_iterator sink, void *context);
+
+/* how many threads to use when `threads' are asked for, zero meaning one per online processor */
+size_t evaluator_threads(size_t threads);
+
+/*
+ * A pool of worker threads sharing ordered fork/join tasks by work stealing.
+ * A task emits nodes and forks other tasks in any mix.  Its output is kept
+ * in that order, with each forked task's output standing where it was
+ * forked, and the whole is handed to the sink once every task has finished.
+ * Each task's argument is allocated with malloc and is freed by the pool.
+ */
+typedef struct task_pool task_pool;
+typedef struct task task;
+
+typedef evaluator_status_code (*task_function)(task_pool *pool, task *self, void *argument);
+
+task_pool *make_task_pool(size_t threads);
+void       task_pool_free(task_pool *pool);
+
+evaluator_status_code task_pool_run(task_pool *pool, task_function function, void *argument, nodelist_iterator sink, void *context);
+bool       task_emit(task *self, Node *each);
+bool       task_fork(task_pool *pool, task *self, task_function function, void *argument);
+/* has any task failed, so that the others can give up early */
+bool       task_pool_failed(task_pool *pool);
+
+/*
+ * Execute the program with recursive descents into wide sequences and
+ * mappings split across the pool's workers.  The results are handed on in
+ * the same order, but only once all of them have been found.
+ */
+evaluator_status_code execute_program_in_pool(const program *code, const DocumentModel *model, Document *document,
+                                              task_pool *pool, nodelist_iterator sink, void *context);
+/* does the program descend recursively, so that running it in a pool can pay off */
+bool program_descends(const program *code);
 
 #define component_name "evaluator"
 
@@ -56,6 +56,21 @@ hashcode fnv1a_string_buffer_hash(const uint8_t *key, size_t length);
 hashcode djb_string_hash(const void *key);
 hashcode djb_string_buffer_hash(const uint8_t *key, size_t length);
 
+/*
+ * A word at a time hash in the style of wyhash, keyed with a per-process
+ * seed.  The seed is chosen randomly when the process starts, so inputs
+ * crafted to collide on one run will not collide on the next.
+ */
+hashcode wyhash_string_hash(const void *key);
+hashcode wyhash_string_buffer_hash(const uint8_t *key, size_t length);
+
+uint64_t hash_seed(void);
+/*
+ * Replace the process seed, e.g. to make benchmarks repeatable.  Any table
+ * already holding seeded hash codes must be rebuilt afterwards.
+ */
+void     hash_set_seed(uint64_t seed);
+
 typedef bool (*compare_function)(const void *key1, const void *key2);
 
 bool string_comparitor(const void *key1, const void *key2);
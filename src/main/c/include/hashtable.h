@@ -35,6 +35,7 @@
 #include <stdio.h>
 
 #include "hash.h"
+#include "arena.h"
 
 typedef struct hashtable_s Hashtable;
 
@@ -56,6 +57,7 @@ Hashtable *make_hashtable_with_capacity_factor_function(compare_function compari
                                                         size_t capacity_hint, 
                                                         float load_factor, 
                                                         hash_function function);
+Hashtable *make_hashtable_in(Arena *arena, compare_function comparitor, hash_function function);
 
 void hashtable_free(Hashtable *hashtable);
 
@@ -81,10 +81,41 @@ enum predicate_kind
     WILDCARD,
     SUBSCRIPT,
     SLICE,
-    JOIN
+    JOIN,
+    FILTER
 };
 typedef struct predicate predicate;
 
+enum filter_kind
+{
+    OR_FILTER,
+    AND_FILTER,
+    NOT_FILTER,
+    COMPARISON_FILTER,
+    EXISTS_FILTER        // a relative path alone, true if it selects a node
+};
+typedef struct filter filter;
+
+enum comparison_operator
+{
+    EQUAL_TO,
+    NOT_EQUAL_TO,
+    LESS_THAN,
+    LESS_THAN_OR_EQUAL_TO,
+    GREATER_THAN,
+    GREATER_THAN_OR_EQUAL_TO
+};
+
+enum operand_kind
+{
+    PATH_OPERAND,        // a path relative to the node being filtered, `@' and zero or more names
+    NUMBER_OPERAND,
+    STRING_OPERAND,
+    BOOLEAN_OPERAND,
+    NULL_OPERAND
+};
+typedef struct operand operand;
+
 enum parser_status_code
 {
     JSONPATH_SUCCESS = 0,
@@ -103,6 +134,8 @@ enum parser_status_code
     ERR_EXPECTED_INTEGER,            // expected an integer
     ERR_INVALID_NUMBER,              // invalid number
     ERR_STEP_CANNOT_BE_ZERO,         // slice step value must be non-zero
+    ERR_EXPECTED_FILTER_OPERAND,     // expected a relative path, number, string, boolean or null in a filter
+    ERR_EXPECTED_COMPARISON,         // expected a comparison operator after a value in a filter
 };
 
 typedef enum parser_status_code parser_status_code;
@@ -159,3 +192,24 @@ bool                slice_predicate_has_step(const predicate *value);
 
 jsonpath *          join_predicate_left(const predicate *value);
 jsonpath *          join_predicate_right(const predicate *value);
+
+filter *            filter_predicate_expression(const predicate *value);
+
+enum filter_kind    filter_kind(const filter *value);
+const char *        filter_kind_name(enum filter_kind value);
+filter *            filter_left(const filter *value);
+filter *            filter_right(const filter *value);
+filter *            filter_negated(const filter *value);
+
+enum comparison_operator comparison_filter_operator(const filter *value);
+const char *             comparison_operator_name(enum comparison_operator value);
+const operand *          comparison_filter_left(const filter *value);
+const operand *          comparison_filter_right(const filter *value);
+const operand *          exists_filter_operand(const filter *value);
+
+enum operand_kind   operand_kind(const operand *value);
+jsonpath *          path_operand(const operand *value);
+double              number_operand(const operand *value);
+uint8_t *           string_operand(const operand *value);
+size_t              string_operand_length(const operand *value);
+bool                boolean_operand(const operand *value);
@@ -68,9 +68,59 @@ struct predicate
             jsonpath *left;
             jsonpath *right;
         } join;
+
+        struct
+        {
+            filter *expression;
+        } filter;
     };
 };
 
+struct operand
+{
+    enum operand_kind kind;
+
+    union
+    {
+        jsonpath *path;
+        double    number;
+        bool      boolean;
+
+        struct
+        {
+            uint8_t *value;
+            size_t   length;
+        } string;
+    };
+};
+
+struct filter
+{
+    enum filter_kind kind;
+
+    union
+    {
+        struct
+        {
+            filter *left;
+            filter *right;
+        } junction;
+
+        filter *negated;
+
+        struct
+        {
+            enum comparison_operator op;
+            operand left;
+            operand right;
+        } comparison;
+
+        operand exists;
+    };
+};
+
+void filter_free(filter *value);
+
 struct step
 {
     enum step_kind kind;
@@ -94,6 +144,8 @@ struct step
     predicate *predicate;
 };
 
+void step_free(step *value);
+
 struct jsonpath
 {
     uint8_t *expression;
@@ -40,6 +40,7 @@
 #include <yaml.h>
 
 #include "model.h"
+#include "tape.h"
 #include "maybe.h"
 
 enum loader_status_code
@@ -71,6 +72,16 @@ enum loader_duplicate_key_strategy
 const char *duplicate_strategy_name(enum loader_duplicate_key_strategy value);
 int32_t     parse_duplicate_strategy(const char *value);
 
+enum loader_input_format
+{
+    INPUT_AUTO,  // JSON if the input starts with an object or array, else YAML
+    INPUT_YAML,
+    INPUT_JSON
+};
+
+const char *input_format_name(enum loader_input_format value);
+int32_t     parse_input_format(const char *value);
+
 struct maybe_document_s
 {
     enum maybe_tag tag;
@@ -87,5 +98,35 @@ struct maybe_document_s
 
 typedef struct maybe_document_s MaybeDocument;
 
-MaybeDocument load_string(const unsigned char *input, size_t size, enum loader_duplicate_key_strategy value);
-MaybeDocument load_file(FILE *input, enum loader_duplicate_key_strategy value);
+MaybeDocument load_string(const unsigned char *input, size_t size, enum loader_duplicate_key_strategy value, enum loader_input_format format);
+MaybeDocument load_file(FILE *input, enum loader_duplicate_key_strategy value, enum loader_input_format format);
+/*
+ * Load a file by mapping it into memory.  Scalars that appear verbatim in the
+ * input borrow their bytes from the mapping instead of being copied, the
+ * mapping is released when the model is freed.
+ */
+MaybeDocument load_mapped(const char *path, enum loader_duplicate_key_strategy value, enum loader_input_format format);
+
+struct maybe_tape_s
+{
+    enum maybe_tag tag;
+    union
+    {
+        Tape *just;
+        struct
+        {
+            loader_status_code code;
+            char *message;
+        } nothing;
+    };
+};
+
+typedef struct maybe_tape_s MaybeTape;
+
+/*
+ * Load the input into a tape rather than a model, see tape.h.  These mirror
+ * the functions above, and a mapped file is released when the tape is freed.
+ */
+MaybeTape load_tape_string(const unsigned char *input, size_t size, enum loader_duplicate_key_strategy value, enum loader_input_format format);
+MaybeTape load_tape_file(FILE *input, enum loader_duplicate_key_strategy value, enum loader_input_format format);
+MaybeTape load_tape_mapped(const char *path, enum loader_duplicate_key_strategy value, enum loader_input_format format);
@@ -38,10 +38,12 @@
 #pragma once
 
 #include <errno.h>
-#include <regex.h>
 
 #include "log.h"
 #include "hashtable.h"
+#include "tape.h"
+
+struct tape_builder;
 
 struct loader_context
 {
@@ -50,6 +52,11 @@ struct loader_context
     enum loader_duplicate_key_strategy strategy;
 
     DocumentModel     *model;
+    struct
+    {
+        uint8_t *data;
+        size_t   length;
+    } input;
 
     Node              *target;
     struct
@@ -57,17 +64,58 @@ struct loader_context
         uint8_t *value;
         size_t   length;
     } key_holder;
+    yaml_event_t       key_event;
 
     Hashtable        *anchors;
 
-    regex_t           decimal_regex;
-    regex_t           integer_regex;
-    regex_t           timestamp_regex;
+    /** when not NULL, the input is loaded into a tape rather than a model, see tape.c */
+    struct tape_builder *tape;
 };
 
 typedef struct loader_context loader_context;
 
+enum structural_kernel
+{
+    KERNEL_SCALAR,
+    KERNEL_SSE2,
+    KERNEL_AVX2
+};
+
+struct structural_index
+{
+    uint32_t *positions;
+    size_t    length;
+    size_t    capacity;
+};
+
+const char *structural_kernel_name(enum structural_kernel kernel);
+bool structural_kernel_supported(enum structural_kernel kernel);
+enum structural_kernel best_structural_kernel(void);
+bool build_structural_index(struct structural_index *index, const uint8_t *input, size_t length, enum structural_kernel kernel);
+void structural_index_free(struct structural_index *index);
+
 void build_model(struct loader_context *context);
+void build_json_model(struct loader_context *context, const uint8_t *input, size_t length);
+bool add_node(struct loader_context *context, Node *value);
+ScalarKind resolve_scalar_kind(const yaml_event_t *event);
+uint8_t *borrow_scalar_value(const loader_context *context, const yaml_event_t *event);
+
+/*
+ * Building a tape.  The builder tracks the open containers itself, and tells
+ * keys from values by whether the innermost open mapping is waiting for a
+ * key.  Each of these returns false, with the context's code set, on failure.
+ */
+bool     start_tape(struct loader_context *context);
+/* the finished tape, or NULL when loading it failed, which frees it */
+Tape    *finish_tape(struct loader_context *context);
+void     build_tape(struct loader_context *context);
+/* the kind of the innermost open container, or of the open document */
+NodeKind tape_target_kind(const struct loader_context *context);
+bool     tape_start_document(struct loader_context *context);
+bool     tape_end_document(struct loader_context *context);
+bool     tape_start_container(struct loader_context *context, NodeKind kind, const uint8_t *tag, size_t *index);
+bool     tape_end_container(struct loader_context *context);
+bool     tape_add_scalar(struct loader_context *context, const uint8_t *value, size_t length, ScalarKind kind, bool borrowable, const uint8_t *tag, size_t *index);
 loader_status_code interpret_yaml_error(yaml_parser_t *parser);
 char *loader_simple_status_message(loader_status_code code);
 char *loader_status_message(const loader_context *context);
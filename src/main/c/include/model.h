@@ -41,6 +41,7 @@
 #include <stdbool.h>
 #include <stdint.h>
 
+#include "arena.h"
 #include "hashtable.h"
 #include "vector.h"
 
@@ -62,33 +63,33 @@ enum scalar_kind
     SCALAR_REAL,
     SCALAR_TIMESTAMP,
     SCALAR_BOOLEAN,
-    SCALAR_NULL
+    SCALAR_NULL,
+    SCALAR_UNRESOLVED     /* classified on first use, never returned by scalar_kind() */
 };
 
 typedef enum scalar_kind ScalarKind;
 
-struct node_s
+/* a node's tag and anchor, which most nodes have neither of */
+struct node_properties_s
 {
-    struct
-    {
-        NodeKind  kind;
-        uint8_t  *name;
-    } tag;
-
-    const struct vtable_s *vtable;
-    struct node_s *parent;
+    uint8_t *tag;
     uint8_t *anchor;
 };
 
-typedef struct node_s Node;
-
-struct vtable_s
+struct node_s
 {
-    void (*free)(Node *);
-    size_t (*size)(const Node *);
-    bool (*equals)(const Node *, const Node *);
+    NodeKind kind;
+    /** the node's place in document order, numbered by `model_index_names` */
+    uint32_t position;
+    struct node_s *parent;
+    /** NULL until a tag or anchor is set */
+    struct node_properties_s *properties;
+    /** when not NULL, the node and everything it owns live in this arena */
+    Arena *arena;
 };
 
+typedef struct node_s Node;
+
 struct document_s
 {
     struct node_s base;
@@ -97,12 +98,44 @@ struct document_s
 
 typedef struct document_s Document;
 
+/* owned values up to this long are stored in the node rather than allocated */
+#define SCALAR_INLINE_CAPACITY 16
+
+/* how much of a numeric scalar's value has been parsed into `number` */
+enum scalar_number_state
+{
+    NUMBER_UNPARSED,
+    NUMBER_INTEGER,
+    NUMBER_REAL,
+    NUMBER_INVALID
+};
+
+/* the longest value a scalar can hold, so that its length fits in the node */
+#define SCALAR_MAX_LENGTH UINT32_MAX
+
 struct scalar_s
 {
     struct node_s    base;
-    ScalarKind kind;
-    uint8_t         *value;
-    size_t           length;
+    /** a `ScalarKind`, kept in a byte so the node stays at 64 bytes */
+    uint8_t          kind;
+    /** an `enum scalar_number_state`, filled on first use like `kind` */
+    uint8_t          parsed;
+    bool             borrowed : 1;
+    /** is the value held in `storage.bytes` rather than pointed to? */
+    bool             inlined : 1;
+    /** is this a model's shared copy of a mapping key, see `model_intern`? */
+    bool             interned : 1;
+    uint32_t         length;
+    union
+    {
+        uint8_t     *value;
+        uint8_t      bytes[SCALAR_INLINE_CAPACITY];
+    } storage;
+    union
+    {
+        int64_t      integer;
+        double       real;
+    } number;
 };
 
 typedef struct scalar_s Scalar;
@@ -111,6 +144,8 @@ struct sequence_s
 {
     struct node_s base;
     Vector       *values;
+    /** how many nodes are below this one, counted by `model_index_names` */
+    uint32_t      extent;
 };
 
 typedef struct sequence_s Sequence;
@@ -119,6 +154,8 @@ struct mapping_s
 {
     struct node_s base;
     Hashtable    *values;
+    /** how many nodes are below this one, counted by `model_index_names` */
+    uint32_t      extent;
 };
 
 typedef struct mapping_s Mapping;
@@ -131,7 +168,35 @@ struct alias_s
 
 typedef struct alias_s Alias;
 
-typedef Vector  DocumentModel;
+enum name_index_state
+{
+    NAME_INDEX_UNBUILT,
+    NAME_INDEX_READY,
+    NAME_INDEX_UNAVAILABLE
+};
+
+struct document_model_s
+{
+    Vector *documents;
+    Arena  *arena;
+    struct
+    {
+        uint8_t *data;
+        size_t   length;
+    } input;
+    /** one shared key scalar per distinct mapping key, made on first use */
+    Hashtable *symbols;
+    /** the mappings holding each symbol, grouped by symbol, see `model_index_names` */
+    struct
+    {
+        enum name_index_state state;
+        struct mapping_s    **holders;
+        /** how many times a recursive name test was asked for before the index was built */
+        size_t                wanted;
+    } names;
+};
+
+typedef struct document_model_s DocumentModel;
 
 Node *narrow(Node *instance, NodeKind kind);
 #define CHECKED_CAST(OBJ, KIND, TYPE) ((TYPE *)narrow((OBJ), (KIND)))
@@ -145,8 +210,21 @@ Document *make_document_node(void);
 Sequence *make_sequence_node(void);
 Mapping  *make_mapping_node(void);
 Scalar   *make_scalar_node(const uint8_t *value, size_t length, ScalarKind kind);
+Scalar   *make_borrowed_scalar_node(uint8_t *value, size_t length, ScalarKind kind);
 Alias    *make_alias_node(Node *target);
-#define   make_model() make_vector_with_capacity(1)
+DocumentModel *make_model(void);
+
+/*
+ * Nodes made in an arena, such as the one owned by each model, are released
+ * only when the arena is.  `node_free` ignores them, and they must only be
+ * added to containers made in the same arena.
+ */
+Document *make_document_node_in(Arena *arena);
+Sequence *make_sequence_node_in(Arena *arena);
+Mapping  *make_mapping_node_in(Arena *arena);
+Scalar   *make_scalar_node_in(Arena *arena, const uint8_t *value, size_t length, ScalarKind kind);
+Scalar   *make_borrowed_scalar_node_in(Arena *arena, uint8_t *value, size_t length, ScalarKind kind);
+Alias    *make_alias_node_in(Arena *arena, Node *target);
 
 /*
  * Destructors
@@ -160,11 +238,30 @@ void model_free(DocumentModel *value);
  * Model API
  */
 
-#define model_size vector_length
-#define model_document vector_get
-Node   *model_document_root(const DocumentModel *model, size_t index);
+size_t    model_size(const DocumentModel *model);
+Document *model_document(const DocumentModel *model, size_t index);
+Node     *model_document_root(const DocumentModel *model, size_t index);
 
-bool    model_add(DocumentModel *model, Document *doc);
+bool      model_add(DocumentModel *model, Document *doc);
+/*
+ * Hand ownership of a memory mapped input buffer to the model.  Borrowed
+ * scalars point into this buffer, so it is unmapped only by `model_free`.
+ */
+void      model_set_input(DocumentModel *model, uint8_t *data, size_t length);
+/*
+ * The arena that holds the model's nodes, and how much of it is in use.
+ */
+Arena     *model_arena(const DocumentModel *model);
+ArenaStats model_arena_stats(const DocumentModel *model);
+/*
+ * The model's single copy of a mapping key, made in the model's arena the
+ * first time it is asked for.  Keys put with `mapping_put_key` are shared by
+ * every mapping that uses them, and finding an interned key is a pointer
+ * comparison.  `model_symbol` only looks, returning NULL if no mapping key in
+ * the model was interned with this value.
+ */
+Scalar    *model_intern(DocumentModel *model, const uint8_t *value, size_t length);
+Scalar    *model_symbol(const DocumentModel *model, const uint8_t *value, size_t length);
 
 /*
  * Node API
@@ -177,6 +274,8 @@ NodeKind    node_kind_(const Node *value);
 #define     node_kind(object) node_kind_(node((object)))
 uint8_t    *node_name_(const Node *value);
 #define     node_name(object) node_name_(node((object)))
+uint8_t    *node_anchor_(const Node *value);
+#define     node_anchor(object) node_anchor_(node((object)))
 Node       *node_parent_(const Node *value);
 #define     node_parent(object) node_parent_(node((object)))
 size_t      node_size_(const Node *value);
@@ -215,6 +314,18 @@ ScalarKind  scalar_kind(const Scalar *scalar);
 bool        scalar_boolean_is_true(const Scalar *scalar);
 bool        scalar_boolean_is_false(const Scalar *scalar);
 
+/*
+ * The binary value of an integer or real scalar, parsed from its text on
+ * first use and kept in the node.  `scalar_integer` fails for reals and for
+ * integers outside the range of `int64_t`, `scalar_number` gives any number
+ * as the nearest double.  Both fail for scalars of other kinds.
+ */
+bool        scalar_integer(const Scalar *scalar, int64_t *result);
+bool        scalar_number(const Scalar *scalar, double *result);
+
+ScalarKind  classify_scalar_value(const uint8_t *value, size_t length);
+enum scalar_number_state parse_scalar_number(const uint8_t *value, size_t length, int64_t *integer, double *real);
+
 #define scalar(obj) (CHECKED_CAST((obj), SCALAR, Scalar))
 #define const_scalar(obj) (CONST_CHECKED_CAST((obj), SCALAR, Scalar))
 
@@ -248,6 +359,12 @@ bool sequence_iterate(const Sequence *seq, sequence_iterator iterator, void *con
 Node *mapping_get(const Mapping *map, uint8_t *key, size_t length);
 bool  mapping_contains(const Mapping *map, uint8_t *scalar, size_t length);
 bool  mapping_put(Mapping *map, uint8_t *key, size_t length, Node *value);
+/*
+ * Variants taking a key from `model_intern`, which the mapping shares rather
+ * than owns.  The mapping must be made in the same model's arena.
+ */
+Node *mapping_get_key(const Mapping *map, const Scalar *key);
+bool  mapping_put_key(Mapping *map, Scalar *key, Node *value);
 
 typedef bool (*mapping_iterator)(Node *key, Node *value, void *context);
 bool mapping_iterate(const Mapping *map, mapping_iterator iterator, void *context);
@@ -256,6 +373,27 @@ bool mapping_iterate(const Mapping *map, mapping_iterator iterator, void *contex
 #define const_mapping(obj) (CONST_CHECKED_CAST((obj), MAPPING, Mapping))
 #define is_mapping(obj) (MAPPING == node_kind(node((obj))))
 
+/*
+ * Name index API
+ */
+
+/*
+ * An inverted index of the model's mapping keys: for each symbol, the mappings
+ * that hold it in document order.  Every node is numbered in document order as
+ * well, so the mappings below any one node are a single run of each list.  It
+ * is built by one walk of the model the first time it is asked for, and only
+ * for models without aliases whose keys were all interned, as the loader's
+ * are.  Otherwise this returns false and callers walk the tree instead.  The
+ * model must not be changed once it has been indexed.
+ */
+bool model_index_names(DocumentModel *model);
+/*
+ * Visit the key and value of each mapping at or below `root` that holds `key`,
+ * in document order.  The key must be one of the model's own symbols, and the
+ * model must have been indexed.
+ */
+bool model_find_key(const DocumentModel *model, const Node *root, const Scalar *key, mapping_iterator iterator, void *context);
+
 /*
  * Alias API
  */
@@ -52,8 +52,78 @@ struct context_adapter_s
 typedef struct context_adapter_s context_adapter;
 
 
-void node_init_(Node *value, NodeKind kind);
-#define node_init(object, kind) node_init_(node((object)), (kind))
+/*
+ * The behaviour of each kind of node, found by its kind rather than through a
+ * pointer in every node.
+ */
+struct vtable_s
+{
+    void (*free)(Node *);
+    size_t (*size)(const Node *);
+    bool (*equals)(const Node *, const Node *);
+};
+
+extern const struct vtable_s document_vtable;
+extern const struct vtable_s scalar_vtable;
+extern const struct vtable_s sequence_vtable;
+extern const struct vtable_s mapping_vtable;
+extern const struct vtable_s alias_vtable;
+
+void node_init_(Node *value, NodeKind kind, Arena *arena);
+#define node_init(object, kind, arena) node_init_(node((object)), (kind), (arena))
+
+/* zeroed storage from the arena, or from the heap when there is none */
+static inline void *node_allocate(Arena *arena, size_t size)
+{
+    return NULL == arena ? calloc(1, size) : arena_alloc(arena, size);
+}
+
+static inline void node_release(Arena *arena, void *block)
+{
+    if(NULL == arena)
+    {
+        free(block);
+    }
+}
 
 bool node_comparitor(const void *one, const void *two);
 
+/* a node's tag, without the argument checks of `node_name` */
+static inline uint8_t *node_tag(const Node *self)
+{
+    return NULL == self->properties ? NULL : self->properties->tag;
+}
+
+/* the bytes of a scalar's value, without the argument checks of `scalar_value` */
+static inline uint8_t *scalar_bytes(const Scalar *self)
+{
+    return self->inlined ? (uint8_t *)self->storage.bytes : self->storage.value;
+}
+
+/*
+ * Initialize caller provided storage, usually on the stack, as a string scalar
+ * that borrows `value`.  Used to probe mappings without allocating a key.
+ */
+void scalar_init_probe(Scalar *self, uint8_t *value, size_t length);
+
+/*
+ * An interned mapping key, which caches its hash so that neither putting nor
+ * finding it in a mapping has to read the key's bytes.
+ */
+struct symbol_s
+{
+    Scalar   scalar;
+    hashcode hash;
+    /** where the mappings holding this key start in the model's name index, and how many there are */
+    size_t   first;
+    size_t   count;
+};
+
+typedef struct symbol_s Symbol;
+
+Symbol  *make_symbol_in(Arena *arena, const uint8_t *value, size_t length, hashcode hash);
+
+/* the hash and equality functions of mapping keys, shared with the symbol table */
+hashcode scalar_key_hash(const void *key);
+bool     scalar_key_comparitor(const void *one, const void *two);
+
@@ -53,7 +53,9 @@ enum command
     SHOW_WARRANTY,
     SHOW_HELP,
     INTERACTIVE_MODE,
-    EXPRESSION_MODE
+    EXPRESSION_MODE,
+    SERVE_MODE,
+    CLIENT_MODE
 };
 
 typedef enum loader_duplicate_key_strategy dup_strategy;
@@ -61,13 +63,33 @@ typedef enum loader_duplicate_key_strategy dup_strategy;
 struct options
 {
     const char     *input_file_name;
-    const char     *expression;
+    /** every input file named, all of which are served in serve mode */
+    char * const   *input_file_names;
+    size_t          input_file_count;
+    /** the socket to serve queries on, or to send them to when `client' is set */
+    const char     *socket_name;
+    bool            client;
+    /** each expression given with `-q', in order */
+    const char    **expressions;
+    size_t          expression_count;
+    /** a file of expressions to evaluate after those given with `-q', one per line */
+    const char     *queries_file_name;
     enum command    mode;
     enum emit_mode  emit_mode;
     dup_strategy    duplicate_strategy;
+    enum loader_input_format input_format;
+    /** the most results to print for each expression, or all of them when zero */
+    size_t          limit;
+    /** evaluate each expression against every document of a multi-document input */
+    bool            all_documents;
+    /** load each input file again whenever it changes */
+    bool            reload;
+    /** answer each line of non-tty interactive input with a length prefixed response instead of ending it with `EOD' */
+    bool            framed;
 };
 
 enum command process_options(const int argc, char * const *argv, struct options *options);
+void         options_free(struct options *options);
 
 int32_t parse_emit_mode(const char *valie);
 const char * emit_mode_name(enum emit_mode value);
@@ -0,0 +1,96 @@
+/*
+ * 金棒 (kanabō)
+ * Copyright (c) 2012 Kevin Birch <kmb@pobox.com>.  All rights reserved.
+ * 
+ * 金棒 is a tool to bludgeon YAML and JSON files from the shell: the strong
+ * made stronger.
+ *
+ * For more information, consult the README file in the project root.
+ *
+ * Distributed under an [MIT-style][license] license.
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal with
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * - Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimers.
+ * - Redistributions in binary form must reproduce the above copyright notice, this
+ *   list of conditions and the following disclaimers in the documentation and/or
+ *   other materials provided with the distribution.
+ * - Neither the names of the copyright holders, nor the names of the authors, nor
+ *   the names of other contributors may be used to endorse or promote products
+ *   derived from this Software without specific prior written permission.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE CONTRIBUTORS
+ * OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS WITH THE SOFTWARE.
+ *
+ * [license]: http://www.opensource.org/licenses/ncsa
+ */
+
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdatomic.h>
+
+#include "model.h"
+#include "loader.h"
+
+/*
+ * Models that are replaced while they are being queried.
+ *
+ * A model in use is held in an `atomic_model'.  Each thread that queries it
+ * joins the model's `epochs' once, then brackets every use of the model with
+ * `epoch_enter' and `epoch_leave'.  `model_publish' swaps a new model in and
+ * frees the old one as soon as every reader that could have seen it has
+ * left, so queries never wait for a reload, and a reload only waits for the
+ * queries already running.
+ */
+
+typedef _Atomic(DocumentModel *) atomic_model;
+
+typedef struct epochs epochs;
+typedef struct epoch_reader epoch_reader;
+
+epochs       *make_epochs(void);
+/* every reader must have left */
+void          epochs_free(epochs *self);
+/* a reader for the calling thread, which lasts as long as the epochs do */
+epoch_reader *epochs_join(epochs *self);
+
+void epoch_enter(epoch_reader *reader);
+void epoch_leave(epoch_reader *reader);
+
+/* make `model' current, then free the model it replaces once no reader can still be using it */
+void model_publish(atomic_model *target, DocumentModel *model, epochs *readers);
+
+/*
+ * A reloader loads models on a thread of its own and publishes each one
+ * when it is ready.  Files are read rather than mapped, so a model never
+ * borrows from a file that may be rewritten while it is in use.
+ */
+typedef struct reloader reloader;
+
+/* called on the reloader's thread after each reload, `failure' is NULL if the model was published */
+typedef void (*reload_report)(const char *path, const char *failure, void *context);
+
+reloader *make_reloader(epochs *readers, reload_report report, void *context);
+/* wait for a reload already started, drop those still queued */
+void      reloader_free(reloader *self);
+
+/* load `path' in the background and publish it to `target' */
+bool reload(reloader *self, atomic_model *target, const char *path,
+            enum loader_duplicate_key_strategy strategy, enum loader_input_format format);
+/* reload `path' into `target' whenever the file is written or replaced, instead of any file `target' was watching */
+bool reloader_watch(reloader *self, atomic_model *target, const char *path,
+                    enum loader_duplicate_key_strategy strategy, enum loader_input_format format);
+/* wait until every reload asked for so far is done */
+void reloader_settle(reloader *self);
@@ -0,0 +1,119 @@
+/*
+ * 金棒 (kanabō)
+ * Copyright (c) 2012 Kevin Birch <kmb@pobox.com>.  All rights reserved.
+ * 
+ * 金棒 is a tool to bludgeon YAML and JSON files from the shell: the strong
+ * made stronger.
+ *
+ * For more information, consult the README file in the project root.
+ *
+ * Distributed under an [MIT-style][license] license.
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal with
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * - Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimers.
+ * - Redistributions in binary form must reproduce the above copyright notice, this
+ *   list of conditions and the following disclaimers in the documentation and/or
+ *   other materials provided with the distribution.
+ * - Neither the names of the copyright holders, nor the names of the authors, nor
+ *   the names of other contributors may be used to endorse or promote products
+ *   derived from this Software without specific prior written permission.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE CONTRIBUTORS
+ * OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS WITH THE SOFTWARE.
+ *
+ * [license]: http://www.opensource.org/licenses/ncsa
+ */
+
+#pragma once
+
+#include <stdio.h>
+#include <stdbool.h>
+
+#include "model.h"
+#include "options.h"
+#include "reload.h"
+
+/*
+ * A server answers queries against models loaded once, from clients that
+ * connect to a Unix domain socket.
+ *
+ * Each request is one line of tab separated fields: the output format, the
+ * result limit, `all' or `first' for which documents to evaluate against,
+ * the name of the model, empty for the first one served, and last the
+ * expression itself.  Each response is a header line of `ok' or `error' and
+ * the length of the body that follows it, which is the output as `-q' would
+ * print it or an error message.  A connection's requests are answered in
+ * the order they are sent.
+ */
+#define MAX_REQUEST_LENGTH (1024 * 1024)
+
+struct served_model
+{
+    /** what clients ask for the model by, the canonical name of the file it was loaded from */
+    const char    *name;
+    /** replaced by `model_publish' when the file is reloaded */
+    atomic_model   model;
+};
+
+typedef struct served_model served_model;
+
+/*
+ * The name a file is served under, and asked for by clients: its absolute
+ * path with every link resolved, so that however a script spells the path
+ * it names the same model.  A name that doesn't resolve, like `-', is kept
+ * as it is.  NULL if there is no memory for the copy.
+ */
+char *canonical_model_name(const char *name);
+
+struct query
+{
+    const char     *expression;
+    /** the name of the model to query, or NULL for the first one served */
+    const char     *model;
+    enum emit_mode  emit_mode;
+    size_t          limit;
+    bool            all_documents;
+};
+
+typedef struct query query;
+
+/*
+ * The whole response, header and body, to one request line without its
+ * newline, or NULL if there is no memory for one.  The models should have
+ * their name index built so that answering never writes to them, and a
+ * caller that may race with a reload must be inside an epoch.
+ */
+char *answer_request(const served_model *models, size_t count, const char *request, size_t length, size_t *response_length);
+
+typedef struct server server;
+
+/*
+ * A server listening at `path', with `threads' workers or one per online
+ * processor when zero.  Each worker joins `readers', if given, to answer
+ * requests while the models are reloaded.
+ */
+server *make_server(const char *path, const served_model *models, size_t count, size_t threads, epochs *readers);
+/* answer requests until stopped, false if the server could not carry on */
+bool    server_run(server *self);
+/* ask a running server to stop, safe to call from a signal handler or another thread */
+void    server_stop(server *self);
+/* close every connection and remove the socket */
+void    server_free(server *self);
+
+/*
+ * Send each query to the server at `path' in turn, writing each answer to
+ * `output', or to `errors' if it is an error, as `-q' would.  For a batch,
+ * each answer is followed by an `EOD' line.
+ */
+int query_server(const char *path, const query *queries, size_t count, bool batch, FILE *output, FILE *errors);
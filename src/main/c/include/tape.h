@@ -0,0 +1,180 @@
+/*
+ * 金棒 (kanabō)
+ * Copyright (c) 2012 Kevin Birch <kmb@pobox.com>.  All rights reserved.
+ * 
+ * 金棒 is a tool to bludgeon YAML and JSON files from the shell: the strong
+ * made stronger.
+ *
+ * For more information, consult the README file in the project root.
+ *
+ * Distributed under an [MIT-style][license] license.
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal with
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * - Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimers.
+ * - Redistributions in binary form must reproduce the above copyright notice, this
+ *   list of conditions and the following disclaimers in the documentation and/or
+ *   other materials provided with the distribution.
+ * - Neither the names of the copyright holders, nor the names of the authors, nor
+ *   the names of other contributors may be used to endorse or promote products
+ *   derived from this Software without specific prior written permission.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE CONTRIBUTORS
+ * OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS WITH THE SOFTWARE.
+ *
+ * [license]: http://www.opensource.org/licenses/ncsa
+ */
+
+#pragma once
+
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "model.h"
+
+/*
+ * A flat, immutable alternative to the document model, for inputs that are
+ * loaded once and queried once.  Every node is a 16 byte record in a single
+ * array, in document order: a container is followed by its descendants, and
+ * its `next` is the index just past the last of them, so a subtree is skipped
+ * with one load.  The children of a mapping alternate between key and value.
+ * A scalar's value is a range of the tape's string pool, or of the input
+ * itself when that is memory mapped, and its kind is classified as it is
+ * loaded.  Tags are kept aside, as most records have none.
+ *
+ * A tape is read through cursors, see cursor.h.  Nothing changes a tape once
+ * it is loaded, so any number of threads may read one at once.
+ */
+
+enum tape_record_flag
+{
+    /** the value is a range of the input rather than of the pool */
+    TAPE_BORROWED = 1 << 0,
+    /** the record has a tag, see `cursor_tag` */
+    TAPE_TAGGED   = 1 << 1,
+    /** a key repeated later in the same mapping, see below */
+    TAPE_SHADOWED = 1 << 2
+};
+
+/*
+ * When a mapping repeats a key and the later value wins, the first key keeps
+ * its place and its `next` is pointed at the later value.  The later key is
+ * shadowed, and it and its value are passed over by the mapping's entries.
+ */
+struct tape_record_s
+{
+    /** a `NodeKind` */
+    uint8_t  kind;
+    /** a `ScalarKind` for scalars, never `SCALAR_UNRESOLVED` */
+    uint8_t  scalar_kind;
+    /** any `tape_record_flag` */
+    uint8_t  flags;
+    uint8_t  reserved;
+    /** the length of a scalar's value, or how many items or entries a container holds */
+    uint32_t size;
+    /** where a scalar's value starts, or the record an alias refers to */
+    uint32_t at;
+    /** the record after this one and its descendants, or for a mapping key the record of its value */
+    uint32_t next;
+};
+
+typedef struct tape_record_s TapeRecord;
+
+/* a tagged record, and where its tag starts in the pool */
+struct tape_tag_s
+{
+    uint32_t record;
+    uint32_t at;
+};
+
+/* the most records a tape holds, and the longest its pool or a borrowed input may be */
+#define TAPE_MAX_LENGTH UINT32_MAX
+/* the index of no record, as found by a lookup that fails */
+#define TAPE_NONE SIZE_MAX
+
+struct tape_s
+{
+    TapeRecord        *records;
+    size_t             length;
+    /** the record of each document */
+    uint32_t          *documents;
+    size_t             document_count;
+    /** the values of scalars that aren't borrowed, and each tag followed by a NUL */
+    uint8_t           *pool;
+    size_t             pool_length;
+    /** the tagged records, in record order */
+    struct tape_tag_s *tags;
+    size_t             tag_count;
+    struct
+    {
+        uint8_t *data;
+        size_t   length;
+    } input;
+    /** how many of each the arrays above have room for while the tape is built */
+    struct
+    {
+        size_t records;
+        size_t documents;
+        size_t pool;
+        size_t tags;
+    } capacity;
+};
+
+typedef struct tape_s Tape;
+
+/*
+ * Constructors
+ */
+
+Tape *make_tape(void);
+
+/*
+ * Destructors
+ */
+
+void tape_free(Tape *tape);
+
+/*
+ * Builder API
+ *
+ * A tape is built by appending records in document order.  Appending may move
+ * the records, so builders hold indexes rather than pointers into them.  Each
+ * of these fails, setting errno, when memory runs out or the tape would
+ * outgrow `TAPE_MAX_LENGTH`.
+ */
+
+/* append a record of the given kind, with every other field zero, returning its index */
+bool tape_append(Tape *tape, NodeKind kind, size_t *index);
+/* copy the value of the scalar record into the pool */
+bool tape_set_value(Tape *tape, size_t index, const uint8_t *value, size_t length);
+/* point the value of the scalar record at a range of the input, see `tape_set_input` */
+bool tape_set_borrowed_value(Tape *tape, size_t index, size_t offset, size_t length);
+/* tags must be set in record order */
+bool tape_set_tag(Tape *tape, size_t index, const uint8_t *tag);
+bool tape_add_document(Tape *tape, size_t index);
+/*
+ * Hand ownership of a memory mapped input buffer to the tape.  Borrowed
+ * values point into this buffer, so it is unmapped only by `tape_free`.
+ */
+void tape_set_input(Tape *tape, uint8_t *data, size_t length);
+/* release the room reserved for more records once the tape is built */
+void tape_trim(Tape *tape);
+
+/*
+ * Tape API
+ */
+
+size_t tape_size(const Tape *tape);
+/* the bytes held by the tape's arrays, not counting a borrowed input */
+size_t tape_footprint(const Tape *tape);
@@ -68,7 +68,9 @@ static const char * const MESSAGES[] =
     "At position %d: expected a node type test.",
     "At position %d: expected an integer.",
     "At position %d: invalid number.",
-    "At position %d: slice step value must be non-zero."
+    "At position %d: slice step value must be non-zero.",
+    "At position %d: expected a relative path, number, string, boolean or null in the filter.",
+    "At position %d: expected a comparison operator in the filter."
 };
 
 static const char * const PATH_KIND_NAMES[] =
@@ -96,7 +98,27 @@ static const char * const PREDICATE_KIND_NAMES[] =
     "wildcard predicate",
     "subscript predicate",
     "slice predicate",
-    "join predicate"
+    "join predicate",
+    "filter predicate"
+};
+
+static const char * const FILTER_KIND_NAMES[] =
+{
+    "or filter",
+    "and filter",
+    "not filter",
+    "comparison filter",
+    "exists filter"
+};
+
+static const char * const COMPARISON_OPERATOR_NAMES[] =
+{
+    "==",
+    "!=",
+    "<",
+    "<=",
+    ">",
+    ">="
 };
 
 static const char * const TYPE_TEST_KIND_NAMES[] =
@@ -135,6 +157,16 @@ const char *predicate_kind_name(enum predicate_kind value)
     return PREDICATE_KIND_NAMES[value];
 }
 
+const char *filter_kind_name(enum filter_kind value)
+{
+    return FILTER_KIND_NAMES[value];
+}
+
+const char *comparison_operator_name(enum comparison_operator value)
+{
+    return COMPARISON_OPERATOR_NAMES[value];
+}
+
 char *parser_status_message(const parser_context *context)
 {
     PRECOND_NONNULL_ELSE_NULL(context);
@@ -153,6 +185,8 @@ char *parser_status_message(const parser_context *context)
         case ERR_UNSUPPORTED_PRED_TYPE:
         case ERR_EXPECTED_INTEGER:
         case ERR_INVALID_NUMBER:
+        case ERR_EXPECTED_FILTER_OPERAND:
+        case ERR_EXPECTED_COMPARISON:
             result = asprintf(&message, MESSAGES[context->result.code], context->cursor + 1);
             break;
         case ERR_UNEXPECTED_VALUE:
@@ -43,16 +43,16 @@
 
 static bool slice_predicate_has(const predicate *value, enum slice_specifiers specifier);
 
-static void step_free(step *step);
 static void predicate_free(predicate *predicate);
 
 void path_free(jsonpath *path)
 {
-    if(NULL == path || NULL == path->steps || 0 == path->length)
+    if(NULL == path)
     {
         return;
     }
-    for(size_t i = 0; i < path->length; i++)
+    // N.B. - the relative path of a filter operand can be `@' alone, which has no steps
+    for(size_t i = 0; NULL != path->steps && i < path->length; i++)
     {
         step_free(path->steps[i]);
     }
@@ -94,7 +94,50 @@ static void predicate_free(predicate *value)
         path_free(value->join.left);
         path_free(value->join.right);
     }
+    else if(FILTER == predicate_kind(value))
+    {
+        filter_free(value->filter.expression);
+    }
+
+    free(value);
+}
+
+static void operand_free(operand *value)
+{
+    if(PATH_OPERAND == value->kind)
+    {
+        path_free(value->path);
+    }
+    else if(STRING_OPERAND == value->kind)
+    {
+        free(value->string.value);
+    }
+}
 
+void filter_free(filter *value)
+{
+    if(NULL == value)
+    {
+        return;
+    }
+    switch(value->kind)
+    {
+        case OR_FILTER:
+        case AND_FILTER:
+            filter_free(value->junction.left);
+            filter_free(value->junction.right);
+            break;
+        case NOT_FILTER:
+            filter_free(value->negated);
+            break;
+        case COMPARISON_FILTER:
+            operand_free(&value->comparison.left);
+            operand_free(&value->comparison.right);
+            break;
+        case EXISTS_FILTER:
+            operand_free(&value->exists);
+            break;
+    }
     free(value);
 }
 
@@ -259,3 +302,102 @@ jsonpath *join_predicate_right(const predicate *value)
     }
     return value->join.right;
 }
+
+filter *filter_predicate_expression(const predicate *value)
+{
+    PRECOND_NONNULL_ELSE_NULL(value);
+    PRECOND_ELSE_NULL(FILTER == value->kind);
+    return value->filter.expression;
+}
+
+enum filter_kind filter_kind(const filter *value)
+{
+    return value->kind;
+}
+
+filter *filter_left(const filter *value)
+{
+    PRECOND_NONNULL_ELSE_NULL(value);
+    PRECOND_ELSE_NULL(OR_FILTER == value->kind || AND_FILTER == value->kind);
+    return value->junction.left;
+}
+
+filter *filter_right(const filter *value)
+{
+    PRECOND_NONNULL_ELSE_NULL(value);
+    PRECOND_ELSE_NULL(OR_FILTER == value->kind || AND_FILTER == value->kind);
+    return value->junction.right;
+}
+
+filter *filter_negated(const filter *value)
+{
+    PRECOND_NONNULL_ELSE_NULL(value);
+    PRECOND_ELSE_NULL(NOT_FILTER == value->kind);
+    return value->negated;
+}
+
+enum comparison_operator comparison_filter_operator(const filter *value)
+{
+    return value->comparison.op;
+}
+
+const operand *comparison_filter_left(const filter *value)
+{
+    PRECOND_NONNULL_ELSE_NULL(value);
+    PRECOND_ELSE_NULL(COMPARISON_FILTER == value->kind);
+    return &value->comparison.left;
+}
+
+const operand *comparison_filter_right(const filter *value)
+{
+    PRECOND_NONNULL_ELSE_NULL(value);
+    PRECOND_ELSE_NULL(COMPARISON_FILTER == value->kind);
+    return &value->comparison.right;
+}
+
+const operand *exists_filter_operand(const filter *value)
+{
+    PRECOND_NONNULL_ELSE_NULL(value);
+    PRECOND_ELSE_NULL(EXISTS_FILTER == value->kind);
+    return &value->exists;
+}
+
+enum operand_kind operand_kind(const operand *value)
+{
+    return value->kind;
+}
+
+jsonpath *path_operand(const operand *value)
+{
+    PRECOND_NONNULL_ELSE_NULL(value);
+    PRECOND_ELSE_NULL(PATH_OPERAND == value->kind);
+    return value->path;
+}
+
+double number_operand(const operand *value)
+{
+    PRECOND_NONNULL_ELSE_ZERO(value);
+    PRECOND_ELSE_ZERO(NUMBER_OPERAND == value->kind);
+    return value->number;
+}
+
+uint8_t *string_operand(const operand *value)
+{
+    PRECOND_NONNULL_ELSE_NULL(value);
+    PRECOND_ELSE_NULL(STRING_OPERAND == value->kind);
+    return value->string.value;
+}
+
+size_t string_operand_length(const operand *value)
+{
+    PRECOND_NONNULL_ELSE_ZERO(value);
+    PRECOND_ELSE_ZERO(STRING_OPERAND == value->kind);
+    return value->string.length;
+}
+
+bool boolean_operand(const operand *value)
+{
+    PRECOND_NONNULL_ELSE_FALSE(value);
+    PRECOND_ELSE_FALSE(BOOLEAN_OPERAND == value->kind);
+    return value->boolean;
+}
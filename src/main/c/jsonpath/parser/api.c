@@ -100,9 +100,11 @@ void parser_free(parser_context *context)
     {
         return;
     }
+    // N.B. - steps are only left on the stack when parsing failed, and then nothing else owns them
     for(cell *entry = context->steps; NULL != entry; entry = context->steps)
     {
         context->steps = entry->next;
+        step_free(entry->step);
         free(entry);
     }
     context->steps = NULL;
@@ -88,6 +88,15 @@ static void step_predicate_parser(parser_context *context);
 static void wildcard_predicate(parser_context *context);
 static void subscript_predicate(parser_context *context);
 static void slice_predicate(parser_context *context);
+static void filter_predicate(parser_context *context);
+static filter *or_expression(parser_context *context);
+static filter *and_expression(parser_context *context);
+static filter *unary_expression(parser_context *context);
+static filter *comparison_expression(parser_context *context);
+static bool filter_operand(parser_context *context, operand *target);
+static bool relative_path_operand(parser_context *context, operand *target);
+static bool number_operand_parser(parser_context *context, operand *target);
+static bool string_operand_parser(parser_context *context, operand *target);
 static void name(parser_context *context, step *name_test);
 static void node_type_test(parser_context *context);
 
@@ -100,6 +109,7 @@ static inline int32_t check_one_node_type_test_value(parser_context *context, si
 // input stream handling
 static inline bool has_more_input(parser_context *context);
 static bool look_for(parser_context *context, char *target);
+static bool next_is(parser_context *context, const char *target);
 static int_fast32_t offset_of(parser_context *context, char *target);
 static inline uint8_t get_char(parser_context *context);
 static inline void skip_ws(parser_context *context);
@@ -111,6 +121,10 @@ static inline void reset(parser_context *context, size_t mark);
 static step *make_root_step(void);
 static inline step *make_step(enum step_kind step_kind, enum test_kind test_kind);
 
+// filter constructors
+static filter *make_filter(parser_context *context, enum filter_kind kind);
+static filter *make_junction(parser_context *context, enum filter_kind kind, filter *left, filter *right);
+
 // state management
 static bool push_step(parser_context *context, step *step);
 static step *pop_step(parser_context *context);
@@ -481,6 +495,13 @@ static void step_predicate_parser(parser_context *context)
     if('[' == get_char(context))
     {
         consume_char(context);
+        skip_ws(context);
+        if('?' == get_char(context))
+        {
+            // N.B. - a filter can hold `.' and `]', either of which ends the search for the closing delimiter below
+            try_predicate_parser(filter_predicate);
+            return;
+        }
         if(!look_for(context, "]"))
         {
             context->result.code = ERR_UNBALANCED_PRED_DELIM;
@@ -663,6 +684,340 @@ static void slice_predicate(parser_context *context)
     pred->slice.step = extent;
 }
 
+static void filter_predicate(parser_context *context)
+{
+    enter_state(context, ST_FILTER_PREDICATE);
+
+    skip_ws(context);
+    if('?' != get_char(context))
+    {
+        unexpected_value(context, '?');
+        return;
+    }
+    consume_char(context);
+    skip_ws(context);
+    if('(' != get_char(context))
+    {
+        unexpected_value(context, '(');
+        return;
+    }
+    consume_char(context);
+
+    filter *expression = or_expression(context);
+    if(NULL == expression)
+    {
+        return;
+    }
+    skip_ws(context);
+    if(')' != get_char(context))
+    {
+        parser_trace("filter: uh oh! missing closing ')', aborting...");
+        filter_free(expression);
+        unexpected_value(context, ')');
+        return;
+    }
+    consume_char(context);
+
+    predicate *pred = add_predicate(context, FILTER);
+    if(NULL == pred)
+    {
+        filter_free(expression);
+        return;
+    }
+    pred->filter.expression = expression;
+    context->result.code = JSONPATH_SUCCESS;
+}
+
+static filter *or_expression(parser_context *context)
+{
+    filter *result = and_expression(context);
+    while(NULL != result && next_is(context, "||"))
+    {
+        consume_chars(context, 2);
+        result = make_junction(context, OR_FILTER, result, and_expression(context));
+    }
+    return result;
+}
+
+static filter *and_expression(parser_context *context)
+{
+    filter *result = unary_expression(context);
+    while(NULL != result && next_is(context, "&&"))
+    {
+        consume_chars(context, 2);
+        result = make_junction(context, AND_FILTER, result, unary_expression(context));
+    }
+    return result;
+}
+
+static filter *unary_expression(parser_context *context)
+{
+    if(next_is(context, "!") && !next_is(context, "!="))
+    {
+        consume_char(context);
+        filter *negated = unary_expression(context);
+        if(NULL == negated)
+        {
+            return NULL;
+        }
+        filter *result = make_filter(context, NOT_FILTER);
+        if(NULL == result)
+        {
+            filter_free(negated);
+            return NULL;
+        }
+        result->negated = negated;
+        return result;
+    }
+    if(next_is(context, "("))
+    {
+        consume_char(context);
+        filter *result = or_expression(context);
+        if(NULL != result && !next_is(context, ")"))
+        {
+            filter_free(result);
+            unexpected_value(context, ')');
+            return NULL;
+        }
+        consume_char(context);
+        return result;
+    }
+    return comparison_expression(context);
+}
+
+static filter *comparison_expression(parser_context *context)
+{
+    static const struct
+    {
+        const char *token;
+        enum comparison_operator op;
+    } OPERATORS[] =
+    {
+        // N.B. - the two character operators come first, so that `<=' isn't taken for `<'
+        {"==", EQUAL_TO},
+        {"!=", NOT_EQUAL_TO},
+        {"<=", LESS_THAN_OR_EQUAL_TO},
+        {">=", GREATER_THAN_OR_EQUAL_TO},
+        {"<",  LESS_THAN},
+        {">",  GREATER_THAN}
+    };
+
+    filter *result = make_filter(context, COMPARISON_FILTER);
+    if(NULL == result)
+    {
+        return NULL;
+    }
+    // N.B. - a null operand owns nothing, so a comparison can be freed before both of its operands are parsed
+    result->comparison.left.kind = NULL_OPERAND;
+    result->comparison.right.kind = NULL_OPERAND;
+    if(!filter_operand(context, &result->comparison.left))
+    {
+        filter_free(result);
+        return NULL;
+    }
+    operand left = result->comparison.left;
+
+    for(size_t i = 0; i < sizeof(OPERATORS) / sizeof(OPERATORS[0]); i++)
+    {
+        if(next_is(context, OPERATORS[i].token))
+        {
+            consume_chars(context, strlen(OPERATORS[i].token));
+            result->comparison.op = OPERATORS[i].op;
+            if(!filter_operand(context, &result->comparison.right))
+            {
+                filter_free(result);
+                return NULL;
+            }
+            return result;
+        }
+    }
+
+    if(PATH_OPERAND != left.kind)
+    {
+        parser_trace("filter: uh oh! a value alone isn't a test, aborting...");
+        filter_free(result);
+        context->result.code = ERR_EXPECTED_COMPARISON;
+        return NULL;
+    }
+    result->kind = EXISTS_FILTER;
+    result->exists = left;
+    return result;
+}
+
+static bool filter_operand(parser_context *context, operand *target)
+{
+    skip_ws(context);
+    uint8_t first = get_char(context);
+    if('@' == first)
+    {
+        return relative_path_operand(context, target);
+    }
+    if(isdigit(first) || '-' == first || '+' == first || '.' == first)
+    {
+        return number_operand_parser(context, target);
+    }
+    if('\'' == first || '"' == first)
+    {
+        return string_operand_parser(context, target);
+    }
+    if(next_is(context, "true") || next_is(context, "false"))
+    {
+        target->kind = BOOLEAN_OPERAND;
+        target->boolean = 't' == first;
+        consume_chars(context, target->boolean ? 4 : 5);
+        return true;
+    }
+    if(next_is(context, "null"))
+    {
+        target->kind = NULL_OPERAND;
+        consume_chars(context, 4);
+        return true;
+    }
+    parser_trace("filter: uh oh! expected an operand, aborting...");
+    context->result.code = ERR_EXPECTED_FILTER_OPERAND;
+    return false;
+}
+
+static bool is_filter_name_char(uint8_t value)
+{
+    return '\0' != value && !isspace(value) && NULL == strchr(".[]()!=<>&|'\"", value);
+}
+
+static bool relative_path_operand(parser_context *context, operand *target)
+{
+    size_t mark = context->cursor;
+    jsonpath *path = (jsonpath *)calloc(1, sizeof(jsonpath));
+    if(NULL == path)
+    {
+        context->result.code = ERR_PARSER_OUT_OF_MEMORY;
+        return false;
+    }
+    path->kind = RELATIVE_PATH;
+    consume_char(context);
+
+    while('.' == get_char(context))
+    {
+        consume_char(context);
+        size_t begin = context->cursor, length = 0;
+        if('\'' == get_char(context))
+        {
+            consume_char(context);
+            begin = context->cursor;
+            while(has_more_input(context) && '\'' != get_char(context))
+            {
+                consume_char(context);
+            }
+            length = context->cursor - begin;
+            if(!has_more_input(context))
+            {
+                context->result.code = ERR_PREMATURE_END_OF_INPUT;
+                path_free(path);
+                return false;
+            }
+            consume_char(context);
+        }
+        else
+        {
+            while(is_filter_name_char(get_char(context)))
+            {
+                consume_char(context);
+            }
+            length = context->cursor - begin;
+        }
+        if(0 == length)
+        {
+            context->result.code = ERR_EXPECTED_NAME_CHAR;
+            path_free(path);
+            return false;
+        }
+
+        step *current = make_step(SINGLE, NAME_TEST);
+        step **steps = NULL == current ? NULL : (step **)realloc(path->steps, sizeof(step *) * (path->length + 1));
+        uint8_t *name = NULL == steps ? NULL : (uint8_t *)calloc(1, length);
+        if(NULL == name)
+        {
+            free(current);
+            context->result.code = ERR_PARSER_OUT_OF_MEMORY;
+            path_free(path);
+            return false;
+        }
+        memcpy(name, context->input + begin, length);
+        current->test.name.value = name;
+        current->test.name.length = length;
+        path->steps = steps;
+        path->steps[path->length++] = current;
+    }
+
+    path->expr_length = context->cursor - mark;
+    path->expression = (uint8_t *)calloc(1, path->expr_length);
+    if(NULL == path->expression)
+    {
+        context->result.code = ERR_PARSER_OUT_OF_MEMORY;
+        path_free(path);
+        return false;
+    }
+    memcpy(path->expression, context->input + mark, path->expr_length);
+    target->kind = PATH_OPERAND;
+    target->path = path;
+    return true;
+}
+
+static bool number_operand_parser(parser_context *context, operand *target)
+{
+    char buffer[64];
+    size_t length = 0;
+    while(has_more_input(context) && length < sizeof(buffer) - 1 && NULL != strchr("0123456789+-.eE", get_char(context)))
+    {
+        buffer[length++] = (char)get_char(context);
+        consume_char(context);
+    }
+    buffer[length] = '\0';
+
+    char *end;
+    errno = 0;
+    double value = strtod(buffer, &end);
+    if(0 != errno || 0 == length || (size_t)(end - buffer) != length)
+    {
+        parser_trace("filter: uh oh! invalid number, aborting...");
+        context->result.code = ERR_INVALID_NUMBER;
+        return false;
+    }
+    target->kind = NUMBER_OPERAND;
+    target->number = value;
+    return true;
+}
+
+static bool string_operand_parser(parser_context *context, operand *target)
+{
+    uint8_t quote = get_char(context);
+    consume_char(context);
+    size_t begin = context->cursor;
+    while(has_more_input(context) && quote != get_char(context))
+    {
+        consume_char(context);
+    }
+    if(!has_more_input(context))
+    {
+        context->result.code = ERR_PREMATURE_END_OF_INPUT;
+        return false;
+    }
+    size_t length = context->cursor - begin;
+    consume_char(context);
+
+    // N.B. - never zero bytes, so that an empty string has a value to free
+    uint8_t *value = (uint8_t *)calloc(1, length + 1);
+    if(NULL == value)
+    {
+        context->result.code = ERR_PARSER_OUT_OF_MEMORY;
+        return false;
+    }
+    memcpy(value, context->input + begin, length);
+    target->kind = STRING_OPERAND;
+    target->string.value = value;
+    target->string.length = length;
+    return true;
+}
+
 static int_fast32_t signed_integer(parser_context *context)
 {
     skip_ws(context);
@@ -696,6 +1051,13 @@ static predicate *add_predicate(parser_context *context, enum predicate_kind kin
     return pred;
 }
 
+static bool next_is(parser_context *context, const char *target)
+{
+    skip_ws(context);
+    size_t length = strlen(target);
+    return context->length - context->cursor >= length && 0 == memcmp(context->input + context->cursor, target, length);
+}
+
 static bool look_for(parser_context *context, char *target)
 {
     return -1 != offset_of(context, target);
@@ -709,7 +1071,8 @@ static int_fast32_t offset_of(parser_context *context, char *target)
 
     while(offset < context->length)
     {
-        if('.' == context->input[offset])
+        // N.B. - a predicate ends the step too, so that a `()' in a filter isn't taken for a type test
+        if('.' == context->input[offset] || ('[' == context->input[offset] && '[' != target[0]))
         {
             return -1;
         }
@@ -729,7 +1092,7 @@ static int_fast32_t offset_of(parser_context *context, char *target)
 
 static inline uint8_t get_char(parser_context *context)
 {
-    return context->input[context->cursor];
+    return has_more_input(context) ? context->input[context->cursor] : '\0';
 }
 
 static inline void skip_ws(parser_context *context)
@@ -769,6 +1132,37 @@ static inline bool has_more_input(parser_context *context)
     return context->length > context->cursor;
 }
 
+static filter *make_filter(parser_context *context, enum filter_kind kind)
+{
+    filter *result = (filter *)calloc(1, sizeof(filter));
+    if(NULL == result)
+    {
+        context->result.code = ERR_PARSER_OUT_OF_MEMORY;
+        return NULL;
+    }
+    result->kind = kind;
+    return result;
+}
+
+static filter *make_junction(parser_context *context, enum filter_kind kind, filter *left, filter *right)
+{
+    if(NULL == right)
+    {
+        filter_free(left);
+        return NULL;
+    }
+    filter *result = make_filter(context, kind);
+    if(NULL == result)
+    {
+        filter_free(left);
+        filter_free(right);
+        return NULL;
+    }
+    result->junction.left = left;
+    result->junction.right = right;
+    return result;
+}
+
 static step *make_root_step(void)
 {
     return make_step(ROOT, NAME_TEST);
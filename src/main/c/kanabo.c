@@ -49,6 +49,7 @@
 #include <signal.h>
 #include <execinfo.h>
 #include <libgen.h>
+#include <sys/stat.h>
 
 #include "warranty.h"
 #include "options.h"
@@ -59,17 +60,32 @@
 #include "log.h"
 #include "version.h"
 #include "linenoise.h"
+#include "server.h"
+#include "framed.h"
+#include "reload.h"
 
 static const char * const DEFAULT_PROGRAM_NAME = "kanabo";
 
 static const char * const HELP =
-    "usage: kanabo [-o <format>] [-d <strategy>] -q <jsonpath> [<file> | '-']\n"
-    "       kanabo [-o <format>] [-d <strategy>] [<file>]\n"
+    "usage: kanabo [-o <format>] [-d <strategy>] [-i <format>] [-l <count>] [-a] -q <jsonpath> [<file> | '-']\n"
+    "       kanabo [-o <format>] [-d <strategy>] [-i <format>] [-l <count>] [-a] (-q <jsonpath> | -f <file>)... [<file> | '-']\n"
+    "       kanabo [-d <strategy>] [-i <format>] [-r] -s <socket> <file>...\n"
+    "       kanabo [-o <format>] [-l <count>] [-a] -c <socket> (-q <jsonpath> | -f <file>)... [<file>]\n"
+    "       kanabo [-o <format>] [-d <strategy>] [-i <format>] [-l <count>] [-a] [-r] [-F] [<file>]\n"
     "\n"
     "OPTIONS:\n"
-    "-q, --query <jsonpath>      Specify a single JSONPath query to execute against the input document and exit.\n"
+    "-q, --query <jsonpath>      Specify a JSONPath query to execute against the input document and exit.\n"
+    "                            Given more than once, the queries are evaluated together and each one's output ends with `EOD'.\n"
+    "-f, --queries-file <file>   Evaluate each line of <file> as a query after any given with -q, as if given with -q.\n"
+    "-s, --serve <socket>        Load each <file> and answer queries against them from clients of the Unix domain <socket>.\n"
+    "-c, --client <socket>       Send the queries to the server on <socket>, asking for the model of <file>, or its first.\n"
     "-o, --output <format>       Specify the output format (`bash' (default), `zsh', `json' or `yaml').\n"
     "-d, --duplicate <strategy>  Specify how to handle duplicate mapping keys (`clobber' (default), `warn' or `fail').\n"
+    "-i, --input-format <format> Specify the input format (`auto' (default), `yaml' or `json').\n"
+    "-l, --limit <count>         Stop evaluating each expression after <count> results (0 (default) for no limit).\n"
+    "-a, --all-documents         Evaluate each expression against every document of a multi-document input.\n"
+    "-r, --reload                Load each <file> again in the background whenever it changes, when serving or interactive.\n"
+    "-F, --framed                Begin each interactive response with a header giving its status, result count and length, instead of ending it with `EOD'.\n"
     "\n"
     "STANDALONE OPTIONS:\n"
     "-v, --version               Print the version information and exit.\n"
@@ -83,7 +99,7 @@ static const char * const BANNER =
 static const char * const INTERACTIVE_HELP =
     "The following commands can be used, any other input is treated as JSONPath.\n"
     "\n"
-    ":load <path>             Load JSON/YAML data from the file <path>.\n"
+    ":load <path>             Load JSON/YAML data from the file <path> in the background, queries use the data already loaded until then.\n"
     ":output [<format>]       Get/set the output format. (`bash', `zsh', `json' and `yaml' are supported).\n"
     ":duplicate [<strategy>]  Get/set the strategy to handle duplicate mapping keys (`clobber' (default), `warn' or `fail').\n";
 
@@ -98,6 +114,8 @@ static const char * const INTERACTIVE_HELP =
 
 static const char *program_name = NULL;
 static bool is_interactive = false;
+/** where the errors of a framed response are gathered, on the thread answering it */
+static _Thread_local FILE *captured_errors = NULL;
 
 #define kanabo_debug(FORMAT, ...) log_debug(program_name, (FORMAT), ##__VA_ARGS__)
 #define kanabo_trace(FORMAT, ...) log_trace(program_name, (FORMAT), ##__VA_ARGS__)
@@ -107,15 +125,16 @@ __attribute__((__format__ (__printf__, 1, 2)))
 static void error(const char *format, ...)
 {
     va_list rest;
-    if(is_interactive)
+    FILE *target = NULL == captured_errors ? stderr : captured_errors;
+    if(is_interactive && NULL == captured_errors)
     {
         fputs(program_name, stderr);
         fputs(": ", stderr);
     }
     va_start(rest, format);
-    vfprintf(stderr, format, rest);
+    vfprintf(target, format, rest);
     va_end(rest);
-    fputc('\n', stderr);
+    fputc('\n', target);
 }
 
 static jsonpath *parse_expression(const char *expression)
@@ -151,46 +170,32 @@ static jsonpath *parse_expression(const char *expression)
     return path;
 }
 
-static nodelist *evaluate_expression(const jsonpath *path, const DocumentModel *model)
+static int emit_status(bool emitted, evaluator_status_code code, const char *expression)
 {
-    kanabo_trace("evaluating expression");
-    MaybeNodelist maybe = evaluate(model, path);
-    if(NOTHING == maybe.tag)
+    if(emitted)
     {
-        char *expression = (char *)path_expression(path);
-        error("while evaluating the expression '%s': %s", expression, maybe.nothing.message);
-        return NULL;
+        return EXIT_SUCCESS;
     }
-    return maybe.just;
-}
-
-static emit_function get_emitter(enum emit_mode emit_mode)
-{
-    emit_function result = NULL;
-    switch(emit_mode)
+    if(EVALUATOR_SUCCESS != code && ERR_EVALUATION_STOPPED != code)
     {
-        case BASH:
-            kanabo_debug("using bash emitter");
-            result = emit_bash;
-            break;
-        case ZSH:
-            kanabo_debug("using zsh emitter");
-            result = emit_zsh;
-            break;
-        case JSON:
-            kanabo_debug("using json emitter");
-            result = emit_json;
-            break;
-        case YAML:
-            kanabo_debug("using yaml emitter");
-            result = emit_yaml;
-            break;
+        error("while evaluating the expression '%s': %s", expression, evaluator_status_message(code));
     }
+    else
+    {
+        error("unable to emit results");
+    }
+    return EXIT_FAILURE;
+}
 
-    return result;
+static int emit_results(Evaluation *results, const char *expression, enum emit_mode emit_mode)
+{
+    emit_function emitter = emitter_for(emit_mode);
+    bool emitted = emitter(results);
+    return emit_status(emitted, results->code, expression);
 }
 
-static int apply_expression(const char *expression, DocumentModel *model, enum emit_mode emit_mode)
+/* evaluate the expression against either the model or the tape, whichever is not NULL */
+static int apply_expression(const char *expression, const DocumentModel *model, const Tape *tape, const struct options *options, size_t *count)
 {
     kanabo_debug("evaluating expression: \"%s\"", expression);
     jsonpath *path = parse_expression(expression);
@@ -199,64 +204,83 @@ static int apply_expression(const char *expression, DocumentModel *model, enum e
         return EXIT_FAILURE;
     }
 
-    nodelist *list = evaluate_expression(path, model);
-    if(NULL == list)
-    {
-        path_free(path);
-        return EXIT_FAILURE;
-    }
-
-    emit_function emitter = get_emitter(emit_mode);
-    if(!emitter(list))
+    // N.B. - the emitter runs the evaluation, writing each result as soon as it is found
+    kanabo_trace("evaluating expression");
+    Evaluation results = NULL == tape ? make_evaluation(model, path) : make_tape_evaluation(tape, path);
+    results.limit = options->limit;
+    results.all_documents = options->all_documents;
+    int status = emit_results(&results, expression, options->emit_mode);
+    if(NULL != count)
     {
-        error("unable to emit results");
+        *count = results.count;
     }
 
     path_free(path);
-    nodelist_free(list);
 
-    return EXIT_SUCCESS;
+    return status;
 }
 
-static FILE *open_input(const char *input_file_name)
+/*
+ * A model kept for a session is read rather than mapped: the file may be
+ * truncated or rewritten in place while the model borrows from it, which
+ * would take the process down with SIGBUS.
+ */
+static MaybeDocument load_input(const char *input_file_name, dup_strategy strategy, enum loader_input_format format, bool kept)
 {
     if(use_stdin(input_file_name))
     {
         kanabo_debug("reading from stdin");
-        return stdin;
+        return load_file(stdin, strategy, format);
     }
-    else
+    else if(kept)
     {
         kanabo_debug("reading from file: '%s'", input_file_name);
-        errno = 0;
-        return fopen(input_file_name, "r");
+        FILE *input = fopen(input_file_name, "r");
+        if(NULL == input)
+        {
+            return (MaybeDocument){.tag = NOTHING, .nothing = {ERR_READER_FAILED, strdup(strerror(errno))}};
+        }
+        MaybeDocument result = load_file(input, strategy, format);
+        fclose(input);
+        return result;
     }
-}
-
-static void close_input(FILE *input)
-{
-    if(stdin == input)
+    else
     {
-        return;
+        kanabo_debug("mapping file: '%s'", input_file_name);
+        return load_mapped(input_file_name, strategy, format);
     }
-
-    kanabo_trace("closing input file");
-    errno = 0;
-    fclose(input);
 }
 
-static DocumentModel *load_document(const char *input_file_name, dup_strategy strategy)
+static DocumentModel *load_document(const char *input_file_name, dup_strategy strategy, enum loader_input_format format, bool kept)
 {
-    FILE *input = open_input(input_file_name);
-    if(NULL == input)
+    MaybeDocument maybe = load_input(input_file_name, strategy, format, kept);
+    if(NOTHING == maybe.tag)
     {
         const char *name = get_input_name(input_file_name);
-        error("while reading '%s': %s", name, strerror(errno));
+        error("while reading '%s': %s", name, maybe.nothing.message);
+        free(maybe.nothing.message);
+
         return NULL;
     }
+    else
+    {
+        return maybe.just;
+    }
+}
 
-    MaybeDocument maybe = load_file(input, strategy);
-    close_input(input);
+static Tape *load_tape(const char *input_file_name, dup_strategy strategy, enum loader_input_format format)
+{
+    MaybeTape maybe;
+    if(use_stdin(input_file_name))
+    {
+        kanabo_debug("reading from stdin");
+        maybe = load_tape_file(stdin, strategy, format);
+    }
+    else
+    {
+        kanabo_debug("reading from file: '%s'", input_file_name);
+        maybe = load_tape_mapped(input_file_name, strategy, format);
+    }
     if(NOTHING == maybe.tag)
     {
         const char *name = get_input_name(input_file_name);
@@ -265,10 +289,7 @@ static DocumentModel *load_document(const char *input_file_name, dup_strategy st
 
         return NULL;
     }
-    else
-    {
-        return maybe.just;
-    }
+    return maybe.just;
 }
 
 static void output_command(const char *argument, struct options *options)
@@ -277,8 +298,8 @@ static void output_command(const char *argument, struct options *options)
     if(!argument)
     {
         kanabo_trace("no command argument, printing current value");
-        fputs(emit_mode_name(options->emit_mode), stdout);
-        fputc('\n', stdout);
+        fputs(emit_mode_name(options->emit_mode), emit_output());
+        fputc('\n', emit_output());
         return;
     }
 
@@ -298,8 +319,8 @@ static void duplicate_command(const char *argument, struct options *options)
     if(!argument)
     {
         kanabo_trace("no command argument, printing current value");
-        fputs(duplicate_strategy_name(options->duplicate_strategy), stdout);
-        fputc('\n', stdout);
+        fputs(duplicate_strategy_name(options->duplicate_strategy), emit_output());
+        fputc('\n', emit_output());
         return;
     }
 
@@ -313,18 +334,111 @@ static void duplicate_command(const char *argument, struct options *options)
     options->duplicate_strategy = (enum loader_duplicate_key_strategy)strategy;
 }
 
-static DocumentModel *load_command(const char *argument, struct options *options)
+/*
+ * An interactive session queries one model, which is loaded again in the
+ * background by `:load', or when its file changes with `-r'.
+ */
+struct session
+{
+    atomic_model  model;
+    epochs       *readers;
+    epoch_reader *reader;
+    reloader     *reloader;
+};
+
+static void report_reload(const char *path, const char *failure, void *context __attribute__((unused)))
+{
+    if(NULL == failure)
+    {
+        kanabo_debug("loaded '%s'", path);
+        return;
+    }
+    error("while reading '%s': %s", path, failure);
+}
+
+static void watch_input(struct session *session, const char *path, const struct options *options)
+{
+    if(!reloader_watch(session->reloader, &session->model, path, options->duplicate_strategy, options->input_format))
+    {
+        error("while watching '%s': %s", path, strerror(errno));
+    }
+}
+
+static void load_command(const char *argument, struct options *options, struct session *session)
 {
     kanabo_debug("processing load command...");
     if(!argument)
     {
         kanabo_trace("no command argument, aborting...");
         error(":load command requires an argument");
-        return NULL;
+        return;
+    }
+
+    kanabo_debug("found command argument, loading '%s' in the background...", argument);
+    if(!reload(session->reloader, &session->model, argument, options->duplicate_strategy, options->input_format))
+    {
+        error("while reading '%s': %s", argument, strerror(errno));
+        return;
     }
+    if(options->reload)
+    {
+        watch_input(session, argument, options);
+    }
+}
 
-    kanabo_debug("found command argument, loading '%s'...", argument);
-    return load_document(argument, options->duplicate_strategy);
+static size_t query_command(const char *command, struct options *options, struct session *session)
+{
+    // N.B. - until the first model is loaded there is nothing else to answer with, so that is worth waiting for
+    if(NULL == atomic_load(&session->model))
+    {
+        reloader_settle(session->reloader);
+    }
+
+    size_t count = 0;
+    epoch_enter(session->reader);
+    DocumentModel *model = atomic_load(&session->model);
+    if(NULL == model)
+    {
+        error("no input loaded, use the `:load' command");
+    }
+    else
+    {
+        apply_expression(command, model, NULL, options, &count);
+    }
+    epoch_leave(session->reader);
+    return count;
+}
+
+static void close_session(struct session *session)
+{
+    reloader_free(session->reloader);
+    model_free(atomic_load(&session->model));
+    epochs_free(session->readers);
+}
+
+static bool open_session(struct session *session, struct options *options)
+{
+    atomic_init(&session->model, NULL);
+    session->readers = make_epochs();
+    session->reader = NULL == session->readers ? NULL : epochs_join(session->readers);
+    session->reloader = NULL == session->reader ? NULL : make_reloader(session->readers, report_reload, NULL);
+    if(NULL == session->reloader)
+    {
+        error("unable to start the session: %s", strerror(errno));
+        close_session(session);
+        return false;
+    }
+
+    if(options->input_file_name)
+    {
+        DocumentModel *model = load_document(options->input_file_name, options->duplicate_strategy, options->input_format, true);
+        atomic_store(&session->model, model);
+        if(options->reload)
+        {
+            watch_input(session, options->input_file_name, options);
+        }
+    }
+    return true;
 }
 
 static const char *get_argument(const char *command)
@@ -355,11 +469,12 @@ static const char *get_argument(const char *command)
     return arg;
 }
 
-static void dispatch_interactive_command(const char *command, struct options *options, DocumentModel **model)
+/* run one line of interactive input, giving how many results it found if it was a query */
+static size_t dispatch_interactive_command(const char *command, struct options *options, struct session *session)
 {
     if(0 == memcmp("?", command, 1) || 0 == memcmp(":help", command, 5))
     {
-        fwrite(INTERACTIVE_HELP, strlen(INTERACTIVE_HELP), 1, stdout);
+        fwrite(INTERACTIVE_HELP, strlen(INTERACTIVE_HELP), 1, emit_output());
     }
     else if(0 == memcmp(":output", command, 7))
     {
@@ -371,22 +486,13 @@ static void dispatch_interactive_command(const char *command, struct options *op
     }
     else if(0 == memcmp(":load", command, 5))
     {
-        DocumentModel *new_model = load_command(get_argument(command), options);
-        if(new_model)
-        {
-            model_free(*model);
-            *model = new_model;
-        }
+        load_command(get_argument(command), options, session);
     }
     else
     {
-        if(NULL == *model)
-        {
-            error("no input loaded, use the `:load' command");
-            return;
-        }
-        apply_expression(command, *model, options->emit_mode);
+        return query_command(command, options, session);
     }
+    return 0;
 }
 
 static void tty_interctive_mode(struct options *options)
@@ -396,10 +502,10 @@ static void tty_interctive_mode(struct options *options)
     fwrite(BANNER, strlen(BANNER), 1, stdout);
     char *prompt = (char *)DEFAULT_PROMPT;
 
-    DocumentModel *model = NULL;
-    if(options->input_file_name)
+    struct session session;
+    if(!open_session(&session, options))
     {
-        model = load_document(options->input_file_name, options->duplicate_strategy);
+        return;
     }
 
     char *input;
@@ -417,10 +523,67 @@ static void tty_interctive_mode(struct options *options)
         }
 
         linenoiseHistoryAdd(input);
-        dispatch_interactive_command(input, options, &model);
+        dispatch_interactive_command(input, options, &session);
         free(input);
     }
-    model_free(model);
+    close_session(&session);
+}
+
+/*
+ * Answer one request with a response framed by a header line of its status,
+ * `ok' or `error', the request's id, how many results a query found and the
+ * length in bytes of the body that follows.  The body is the output, or the
+ * error messages if there were any.  A request may begin with an id and a
+ * tab, so that a client sending many at once can match up the responses,
+ * and otherwise its id is `-'.
+ */
+static void answer_framed(char *request, struct options *options, struct session *session)
+{
+    char *command = NULL;
+    const char *id = split_request_id(request, &command);
+    if(NULL == id)
+    {
+        id = "-";
+    }
+
+    char *output = NULL;
+    char *errors = NULL;
+    size_t output_length = 0;
+    size_t errors_length = 0;
+    FILE *output_stream = open_memstream(&output, &output_length);
+    FILE *error_stream = open_memstream(&errors, &errors_length);
+    if(NULL == output_stream || NULL == error_stream)
+    {
+        const char *message = strerror(errno);
+        fprintf(stdout, "error %s 0 %zu\n%s\n", id, strlen(message) + 1, message);
+    }
+    else
+    {
+        captured_errors = error_stream;
+        emit_to(output_stream);
+        size_t count = dispatch_interactive_command(command, options, session);
+        emit_to(NULL);
+        captured_errors = NULL;
+        fclose(output_stream);
+        fclose(error_stream);
+        output_stream = error_stream = NULL;
+
+        bool failed = 0 != errors_length;
+        fprintf(stdout, "%s %s %zu %zu\n", failed ? "error" : "ok", id, failed ? 0 : count, failed ? errors_length : output_length);
+        fwrite(failed ? errors : output, 1, failed ? errors_length : output_length, stdout);
+    }
+    fflush(stdout);
+
+    if(NULL != output_stream)
+    {
+        fclose(output_stream);
+    }
+    if(NULL != error_stream)
+    {
+        fclose(error_stream);
+    }
+    free(output);
+    free(errors);
 }
 
 static void pipe_interactive_mode(struct options *options)
@@ -429,10 +592,10 @@ static void pipe_interactive_mode(struct options *options)
     size_t len = 0;
     ssize_t read;
 
-    DocumentModel *model = NULL;
-    if(options->input_file_name)
+    struct session session;
+    if(!open_session(&session, options))
     {
-        model = load_document(options->input_file_name, options->duplicate_strategy);
+        return;
     }
 
     kanabo_debug("entering non-tty interative mode");
@@ -443,12 +606,17 @@ static void pipe_interactive_mode(struct options *options)
             continue;
         }
         input[read - 1] = '\0';  // N.B. `read` should always be positive here
-        dispatch_interactive_command(input, options, &model);
+        if(options->framed)
+        {
+            answer_framed(input, options, &session);
+            continue;
+        }
+        dispatch_interactive_command(input, options, &session);
         fputs("EOD\n", stdout);
         fflush(stdout);
     }
     free(input);
-    model_free(model);
+    close_session(&session);
 }
 
 static int interactive_mode(struct options *options)
@@ -466,22 +634,411 @@ static int interactive_mode(struct options *options)
     return EXIT_SUCCESS;
 }
 
+/*
+ * The expressions of a batch: those given with `-q', then each line of the
+ * queries file that is neither blank nor a `#' comment.
+ */
+struct batch
+{
+    const char **expressions;
+    jsonpath   **paths;
+    size_t       length;
+    /** the queries file, which the expressions read from it point into */
+    char        *text;
+};
+
+static char *read_queries_file(const char *file_name, size_t *lines)
+{
+    kanabo_debug("reading queries from file: '%s'", file_name);
+    FILE *input = fopen(file_name, "r");
+    if(NULL == input)
+    {
+        error("while reading '%s': %s", file_name, strerror(errno));
+        return NULL;
+    }
+
+    size_t length = 0, capacity = 4096;
+    char *text = malloc(capacity);
+    while(NULL != text)
+    {
+        length += fread(text + length, 1, capacity - length - 1, input);
+        if(length < capacity - 1)
+        {
+            break;
+        }
+        capacity *= 2;
+        char *larger = realloc(text, capacity);
+        if(NULL == larger)
+        {
+            free(text);
+        }
+        text = larger;
+    }
+    if(NULL == text || ferror(input))
+    {
+        error("while reading '%s': %s", file_name, NULL == text ? strerror(ENOMEM) : strerror(errno));
+        free(text);
+        fclose(input);
+        return NULL;
+    }
+    fclose(input);
+
+    text[length] = '\0';
+    *lines = 1;
+    for(size_t i = 0; i < length; i++)
+    {
+        *lines += '\n' == text[i];
+    }
+    return text;
+}
+
+static void add_query_lines(struct batch *batch, char *text)
+{
+    char *line = text;
+    while(NULL != line)
+    {
+        char *end = strchr(line, '\n');
+        if(NULL != end)
+        {
+            *end = '\0';
+        }
+        size_t length = strlen(line);
+        while(0 < length && isspace((unsigned char)line[length - 1]))
+        {
+            line[--length] = '\0';
+        }
+        while(isspace((unsigned char)*line))
+        {
+            line++;
+        }
+        if('\0' != *line && '#' != *line)
+        {
+            batch->expressions[batch->length++] = line;
+        }
+        line = NULL == end ? NULL : end + 1;
+    }
+}
+
+static void batch_free(struct batch *batch)
+{
+    if(NULL != batch->paths)
+    {
+        for(size_t i = 0; i < batch->length; i++)
+        {
+            path_free(batch->paths[i]);
+        }
+    }
+    free(batch->paths);
+    free(batch->expressions);
+    free(batch->text);
+}
+
+static bool collect_queries(struct batch *batch, const struct options *options)
+{
+    size_t lines = 0;
+    if(NULL != options->queries_file_name)
+    {
+        batch->text = read_queries_file(options->queries_file_name, &lines);
+        if(NULL == batch->text)
+        {
+            return false;
+        }
+    }
+    batch->expressions = calloc(options->expression_count + lines, sizeof(char *));
+    batch->paths = calloc(options->expression_count + lines, sizeof(jsonpath *));
+    if(NULL == batch->expressions || NULL == batch->paths)
+    {
+        error("while reading the queries: %s", strerror(ENOMEM));
+        return false;
+    }
+    for(size_t i = 0; i < options->expression_count; i++)
+    {
+        batch->expressions[batch->length++] = options->expressions[i];
+    }
+    if(NULL != batch->text)
+    {
+        add_query_lines(batch, batch->text);
+    }
+    return true;
+}
+
+static bool parse_batch(struct batch *batch, const struct options *options)
+{
+    if(!collect_queries(batch, options))
+    {
+        return false;
+    }
+
+    // N.B. - every expression is parsed before the input is loaded, so a mistake in any of them costs nothing
+    bool result = true;
+    for(size_t i = 0; i < batch->length; i++)
+    {
+        batch->paths[i] = parse_expression(batch->expressions[i]);
+        result = result && NULL != batch->paths[i];
+    }
+    return result;
+}
+
+/* evaluate the batch against either the model or the tape, whichever is not NULL */
+static int apply_batch(const struct batch *batch, const DocumentModel *model, const Tape *tape, const struct options *options)
+{
+    kanabo_debug("evaluating a batch of %zd expressions", batch->length);
+    Selection *found = calloc(batch->length, sizeof(Selection));
+    if(NULL == found)
+    {
+        error("while evaluating the expressions: %s", strerror(ENOMEM));
+        return EXIT_FAILURE;
+    }
+    const jsonpath * const *paths = (const jsonpath * const *)batch->paths;
+    evaluator_status_code code = NULL == tape
+        ? evaluate_batch(model, paths, batch->length, options->all_documents, options->limit, found)
+        : evaluate_tape_batch(tape, paths, batch->length, options->all_documents, options->limit, found);
+    if(EVALUATOR_SUCCESS != code)
+    {
+        error("while evaluating the expressions: %s", evaluator_status_message(code));
+        free(found);
+        return EXIT_FAILURE;
+    }
+
+    // N.B. - each expression's results end with the same delimiter as a command's output in non-tty interactive mode
+    int status = EXIT_SUCCESS;
+    for(size_t i = 0; i < batch->length; i++)
+    {
+        Evaluation results = NULL == tape ? make_evaluation(model, batch->paths[i]) : make_tape_evaluation(tape, batch->paths[i]);
+        results.found = found + i;
+        if(EXIT_SUCCESS != emit_results(&results, batch->expressions[i], options->emit_mode))
+        {
+            status = EXIT_FAILURE;
+        }
+        fputs("EOD\n", stdout);
+        selection_release(found + i);
+    }
+    free(found);
+    return status;
+}
+
+/*
+ * The expression parsed without a word about any mistake in it, which is
+ * reported once the input is loaded, as it always has been.
+ */
+static jsonpath *peek_expression(const char *expression)
+{
+    parser_context *parser = make_parser((uint8_t *)expression, strlen(expression));
+    if(NULL == parser)
+    {
+        return NULL;
+    }
+
+    jsonpath *path = parser_status(parser) ? NULL : parse(parser);
+    if(NULL != path && parser_status(parser))
+    {
+        path_free(path);
+        path = NULL;
+    }
+
+    parser_free(parser);
+    return path;
+}
+
+/*
+ * The input of a single run is loaded into a tape rather than a model: it is
+ * queried once, so the model's indexes and caches would never pay for the
+ * memory and the time it takes to build them.  A model is still loaded for
+ * every document at once, for paths that would use its name index or split
+ * across `threads' workers, and for any input that might not fit in a tape,
+ * which includes a pipe, whose length isn't known until it has been read.
+ */
+static bool use_tape(const struct options *options, const jsonpath * const *paths, size_t count, size_t threads)
+{
+    if(options->all_documents || paths_want_model(paths, count, threads, options->limit))
+    {
+        return false;
+    }
+
+    struct stat status;
+    int result = use_stdin(options->input_file_name)
+        ? fstat(STDIN_FILENO, &status)
+        : stat(options->input_file_name, &status);
+    return 0 == result && S_ISREG(status.st_mode) && (uint64_t)status.st_size <= TAPE_MAX_LENGTH;
+}
+
 static int expression_mode(struct options *options)
 {
-    DocumentModel *model = load_document(options->input_file_name, options->duplicate_strategy);
-    if(NULL == model)
+    // N.B. - a single expression is still evaluated as a stream, a batch is collected before anything is written
+    bool batched = NULL != options->queries_file_name || 1 < options->expression_count;
+    struct batch batch = {NULL, NULL, 0, NULL};
+    if(batched && !parse_batch(&batch, options))
     {
+        batch_free(&batch);
         return EXIT_FAILURE;
     }
+
+    // N.B. - a batch never runs on a pool, while a single expression may
+    jsonpath *single = batched ? NULL : peek_expression(options->expressions[0]);
+    bool taped = batched
+        ? use_tape(options, (const jsonpath * const *)batch.paths, batch.length, 1)
+        : use_tape(options, (const jsonpath * const *)&single, NULL == single ? 0 : 1, 0);
+    path_free(single);
+
+    Tape *tape = NULL;
+    DocumentModel *model = NULL;
+    if(taped)
+    {
+        tape = load_tape(options->input_file_name, options->duplicate_strategy, options->input_format);
+    }
     else
     {
-        kanabo_trace("model loaded.");
+        model = load_document(options->input_file_name, options->duplicate_strategy, options->input_format, false);
+    }
+    if(NULL == tape && NULL == model)
+    {
+        batch_free(&batch);
+        return EXIT_FAILURE;
+    }
+    kanabo_trace(taped ? "tape loaded." : "model loaded.");
 
-        int result = apply_expression(options->expression, model, options->emit_mode);
-        model_free(model);
+    int result = batched
+        ? apply_batch(&batch, model, tape, options)
+        : apply_expression(options->expressions[0], model, tape, options, NULL);
+    tape_free(tape);
+    model_free(model);
+    batch_free(&batch);
 
-        return result;
+    return result;
+}
+
+static server *active_server = NULL;
+
+static void stop_serving(int sigval __attribute__((unused)))
+{
+    server_stop(active_server);
+}
+
+/*
+ * Watch each served file, publishing it again to the workers as it changes.
+ * The file is watched by the name it was given, not its canonical one, so
+ * that a link repointed at a new file is followed.
+ */
+static reloader *watch_served(served_model *models, size_t count, epochs *readers, const struct options *options)
+{
+    reloader *result = make_reloader(readers, report_reload, NULL);
+    if(NULL == result)
+    {
+        error("unable to watch the inputs: %s", strerror(errno));
+        return NULL;
+    }
+    for(size_t i = 0; i < count; i++)
+    {
+        const char *name = options->input_file_names[i];
+        if(!reloader_watch(result, &models[i].model, name, options->duplicate_strategy, options->input_format))
+        {
+            error("while watching '%s': %s", name, strerror(errno));
+            reloader_free(result);
+            return NULL;
+        }
+    }
+    return result;
+}
+
+static int serve_mode(struct options *options)
+{
+    size_t count = options->input_file_count;
+    served_model *models = calloc(count, sizeof(served_model));
+    if(NULL == models)
+    {
+        error("while loading the inputs: %s", strerror(ENOMEM));
+        return EXIT_FAILURE;
+    }
+
+    int result = EXIT_SUCCESS;
+    size_t loaded = 0;
+    for(; loaded < count; loaded++)
+    {
+        const char *name = options->input_file_names[loaded];
+        DocumentModel *model = load_document(name, options->duplicate_strategy, options->input_format, true);
+        if(NULL == model)
+        {
+            result = EXIT_FAILURE;
+            break;
+        }
+        // N.B. - indexing now, before the workers share the model, means answering a query never writes to it
+        model_index_names(model);
+        atomic_init(&models[loaded].model, model);
+        if(NULL == (models[loaded].name = canonical_model_name(name)))
+        {
+            error("while loading '%s': %s", name, strerror(errno));
+            model_free(model);
+            result = EXIT_FAILURE;
+            break;
+        }
     }
+
+    epochs *readers = NULL;
+    reloader *reloads = NULL;
+    if(EXIT_SUCCESS == result && options->reload && NULL == (readers = make_epochs()))
+    {
+        error("unable to watch the inputs: %s", strerror(errno));
+        result = EXIT_FAILURE;
+    }
+    if(EXIT_SUCCESS == result)
+    {
+        active_server = make_server(options->socket_name, models, count, 0, readers);
+        if(NULL == active_server)
+        {
+            error("while listening on '%s': %s", options->socket_name, strerror(errno));
+            result = EXIT_FAILURE;
+        }
+    }
+    if(EXIT_SUCCESS == result && options->reload && NULL == (reloads = watch_served(models, count, readers, options)))
+    {
+        result = EXIT_FAILURE;
+    }
+    if(EXIT_SUCCESS == result)
+    {
+        if(SIG_ERR == signal(SIGINT, stop_serving) || SIG_ERR == signal(SIGTERM, stop_serving))
+        {
+            error("while listening on '%s': %s", options->socket_name, strerror(errno));
+            result = EXIT_FAILURE;
+        }
+        else if(!server_run(active_server))
+        {
+            result = EXIT_FAILURE;
+        }
+        signal(SIGINT, SIG_DFL);
+        signal(SIGTERM, SIG_DFL);
+    }
+    // N.B. - the workers are gone once the server is, so a reload finishing after them has no reader to wait for
+    server_free(active_server);
+    active_server = NULL;
+    reloader_free(reloads);
+
+    for(size_t i = 0; i < loaded; i++)
+    {
+        model_free(atomic_load(&models[i].model));
+        free((char *)models[i].name);
+    }
+    free(models);
+    epochs_free(readers);
+    return result;
+}
+
+static int client_mode(struct options *options)
+{
+    struct batch batch = {NULL, NULL, 0, NULL};
+    query *queries = NULL;
+    int result = EXIT_FAILURE;
+    if(collect_queries(&batch, options) && NULL != (queries = calloc(batch.length, sizeof(query))))
+    {
+        for(size_t i = 0; i < batch.length; i++)
+        {
+            queries[i] = (query){batch.expressions[i], options->input_file_name, options->emit_mode, options->limit, options->all_documents};
+        }
+        bool batched = NULL != options->queries_file_name || 1 < options->expression_count;
+        result = query_server(options->socket_name, queries, batch.length, batched, stdout, stderr);
+    }
+    free(queries);
+    batch_free(&batch);
+    return result;
 }
 
 static int execute_command(enum command cmd, struct options *options)
@@ -505,6 +1062,12 @@ static int execute_command(enum command cmd, struct options *options)
         case EXPRESSION_MODE:
             result = expression_mode(options);
             break;
+        case SERVE_MODE:
+            result = serve_mode(options);
+            break;
+        case CLIENT_MODE:
+            result = client_mode(options);
+            break;
     }
 
     return result;
@@ -516,7 +1079,9 @@ static int run(const int argc, char * const *argv)
     memset(&options, 0, sizeof(struct options));
     enum command cmd = process_options(argc, argv, &options);
 
-    return execute_command(cmd, &options);
+    int result = execute_command(cmd, &options);
+    options_free(&options);
+    return result;
 }
 
 static void handle_signal(int sigval)
@@ -41,26 +41,53 @@
 #endif
 
 #include <stdio.h>            /* for fileno() */
+#include <string.h>           /* for strerror() */
+#include <fcntl.h>            /* for open() */
+#include <unistd.h>           /* for close() */
 #include <sys/stat.h>         /* for fstat() */
+#include <sys/mman.h>         /* for mmap() */
 
 #include "conditions.h"
 #include "loader.h"
 #include "loader/private.h"
 
-#define make_regex(MEMBER, PATTERN) (0 == regcomp((MEMBER), (PATTERN), REG_EXTENDED | REG_NOSUB))
+/*
+ * Every load produces either a model or a tape, which the public functions
+ * below wrap as a `MaybeDocument` or a `MaybeTape`.
+ */
+struct outcome
+{
+    loader_status_code code;
+    char              *message;
+    DocumentModel     *model;
+    Tape              *tape;
+};
 
-#define _nothing(CODE, MESSAGE) (MaybeDocument){.tag=NOTHING, .nothing={(CODE), (MESSAGE)}}
+#define _nothing(CODE, MESSAGE) (struct outcome){.code=(CODE), .message=(MESSAGE)}
 
 #define nothing(CONTEXT) _nothing((CONTEXT)->code, loader_status_message((CONTEXT)))
-#define just(MODEL) (MaybeDocument){.tag=JUST, .just=(MODEL)}
 
 #define PRECOND_ELSE_NOTHING(COND, CODE) ENSURE_THAT(_nothing(CODE, loader_simple_status_message(CODE)), EINVAL, (COND))
 #define PRECOND_NONNULL_ELSE_NOTHING(VALUE, CODE) ENSURE_NONNULL(_nothing(CODE, loader_simple_status_message(CODE)), EINVAL, (VALUE))
 #define PRECOND_NONZERO_ELSE_NOTHING(VALUE, CODE) ENSURE_THAT(_nothing(CODE, loader_simple_status_message(CODE)), EINVAL, 0 != (VALUE))
 
-static const char * const DECIMAL_PATTERN = "^-?(0|([1-9][[:digit:]]*))([.][[:digit:]]+)?([eE][+-]?[[:digit:]]+)?$";
-static const char * const INTEGER_PATTERN = "^-?(0|([1-9][[:digit:]]*))$";
-static const char * const TIMESTAMP_PATTERN = "^[0-9][0-9][0-9][0-9]-[0-9][0-9]?-[0-9][0-9]?(([Tt]|[ \t]+)[0-9][0-9]?:[0-9][0-9](:[0-9][0-9])?([.][0-9]+)?([ \t]*(Z|([-+][0-9][0-9]?(:[0-9][0-9])?)))?)?$";
+static inline MaybeDocument as_document(struct outcome result)
+{
+    if(LOADER_SUCCESS != result.code)
+    {
+        return (MaybeDocument){.tag=NOTHING, .nothing={result.code, result.message}};
+    }
+    return (MaybeDocument){.tag=JUST, .just=result.model};
+}
+
+static inline MaybeTape as_tape(struct outcome result)
+{
+    if(LOADER_SUCCESS != result.code)
+    {
+        return (MaybeTape){.tag=NOTHING, .nothing={result.code, result.message}};
+    }
+    return (MaybeTape){.tag=JUST, .just=result.tape};
+}
 
 static loader_status_code make_loader(loader_context *context, enum loader_duplicate_key_strategy value)
 {
@@ -72,33 +99,12 @@ static loader_status_code make_loader(loader_context *context, enum loader_dupli
         return interpret_yaml_error(&context->parser);
     }
 
-    context->anchors = make_hashtable_with_function(string_comparitor, shift_add_xor_string_hash);
+    context->anchors = make_hashtable_with_function(string_comparitor, wyhash_string_hash);
     if(NULL == context->anchors)
     {
         return ERR_LOADER_OUT_OF_MEMORY;
     }
 
-    if(!make_regex(&context->decimal_regex, DECIMAL_PATTERN))
-    {
-        hashtable_free(context->anchors);
-        return ERR_OTHER;
-    }
-
-    if(!make_regex(&context->integer_regex, INTEGER_PATTERN))
-    {
-        hashtable_free(context->anchors);
-        regfree(&context->decimal_regex);
-        return ERR_OTHER;
-    }
-
-    if(!make_regex(&context->timestamp_regex, TIMESTAMP_PATTERN))
-    {
-        hashtable_free(context->anchors);
-        regfree(&context->decimal_regex);
-        regfree(&context->integer_regex);
-        return ERR_OTHER;
-    }
-
     return LOADER_SUCCESS;
 }
 
@@ -110,31 +116,58 @@ static void loader_free(loader_context *context)
 
     hashtable_free(context->anchors);
     context->anchors = NULL;
-
-    regfree(&context->decimal_regex);
-    regfree(&context->integer_regex);
-    regfree(&context->timestamp_regex);
 }
 
-static inline MaybeDocument load(loader_context *context)
+/* hand the loaded model or tape the input it borrows from */
+static struct outcome finish(loader_context *context)
 {
-    loader_debug("starting load...");
-    build_model(context);
+    if(NULL != context->tape)
+    {
+        Tape *tape = finish_tape(context);
+        if(NULL == tape)
+        {
+            return nothing(context);
+        }
+        tape_set_input(tape, context->input.data, context->input.length);
+        return (struct outcome){.code=LOADER_SUCCESS, .tape=tape};
+    }
     if(LOADER_SUCCESS != context->code)
     {
         return nothing(context);
     }
-    else
+    model_set_input(context->model, context->input.data, context->input.length);
+    return (struct outcome){.code=LOADER_SUCCESS, .model=context->model};
+}
+
+static inline struct outcome load(loader_context *context, bool tape)
+{
+    loader_debug("starting load...");
+    if(tape && !start_tape(context))
     {
-        return just(context->model);
+        return nothing(context);
     }
+    build_model(context);
+    return finish(context);
 }
 
-MaybeDocument load_string(const unsigned char *input, size_t size, enum loader_duplicate_key_strategy value)
+static bool looks_like_json(const uint8_t *input, size_t size)
 {
-    PRECOND_NONNULL_ELSE_NOTHING(input, ERR_INPUT_IS_NULL);
-    PRECOND_NONZERO_ELSE_NOTHING(size, ERR_INPUT_SIZE_IS_ZERO);
+    const uint8_t *cursor = input;
+    const uint8_t *end = input + size;
+    if(3 <= size && 0 == memcmp("\xEF\xBB\xBF", input, 3))
+    {
+        cursor += 3;
+    }
+    while(cursor < end && (' ' == *cursor || '\t' == *cursor || '\n' == *cursor || '\r' == *cursor))
+    {
+        cursor++;
+    }
 
+    return cursor < end && ('{' == *cursor || '[' == *cursor);
+}
+
+static struct outcome load_yaml_string(const uint8_t *input, size_t size, bool borrow, enum loader_duplicate_key_strategy value, bool tape)
+{
     loader_debug("creating string loader context");
     loader_context context;
     memset(&context, 0, sizeof(loader_context));
@@ -145,23 +178,89 @@ MaybeDocument load_string(const unsigned char *input, size_t size, enum loader_d
         return nothing(&context);
     }
 
+    if(borrow)
+    {
+        context.input.data = (uint8_t *)input;
+        context.input.length = size;
+    }
     yaml_parser_set_input_string(&context.parser, input, size);
-    MaybeDocument result = load(&context);
+    struct outcome result = load(&context, tape);
     loader_free(&context);
     return result;
 }
 
-MaybeDocument load_file(FILE *input, enum loader_duplicate_key_strategy value)
+/*
+ * JSON is read natively.  Flow style YAML also starts with an object or
+ * array, so when the format was sniffed a syntax error retries as YAML.
+ */
+static struct outcome load_buffer(const uint8_t *input, size_t size, bool borrow, enum loader_duplicate_key_strategy value, enum loader_input_format format, bool tape)
+{
+    if(INPUT_YAML == format || (INPUT_AUTO == format && !looks_like_json(input, size)))
+    {
+        return load_yaml_string(input, size, borrow, value, tape);
+    }
+
+    loader_debug("creating json loader context");
+    loader_context context;
+    memset(&context, 0, sizeof(loader_context));
+    context.strategy = value;
+    if(borrow)
+    {
+        context.input.data = (uint8_t *)input;
+        context.input.length = size;
+    }
+
+    if(tape && !start_tape(&context))
+    {
+        return nothing(&context);
+    }
+
+    build_json_model(&context, input, size);
+    if(INPUT_AUTO == format && (ERR_SCANNER_FAILED == context.code || ERR_PARSER_FAILED == context.code))
+    {
+        loader_debug("input is not json, falling back to yaml");
+        finish_tape(&context);
+        return load_yaml_string(input, size, borrow, value, tape);
+    }
+
+    return finish(&context);
+}
+
+static struct outcome read_string(const unsigned char *input, size_t size, enum loader_duplicate_key_strategy value, enum loader_input_format format, bool tape)
 {
     PRECOND_NONNULL_ELSE_NOTHING(input, ERR_INPUT_IS_NULL);
+    PRECOND_NONZERO_ELSE_NOTHING(size, ERR_INPUT_SIZE_IS_ZERO);
 
-    struct stat file_info;
-    int syscall_result = fstat(fileno(input), &file_info);
-    PRECOND_ELSE_NOTHING(-1 != syscall_result, ERR_READER_FAILED);
+    return load_buffer(input, size, false, value, format, tape);
+}
 
-    bool is_readable = !(file_info.st_mode & S_IFREG && (feof(input) || 0 == file_info.st_size));
-    PRECOND_ELSE_NOTHING(is_readable, ERR_INPUT_SIZE_IS_ZERO);
+struct prefixed_input
+{
+    FILE          *file;
+    const uint8_t *prefix;
+    size_t         length;
+    size_t         offset;
+};
+
+static int read_prefixed_input(void *data, unsigned char *buffer, size_t size, size_t *size_read)
+{
+    struct prefixed_input *input = (struct prefixed_input *)data;
+    if(input->offset < input->length)
+    {
+        size_t count = input->length - input->offset;
+        count = count < size ? count : size;
+        memcpy(buffer, input->prefix + input->offset, count);
+        input->offset += count;
+        *size_read = count;
+        return 1;
+    }
 
+    *size_read = fread(buffer, 1, size, input->file);
+    return !ferror(input->file);
+}
+
+static struct outcome load_yaml_file(struct prefixed_input *input, enum loader_duplicate_key_strategy value, bool tape)
+{
     loader_debug("creating file loader context");
     loader_context context;
     memset(&context, 0, sizeof(loader_context));
@@ -172,8 +271,161 @@ MaybeDocument load_file(FILE *input, enum loader_duplicate_key_strategy value)
         return nothing(&context);
     }
 
-    yaml_parser_set_input_file(&context.parser, input);
-    MaybeDocument result = load(&context);
+    yaml_parser_set_input(&context.parser, read_prefixed_input, input);
+    struct outcome result = load(&context, tape);
     loader_free(&context);
     return result;
 }
+
+static uint8_t *read_remaining_input(FILE *input, const uint8_t *prefix, size_t length, size_t *size)
+{
+    size_t capacity = length < BUFSIZ ? BUFSIZ : length * 2;
+    uint8_t *result = malloc(capacity);
+    if(NULL == result)
+    {
+        return NULL;
+    }
+    memcpy(result, prefix, length);
+
+    while(!feof(input))
+    {
+        if(length == capacity)
+        {
+            capacity *= 2;
+            uint8_t *larger = realloc(result, capacity);
+            if(NULL == larger)
+            {
+                free(result);
+                return NULL;
+            }
+            result = larger;
+        }
+        length += fread(result + length, 1, capacity - length, input);
+        if(ferror(input))
+        {
+            free(result);
+            return NULL;
+        }
+    }
+
+    *size = length;
+    return result;
+}
+
+static struct outcome read_file(FILE *input, enum loader_duplicate_key_strategy value, enum loader_input_format format, bool tape)
+{
+    PRECOND_NONNULL_ELSE_NOTHING(input, ERR_INPUT_IS_NULL);
+
+    struct stat file_info;
+    int syscall_result = fstat(fileno(input), &file_info);
+    PRECOND_ELSE_NOTHING(-1 != syscall_result, ERR_READER_FAILED);
+
+    bool is_readable = !(file_info.st_mode & S_IFREG && (feof(input) || 0 == file_info.st_size));
+    PRECOND_ELSE_NOTHING(is_readable, ERR_INPUT_SIZE_IS_ZERO);
+
+    uint8_t prefix[BUFSIZ];
+    struct prefixed_input prefixed = {.file=input, .prefix=prefix, .length=0, .offset=0};
+    if(INPUT_YAML != format)
+    {
+        prefixed.length = fread(prefix, 1, sizeof(prefix), input);
+        PRECOND_ELSE_NOTHING(!ferror(input), ERR_READER_FAILED);
+    }
+
+    if(INPUT_YAML == format || (INPUT_AUTO == format && !looks_like_json(prefix, prefixed.length)))
+    {
+        return load_yaml_file(&prefixed, value, tape);
+    }
+
+    size_t size = 0;
+    uint8_t *data = read_remaining_input(input, prefix, prefixed.length, &size);
+    PRECOND_NONNULL_ELSE_NOTHING(data, ERR_READER_FAILED);
+
+    struct outcome result = load_buffer(data, size, false, value, format, tape);
+    free(data);
+    return result;
+}
+
+static struct outcome read_mapped(const char *path, enum loader_duplicate_key_strategy value, enum loader_input_format format, bool tape)
+{
+    PRECOND_NONNULL_ELSE_NOTHING(path, ERR_INPUT_IS_NULL);
+
+    int descriptor = open(path, O_RDONLY);
+    if(-1 == descriptor)
+    {
+        return _nothing(ERR_READER_FAILED, strdup(strerror(errno)));
+    }
+
+    struct stat file_info;
+    if(-1 == fstat(descriptor, &file_info))
+    {
+        struct outcome result = _nothing(ERR_READER_FAILED, strdup(strerror(errno)));
+        close(descriptor);
+        return result;
+    }
+
+    if(!S_ISREG(file_info.st_mode))
+    {
+        loader_debug("input is not a regular file, falling back to stream loader");
+        FILE *input = fdopen(descriptor, "r");
+        if(NULL == input)
+        {
+            struct outcome result = _nothing(ERR_READER_FAILED, strdup(strerror(errno)));
+            close(descriptor);
+            return result;
+        }
+        struct outcome result = read_file(input, value, format, tape);
+        fclose(input);
+        return result;
+    }
+
+    if(0 == file_info.st_size)
+    {
+        close(descriptor);
+        return _nothing(ERR_INPUT_SIZE_IS_ZERO, loader_simple_status_message(ERR_INPUT_SIZE_IS_ZERO));
+    }
+
+    size_t size = (size_t)file_info.st_size;
+    void *data = mmap(NULL, size, PROT_READ, MAP_PRIVATE, descriptor, 0);
+    close(descriptor);
+    if(MAP_FAILED == data)
+    {
+        return _nothing(ERR_READER_FAILED, strdup(strerror(errno)));
+    }
+
+    struct outcome result = load_buffer(data, size, true, value, format, tape);
+    if(LOADER_SUCCESS != result.code)
+    {
+        munmap(data, size);
+    }
+    return result;
+}
+
+MaybeDocument load_string(const unsigned char *input, size_t size, enum loader_duplicate_key_strategy value, enum loader_input_format format)
+{
+    return as_document(read_string(input, size, value, format, false));
+}
+
+MaybeDocument load_file(FILE *input, enum loader_duplicate_key_strategy value, enum loader_input_format format)
+{
+    return as_document(read_file(input, value, format, false));
+}
+
+MaybeDocument load_mapped(const char *path, enum loader_duplicate_key_strategy value, enum loader_input_format format)
+{
+    return as_document(read_mapped(path, value, format, false));
+}
+
+MaybeTape load_tape_string(const unsigned char *input, size_t size, enum loader_duplicate_key_strategy value, enum loader_input_format format)
+{
+    return as_tape(read_string(input, size, value, format, true));
+}
+
+MaybeTape load_tape_file(FILE *input, enum loader_duplicate_key_strategy value, enum loader_input_format format)
+{
+    return as_tape(read_file(input, value, format, true));
+}
+
+MaybeTape load_tape_mapped(const char *path, enum loader_duplicate_key_strategy value, enum loader_input_format format)
+{
+    return as_tape(read_mapped(path, value, format, true));
+}
@@ -37,7 +37,6 @@
 
 #include <stdlib.h>
 #include <stdbool.h>
-#include <regex.h>
 
 #include "loader.h"
 #include "loader/private.h"
@@ -49,13 +48,18 @@ static const char * const DUPLICATE_STRATEGIES [] =
     "fail"
 };
 
+static const char * const INPUT_FORMATS [] =
+{
+    "auto",
+    "yaml",
+    "json"
+};
+
 static void event_loop(loader_context *context);
 static bool dispatch_event(yaml_event_t *event, loader_context *context);
 
 static bool add_scalar(loader_context *context, const yaml_event_t *event);
-static ScalarKind resolve_scalar_kind(const loader_context *context, const yaml_event_t *event);
 static ScalarKind tag_to_scalar_kind(const yaml_event_t *event);
-static inline bool regex_test(const yaml_event_t *event, const regex_t *regex);
 
 static bool cache_mapping_key(loader_context *context, const yaml_event_t *event);
 static Scalar *build_scalar_node(loader_context *context, const yaml_event_t *event);
@@ -69,13 +73,17 @@ static bool end_sequence(loader_context *context);
 static bool start_mapping(loader_context *context, const yaml_event_t *event);
 static bool end_mapping(loader_context *context);
 
-static void set_anchor(loader_context *context, Node *target, uint8_t *anchor);
+static void set_anchor(loader_context *context, Node *target, const uint8_t *anchor);
 
-static bool add_node(loader_context *context, Node *value);
 static inline bool add_to_mapping_node(loader_context *context, Node *value);
 
 void build_model(struct loader_context *context)
 {
+    if(NULL != context->tape)
+    {
+        build_tape(context);
+        return;
+    }
     loader_debug("building model...");
     DocumentModel *model = make_model();
     if(NULL == model)
@@ -120,7 +128,19 @@ static void event_loop(loader_context *context)
             break;
         }
         done = dispatch_event(&event, context);
+        if(YAML_SCALAR_EVENT == event.type && context->key_holder.value == event.data.scalar.value)
+        {
+            // the key holder points into this event, keep it until the value arrives
+            context->key_event = event;
+        }
+        else
+        {
+            yaml_event_delete(&event);
+        }
     }
+    yaml_event_delete(&context->key_event);
+    context->key_holder.value = NULL;
+    context->key_holder.length = 0ul;
     loader_trace("finished loading");
 }
 
@@ -224,8 +244,17 @@ static bool cache_mapping_key(loader_context *context, const yaml_event_t *event
 
 static Scalar *build_scalar_node(loader_context *context, const yaml_event_t *event)
 {
-    ScalarKind kind = resolve_scalar_kind(context, event);
-    Scalar *result = make_scalar_node(event->data.scalar.value, event->data.scalar.length, kind);
+    ScalarKind kind = resolve_scalar_kind(event);
+    Scalar *result = NULL;
+    uint8_t *borrowed = borrow_scalar_value(context, event);
+    if(NULL != borrowed)
+    {
+        result = make_borrowed_scalar_node_in(model_arena(context->model), borrowed, event->data.scalar.length, kind);
+    }
+    else
+    {
+        result = make_scalar_node_in(model_arena(context->model), event->data.scalar.value, event->data.scalar.length, kind);
+    }
     if(NULL == result)
     {
         loader_error("uh oh! couldn't create scalar node, aborting...");
@@ -241,49 +270,65 @@ static Scalar *build_scalar_node(loader_context *context, const yaml_event_t *ev
     return result;
 }
 
-static ScalarKind resolve_scalar_kind(const loader_context *context, const yaml_event_t *event)
+/*
+ * When the input is memory mapped, find the scalar's bytes in the mapping.
+ * Plain and quoted scalars without escapes or line folding appear verbatim
+ * in the source, everything else must be copied from the event.  The marks
+ * count characters rather than bytes, so the candidate is always verified.
+ */
+uint8_t *borrow_scalar_value(const loader_context *context, const yaml_event_t *event)
 {
-    ScalarKind kind = SCALAR_STRING;
-
-    if(NULL != event->data.scalar.tag)
+    if(NULL == context->input.data || 0 == event->data.scalar.length)
     {
-        kind = tag_to_scalar_kind(event);
-    }
-    else if(YAML_SINGLE_QUOTED_SCALAR_STYLE == event->data.scalar.style ||
-            YAML_DOUBLE_QUOTED_SCALAR_STYLE == event->data.scalar.style)
-    {
-        trace_string("found scalar string '%s', len: %zd", event->data.scalar.value, event->data.scalar.length, event->data.scalar.length);
-        kind = SCALAR_STRING;
+        return NULL;
     }
-    else if(0 == memcmp("null", event->data.scalar.value, 4))
+
+    size_t start = event->start_mark.index;
+    size_t end = event->end_mark.index;
+    switch(event->data.scalar.style)
     {
-        loader_trace("found scalar null");
-        kind = SCALAR_NULL;
+        case YAML_PLAIN_SCALAR_STYLE:
+            break;
+        case YAML_SINGLE_QUOTED_SCALAR_STYLE:
+        case YAML_DOUBLE_QUOTED_SCALAR_STYLE:
+            start++;
+            end--;
+            break;
+        default:
+            return NULL;
     }
-    else if(0 == memcmp("true", event->data.scalar.value, 4) ||
-            0 == memcmp("false", event->data.scalar.value, 5))
+
+    if(end > context->input.length || end < start || end - start != event->data.scalar.length)
     {
-        trace_string("found scalar boolean '%s'", event->data.scalar.value, event->data.scalar.length);
-        kind = SCALAR_BOOLEAN;
+        return NULL;
     }
-    else if(regex_test(event, &context->integer_regex))
+    uint8_t *candidate = context->input.data + start;
+    if(0 != memcmp(candidate, event->data.scalar.value, event->data.scalar.length))
     {
-        trace_string("found scalar integer '%s'", event->data.scalar.value, event->data.scalar.length);
-        kind = SCALAR_INTEGER;
+        return NULL;
     }
-    else if(regex_test(event, &context->decimal_regex))
+
+    return candidate;
+}
+
+ScalarKind resolve_scalar_kind(const yaml_event_t *event)
+{
+    ScalarKind kind = SCALAR_STRING;
+
+    if(NULL != event->data.scalar.tag)
     {
-        trace_string("found scalar real '%s'", event->data.scalar.value, event->data.scalar.length);
-        kind = SCALAR_REAL;
+        kind = tag_to_scalar_kind(event);
     }
-    else if(regex_test(event, &context->timestamp_regex))
+    else if(YAML_SINGLE_QUOTED_SCALAR_STYLE == event->data.scalar.style ||
+            YAML_DOUBLE_QUOTED_SCALAR_STYLE == event->data.scalar.style)
     {
-        trace_string("found scalar timestamp '%s'", event->data.scalar.value, event->data.scalar.length);
-        kind = SCALAR_TIMESTAMP;
+        trace_string("found scalar string '%s', len: %zd", event->data.scalar.value, event->data.scalar.length, event->data.scalar.length);
+        kind = SCALAR_STRING;
     }
     else
     {
-        trace_string("defaulting to scalar string '%s'", event->data.scalar.value, event->data.scalar.length, event->data.scalar.length);
+        trace_string("deferring kind of plain scalar '%s'", event->data.scalar.value, event->data.scalar.length);
+        kind = SCALAR_UNRESOLVED;
     }
 
     return kind;
@@ -326,15 +371,6 @@ static ScalarKind tag_to_scalar_kind(const yaml_event_t *event)
     return SCALAR_STRING;
 }
 
-static inline bool regex_test(const yaml_event_t *event, const regex_t *regex)
-{
-    char string[event->data.scalar.length + 1];
-    memcpy(string, event->data.scalar.value, event->data.scalar.length);
-    string[event->data.scalar.length] = '\0';
-
-    return 0 == regexec(regex, string, 0, NULL, 0);
-}
-
 static bool add_alias(loader_context *context, const yaml_event_t *event)
 {
     Node *target = hashtable_get(context->anchors, event->data.alias.anchor);
@@ -356,13 +392,13 @@ static bool add_alias(loader_context *context, const yaml_event_t *event)
     }
 
     loader_trace("added '%s' alias target (%p)", event->data.alias.anchor, target);
-    Alias *value = make_alias_node(target);
+    Alias *value = make_alias_node_in(model_arena(context->model), target);
     return add_node(context, node(value));
 }
 
 static bool start_document(loader_context *context)
 {
-    Document *value = make_document_node();
+    Document *value = make_document_node_in(model_arena(context->model));
     if(NULL == value)
     {
         loader_error("uh oh! couldn't create new document node, aborting...");
@@ -393,7 +429,7 @@ static bool start_sequence(loader_context *context, const yaml_event_t *event)
         context->code = ERR_NON_SCALAR_KEY;
         return true;
     }
-    Sequence *seq = make_sequence_node();
+    Sequence *seq = make_sequence_node_in(model_arena(context->model));
     if(NULL == seq)
     {
         loader_error("uh oh! couldn't create a sequence node, aborting...");
@@ -433,7 +469,7 @@ static bool start_mapping(loader_context *context, const yaml_event_t *event)
         context->code = ERR_NON_SCALAR_KEY;
         return true;
     }
-    Mapping *map = make_mapping_node();
+    Mapping *map = make_mapping_node_in(model_arena(context->model));
     if(NULL == map)
     {
         loader_error("uh oh! couldn't create a mapping node, aborting...");
@@ -464,18 +500,24 @@ static bool end_mapping(loader_context *context)
     return false;
 }
 
-static void set_anchor(loader_context *context, Node *target, uint8_t *anchor)
+static void set_anchor(loader_context *context, Node *target, const uint8_t *anchor)
 {
     if(NULL == anchor)
     {
         return;
     }
     node_set_anchor(target, anchor, strlen((char *)anchor));
+    uint8_t *copy = node_anchor(target);
+    if(NULL == copy)
+    {
+        return;
+    }
 
-    hashtable_put(context->anchors, anchor, target);
+    // the event is released after dispatch, so key the table on the node's copy
+    hashtable_put(context->anchors, copy, target);
 }
 
-static bool add_node(loader_context *context, Node *value)
+bool add_node(loader_context *context, Node *value)
 {
     switch(node_kind(context->target))
     {
@@ -503,9 +545,15 @@ static bool add_node(loader_context *context, Node *value)
 
 static inline bool add_to_mapping_node(loader_context *context, Node *value)
 {
-    bool duplicate = mapping_contains(mapping(context->target),
-                                      context->key_holder.value,
-                                      context->key_holder.length);
+    // N.B. - keys repeat across the mappings of a document, each distinct one is stored once
+    Scalar *key = model_intern(context->model, context->key_holder.value, context->key_holder.length);
+    if(NULL == key)
+    {
+        loader_error("uh oh! couldn't intern a mapping key, aborting...");
+        context->code = ERR_LOADER_OUT_OF_MEMORY;
+        return true;
+    }
+    bool duplicate = NULL != mapping_get_key(mapping(context->target), key);
     if(duplicate && DUPE_FAIL == context->strategy)
     {
         loader_debug("uh oh! a scalar node has become the context node, aborting...");
@@ -519,13 +567,12 @@ static inline bool add_to_mapping_node(loader_context *context, Node *value)
         key_name[context->key_holder.length] = '\0';
         fprintf(stderr, "warning: duplicate mapping key found: '%s'\n", key_name);
     }
-    bool done = !mapping_put(mapping(context->target),
-                             context->key_holder.value,
-                             context->key_holder.length, value);
+    bool done = !mapping_put_key(mapping(context->target), key, value);
     if(!done)
     {
         context->key_holder.value = NULL;
         context->key_holder.length = 0ul;
+        yaml_event_delete(&context->key_event);
     }
     return done;
 }
@@ -554,3 +601,28 @@ const char * duplicate_strategy_name(enum loader_duplicate_key_strategy value)
 {
     return DUPLICATE_STRATEGIES[value];
 }
+
+int32_t parse_input_format(const char *argument)
+{
+    if(0 == strncmp("auto", argument, 4ul))
+    {
+        return INPUT_AUTO;
+    }
+    else if(0 == strncmp("yaml", argument, 4ul))
+    {
+        return INPUT_YAML;
+    }
+    else if(0 == strncmp("json", argument, 4ul))
+    {
+        return INPUT_JSON;
+    }
+    else
+    {
+        return -1;
+    }
+}
+
+const char * input_format_name(enum loader_input_format value)
+{
+    return INPUT_FORMATS[value];
+}
@@ -0,0 +1,978 @@
+/*
+ * 金棒 (kanabō)
+ * Copyright (c) 2012 Kevin Birch <kmb@pobox.com>.  All rights reserved.
+ *
+ * 金棒 is a tool to bludgeon YAML and JSON files from the shell: the strong
+ * made stronger.
+ *
+ * For more information, consult the README file in the project root.
+ *
+ * Distributed under an [MIT-style][license] license.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal with
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * - Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimers.
+ * - Redistributions in binary form must reproduce the above copyright notice, this
+ *   list of conditions and the following disclaimers in the documentation and/or
+ *   other materials provided with the distribution.
+ * - Neither the names of the copyright holders, nor the names of the authors, nor
+ *   the names of other contributors may be used to endorse or promote products
+ *   derived from this Software without specific prior written permission.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE CONTRIBUTORS
+ * OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS WITH THE SOFTWARE.
+ *
+ * [license]: http://www.opensource.org/licenses/ncsa
+ */
+
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "loader.h"
+#include "loader/private.h"
+
+/*
+ * A native JSON reader that builds the document model directly from the
+ * input buffer, without going through libyaml's event machinery.  The
+ * container nesting is tracked with the model's own parent links, so the
+ * reader is iterative and deep documents don't exhaust the stack.
+ *
+ * When a structural index is available (see structural.c) the reader moves
+ * from token to token through it, otherwise it skips whitespace itself.
+ *
+ * When the context is building a tape instead (see tape.c), the nesting is
+ * tracked by the tape's builder and each node is appended as it is read.
+ */
+
+enum json_state
+{
+    EXPECT_VALUE,
+    EXPECT_VALUE_OR_END,
+    EXPECT_KEY,
+    EXPECT_KEY_OR_END,
+    EXPECT_SEPARATOR
+};
+
+struct string_buffer
+{
+    uint8_t *value;
+    size_t   length;
+    size_t   capacity;
+};
+
+struct json_reader
+{
+    loader_context       *context;
+    const uint8_t        *start;
+    const uint8_t        *cursor;
+    const uint8_t        *end;
+    struct string_buffer  key;
+    struct string_buffer  scratch;
+    const uint32_t       *tokens;
+    size_t                token_count;
+    size_t                next_token;
+};
+
+typedef struct json_reader json_reader;
+
+static bool read_document(json_reader *reader);
+static bool read_scalar(json_reader *reader);
+static bool read_key(json_reader *reader);
+static bool read_string(json_reader *reader, struct string_buffer *buffer, uint8_t **value, size_t *length, bool *borrowable);
+static bool read_number(json_reader *reader);
+static bool read_literal(json_reader *reader, const char *literal, size_t length, ScalarKind kind);
+static bool start_container(json_reader *reader, NodeKind kind);
+static void end_container(json_reader *reader);
+static bool add_scalar_value(json_reader *reader, const uint8_t *value, size_t length, ScalarKind kind, bool borrowable);
+
+static bool scanner_error(json_reader *reader, const char *problem);
+static bool parser_error(json_reader *reader, const char *problem);
+static bool reader_error(json_reader *reader, const char *problem);
+static void set_marks(json_reader *reader);
+
+static inline void skip_whitespace(json_reader *reader)
+{
+    while(reader->cursor < reader->end)
+    {
+        switch(*reader->cursor)
+        {
+            case ' ':
+            case '\t':
+            case '\n':
+            case '\r':
+                reader->cursor++;
+                break;
+            default:
+                return;
+        }
+    }
+}
+
+static inline void next_token(json_reader *reader)
+{
+    if(NULL == reader->tokens)
+    {
+        skip_whitespace(reader);
+        return;
+    }
+
+    size_t offset = (size_t)(reader->cursor - reader->start);
+    while(reader->next_token < reader->token_count && reader->tokens[reader->next_token] < offset)
+    {
+        reader->next_token++;
+    }
+    if(reader->next_token < reader->token_count)
+    {
+        reader->cursor = reader->start + reader->tokens[reader->next_token];
+    }
+    else
+    {
+        reader->cursor = reader->end;
+    }
+}
+
+static inline bool is_delimiter(uint8_t c)
+{
+    switch(c)
+    {
+        case ' ':
+        case '\t':
+        case '\n':
+        case '\r':
+        case ',':
+        case ':':
+        case ']':
+        case '}':
+            return true;
+        default:
+            return false;
+    }
+}
+
+static inline bool is_digit(uint8_t c)
+{
+    return '0' <= c && '9' >= c;
+}
+
+static inline NodeKind target_kind(const loader_context *context)
+{
+    return NULL == context->tape ? node_kind(context->target) : tape_target_kind(context);
+}
+
+void build_json_model(loader_context *context, const uint8_t *input, size_t length)
+{
+    loader_debug("building %s from json...", NULL == context->tape ? "model" : "tape");
+    context->code = LOADER_SUCCESS;
+    if(NULL == context->tape)
+    {
+        DocumentModel *model = make_model();
+        if(NULL == model)
+        {
+            loader_error("uh oh! out of memory, can't allocate the document model, aborting...");
+            context->code = ERR_LOADER_OUT_OF_MEMORY;
+            return;
+        }
+        context->model = model;
+    }
+
+    json_reader reader;
+    memset(&reader, 0, sizeof(json_reader));
+    reader.context = context;
+    reader.start = input;
+    reader.cursor = input;
+    reader.end = input + length;
+
+    if(3 <= length && 0 == memcmp("\xEF\xBB\xBF", input, 3))
+    {
+        reader.cursor += 3;
+    }
+
+    struct structural_index index;
+    enum structural_kernel kernel = best_structural_kernel();
+    if(build_structural_index(&index, input, length, kernel))
+    {
+        loader_debug("indexed %zd tokens using the %s kernel", index.length, structural_kernel_name(kernel));
+        reader.tokens = index.positions;
+        reader.token_count = index.length;
+    }
+
+    next_token(&reader);
+    if(reader.cursor == reader.end)
+    {
+        loader_error("no documents found for the input!");
+        context->code = ERR_NO_DOCUMENTS_FOUND;
+    }
+    else if(read_document(&reader))
+    {
+        next_token(&reader);
+        if(reader.cursor != reader.end)
+        {
+            parser_error(&reader, "did not find expected end of input");
+        }
+    }
+
+    free(reader.key.value);
+    free(reader.scratch.value);
+    structural_index_free(&index);
+    context->key_holder.value = NULL;
+    context->key_holder.length = 0ul;
+
+    if(NULL != context->tape)
+    {
+        return;
+    }
+    if(LOADER_SUCCESS == context->code)
+    {
+        loader_debug("done. found %zd documents.", model_size(context->model));
+    }
+    else
+    {
+        model_free(context->model);
+        context->model = NULL;
+    }
+}
+
+static bool start_document(loader_context *context)
+{
+    if(NULL != context->tape)
+    {
+        return tape_start_document(context);
+    }
+    Document *document = make_document_node_in(model_arena(context->model));
+    if(NULL == document || !model_add(context->model, document))
+    {
+        loader_error("uh oh! couldn't create new document node, aborting...");
+        node_free(document);
+        context->code = ERR_LOADER_OUT_OF_MEMORY;
+        return false;
+    }
+    loader_trace("started document (%p)", document);
+    context->target = node(document);
+    return true;
+}
+
+static bool read_document(json_reader *reader)
+{
+    loader_context *context = reader->context;
+    if(!start_document(context))
+    {
+        return false;
+    }
+
+    enum json_state state = EXPECT_VALUE;
+    while(true)
+    {
+        if(EXPECT_SEPARATOR == state && DOCUMENT == target_kind(context))
+        {
+            if(NULL != context->tape)
+            {
+                return tape_end_document(context);
+            }
+            loader_trace("completed document (%p)", context->target);
+            context->target = NULL;
+            return true;
+        }
+        next_token(reader);
+        if(reader->cursor == reader->end)
+        {
+            return parser_error(reader, "found unexpected end of input");
+        }
+
+        uint8_t current = *reader->cursor;
+        switch(state)
+        {
+            case EXPECT_VALUE_OR_END:
+                if(']' == current)
+                {
+                    reader->cursor++;
+                    end_container(reader);
+                    state = EXPECT_SEPARATOR;
+                    break;
+                }
+                // fall through
+            case EXPECT_VALUE:
+                if('{' == current)
+                {
+                    reader->cursor++;
+                    if(!start_container(reader, MAPPING))
+                    {
+                        return false;
+                    }
+                    state = EXPECT_KEY_OR_END;
+                }
+                else if('[' == current)
+                {
+                    reader->cursor++;
+                    if(!start_container(reader, SEQUENCE))
+                    {
+                        return false;
+                    }
+                    state = EXPECT_VALUE_OR_END;
+                }
+                else
+                {
+                    if(!read_scalar(reader))
+                    {
+                        return false;
+                    }
+                    state = EXPECT_SEPARATOR;
+                }
+                break;
+
+            case EXPECT_KEY_OR_END:
+                if('}' == current)
+                {
+                    reader->cursor++;
+                    end_container(reader);
+                    state = EXPECT_SEPARATOR;
+                    break;
+                }
+                // fall through
+            case EXPECT_KEY:
+                if(!read_key(reader))
+                {
+                    return false;
+                }
+                state = EXPECT_VALUE;
+                break;
+
+            case EXPECT_SEPARATOR:
+                if(',' == current)
+                {
+                    reader->cursor++;
+                    state = MAPPING == target_kind(context) ? EXPECT_KEY : EXPECT_VALUE;
+                }
+                else if('}' == current && MAPPING == target_kind(context))
+                {
+                    reader->cursor++;
+                    end_container(reader);
+                }
+                else if(']' == current && SEQUENCE == target_kind(context))
+                {
+                    reader->cursor++;
+                    end_container(reader);
+                }
+                else
+                {
+                    return parser_error(reader, MAPPING == target_kind(context)
+                                        ? "did not find expected ',' or '}'"
+                                        : "did not find expected ',' or ']'");
+                }
+                break;
+        }
+    }
+}
+
+static bool start_container(json_reader *reader, NodeKind kind)
+{
+    loader_context *context = reader->context;
+    if(NULL != context->tape)
+    {
+        size_t index;
+        if(!tape_start_container(context, kind, NULL, &index))
+        {
+            set_marks(reader);
+            return false;
+        }
+        return true;
+    }
+    Arena *arena = model_arena(context->model);
+    Node *container = MAPPING == kind ? node(make_mapping_node_in(arena)) : node(make_sequence_node_in(arena));
+    if(NULL == container)
+    {
+        loader_error("uh oh! couldn't create a container node, aborting...");
+        context->code = ERR_LOADER_OUT_OF_MEMORY;
+        return false;
+    }
+    loader_trace("started container (%p)", container);
+
+    if(add_node(context, container))
+    {
+        node_free(container);
+        set_marks(reader);
+        return false;
+    }
+    context->target = container;
+    return true;
+}
+
+static void end_container(json_reader *reader)
+{
+    if(NULL != reader->context->tape)
+    {
+        tape_end_container(reader->context);
+        return;
+    }
+    Node *container = reader->context->target;
+    loader_trace("completed container (%p)", container);
+    if(is_sequence(container))
+    {
+        vector_trim(sequence(container)->values);
+    }
+    reader->context->target = node_parent(container);
+}
+
+static bool read_key(json_reader *reader)
+{
+    loader_context *context = reader->context;
+    uint8_t current = *reader->cursor;
+    if('{' == current || '[' == current)
+    {
+        loader_debug("uh oh! found a non scalar mapping key, aborting...");
+        context->code = ERR_NON_SCALAR_KEY;
+        set_marks(reader);
+        return false;
+    }
+    if('"' != current)
+    {
+        return parser_error(reader, "did not find expected key");
+    }
+
+    bool borrowable;
+    if(!read_string(reader, &reader->key, &context->key_holder.value, &context->key_holder.length, &borrowable))
+    {
+        return false;
+    }
+    if(NULL != context->tape)
+    {
+        // N.B. - a tape's builder knows a key when it sees one, so it is added straight away
+        size_t index;
+        if(!tape_add_scalar(context, context->key_holder.value, context->key_holder.length, SCALAR_STRING, borrowable, NULL, &index))
+        {
+            set_marks(reader);
+            return false;
+        }
+    }
+    else
+    {
+        trace_string("caching scalar '%s' as mapping key", context->key_holder.value, context->key_holder.length);
+    }
+
+    next_token(reader);
+    if(reader->cursor == reader->end || ':' != *reader->cursor)
+    {
+        return parser_error(reader, "did not find expected ':'");
+    }
+    reader->cursor++;
+
+    return true;
+}
+
+static bool read_scalar(json_reader *reader)
+{
+    switch(*reader->cursor)
+    {
+        case '"':
+        {
+            uint8_t *value;
+            size_t length;
+            bool borrowable;
+            if(!read_string(reader, &reader->scratch, &value, &length, &borrowable))
+            {
+                return false;
+            }
+            return add_scalar_value(reader, value, length, SCALAR_STRING, borrowable);
+        }
+        case 't':
+            return read_literal(reader, "true", 4, SCALAR_BOOLEAN);
+        case 'f':
+            return read_literal(reader, "false", 5, SCALAR_BOOLEAN);
+        case 'n':
+            return read_literal(reader, "null", 4, SCALAR_NULL);
+        case '-':
+        case '0':
+        case '1':
+        case '2':
+        case '3':
+        case '4':
+        case '5':
+        case '6':
+        case '7':
+        case '8':
+        case '9':
+            return read_number(reader);
+        case '}':
+        case ']':
+        case ',':
+        case ':':
+            return parser_error(reader, "did not find expected node content");
+        default:
+            return scanner_error(reader, "found character that cannot start any token");
+    }
+}
+
+static bool read_literal(json_reader *reader, const char *literal, size_t length, ScalarKind kind)
+{
+    const uint8_t *start = reader->cursor;
+    if((size_t)(reader->end - start) < length || 0 != memcmp(literal, start, length))
+    {
+        return scanner_error(reader, "found character that cannot start any token");
+    }
+    reader->cursor += length;
+    if(reader->cursor < reader->end && !is_delimiter(*reader->cursor))
+    {
+        return scanner_error(reader, "found unexpected character following a scalar");
+    }
+
+    return add_scalar_value(reader, start, length, kind, true);
+}
+
+static bool read_number(json_reader *reader)
+{
+    const uint8_t *start = reader->cursor;
+    const uint8_t *end = reader->end;
+    const uint8_t *cursor = start;
+    ScalarKind kind = SCALAR_INTEGER;
+
+    if('-' == *cursor)
+    {
+        cursor++;
+    }
+    if(cursor == end || !is_digit(*cursor))
+    {
+        reader->cursor = cursor;
+        return scanner_error(reader, "found invalid number, expected a digit");
+    }
+    if('0' == *cursor)
+    {
+        cursor++;
+    }
+    else
+    {
+        while(cursor < end && is_digit(*cursor))
+        {
+            cursor++;
+        }
+    }
+    if(cursor < end && '.' == *cursor)
+    {
+        kind = SCALAR_REAL;
+        cursor++;
+        if(cursor == end || !is_digit(*cursor))
+        {
+            reader->cursor = cursor;
+            return scanner_error(reader, "found invalid number, expected a fraction digit");
+        }
+        while(cursor < end && is_digit(*cursor))
+        {
+            cursor++;
+        }
+    }
+    if(cursor < end && ('e' == *cursor || 'E' == *cursor))
+    {
+        kind = SCALAR_REAL;
+        cursor++;
+        if(cursor < end && ('+' == *cursor || '-' == *cursor))
+        {
+            cursor++;
+        }
+        if(cursor == end || !is_digit(*cursor))
+        {
+            reader->cursor = cursor;
+            return scanner_error(reader, "found invalid number, expected an exponent digit");
+        }
+        while(cursor < end && is_digit(*cursor))
+        {
+            cursor++;
+        }
+    }
+    reader->cursor = cursor;
+    if(cursor < end && !is_delimiter(*cursor))
+    {
+        return scanner_error(reader, "found unexpected character following a scalar");
+    }
+
+    return add_scalar_value(reader, start, (size_t)(cursor - start), kind, true);
+}
+
+static bool ensure_capacity(struct string_buffer *buffer, size_t capacity)
+{
+    if(capacity <= buffer->capacity)
+    {
+        return true;
+    }
+    size_t size = 0 == buffer->capacity ? 64 : buffer->capacity;
+    while(size < capacity)
+    {
+        size *= 2;
+    }
+    uint8_t *value = realloc(buffer->value, size);
+    if(NULL == value)
+    {
+        return false;
+    }
+    buffer->value = value;
+    buffer->capacity = size;
+    return true;
+}
+
+static inline int hex_value(uint8_t c)
+{
+    if(is_digit(c))
+    {
+        return c - '0';
+    }
+    if('a' <= c && 'f' >= c)
+    {
+        return c - 'a' + 10;
+    }
+    if('A' <= c && 'F' >= c)
+    {
+        return c - 'A' + 10;
+    }
+    return -1;
+}
+
+static bool read_code_unit(json_reader *reader, uint32_t *unit)
+{
+    if(4 > reader->end - reader->cursor)
+    {
+        return scanner_error(reader, "found unexpected end of input in an escape sequence");
+    }
+    uint32_t result = 0;
+    for(size_t i = 0; i < 4; i++)
+    {
+        int digit = hex_value(reader->cursor[i]);
+        if(-1 == digit)
+        {
+            reader->cursor += i;
+            return scanner_error(reader, "did not find expected hexdecimal number");
+        }
+        result = (result << 4) | (uint32_t)digit;
+    }
+    reader->cursor += 4;
+    *unit = result;
+    return true;
+}
+
+static size_t encode_utf8(uint32_t code_point, uint8_t *output)
+{
+    if(0x80 > code_point)
+    {
+        output[0] = (uint8_t)code_point;
+        return 1;
+    }
+    if(0x800 > code_point)
+    {
+        output[0] = (uint8_t)(0xC0 | (code_point >> 6));
+        output[1] = (uint8_t)(0x80 | (code_point & 0x3F));
+        return 2;
+    }
+    if(0x10000 > code_point)
+    {
+        output[0] = (uint8_t)(0xE0 | (code_point >> 12));
+        output[1] = (uint8_t)(0x80 | ((code_point >> 6) & 0x3F));
+        output[2] = (uint8_t)(0x80 | (code_point & 0x3F));
+        return 3;
+    }
+    output[0] = (uint8_t)(0xF0 | (code_point >> 18));
+    output[1] = (uint8_t)(0x80 | ((code_point >> 12) & 0x3F));
+    output[2] = (uint8_t)(0x80 | ((code_point >> 6) & 0x3F));
+    output[3] = (uint8_t)(0x80 | (code_point & 0x3F));
+    return 4;
+}
+
+static bool read_escape(json_reader *reader, struct string_buffer *buffer)
+{
+    if(!ensure_capacity(buffer, buffer->length + 4))
+    {
+        reader->context->code = ERR_LOADER_OUT_OF_MEMORY;
+        return false;
+    }
+    if(reader->cursor == reader->end)
+    {
+        return scanner_error(reader, "found unexpected end of input in an escape sequence");
+    }
+
+    uint8_t *output = buffer->value + buffer->length;
+    switch(*reader->cursor++)
+    {
+        case '"':  *output = '"';  break;
+        case '\\': *output = '\\'; break;
+        case '/':  *output = '/';  break;
+        case 'b':  *output = '\b'; break;
+        case 'f':  *output = '\f'; break;
+        case 'n':  *output = '\n'; break;
+        case 'r':  *output = '\r'; break;
+        case 't':  *output = '\t'; break;
+        case 'u':
+        {
+            uint32_t code_point;
+            if(!read_code_unit(reader, &code_point))
+            {
+                return false;
+            }
+            if(0xD800 <= code_point && 0xDBFF >= code_point)
+            {
+                uint32_t low;
+                if(2 > reader->end - reader->cursor || '\\' != reader->cursor[0] || 'u' != reader->cursor[1])
+                {
+                    return scanner_error(reader, "found an unpaired surrogate in an escape sequence");
+                }
+                reader->cursor += 2;
+                if(!read_code_unit(reader, &low))
+                {
+                    return false;
+                }
+                if(0xDC00 > low || 0xDFFF < low)
+                {
+                    return scanner_error(reader, "found an unpaired surrogate in an escape sequence");
+                }
+                code_point = 0x10000 + ((code_point - 0xD800) << 10) + (low - 0xDC00);
+            }
+            else if(0xDC00 <= code_point && 0xDFFF >= code_point)
+            {
+                return scanner_error(reader, "found an unpaired surrogate in an escape sequence");
+            }
+            buffer->length += encode_utf8(code_point, output);
+            return true;
+        }
+        default:
+            reader->cursor--;
+            return scanner_error(reader, "found unknown escape character");
+    }
+    buffer->length++;
+    return true;
+}
+
+static size_t utf8_sequence_length(const uint8_t *cursor, const uint8_t *end)
+{
+    uint8_t lead = *cursor;
+    size_t width;
+    uint8_t minimum = 0x80;
+    uint8_t maximum = 0xBF;
+
+    if(0xC2 <= lead && 0xDF >= lead)
+    {
+        width = 2;
+    }
+    else if(0xE0 <= lead && 0xEF >= lead)
+    {
+        width = 3;
+        minimum = 0xE0 == lead ? 0xA0 : 0x80;
+        maximum = 0xED == lead ? 0x9F : 0xBF;
+    }
+    else if(0xF0 <= lead && 0xF4 >= lead)
+    {
+        width = 4;
+        minimum = 0xF0 == lead ? 0x90 : 0x80;
+        maximum = 0xF4 == lead ? 0x8F : 0xBF;
+    }
+    else
+    {
+        return 0;
+    }
+    if((size_t)(end - cursor) < width || minimum > cursor[1] || maximum < cursor[1])
+    {
+        return 0;
+    }
+    for(size_t i = 2; i < width; i++)
+    {
+        if(0x80 != (cursor[i] & 0xC0))
+        {
+            return 0;
+        }
+    }
+    return width;
+}
+
+/*
+ * Strings without escapes are returned as a range of the input, others are
+ * decoded into the given buffer.  Only ranges of the input are borrowable.
+ */
+static bool read_string(json_reader *reader, struct string_buffer *buffer, uint8_t **value, size_t *length, bool *borrowable)
+{
+    const uint8_t *end = reader->end;
+    const uint8_t *start = ++reader->cursor;
+    const uint8_t *cursor = start;
+    bool escaped = false;
+    buffer->length = 0;
+
+    while(true)
+    {
+        const uint8_t *run = cursor;
+        while(cursor < end && '"' != *cursor && '\\' != *cursor && 0x20 <= *cursor && 0x80 > *cursor)
+        {
+            cursor++;
+        }
+        if(cursor == end)
+        {
+            reader->cursor = cursor;
+            return scanner_error(reader, "found unexpected end of input while scanning a quoted scalar");
+        }
+        if(escaped && run != cursor)
+        {
+            if(!ensure_capacity(buffer, buffer->length + (size_t)(cursor - run)))
+            {
+                reader->context->code = ERR_LOADER_OUT_OF_MEMORY;
+                return false;
+            }
+            memcpy(buffer->value + buffer->length, run, (size_t)(cursor - run));
+            buffer->length += (size_t)(cursor - run);
+        }
+
+        uint8_t current = *cursor;
+        if('"' == current)
+        {
+            reader->cursor = cursor + 1;
+            break;
+        }
+        else if('\\' == current)
+        {
+            if(!escaped)
+            {
+                escaped = true;
+                size_t prefix = (size_t)(cursor - start);
+                if(!ensure_capacity(buffer, prefix + 4))
+                {
+                    reader->context->code = ERR_LOADER_OUT_OF_MEMORY;
+                    return false;
+                }
+                memcpy(buffer->value, start, prefix);
+                buffer->length = prefix;
+            }
+            reader->cursor = cursor + 1;
+            if(!read_escape(reader, buffer))
+            {
+                return false;
+            }
+            cursor = reader->cursor;
+        }
+        else if(0x20 > current)
+        {
+            reader->cursor = cursor;
+            return scanner_error(reader, "found a control character in a quoted scalar");
+        }
+        else
+        {
+            size_t width = utf8_sequence_length(cursor, end);
+            if(0 == width)
+            {
+                reader->cursor = cursor;
+                return reader_error(reader, "invalid UTF-8 octet sequence");
+            }
+            if(escaped)
+            {
+                if(!ensure_capacity(buffer, buffer->length + width))
+                {
+                    reader->context->code = ERR_LOADER_OUT_OF_MEMORY;
+                    return false;
+                }
+                memcpy(buffer->value + buffer->length, cursor, width);
+                buffer->length += width;
+            }
+            cursor += width;
+        }
+    }
+
+    if(escaped)
+    {
+        *value = buffer->value;
+        *length = buffer->length;
+        *borrowable = false;
+    }
+    else
+    {
+        *value = (uint8_t *)start;
+        *length = (size_t)(reader->cursor - 1 - start);
+        *borrowable = true;
+    }
+    return true;
+}
+
+static bool add_scalar_value(json_reader *reader, const uint8_t *value, size_t length, ScalarKind kind, bool borrowable)
+{
+    loader_context *context = reader->context;
+    if(NULL != context->tape)
+    {
+        size_t index;
+        if(!tape_add_scalar(context, value, length, kind, borrowable, NULL, &index))
+        {
+            set_marks(reader);
+            return false;
+        }
+        return true;
+    }
+    Scalar *scalar = NULL;
+    if(borrowable && NULL != context->input.data && 0 != length)
+    {
+        scalar = make_borrowed_scalar_node_in(model_arena(context->model), (uint8_t *)value, length, kind);
+    }
+    else
+    {
+        scalar = make_scalar_node_in(model_arena(context->model), value, length, kind);
+    }
+    if(NULL == scalar)
+    {
+        loader_error("uh oh! couldn't create scalar node, aborting...");
+        context->code = ERR_LOADER_OUT_OF_MEMORY;
+        return false;
+    }
+
+    loader_trace("added scalar (%p)", scalar);
+    if(add_node(context, node(scalar)))
+    {
+        node_free(scalar);
+        set_marks(reader);
+        return false;
+    }
+    return true;
+}
+
+static void set_marks(json_reader *reader)
+{
+    yaml_parser_t *parser = &reader->context->parser;
+    size_t line = 0;
+    const uint8_t *line_start = reader->start;
+    for(const uint8_t *cursor = reader->start; cursor < reader->cursor; cursor++)
+    {
+        if('\n' == *cursor)
+        {
+            line++;
+            line_start = cursor + 1;
+        }
+    }
+    parser->mark.index = (size_t)(reader->cursor - reader->start);
+    parser->mark.line = line;
+    parser->mark.column = (size_t)(reader->cursor - line_start);
+    parser->problem_mark = parser->mark;
+    parser->problem_offset = parser->mark.index;
+}
+
+static bool scanner_error(json_reader *reader, const char *problem)
+{
+    loader_debug("uh oh! %s, aborting...", problem);
+    reader->context->code = ERR_SCANNER_FAILED;
+    reader->context->parser.problem = problem;
+    set_marks(reader);
+    return false;
+}
+
+static bool parser_error(json_reader *reader, const char *problem)
+{
+    loader_debug("uh oh! %s, aborting...", problem);
+    reader->context->code = ERR_PARSER_FAILED;
+    reader->context->parser.problem = problem;
+    set_marks(reader);
+    return false;
+}
+
+static bool reader_error(json_reader *reader, const char *problem)
+{
+    loader_debug("uh oh! %s, aborting...", problem);
+    reader->context->code = ERR_READER_FAILED;
+    reader->context->parser.problem = problem;
+    set_marks(reader);
+    return false;
+}
@@ -0,0 +1,338 @@
+/*
+ * 金棒 (kanabō)
+ * Copyright (c) 2012 Kevin Birch <kmb@pobox.com>.  All rights reserved.
+ *
+ * 金棒 is a tool to bludgeon YAML and JSON files from the shell: the strong
+ * made stronger.
+ *
+ * For more information, consult the README file in the project root.
+ *
+ * Distributed under an [MIT-style][license] license.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal with
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * - Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimers.
+ * - Redistributions in binary form must reproduce the above copyright notice, this
+ *   list of conditions and the following disclaimers in the documentation and/or
+ *   other materials provided with the distribution.
+ * - Neither the names of the copyright holders, nor the names of the authors, nor
+ *   the names of other contributors may be used to endorse or promote products
+ *   derived from this Software without specific prior written permission.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE CONTRIBUTORS
+ * OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS WITH THE SOFTWARE.
+ *
+ * [license]: http://www.opensource.org/licenses/ncsa
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "loader.h"
+#include "loader/private.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define HAVE_X86_KERNELS 1
+#include <immintrin.h>
+#else
+#define HAVE_X86_KERNELS 0
+#endif
+
+/*
+ * Stage one of the JSON reader: classify the input 64 bytes at a time into
+ * bitmasks and reduce them to the offsets of every token outside of a string.
+ * That is each structural character, each opening quote, and the first byte
+ * of each number or literal.  Stage two (json.c) jumps between these offsets
+ * instead of scanning the whitespace in between.
+ */
+
+#define BLOCK_SIZE 64
+
+struct block_masks
+{
+    uint64_t quote;
+    uint64_t backslash;
+    uint64_t structural;
+    uint64_t whitespace;
+};
+
+typedef void (*classify_function)(const uint8_t *block, struct block_masks *masks);
+
+static const char * const KERNEL_NAMES [] =
+{
+    "scalar",
+    "sse2",
+    "avx2"
+};
+
+static void classify_scalar(const uint8_t *block, struct block_masks *masks)
+{
+    memset(masks, 0, sizeof(struct block_masks));
+    for(size_t i = 0; i < BLOCK_SIZE; i++)
+    {
+        uint64_t bit = 1ull << i;
+        switch(block[i])
+        {
+            case '"':
+                masks->quote |= bit;
+                break;
+            case '\\':
+                masks->backslash |= bit;
+                break;
+            case '{':
+            case '}':
+            case '[':
+            case ']':
+            case ':':
+            case ',':
+                masks->structural |= bit;
+                break;
+            case ' ':
+            case '\t':
+            case '\n':
+            case '\r':
+                masks->whitespace |= bit;
+                break;
+            default:
+                break;
+        }
+    }
+}
+
+#if HAVE_X86_KERNELS
+
+#define MATCH_SSE2(CHUNK, C) _mm_cmpeq_epi8((CHUNK), _mm_set1_epi8((C)))
+
+__attribute__((target("sse2")))
+static void classify_sse2(const uint8_t *block, struct block_masks *masks)
+{
+    memset(masks, 0, sizeof(struct block_masks));
+    for(size_t i = 0; i < BLOCK_SIZE; i += 16)
+    {
+        __m128i chunk = _mm_loadu_si128((const __m128i *)(const void *)(block + i));
+        __m128i structural = _mm_or_si128(_mm_or_si128(MATCH_SSE2(chunk, '{'), MATCH_SSE2(chunk, '}')),
+                                          _mm_or_si128(MATCH_SSE2(chunk, '['), MATCH_SSE2(chunk, ']')));
+        structural = _mm_or_si128(structural, _mm_or_si128(MATCH_SSE2(chunk, ':'), MATCH_SSE2(chunk, ',')));
+        __m128i whitespace = _mm_or_si128(_mm_or_si128(MATCH_SSE2(chunk, ' '), MATCH_SSE2(chunk, '\t')),
+                                          _mm_or_si128(MATCH_SSE2(chunk, '\n'), MATCH_SSE2(chunk, '\r')));
+
+        masks->quote |= (uint64_t)(uint16_t)_mm_movemask_epi8(MATCH_SSE2(chunk, '"')) << i;
+        masks->backslash |= (uint64_t)(uint16_t)_mm_movemask_epi8(MATCH_SSE2(chunk, '\\')) << i;
+        masks->structural |= (uint64_t)(uint16_t)_mm_movemask_epi8(structural) << i;
+        masks->whitespace |= (uint64_t)(uint16_t)_mm_movemask_epi8(whitespace) << i;
+    }
+}
+
+#define MATCH_AVX2(CHUNK, C) _mm256_cmpeq_epi8((CHUNK), _mm256_set1_epi8((C)))
+
+__attribute__((target("avx2")))
+static void classify_avx2(const uint8_t *block, struct block_masks *masks)
+{
+    memset(masks, 0, sizeof(struct block_masks));
+    for(size_t i = 0; i < BLOCK_SIZE; i += 32)
+    {
+        __m256i chunk = _mm256_loadu_si256((const __m256i *)(const void *)(block + i));
+        __m256i structural = _mm256_or_si256(_mm256_or_si256(MATCH_AVX2(chunk, '{'), MATCH_AVX2(chunk, '}')),
+                                             _mm256_or_si256(MATCH_AVX2(chunk, '['), MATCH_AVX2(chunk, ']')));
+        structural = _mm256_or_si256(structural, _mm256_or_si256(MATCH_AVX2(chunk, ':'), MATCH_AVX2(chunk, ',')));
+        __m256i whitespace = _mm256_or_si256(_mm256_or_si256(MATCH_AVX2(chunk, ' '), MATCH_AVX2(chunk, '\t')),
+                                             _mm256_or_si256(MATCH_AVX2(chunk, '\n'), MATCH_AVX2(chunk, '\r')));
+
+        masks->quote |= (uint64_t)(uint32_t)_mm256_movemask_epi8(MATCH_AVX2(chunk, '"')) << i;
+        masks->backslash |= (uint64_t)(uint32_t)_mm256_movemask_epi8(MATCH_AVX2(chunk, '\\')) << i;
+        masks->structural |= (uint64_t)(uint32_t)_mm256_movemask_epi8(structural) << i;
+        masks->whitespace |= (uint64_t)(uint32_t)_mm256_movemask_epi8(whitespace) << i;
+    }
+}
+
+#endif
+
+const char *structural_kernel_name(enum structural_kernel kernel)
+{
+    return KERNEL_NAMES[kernel];
+}
+
+bool structural_kernel_supported(enum structural_kernel kernel)
+{
+    switch(kernel)
+    {
+        case KERNEL_SCALAR:
+            return true;
+#if HAVE_X86_KERNELS
+        case KERNEL_SSE2:
+            return __builtin_cpu_supports("sse2");
+        case KERNEL_AVX2:
+            return __builtin_cpu_supports("avx2");
+#else
+        case KERNEL_SSE2:
+        case KERNEL_AVX2:
+            return false;
+#endif
+    }
+    return false;
+}
+
+enum structural_kernel best_structural_kernel(void)
+{
+    if(structural_kernel_supported(KERNEL_AVX2))
+    {
+        return KERNEL_AVX2;
+    }
+    if(structural_kernel_supported(KERNEL_SSE2))
+    {
+        return KERNEL_SSE2;
+    }
+    return KERNEL_SCALAR;
+}
+
+static classify_function kernel_function(enum structural_kernel kernel)
+{
+    switch(kernel)
+    {
+#if HAVE_X86_KERNELS
+        case KERNEL_AVX2:
+            return classify_avx2;
+        case KERNEL_SSE2:
+            return classify_sse2;
+#else
+        case KERNEL_AVX2:
+        case KERNEL_SSE2:
+#endif
+        case KERNEL_SCALAR:
+            break;
+    }
+    return classify_scalar;
+}
+
+/*
+ * Mark the character following each backslash that is not itself escaped.
+ * Backslashes are rare outside of escape heavy strings, so visiting them one
+ * at a time is cheaper than the carry tricks for odd length runs.
+ */
+static inline uint64_t find_escaped(uint64_t backslash, uint64_t *carry)
+{
+    uint64_t escaped = *carry;
+    *carry = 0;
+    while(0 != backslash)
+    {
+        unsigned int position = (unsigned int)__builtin_ctzll(backslash);
+        backslash &= backslash - 1;
+        if(0 != (escaped & (1ull << position)))
+        {
+            continue;
+        }
+        if(63 == position)
+        {
+            *carry = 1;
+        }
+        else
+        {
+            escaped |= 1ull << (position + 1);
+        }
+    }
+    return escaped;
+}
+
+static inline uint64_t prefix_xor(uint64_t value)
+{
+    value ^= value << 1;
+    value ^= value << 2;
+    value ^= value << 4;
+    value ^= value << 8;
+    value ^= value << 16;
+    value ^= value << 32;
+    return value;
+}
+
+static bool reserve_positions(struct structural_index *index, size_t count)
+{
+    if(index->length + count <= index->capacity)
+    {
+        return true;
+    }
+    size_t capacity = 0 == index->capacity ? 1024 : index->capacity;
+    while(capacity < index->length + count)
+    {
+        capacity *= 2;
+    }
+    uint32_t *positions = realloc(index->positions, capacity * sizeof(uint32_t));
+    if(NULL == positions)
+    {
+        return false;
+    }
+    index->positions = positions;
+    index->capacity = capacity;
+    return true;
+}
+
+bool build_structural_index(struct structural_index *index, const uint8_t *input, size_t length, enum structural_kernel kernel)
+{
+    memset(index, 0, sizeof(struct structural_index));
+    if(UINT32_MAX < length || !structural_kernel_supported(kernel))
+    {
+        return false;
+    }
+    if(!reserve_positions(index, length / 8 + BLOCK_SIZE))
+    {
+        return false;
+    }
+
+    classify_function classify = kernel_function(kernel);
+    uint64_t escape_carry = 0;
+    uint64_t in_string_carry = 0;
+    uint64_t scalar_carry = 0;
+    uint8_t tail[BLOCK_SIZE];
+
+    for(size_t offset = 0; offset < length; offset += BLOCK_SIZE)
+    {
+        const uint8_t *block = input + offset;
+        if(BLOCK_SIZE > length - offset)
+        {
+            memset(tail, ' ', BLOCK_SIZE);
+            memcpy(tail, block, length - offset);
+            block = tail;
+        }
+
+        struct block_masks masks;
+        classify(block, &masks);
+
+        uint64_t escaped = find_escaped(masks.backslash, &escape_carry);
+        uint64_t quote = masks.quote & ~escaped;
+        uint64_t in_string = prefix_xor(quote) ^ in_string_carry;
+        in_string_carry = (uint64_t)((int64_t)in_string >> 63);
+
+        uint64_t scalar = ~(masks.whitespace | masks.structural | quote | in_string);
+        uint64_t scalar_start = scalar & ~((scalar << 1) | scalar_carry);
+        scalar_carry = scalar >> 63;
+
+        uint64_t tokens = (masks.structural & ~in_string) | (quote & in_string) | scalar_start;
+        if(!reserve_positions(index, BLOCK_SIZE))
+        {
+            structural_index_free(index);
+            return false;
+        }
+        while(0 != tokens)
+        {
+            index->positions[index->length++] = (uint32_t)(offset + (size_t)__builtin_ctzll(tokens));
+            tokens &= tokens - 1;
+        }
+    }
+
+    return true;
+}
+
+void structural_index_free(struct structural_index *index)
+{
+    free(index->positions);
+    memset(index, 0, sizeof(struct structural_index));
+}
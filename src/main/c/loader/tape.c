@@ -0,0 +1,571 @@
+/*
+ * 金棒 (kanabō)
+ * Copyright (c) 2012 Kevin Birch <kmb@pobox.com>.  All rights reserved.
+ * 
+ * 金棒 is a tool to bludgeon YAML and JSON files from the shell: the strong
+ * made stronger.
+ *
+ * For more information, consult the README file in the project root.
+ *
+ * Distributed under an [MIT-style][license] license.
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal with
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * - Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimers.
+ * - Redistributions in binary form must reproduce the above copyright notice, this
+ *   list of conditions and the following disclaimers in the documentation and/or
+ *   other materials provided with the distribution.
+ * - Neither the names of the copyright holders, nor the names of the authors, nor
+ *   the names of other contributors may be used to endorse or promote products
+ *   derived from this Software without specific prior written permission.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE CONTRIBUTORS
+ * OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS WITH THE SOFTWARE.
+ *
+ * [license]: http://www.opensource.org/licenses/ncsa
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "loader.h"
+#include "loader/private.h"
+#include "hash.h"
+#include "arena.h"
+
+/*
+ * Loading a tape rather than a model, for the JSON reader (json.c) and for
+ * YAML from libyaml's events.  Records are appended in document order, and
+ * the builder keeps a stack of the containers still open, whose `next` is
+ * filled in when they are closed.
+ *
+ * Duplicate keys are found by comparing a new key with those of its mapping
+ * in turn, until the mapping has `HASHED_KEYS` of them.  From then on its
+ * keys are also held in an open addressed table of their records, so that a
+ * wide mapping is loaded in linear time.  The table is released when the
+ * mapping is closed.
+ */
+
+#define HASHED_KEYS 8
+
+struct open_container
+{
+    size_t    record;
+    /** for a mapping, is the next scalar one of its keys? */
+    bool      expecting_key;
+    /** for a mapping, is the key waiting for its value one it already has? */
+    bool      duplicate;
+    /** for a wide mapping, the record of each key plus one, or zero for an empty slot */
+    uint32_t *keys;
+    size_t    slots;
+};
+
+struct tape_builder
+{
+    Tape                  *tape;
+    struct open_container *open;
+    size_t                 depth;
+    size_t                 capacity;
+    /** the names of anchors, which outlive the events they came from */
+    Arena                 *anchors;
+};
+
+static bool out_of_memory(loader_context *context, const char *what __attribute__((unused)))
+{
+    loader_error("uh oh! out of memory, couldn't add %s to the tape, aborting...", what);
+    context->code = ERR_LOADER_OUT_OF_MEMORY;
+    return false;
+}
+
+bool start_tape(loader_context *context)
+{
+    struct tape_builder *builder = calloc(1, sizeof(struct tape_builder));
+    if(NULL == builder)
+    {
+        return out_of_memory(context, "the builder");
+    }
+    builder->tape = make_tape();
+    if(NULL == builder->tape)
+    {
+        free(builder);
+        return out_of_memory(context, "the first record");
+    }
+    context->tape = builder;
+    return true;
+}
+
+Tape *finish_tape(loader_context *context)
+{
+    struct tape_builder *builder = context->tape;
+    if(NULL == builder)
+    {
+        return NULL;
+    }
+    Tape *result = builder->tape;
+    for(size_t i = 0; i < builder->depth; i++)
+    {
+        free(builder->open[i].keys);
+    }
+    free(builder->open);
+    arena_free(builder->anchors);
+    free(builder);
+    context->tape = NULL;
+
+    if(LOADER_SUCCESS != context->code)
+    {
+        tape_free(result);
+        return NULL;
+    }
+    tape_trim(result);
+    loader_debug("done. found %zd documents in %zd records.", tape_size(result), result->length);
+    return result;
+}
+
+static inline struct open_container *innermost(const struct tape_builder *builder)
+{
+    return 0 == builder->depth ? NULL : builder->open + builder->depth - 1;
+}
+
+static inline TapeRecord *record(const struct tape_builder *builder, size_t index)
+{
+    return builder->tape->records + index;
+}
+
+NodeKind tape_target_kind(const loader_context *context)
+{
+    struct open_container *target = innermost(context->tape);
+    return NULL == target ? DOCUMENT : (NodeKind)record(context->tape, target->record)->kind;
+}
+
+static bool push(loader_context *context, size_t index)
+{
+    struct tape_builder *builder = context->tape;
+    if(builder->depth == builder->capacity)
+    {
+        size_t capacity = 0 == builder->capacity ? 16 : builder->capacity * 2;
+        struct open_container *larger = realloc(builder->open, capacity * sizeof(struct open_container));
+        if(NULL == larger)
+        {
+            return out_of_memory(context, "a container");
+        }
+        builder->open = larger;
+        builder->capacity = capacity;
+    }
+    builder->open[builder->depth++] = (struct open_container){index, true, false, NULL, 0};
+    return true;
+}
+
+static void pop(struct tape_builder *builder)
+{
+    struct open_container *target = innermost(builder);
+    record(builder, target->record)->next = (uint32_t)builder->tape->length;
+    free(target->keys);
+    builder->depth--;
+}
+
+bool tape_start_document(loader_context *context)
+{
+    struct tape_builder *builder = context->tape;
+    size_t index;
+    if(!tape_append(builder->tape, DOCUMENT, &index) || !tape_add_document(builder->tape, index) || !push(context, index))
+    {
+        return out_of_memory(context, "a document");
+    }
+    loader_trace("started document (%zd)", index);
+    return true;
+}
+
+bool tape_end_document(loader_context *context)
+{
+    struct tape_builder *builder = context->tape;
+    loader_trace("completed document (%zd)", innermost(builder)->record);
+    pop(builder);
+    return true;
+}
+
+bool tape_end_container(loader_context *context)
+{
+    struct tape_builder *builder = context->tape;
+    loader_trace("completed container (%zd) of length: %u", innermost(builder)->record, record(builder, innermost(builder)->record)->size);
+    pop(builder);
+    return true;
+}
+
+static inline const uint8_t *key_value(const loader_context *context, size_t key)
+{
+    const TapeRecord *each = record(context->tape, key);
+    return (each->flags & TAPE_BORROWED ? context->input.data : context->tape->tape->pool) + each->at;
+}
+
+static inline bool key_matches(const loader_context *context, size_t key, const uint8_t *value, size_t length)
+{
+    return length == record(context->tape, key)->size && 0 == memcmp(value, key_value(context, key), length);
+}
+
+static void hash_key(const loader_context *context, struct open_container *mapping, size_t key)
+{
+    const TapeRecord *each = record(context->tape, key);
+    size_t slot = wyhash_string_buffer_hash(key_value(context, key), each->size) & (mapping->slots - 1);
+    while(0 != mapping->keys[slot])
+    {
+        slot = (slot + 1) & (mapping->slots - 1);
+    }
+    mapping->keys[slot] = (uint32_t)key + 1;
+}
+
+static uint32_t *make_key_table(loader_context *context, struct open_container *mapping, size_t count)
+{
+    size_t slots = 2 * HASHED_KEYS;
+    while(slots < 2 * count)
+    {
+        slots *= 2;
+    }
+    uint32_t *result = calloc(slots, sizeof(uint32_t));
+    if(NULL == result)
+    {
+        out_of_memory(context, "a mapping key table");
+        return NULL;
+    }
+    mapping->keys = result;
+    mapping->slots = slots;
+    return result;
+}
+
+/* hash each of the mapping's keys so far, the last of which has no value yet */
+static bool build_key_table(loader_context *context, struct open_container *mapping, size_t count)
+{
+    if(NULL == make_key_table(context, mapping, count))
+    {
+        return false;
+    }
+    const TapeRecord *records = context->tape->tape->records;
+    size_t end = context->tape->tape->length;
+    for(size_t each = mapping->record + 1; each < end; each = each + 1 < end ? records[each + 1].next : end)
+    {
+        if(!(records[each].flags & TAPE_SHADOWED))
+        {
+            hash_key(context, mapping, each);
+        }
+    }
+    return true;
+}
+
+/* move the mapping's keys to a table with room for twice as many */
+static bool grow_key_table(loader_context *context, struct open_container *mapping, size_t count)
+{
+    uint32_t *old = mapping->keys;
+    size_t old_slots = mapping->slots;
+    if(NULL == make_key_table(context, mapping, count))
+    {
+        mapping->keys = old;
+        return false;
+    }
+    for(size_t i = 0; i < old_slots; i++)
+    {
+        if(0 != old[i])
+        {
+            hash_key(context, mapping, old[i] - 1);
+        }
+    }
+    free(old);
+    return true;
+}
+
+/* the record of the mapping's key with this value, or TAPE_NONE */
+static size_t find_key(const loader_context *context, const struct open_container *mapping, const uint8_t *value, size_t length)
+{
+    if(NULL != mapping->keys)
+    {
+        size_t slot = wyhash_string_buffer_hash(value, length) & (mapping->slots - 1);
+        for(; 0 != mapping->keys[slot]; slot = (slot + 1) & (mapping->slots - 1))
+        {
+            if(key_matches(context, mapping->keys[slot] - 1, value, length))
+            {
+                return mapping->keys[slot] - 1;
+            }
+        }
+        return TAPE_NONE;
+    }
+
+    const TapeRecord *records = context->tape->tape->records;
+    size_t end = context->tape->tape->length;
+    for(size_t each = mapping->record + 1; each < end; each = records[each + 1].next)
+    {
+        if(!(records[each].flags & TAPE_SHADOWED) && key_matches(context, each, value, length))
+        {
+            return each;
+        }
+    }
+    return TAPE_NONE;
+}
+
+static bool set_value(loader_context *context, size_t index, const uint8_t *value, size_t length, bool borrowable)
+{
+    Tape *tape = context->tape->tape;
+    if(borrowable && NULL != context->input.data && 0 != length)
+    {
+        return tape_set_borrowed_value(tape, index, (size_t)(value - context->input.data), length);
+    }
+    return 0 == length || tape_set_value(tape, index, value, length);
+}
+
+static bool add_key(loader_context *context, struct open_container *mapping, const uint8_t *value, size_t length, bool borrowable, size_t *index)
+{
+    size_t existing = find_key(context, mapping, value, length);
+    // N.B. - as in a model, a duplicate fails once its value is read, so that the error is reported where the value ends
+    mapping->duplicate = TAPE_NONE != existing && DUPE_FAIL == context->strategy;
+    if(TAPE_NONE != existing && DUPE_WARN == context->strategy)
+    {
+        fprintf(stderr, "warning: duplicate mapping key found: '%.*s'\n", (int)length, (const char *)value);
+    }
+
+    Tape *tape = context->tape->tape;
+    if(!tape_append(tape, SCALAR, index) || !set_value(context, *index, value, length, borrowable))
+    {
+        return out_of_memory(context, "a mapping key");
+    }
+    TapeRecord *key = record(context->tape, *index);
+    key->scalar_kind = SCALAR_STRING;
+    mapping->expecting_key = false;
+    if(TAPE_NONE != existing)
+    {
+        // N.B. - the first key keeps its place in the mapping, but takes this key's value
+        trace_string("shadowing duplicate key '%s' (%zd)", value, length, existing);
+        key->flags |= TAPE_SHADOWED;
+        record(context->tape, existing)->next = (uint32_t)*index + 1;
+        return true;
+    }
+
+    size_t count = ++record(context->tape, mapping->record)->size;
+    if(NULL == mapping->keys)
+    {
+        return HASHED_KEYS > count || build_key_table(context, mapping, count);
+    }
+    if(mapping->slots < 2 * count && !grow_key_table(context, mapping, count))
+    {
+        return false;
+    }
+    hash_key(context, mapping, *index);
+    return true;
+}
+
+/*
+ * Count a value other than a key into the innermost container, or refuse it
+ * where a key is expected.
+ */
+static bool place_value(loader_context *context)
+{
+    struct open_container *target = innermost(context->tape);
+    if(NULL == target)
+    {
+        loader_debug("uh oh! found a node outside of any document, aborting...");
+        context->code = ERR_OTHER;
+        return false;
+    }
+    TapeRecord *container = record(context->tape, target->record);
+    if(MAPPING != container->kind)
+    {
+        container->size++;
+        return true;
+    }
+    if(target->expecting_key)
+    {
+        loader_debug("uh oh! found a non scalar mapping key, aborting...");
+        context->code = ERR_NON_SCALAR_KEY;
+        return false;
+    }
+    if(target->duplicate)
+    {
+        loader_debug("uh oh! a duplicate mapping key was found, aborting...");
+        context->code = ERR_DUPLICATE_KEY;
+        return false;
+    }
+    target->expecting_key = true;
+    return true;
+}
+
+bool tape_start_container(loader_context *context, NodeKind kind, const uint8_t *tag, size_t *index)
+{
+    if(!place_value(context))
+    {
+        return false;
+    }
+    Tape *tape = context->tape->tape;
+    if(!tape_append(tape, kind, index) || (NULL != tag && !tape_set_tag(tape, *index, tag)) || !push(context, *index))
+    {
+        return out_of_memory(context, SEQUENCE == kind ? "a sequence" : "a mapping");
+    }
+    loader_trace("started container (%zd)", *index);
+    return true;
+}
+
+bool tape_add_scalar(loader_context *context, const uint8_t *value, size_t length, ScalarKind kind, bool borrowable, const uint8_t *tag, size_t *index)
+{
+    struct open_container *target = innermost(context->tape);
+    if(NULL != target && MAPPING == record(context->tape, target->record)->kind && target->expecting_key)
+    {
+        // N.B. - as in a model, keys are plain strings whatever their tag
+        return add_key(context, target, value, length, borrowable, index);
+    }
+    if(!place_value(context))
+    {
+        return false;
+    }
+    Tape *tape = context->tape->tape;
+    if(!tape_append(tape, SCALAR, index) || !set_value(context, *index, value, length, borrowable)
+       || (NULL != tag && !tape_set_tag(tape, *index, tag)))
+    {
+        return out_of_memory(context, "a scalar");
+    }
+    // N.B. - the tape is never written once loaded, so plain scalars are classified now rather than on first use
+    record(context->tape, *index)->scalar_kind = (uint8_t)(SCALAR_UNRESOLVED == kind ? classify_scalar_value(value, length) : kind);
+    trace_string("added scalar '%s' (%zd)", value, length, *index);
+    return true;
+}
+
+/*
+ * YAML
+ * ====
+ */
+
+static bool set_anchor(loader_context *context, const uint8_t *anchor, size_t index)
+{
+    if(NULL == anchor)
+    {
+        return true;
+    }
+    struct tape_builder *builder = context->tape;
+    if(NULL == builder->anchors)
+    {
+        builder->anchors = make_arena();
+        if(NULL == builder->anchors)
+        {
+            return out_of_memory(context, "an anchor");
+        }
+    }
+    size_t length = strlen((const char *)anchor) + 1;
+    uint8_t *name = arena_alloc(builder->anchors, length);
+    if(NULL == name)
+    {
+        return out_of_memory(context, "an anchor");
+    }
+    memcpy(name, anchor, length);
+
+    errno = 0;
+    hashtable_put(context->anchors, name, (void *)(uintptr_t)(index + 1));
+    return 0 == errno || out_of_memory(context, "an anchor");
+}
+
+static bool add_alias(loader_context *context, const yaml_event_t *event)
+{
+    void *found = hashtable_get(context->anchors, event->data.alias.anchor);
+    if(NULL == found)
+    {
+        loader_debug("uh oh! couldn't find anchor for alias '%s', aborting...", event->data.alias.anchor);
+        context->code = ERR_NO_ANCHOR_FOR_ALIAS;
+        return false;
+    }
+    size_t target = (size_t)(uintptr_t)found - 1;
+
+    struct tape_builder *builder = context->tape;
+    for(size_t i = 0; i < builder->depth; i++)
+    {
+        if(builder->open[i].record == target)
+        {
+            loader_debug("uh oh! found an alias loop for '%s', aborting...", event->data.alias.anchor);
+            context->code = ERR_ALIAS_LOOP;
+            return false;
+        }
+    }
+
+    size_t index;
+    if(!place_value(context))
+    {
+        return false;
+    }
+    if(!tape_append(builder->tape, ALIAS, &index))
+    {
+        return out_of_memory(context, "an alias");
+    }
+    record(builder, index)->at = (uint32_t)target;
+    loader_trace("added '%s' alias (%zd) of (%zd)", event->data.alias.anchor, index, target);
+    return true;
+}
+
+static bool add_scalar(loader_context *context, const yaml_event_t *event)
+{
+    uint8_t *borrowed = borrow_scalar_value(context, event);
+    const uint8_t *value = NULL == borrowed ? event->data.scalar.value : borrowed;
+    size_t index;
+    return tape_add_scalar(context, value, event->data.scalar.length, resolve_scalar_kind(event),
+                           NULL != borrowed, event->data.scalar.tag, &index)
+        && set_anchor(context, event->data.scalar.anchor, index);
+}
+
+static bool start_container(loader_context *context, NodeKind kind, const uint8_t *tag, const uint8_t *anchor)
+{
+    size_t index;
+    return tape_start_container(context, kind, tag, &index) && set_anchor(context, anchor, index);
+}
+
+static bool dispatch_event(loader_context *context, const yaml_event_t *event)
+{
+    switch(event->type)
+    {
+        case YAML_NO_EVENT:
+        case YAML_STREAM_START_EVENT:
+        case YAML_STREAM_END_EVENT:
+            return true;
+        case YAML_DOCUMENT_START_EVENT:
+            return tape_start_document(context);
+        case YAML_DOCUMENT_END_EVENT:
+            return tape_end_document(context);
+        case YAML_ALIAS_EVENT:
+            return add_alias(context, event);
+        case YAML_SCALAR_EVENT:
+            return add_scalar(context, event);
+        case YAML_SEQUENCE_START_EVENT:
+            return start_container(context, SEQUENCE, event->data.sequence_start.tag, event->data.sequence_start.anchor);
+        case YAML_MAPPING_START_EVENT:
+            return start_container(context, MAPPING, event->data.mapping_start.tag, event->data.mapping_start.anchor);
+        case YAML_SEQUENCE_END_EVENT:
+        case YAML_MAPPING_END_EVENT:
+            return tape_end_container(context);
+    }
+    return true;
+}
+
+void build_tape(loader_context *context)
+{
+    loader_debug("building tape...");
+    context->code = LOADER_SUCCESS;
+
+    yaml_event_t event;
+    bool done = false;
+    while(!done)
+    {
+        if(!yaml_parser_parse(&context->parser, &event))
+        {
+            context->code = interpret_yaml_error(&context->parser);
+            break;
+        }
+        // N.B. - unlike a model's, a tape's keys are stored as soon as they are read, so no event outlives its dispatch
+        done = YAML_STREAM_END_EVENT == event.type || !dispatch_event(context, &event);
+        yaml_event_delete(&event);
+    }
+    if(LOADER_SUCCESS == context->code && 0 == tape_size(context->tape->tape))
+    {
+        loader_error("no documents found for the input!");
+        context->code = ERR_NO_DOCUMENTS_FOUND;
+    }
+}
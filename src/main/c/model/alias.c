@@ -57,7 +57,7 @@ static size_t alias_size(const Node *self __attribute__((unused)))
     return 0;
 }
 
-static const struct vtable_s alias_vtable = 
+const struct vtable_s alias_vtable = 
 {
     alias_free,
     alias_size,
@@ -66,12 +66,16 @@ static const struct vtable_s alias_vtable =
 
 Alias *make_alias_node(Node *target)
 {
-    Alias *self = calloc(1, sizeof(Alias));
+    return make_alias_node_in(NULL, target);
+}
+
+Alias *make_alias_node_in(Arena *arena, Node *target)
+{
+    Alias *self = node_allocate(arena, sizeof(Alias));
     if(NULL != self)
     {
-        node_init(self, ALIAS);
+        node_init(self, ALIAS, arena);
         self->target = target;
-        self->base.vtable = &alias_vtable;
     }
 
     return self;
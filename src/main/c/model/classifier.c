@@ -0,0 +1,261 @@
+/*
+ * 金棒 (kanabō)
+ * Copyright (c) 2012 Kevin Birch <kmb@pobox.com>.  All rights reserved.
+ *
+ * 金棒 is a tool to bludgeon YAML and JSON files from the shell: the strong
+ * made stronger.
+ *
+ * For more information, consult the README file in the project root.
+ *
+ * Distributed under an [MIT-style][license] license.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal with
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * - Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimers.
+ * - Redistributions in binary form must reproduce the above copyright notice, this
+ *   list of conditions and the following disclaimers in the documentation and/or
+ *   other materials provided with the distribution.
+ * - Neither the names of the copyright holders, nor the names of the authors, nor
+ *   the names of other contributors may be used to endorse or promote products
+ *   derived from this Software without specific prior written permission.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE CONTRIBUTORS
+ * OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS WITH THE SOFTWARE.
+ *
+ * [license]: http://www.opensource.org/licenses/ncsa
+ */
+
+
+/*
+ * Plain scalar classification.
+ *
+ * A single table driven DFA recognizes the integer, decimal and timestamp
+ * forms the loader used to test with three POSIX regular expressions:
+ *
+ *   integer:   -?(0|[1-9][0-9]*)
+ *   decimal:   -?(0|[1-9][0-9]*)([.][0-9]+)?([eE][+-]?[0-9]+)?
+ *   timestamp: [0-9]{4}-[0-9][0-9]?-[0-9][0-9]?
+ *              (([Tt]|[ \t]+)[0-9][0-9]?:[0-9][0-9](:[0-9][0-9])?([.][0-9]+)?
+ *               ([ \t]*(Z|[-+][0-9][0-9]?(:[0-9][0-9])?))?)?
+ *
+ * The integer and timestamp forms share their leading digits, so the states
+ * for the first four characters track both at once (e.g. "0123" is neither an
+ * integer nor a decimal, but can still become "0123-04-05").  Each state
+ * carries the kind it accepts as, so the value is classified in one pass with
+ * no copying and no terminator.
+ */
+
+#include <string.h>
+
+#include "model.h"
+
+
+enum char_class
+{
+    C_OTHER,
+    C_ZERO,                     /* 0 */
+    C_DIGIT,                    /* 1-9 */
+    C_MINUS,                    /* - */
+    C_PLUS,                     /* + */
+    C_DOT,                      /* . */
+    C_EXPONENT,                 /* e E */
+    C_TIME,                     /* T t */
+    C_BLANK,                    /* space and tab */
+    C_COLON,                    /* : */
+    C_ZULU,                     /* Z */
+    CLASS_COUNT
+};
+
+enum state
+{
+    S_DEAD,                     /* no form can match any more */
+    S_START,
+
+    /* leading digits, shared between the numeric and timestamp forms */
+    S_ZERO1,                    /* 0 */
+    S_INT1,                     /* [1-9] */
+    S_INT2,                     /* [1-9]d */
+    S_INT3,                     /* [1-9]dd */
+    S_INT4,                     /* [1-9]ddd */
+    S_YEAR2,                    /* 0d, only a timestamp from here */
+    S_YEAR3,
+    S_YEAR4,
+
+    /* numeric forms */
+    S_MINUS,
+    S_MINUS_ZERO,
+    S_INT,
+    S_FRACTION_START,
+    S_FRACTION,
+    S_EXPONENT_START,
+    S_EXPONENT_SIGN,
+    S_EXPONENT,
+
+    /* timestamp date */
+    S_YEAR_DASH,
+    S_MONTH1,
+    S_MONTH2,
+    S_MONTH_DASH,
+    S_DAY1,
+    S_DAY2,
+
+    /* timestamp time */
+    S_TIME_MARK,
+    S_TIME_BLANK,
+    S_HOUR1,
+    S_HOUR2,
+    S_HOUR_COLON,
+    S_MINUTE1,
+    S_MINUTE2,
+    S_MINUTE_COLON,
+    S_SECOND1,
+    S_SECOND2,
+    S_SECOND_FRACTION_START,
+    S_SECOND_FRACTION,
+
+    /* timestamp zone */
+    S_ZONE_BLANK,
+    S_ZULU,
+    S_OFFSET_SIGN,
+    S_OFFSET_HOUR1,
+    S_OFFSET_HOUR2,
+    S_OFFSET_COLON,
+    S_OFFSET_MINUTE1,
+    S_OFFSET_MINUTE2,
+
+    STATE_COUNT
+};
+
+static const uint8_t CLASSES[256] =
+{
+    ['0'] = C_ZERO,
+    ['1'] = C_DIGIT, ['2'] = C_DIGIT, ['3'] = C_DIGIT, ['4'] = C_DIGIT, ['5'] = C_DIGIT,
+    ['6'] = C_DIGIT, ['7'] = C_DIGIT, ['8'] = C_DIGIT, ['9'] = C_DIGIT,
+    ['-'] = C_MINUS,
+    ['+'] = C_PLUS,
+    ['.'] = C_DOT,
+    ['e'] = C_EXPONENT, ['E'] = C_EXPONENT,
+    ['t'] = C_TIME, ['T'] = C_TIME,
+    [' '] = C_BLANK, ['\t'] = C_BLANK,
+    [':'] = C_COLON,
+    ['Z'] = C_ZULU
+};
+
+#define DIGITS(STATE) [C_ZERO] = (STATE), [C_DIGIT] = (STATE)
+#define SIGNS(STATE) [C_MINUS] = (STATE), [C_PLUS] = (STATE)
+#define ZONE [C_BLANK] = S_ZONE_BLANK, [C_ZULU] = S_ZULU, SIGNS(S_OFFSET_SIGN)
+
+/* unlisted transitions go to S_DEAD, which is zero */
+static const uint8_t TRANSITIONS[STATE_COUNT][CLASS_COUNT] =
+{
+    [S_START]                 = {[C_ZERO] = S_ZERO1, [C_DIGIT] = S_INT1, [C_MINUS] = S_MINUS},
+
+    [S_ZERO1]                 = {DIGITS(S_YEAR2), [C_DOT] = S_FRACTION_START, [C_EXPONENT] = S_EXPONENT_START},
+    [S_INT1]                  = {DIGITS(S_INT2), [C_DOT] = S_FRACTION_START, [C_EXPONENT] = S_EXPONENT_START},
+    [S_INT2]                  = {DIGITS(S_INT3), [C_DOT] = S_FRACTION_START, [C_EXPONENT] = S_EXPONENT_START},
+    [S_INT3]                  = {DIGITS(S_INT4), [C_DOT] = S_FRACTION_START, [C_EXPONENT] = S_EXPONENT_START},
+    [S_INT4]                  = {DIGITS(S_INT), [C_DOT] = S_FRACTION_START, [C_EXPONENT] = S_EXPONENT_START, [C_MINUS] = S_YEAR_DASH},
+    [S_YEAR2]                 = {DIGITS(S_YEAR3)},
+    [S_YEAR3]                 = {DIGITS(S_YEAR4)},
+    [S_YEAR4]                 = {[C_MINUS] = S_YEAR_DASH},
+
+    [S_MINUS]                 = {[C_ZERO] = S_MINUS_ZERO, [C_DIGIT] = S_INT},
+    [S_MINUS_ZERO]            = {[C_DOT] = S_FRACTION_START, [C_EXPONENT] = S_EXPONENT_START},
+    [S_INT]                   = {DIGITS(S_INT), [C_DOT] = S_FRACTION_START, [C_EXPONENT] = S_EXPONENT_START},
+    [S_FRACTION_START]        = {DIGITS(S_FRACTION)},
+    [S_FRACTION]              = {DIGITS(S_FRACTION), [C_EXPONENT] = S_EXPONENT_START},
+    [S_EXPONENT_START]        = {DIGITS(S_EXPONENT), SIGNS(S_EXPONENT_SIGN)},
+    [S_EXPONENT_SIGN]         = {DIGITS(S_EXPONENT)},
+    [S_EXPONENT]              = {DIGITS(S_EXPONENT)},
+
+    [S_YEAR_DASH]             = {DIGITS(S_MONTH1)},
+    [S_MONTH1]                = {DIGITS(S_MONTH2), [C_MINUS] = S_MONTH_DASH},
+    [S_MONTH2]                = {[C_MINUS] = S_MONTH_DASH},
+    [S_MONTH_DASH]            = {DIGITS(S_DAY1)},
+    [S_DAY1]                  = {DIGITS(S_DAY2), [C_TIME] = S_TIME_MARK, [C_BLANK] = S_TIME_BLANK},
+    [S_DAY2]                  = {[C_TIME] = S_TIME_MARK, [C_BLANK] = S_TIME_BLANK},
+
+    [S_TIME_MARK]             = {DIGITS(S_HOUR1)},
+    [S_TIME_BLANK]            = {DIGITS(S_HOUR1), [C_BLANK] = S_TIME_BLANK},
+    [S_HOUR1]                 = {DIGITS(S_HOUR2), [C_COLON] = S_HOUR_COLON},
+    [S_HOUR2]                 = {[C_COLON] = S_HOUR_COLON},
+    [S_HOUR_COLON]            = {DIGITS(S_MINUTE1)},
+    [S_MINUTE1]               = {DIGITS(S_MINUTE2)},
+    [S_MINUTE2]               = {[C_COLON] = S_MINUTE_COLON, [C_DOT] = S_SECOND_FRACTION_START, ZONE},
+    [S_MINUTE_COLON]          = {DIGITS(S_SECOND1)},
+    [S_SECOND1]               = {DIGITS(S_SECOND2)},
+    [S_SECOND2]               = {[C_DOT] = S_SECOND_FRACTION_START, ZONE},
+    [S_SECOND_FRACTION_START] = {DIGITS(S_SECOND_FRACTION)},
+    [S_SECOND_FRACTION]       = {DIGITS(S_SECOND_FRACTION), ZONE},
+
+    [S_ZONE_BLANK]            = {[C_BLANK] = S_ZONE_BLANK, [C_ZULU] = S_ZULU, SIGNS(S_OFFSET_SIGN)},
+    [S_OFFSET_SIGN]           = {DIGITS(S_OFFSET_HOUR1)},
+    [S_OFFSET_HOUR1]          = {DIGITS(S_OFFSET_HOUR2), [C_COLON] = S_OFFSET_COLON},
+    [S_OFFSET_HOUR2]          = {[C_COLON] = S_OFFSET_COLON},
+    [S_OFFSET_COLON]          = {DIGITS(S_OFFSET_MINUTE1)},
+    [S_OFFSET_MINUTE1]        = {DIGITS(S_OFFSET_MINUTE2)}
+};
+
+/* the kind of a value that ends in each state, strings are the default */
+static const uint8_t ACCEPTS[STATE_COUNT] =
+{
+    [S_ZERO1]           = SCALAR_INTEGER,
+    [S_INT1]            = SCALAR_INTEGER,
+    [S_INT2]            = SCALAR_INTEGER,
+    [S_INT3]            = SCALAR_INTEGER,
+    [S_INT4]            = SCALAR_INTEGER,
+    [S_MINUS_ZERO]      = SCALAR_INTEGER,
+    [S_INT]             = SCALAR_INTEGER,
+    [S_FRACTION]        = SCALAR_REAL,
+    [S_EXPONENT]        = SCALAR_REAL,
+    [S_DAY1]            = SCALAR_TIMESTAMP,
+    [S_DAY2]            = SCALAR_TIMESTAMP,
+    [S_MINUTE2]         = SCALAR_TIMESTAMP,
+    [S_SECOND2]         = SCALAR_TIMESTAMP,
+    [S_SECOND_FRACTION] = SCALAR_TIMESTAMP,
+    [S_ZULU]            = SCALAR_TIMESTAMP,
+    [S_OFFSET_HOUR1]    = SCALAR_TIMESTAMP,
+    [S_OFFSET_HOUR2]    = SCALAR_TIMESTAMP,
+    [S_OFFSET_MINUTE2]  = SCALAR_TIMESTAMP
+};
+
+static inline bool has_prefix(const uint8_t *value, size_t length, const char *prefix, size_t prefix_length)
+{
+    return length >= prefix_length && 0 == memcmp(prefix, value, prefix_length);
+}
+
+ScalarKind classify_scalar_value(const uint8_t *value, size_t length)
+{
+    if(NULL == value || 0 == length)
+    {
+        return SCALAR_STRING;
+    }
+
+    // N.B. - null and booleans are matched on their prefix, as they always have been
+    if(has_prefix(value, length, "null", 4))
+    {
+        return SCALAR_NULL;
+    }
+    if(has_prefix(value, length, "true", 4) || has_prefix(value, length, "false", 5))
+    {
+        return SCALAR_BOOLEAN;
+    }
+
+    uint_fast8_t state = S_START;
+    for(size_t i = 0; i < length && S_DEAD != state; i++)
+    {
+        state = TRANSITIONS[state][CLASSES[value[i]]];
+    }
+
+    return (ScalarKind)ACCEPTS[state];
+}
@@ -59,7 +59,7 @@ static size_t document_size(const Node *self)
     return NULL == ((Document *)self)->root ? 0 : 1;
 }
 
-static const struct vtable_s document_vtable = 
+const struct vtable_s document_vtable = 
 {
     document_free,
     document_size,
@@ -68,11 +68,15 @@ static const struct vtable_s document_vtable =
 
 Document *make_document_node(void)
 {
-    Document *self = calloc(1, sizeof(Document));
+    return make_document_node_in(NULL);
+}
+
+Document *make_document_node_in(Arena *arena)
+{
+    Document *self = node_allocate(arena, sizeof(Document));
     if(NULL != self)
     {
-        node_init(self, DOCUMENT);
-        self->base.vtable = &document_vtable;
+        node_init(self, DOCUMENT, arena);
     }
 
     return self;
@@ -37,8 +37,10 @@
 
 #include <string.h>
 #include <errno.h>
+#include <sys/mman.h>
 
 #include "model.h"
+#include "model/private.h"
 #include "vector.h"
 #include "conditions.h"
 
@@ -50,14 +52,133 @@ static bool freedom_iterator(void *each, void *context __attribute__((unused)))
     return true;
 }
 
+DocumentModel *make_model(void)
+{
+    DocumentModel *result = calloc(1, sizeof(DocumentModel));
+    if(NULL == result)
+    {
+        return NULL;
+    }
+    result->documents = make_vector_with_capacity(1);
+    if(NULL == result->documents)
+    {
+        free(result);
+        return NULL;
+    }
+    result->arena = make_arena();
+    if(NULL == result->arena)
+    {
+        vector_free(result->documents);
+        free(result);
+        return NULL;
+    }
+
+    return result;
+}
+
 void model_free(DocumentModel *self)
 {
     if(NULL == self)
     {
         return;
     }
-    vector_iterate(self, freedom_iterator, NULL);
-    vector_free(self);
+    // N.B. - documents made in the model's arena are skipped here, releasing the arena frees them all at once
+    vector_iterate(self->documents, freedom_iterator, NULL);
+    vector_free(self->documents);
+    arena_free(self->arena);
+    if(NULL != self->input.data)
+    {
+        munmap(self->input.data, self->input.length);
+    }
+    free(self);
+}
+
+void model_set_input(DocumentModel *self, uint8_t *data, size_t length)
+{
+    PRECOND_NONNULL_ELSE_VOID(self);
+
+    self->input.data = data;
+    self->input.length = length;
+}
+
+Arena *model_arena(const DocumentModel *self)
+{
+    PRECOND_NONNULL_ELSE_NULL(self);
+
+    return self->arena;
+}
+
+ArenaStats model_arena_stats(const DocumentModel *self)
+{
+    if(NULL == self)
+    {
+        errno = EINVAL;
+        return (ArenaStats){0, 0, 0, 0};
+    }
+
+    return arena_stats(self->arena);
+}
+
+Scalar *model_symbol(const DocumentModel *self, const uint8_t *value, size_t length)
+{
+    PRECOND_NONNULL_ELSE_NULL(self, value);
+
+    if(NULL == self->symbols)
+    {
+        return NULL;
+    }
+    Scalar key;
+    scalar_init_probe(&key, (uint8_t *)value, length);
+
+    return hashtable_get(self->symbols, &key);
+}
+
+Scalar *model_intern(DocumentModel *self, const uint8_t *value, size_t length)
+{
+    PRECOND_NONNULL_ELSE_NULL(self, value);
+
+    if(NULL == self->symbols)
+    {
+        self->symbols = make_hashtable_in(self->arena, scalar_key_comparitor, scalar_key_hash);
+        if(NULL == self->symbols)
+        {
+            return NULL;
+        }
+    }
+    Scalar key;
+    scalar_init_probe(&key, (uint8_t *)value, length);
+    Scalar *result = hashtable_get(self->symbols, &key);
+    if(NULL != result)
+    {
+        return result;
+    }
+
+    Symbol *symbol = make_symbol_in(self->arena, value, length, wyhash_string_buffer_hash(value, length));
+    if(NULL == symbol)
+    {
+        return NULL;
+    }
+    errno = 0;
+    hashtable_put(self->symbols, symbol, symbol);
+    if(0 != errno)
+    {
+        return NULL;
+    }
+    return &symbol->scalar;
+}
+
+size_t model_size(const DocumentModel *self)
+{
+    PRECOND_NONNULL_ELSE_ZERO(self);
+
+    return vector_length(self->documents);
+}
+
+Document *model_document(const DocumentModel *self, size_t index)
+{
+    PRECOND_NONNULL_ELSE_NULL(self);
+
+    return vector_get(self->documents, index);
 }
 
 Node *model_document_root(const DocumentModel *self, size_t index)
@@ -77,5 +198,7 @@ bool model_add(DocumentModel *self, Document *doc)
 {
     PRECOND_NONNULL_ELSE_FALSE(self, doc);
 
-    return vector_add(self, doc);
+    // N.B. - a new document isn't numbered, so an index built before now has to be built again
+    self->names.state = NAME_INDEX_UNBUILT;
+    return vector_add(self->documents, doc);
 }
@@ -36,6 +36,8 @@
  */
 
 
+#include <string.h>
+
 #include "model.h"
 #include "model/private.h"
 #include "conditions.h"
@@ -74,18 +76,38 @@ static void mapping_free(Node *value)
     map->values = NULL;
 }
 
-static hashcode scalar_hash(const void *key)
+hashcode scalar_key_hash(const void *key)
 {
     const Scalar *value = (const Scalar *)key;
-    return shift_add_xor_string_buffer_hash(scalar_value(value), node_size(key));
+    if(value->interned)
+    {
+        return ((const Symbol *)value)->hash;
+    }
+    return wyhash_string_buffer_hash(scalar_bytes(value), value->length);
 }
 
-static bool scalar_comparitor(const void *one, const void *two)
+bool scalar_key_comparitor(const void *one, const void *two)
 {
+    const Scalar *a = (const Scalar *)one;
+    const Scalar *b = (const Scalar *)two;
+    if(a == b)
+    {
+        return true;
+    }
+    if(a->interned && b->interned && ((const Symbol *)a)->hash != ((const Symbol *)b)->hash)
+    {
+        // N.B. - symbols from one model are never equal, but those of two different models may be
+        return false;
+    }
+    if(NULL == node_tag(&a->base) && NULL == node_tag(&b->base))
+    {
+        // N.B. - untagged keys are the common case, compare their bytes without the generic node dispatch
+        return a->length == b->length && 0 == memcmp(scalar_bytes(a), scalar_bytes(b), a->length);
+    }
     return node_equals(const_node(one), const_node(two));
 }
 
-static const struct vtable_s mapping_vtable = 
+const struct vtable_s mapping_vtable = 
 {
     mapping_free,
     mapping_size,
@@ -94,18 +116,23 @@ static const struct vtable_s mapping_vtable =
 
 Mapping *make_mapping_node(void)
 {
-    Mapping *self = calloc(1, sizeof(Mapping));
+    return make_mapping_node_in(NULL);
+}
+
+Mapping *make_mapping_node_in(Arena *arena)
+{
+    Mapping *self = node_allocate(arena, sizeof(Mapping));
     if(NULL != self)
     {
-        node_init(self, MAPPING);
-        self->values = make_hashtable_with_function(scalar_comparitor, scalar_hash);
+        node_init(self, MAPPING, arena);
+        self->values = NULL == arena ? make_hashtable_with_function(scalar_key_comparitor, scalar_key_hash)
+                                     : make_hashtable_in(arena, scalar_key_comparitor, scalar_key_hash);
         if(NULL == self->values)
         {
-            free(self);
+            node_release(arena, self);
             self = NULL;
             return NULL;
         }
-        self->base.vtable = &mapping_vtable;
     }
 
     return self;
@@ -116,11 +143,10 @@ Node *mapping_get(const Mapping *self, uint8_t *value, size_t length)
     PRECOND_NONNULL_ELSE_NULL(self, value);
     PRECOND_ELSE_NULL(0 < length);
 
-    Scalar *key = make_scalar_node(value, length, SCALAR_STRING);
-    Node *result = hashtable_get(self->values, key);
-    node_free(key);
+    Scalar key;
+    scalar_init_probe(&key, value, length);
 
-    return result;
+    return hashtable_get(self->values, &key);
 }
 
 bool mapping_contains(const Mapping *self, uint8_t *value, size_t length)
@@ -128,11 +154,17 @@ bool mapping_contains(const Mapping *self, uint8_t *value, size_t length)
     PRECOND_NONNULL_ELSE_FALSE(self, value);
     PRECOND_ELSE_FALSE(0 < length);
 
-    Scalar *key = make_scalar_node(value, length, SCALAR_STRING);
-    bool result = hashtable_contains(self->values, key);
-    node_free(key);
+    Scalar key;
+    scalar_init_probe(&key, value, length);
 
-    return result;
+    return hashtable_contains(self->values, &key);
+}
+
+Node *mapping_get_key(const Mapping *self, const Scalar *key)
+{
+    PRECOND_NONNULL_ELSE_NULL(self, key);
+
+    return hashtable_get(self->values, key);
 }
 
 static bool mapping_iterator_adpater(void *key, void *value, void *context)
@@ -153,7 +185,7 @@ bool mapping_put(Mapping *map, uint8_t *key_name, size_t length, Node *value)
 {
     PRECOND_NONNULL_ELSE_FALSE(map, key_name, value);
 
-    Scalar *key = make_scalar_node(key_name, length, SCALAR_STRING);
+    Scalar *key = make_scalar_node_in(map->base.arena, key_name, length, SCALAR_STRING);
     if(NULL == key)
     {
         return false;
@@ -166,3 +198,17 @@ bool mapping_put(Mapping *map, uint8_t *key_name, size_t length, Node *value)
     }
     return 0 == errno;
 }
+
+bool mapping_put_key(Mapping *map, Scalar *key, Node *value)
+{
+    PRECOND_NONNULL_ELSE_FALSE(map, key, value);
+    PRECOND_ELSE_FALSE(key->interned, key->base.arena == map->base.arena);
+
+    errno = 0;
+    hashtable_put(map->values, key, value);
+    if(0 == errno)
+    {
+        value->parent = node(map);
+    }
+    return 0 == errno;
+}
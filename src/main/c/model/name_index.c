@@ -0,0 +1,267 @@
+/*
+ * 金棒 (kanabō)
+ * Copyright (c) 2012 Kevin Birch <kmb@pobox.com>.  All rights reserved.
+ *
+ * 金棒 is a tool to bludgeon YAML and JSON files from the shell: the strong
+ * made stronger.
+ *
+ * For more information, consult the README file in the project root.
+ *
+ * Distributed under an [MIT-style][license] license.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal with
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * - Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimers.
+ * - Redistributions in binary form must reproduce the above copyright notice, this
+ *   list of conditions and the following disclaimers in the documentation and/or
+ *   other materials provided with the distribution.
+ * - Neither the names of the copyright holders, nor the names of the authors, nor
+ *   the names of other contributors may be used to endorse or promote products
+ *   derived from this Software without specific prior written permission.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE CONTRIBUTORS
+ * OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS WITH THE SOFTWARE.
+ *
+ * [license]: http://www.opensource.org/licenses/ncsa
+ */
+
+
+#include <errno.h>
+
+#include "model.h"
+#include "model/private.h"
+#include "conditions.h"
+
+
+/*
+ * The index is built with two walks of the model: the first numbers the nodes
+ * and counts the holders of each symbol, which gives every symbol its run of
+ * one shared array, and the second fills the runs in.  Both walks visit nodes
+ * in the order that a recursive step does, so each run is in document order.
+ */
+struct indexer
+{
+    uint32_t  next;
+    Mapping **holders;
+};
+
+typedef struct indexer indexer;
+
+struct holder
+{
+    indexer *index;
+    Mapping *mapping;
+};
+
+static bool index_node(indexer *self, Node *each);
+
+static bool index_sequence_iterator(Node *each, void *context)
+{
+    return index_node((indexer *)context, each);
+}
+
+static bool index_key_iterator(Node *key, Node *value __attribute__((unused)), void *context)
+{
+    struct holder *current = (struct holder *)context;
+    if(!is_scalar(key) || !scalar(key)->interned)
+    {
+        return false;
+    }
+    Symbol *symbol = (Symbol *)key;
+    if(NULL != current->index->holders)
+    {
+        current->index->holders[symbol->first + symbol->count] = current->mapping;
+    }
+    symbol->count++;
+
+    return true;
+}
+
+static bool index_value_iterator(Node *key __attribute__((unused)), Node *value, void *context)
+{
+    return index_node((indexer *)context, value);
+}
+
+static bool index_node(indexer *self, Node *each)
+{
+    if(UINT32_MAX == self->next)
+    {
+        return false;
+    }
+    each->position = self->next++;
+
+    switch(node_kind(each))
+    {
+        case DOCUMENT:
+            return NULL == document(each)->root || index_node(self, document(each)->root);
+        case SCALAR:
+            return true;
+        case SEQUENCE:
+            if(!sequence_iterate(sequence(each), index_sequence_iterator, self))
+            {
+                return false;
+            }
+            sequence(each)->extent = self->next - each->position - 1;
+            return true;
+        case MAPPING:
+            // N.B. - the mapping's keys are recorded before anything below it, keeping every run in document order
+            if(!mapping_iterate(mapping(each), index_key_iterator, &(struct holder){self, mapping(each)})
+               || !mapping_iterate(mapping(each), index_value_iterator, self))
+            {
+                return false;
+            }
+            mapping(each)->extent = self->next - each->position - 1;
+            return true;
+        case ALIAS:
+            // N.B. - the nodes below an alias's target aren't below the alias, so they can't be one run
+            return false;
+    }
+    return false;
+}
+
+static bool index_documents(DocumentModel *self, Mapping **holders)
+{
+    indexer walk = {0, holders};
+    for(size_t i = 0; i < model_size(self); i++)
+    {
+        if(!index_node(&walk, node(model_document(self, i))))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool reset_symbol_iterator(void *each, void *context __attribute__((unused)))
+{
+    Symbol *symbol = (Symbol *)each;
+    symbol->first = 0;
+    symbol->count = 0;
+
+    return true;
+}
+
+static bool place_symbol_iterator(void *each, void *context)
+{
+    Symbol *symbol = (Symbol *)each;
+    size_t *total = (size_t *)context;
+    symbol->first = *total;
+    *total += symbol->count;
+    symbol->count = 0;
+
+    return true;
+}
+
+static bool build_index(DocumentModel *self)
+{
+    if(NULL == self->symbols)
+    {
+        // N.B. - a model with mappings but no symbols has keys that weren't interned
+        self->names.holders = NULL;
+        return index_documents(self, NULL);
+    }
+
+    hashtable_iterate_keys(self->symbols, reset_symbol_iterator, NULL);
+    if(!index_documents(self, NULL))
+    {
+        return false;
+    }
+    size_t total = 0;
+    hashtable_iterate_keys(self->symbols, place_symbol_iterator, &total);
+    if(0 == total)
+    {
+        self->names.holders = NULL;
+        return true;
+    }
+    self->names.holders = arena_alloc(self->arena, total * sizeof(Mapping *));
+    if(NULL == self->names.holders)
+    {
+        return false;
+    }
+
+    return index_documents(self, self->names.holders);
+}
+
+bool model_index_names(DocumentModel *self)
+{
+    PRECOND_NONNULL_ELSE_FALSE(self);
+
+    if(NAME_INDEX_UNBUILT == self->names.state)
+    {
+        self->names.state = build_index(self) ? NAME_INDEX_READY : NAME_INDEX_UNAVAILABLE;
+    }
+    return NAME_INDEX_READY == self->names.state;
+}
+
+static uint32_t node_extent(const Node *self)
+{
+    switch(self->kind)
+    {
+        case SEQUENCE:
+            return ((const Sequence *)self)->extent;
+        case MAPPING:
+            return ((const Mapping *)self)->extent;
+        case DOCUMENT:
+        {
+            const Node *root = ((const Document *)self)->root;
+            return NULL == root ? 0 : 1 + node_extent(root);
+        }
+        case SCALAR:
+        case ALIAS:
+            break;
+    }
+    return 0;
+}
+
+bool model_find_key(const DocumentModel *self, const Node *root, const Scalar *key, mapping_iterator iterator, void *context)
+{
+    PRECOND_NONNULL_ELSE_FALSE(self, root, key, iterator);
+    if(NAME_INDEX_READY != self->names.state)
+    {
+        errno = EINVAL;
+        return false;
+    }
+    if(!key->interned)
+    {
+        // N.B. - every key in an indexed model is a symbol, so no mapping can hold any other
+        return true;
+    }
+
+    const Symbol *symbol = (const Symbol *)key;
+    Mapping **run = self->names.holders + symbol->first;
+    uint32_t from = root->position;
+    uint32_t to = from + node_extent(root);
+
+    // N.B. - each run is in document order, so the mappings below the root start at the first one not before it
+    size_t low = 0, high = symbol->count;
+    while(low < high)
+    {
+        size_t middle = low + (high - low) / 2;
+        if(run[middle]->base.position < from)
+        {
+            low = middle + 1;
+        }
+        else
+        {
+            high = middle;
+        }
+    }
+    for(size_t i = low; i < symbol->count && run[i]->base.position <= to; i++)
+    {
+        if(!iterator((Node *)key, mapping_get_key(run[i], key), context))
+        {
+            return false;
+        }
+    }
+    return true;
+}
@@ -52,6 +52,17 @@ static const char * const NODE_KINDS [] =
     "alias"
 };
 
+static const struct vtable_s * const VTABLES [] =
+{
+    &document_vtable,
+    &scalar_vtable,
+    &sequence_vtable,
+    &mapping_vtable,
+    &alias_vtable
+};
+
+#define vtable(NODE) VTABLES[(NODE)->kind]
+
 const char *node_kind_name_(const Node *self)
 {
     return NODE_KINDS[node_kind(self)];
@@ -67,30 +78,35 @@ Node *narrow(Node *instance, NodeKind kind)
     return instance;
 }
 
-void node_init_(Node *self, NodeKind kind)
+void node_init_(Node *self, NodeKind kind, Arena *arena)
 {
     if(NULL != self)
     {
-        self->tag.kind = kind;
-        self->tag.name = NULL;
-        self->anchor = NULL;
+        self->kind = kind;
+        self->properties = NULL;
+        self->arena = arena;
     }
 }
 
 static void basic_node_free(Node *value)
 {
-    free(value->tag.name);
-    free(value->anchor);
+    if(NULL != value->properties)
+    {
+        free(value->properties->tag);
+        free(value->properties->anchor);
+        free(value->properties);
+    }
     free(value);
 }
 
 void node_free_(Node *value)
 {
-    if(NULL == value)
+    if(NULL == value || NULL != value->arena)
     {
+        // N.B. - arena nodes are released with their arena
         return;
     }
-    value->vtable->free(value);
+    vtable(value)->free(value);
     basic_node_free(value);
 }
 
@@ -98,19 +114,26 @@ size_t node_size_(const Node *self)
 {
     PRECOND_NONNULL_ELSE_ZERO(self);
 
-    return self->vtable->size(self);
+    return vtable(self)->size(self);
 }
 
 NodeKind node_kind_(const Node *self)
 {
-    return self->tag.kind;
+    return self->kind;
 }
 
 uint8_t *node_name_(const Node *self)
 {
     PRECOND_NONNULL_ELSE_NULL(self);
 
-    return self->tag.name;
+    return node_tag(self);
+}
+
+uint8_t *node_anchor_(const Node *self)
+{
+    PRECOND_NONNULL_ELSE_NULL(self);
+
+    return NULL == self->properties ? NULL : self->properties->anchor;
 }
 
 Node *node_parent_(const Node *self)
@@ -119,25 +142,42 @@ Node *node_parent_(const Node *self)
     return self->parent;
 }
 
+static uint8_t *copy_property(Node *self, const uint8_t *value, size_t length)
+{
+    if(NULL == self->properties)
+    {
+        self->properties = node_allocate(self->arena, sizeof(struct node_properties_s));
+        if(NULL == self->properties)
+        {
+            return NULL;
+        }
+    }
+    uint8_t *result = (uint8_t *)node_allocate(self->arena, length + 1);
+    if(NULL != result)
+    {
+        memcpy(result, value, length);
+        result[length] = '\0';
+    }
+    return result;
+}
+
 void node_set_tag_(Node *self, const uint8_t *value, size_t length)
 {
     PRECOND_NONNULL_ELSE_VOID(self, value);
-    self->tag.name = (uint8_t *)calloc(1, length + 1);
-    if(NULL != self->tag.name)
+    uint8_t *tag = copy_property(self, value, length);
+    if(NULL != tag)
     {
-        memcpy(self->tag.name, value, length);
-        self->tag.name[length] = '\0';
+        self->properties->tag = tag;
     }
 }
 
 void node_set_anchor_(Node *self, const uint8_t *value, size_t length)
 {
     PRECOND_NONNULL_ELSE_VOID(self, value);
-    self->anchor = (uint8_t *)calloc(1, length + 1);
-    if(NULL != self->anchor)
+    uint8_t *anchor = copy_property(self, value, length);
+    if(NULL != anchor)
     {
-        memcpy(self->anchor, value, length);
-        self->anchor[length] = '\0';
+        self->properties->anchor = anchor;
     }
 }
 
@@ -182,6 +222,6 @@ bool node_equals_(const Node *one, const Node *two)
     {
         return false;
     }
-    return one->vtable->equals(one, two);
+    return vtable(one)->equals(one, two);
 }
 
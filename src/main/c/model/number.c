@@ -0,0 +1,227 @@
+/*
+ * 金棒 (kanabō)
+ * Copyright (c) 2012 Kevin Birch <kmb@pobox.com>.  All rights reserved.
+ *
+ * 金棒 is a tool to bludgeon YAML and JSON files from the shell: the strong
+ * made stronger.
+ *
+ * For more information, consult the README file in the project root.
+ *
+ * Distributed under an [MIT-style][license] license.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal with
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * - Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimers.
+ * - Redistributions in binary form must reproduce the above copyright notice, this
+ *   list of conditions and the following disclaimers in the documentation and/or
+ *   other materials provided with the distribution.
+ * - Neither the names of the copyright holders, nor the names of the authors, nor
+ *   the names of other contributors may be used to endorse or promote products
+ *   derived from this Software without specific prior written permission.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE CONTRIBUTORS
+ * OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS WITH THE SOFTWARE.
+ *
+ * [license]: http://www.opensource.org/licenses/ncsa
+ */
+
+
+/*
+ * Numeric scalar parsing.
+ *
+ * Integers that fit in an `int64_t` are parsed exactly.  Reals take Clinger's
+ * fast path when it is exact: a decimal significand of at most 2^53 scaled by
+ * at most 10^22 is one correctly rounded multiplication or division of two
+ * exactly representable doubles.  That covers nearly every value found in
+ * practice, such as prices, coordinates and measurements.  Longer
+ * significands and larger exponents fall back to `strtod`.
+ */
+
+#include <errno.h>
+#include <math.h>
+#include <string.h>
+
+#include "model.h"
+
+
+/* the largest significand a double holds exactly */
+#define EXACT_SIGNIFICAND (UINT64_C(1) << 53)
+
+/* the most decimal digits that always fit in a uint64_t */
+#define SIGNIFICAND_DIGITS 19
+
+static const double EXACT_POWERS_OF_TEN[] =
+{
+    1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+#define EXACT_POWER_LIMIT ((int)(sizeof(EXACT_POWERS_OF_TEN) / sizeof(double)) - 1)
+
+/* the largest exponent tracked, past which every double is zero or infinite */
+#define EXPONENT_LIMIT 100000
+
+#define FALLBACK_CAPACITY 64
+
+static inline bool is_digit(uint8_t c)
+{
+    return '0' <= c && '9' >= c;
+}
+
+static bool fallback(const uint8_t *value, size_t length, double *result)
+{
+    // N.B. - scalar values aren't terminated, so strtod gets a copy
+    char buffer[FALLBACK_CAPACITY];
+    char *text = buffer;
+    if(sizeof(buffer) <= length)
+    {
+        text = malloc(length + 1);
+        if(NULL == text)
+        {
+            return false;
+        }
+    }
+    memcpy(text, value, length);
+    text[length] = '\0';
+
+    char *end;
+    int saved = errno;
+    *result = strtod(text, &end);
+    bool parsed = (size_t)(end - text) == length;
+    // N.B. - an out of range value is still the nearest double, zero or infinity
+    errno = saved;
+
+    if(buffer != text)
+    {
+        free(text);
+    }
+    return parsed;
+}
+
+enum scalar_number_state parse_scalar_number(const uint8_t *value, size_t length, int64_t *integer, double *real)
+{
+    if(NULL == value || 0 == length)
+    {
+        return NUMBER_INVALID;
+    }
+
+    size_t i = 0;
+    bool negative = '-' == value[0];
+    if(negative || '+' == value[0])
+    {
+        i++;
+    }
+
+    uint64_t significand = 0;
+    size_t digits = 0;
+    long exponent = 0;
+    bool truncated = false;
+    bool fraction = false;
+    size_t start = i;
+    for(; i < length; i++)
+    {
+        uint8_t c = value[i];
+        if(is_digit(c))
+        {
+            if(0 == digits && '0' == c)
+            {
+                // N.B. - leading zeros, including those after the point, aren't significant
+                exponent -= fraction ? 1 : 0;
+                continue;
+            }
+            if(SIGNIFICAND_DIGITS > digits)
+            {
+                significand = significand * 10 + (uint64_t)(c - '0');
+                digits++;
+                exponent -= fraction ? 1 : 0;
+            }
+            else
+            {
+                truncated |= '0' != c;
+                exponent += fraction ? 0 : 1;
+            }
+        }
+        else if('.' == c && !fraction)
+        {
+            fraction = true;
+        }
+        else
+        {
+            break;
+        }
+    }
+    size_t mantissa_length = i - start - (fraction ? 1 : 0);
+    if(0 == mantissa_length)
+    {
+        return NUMBER_INVALID;
+    }
+
+    bool scaled = false;
+    if(i < length && ('e' == value[i] || 'E' == value[i]))
+    {
+        scaled = true;
+        i++;
+        bool negative_exponent = i < length && '-' == value[i];
+        if(i < length && ('-' == value[i] || '+' == value[i]))
+        {
+            i++;
+        }
+        if(i == length)
+        {
+            return NUMBER_INVALID;
+        }
+        long written = 0;
+        for(; i < length && is_digit(value[i]); i++)
+        {
+            if(EXPONENT_LIMIT > written)
+            {
+                written = written * 10 + (value[i] - '0');
+            }
+        }
+        exponent += negative_exponent ? -written : written;
+    }
+    if(i != length)
+    {
+        return NUMBER_INVALID;
+    }
+
+    if(!fraction && !scaled && !truncated && 0 == exponent)
+    {
+        if(negative && significand <= (uint64_t)INT64_MAX + 1)
+        {
+            *integer = (int64_t)(0 - significand);
+            return NUMBER_INTEGER;
+        }
+        if(!negative && significand <= (uint64_t)INT64_MAX)
+        {
+            *integer = (int64_t)significand;
+            return NUMBER_INTEGER;
+        }
+    }
+
+    if(!truncated && EXACT_SIGNIFICAND >= significand &&
+       -EXACT_POWER_LIMIT <= exponent && EXACT_POWER_LIMIT >= exponent)
+    {
+        double result = (double)significand;
+        result = 0 > exponent ? result / EXACT_POWERS_OF_TEN[-exponent] : result * EXACT_POWERS_OF_TEN[exponent];
+        *real = negative ? -result : result;
+        return NUMBER_REAL;
+    }
+    if(0 == significand)
+    {
+        *real = negative ? -0.0 : 0.0;
+        return NUMBER_REAL;
+    }
+
+    return fallback(value, length, real) ? NUMBER_REAL : NUMBER_INVALID;
+}
@@ -50,7 +50,8 @@ static const char * const SCALAR_KINDS [] =
     "real",
     "timestamp",
     "boolean",
-    "null"
+    "null",
+    "unresolved"
 };
 
 const char *scalar_kind_name(const Scalar *self)
@@ -79,11 +80,15 @@ static size_t scalar_size(const Node *self)
 static void scalar_free(Node *value)
 {
     Scalar *self = (Scalar *)value;
-    free(self->value);
-    self->value = NULL;
+    if(!self->borrowed && !self->inlined)
+    {
+        free(self->storage.value);
+    }
+    self->storage.value = NULL;
+    self->inlined = false;
 }
 
-static const struct vtable_s scalar_vtable = 
+const struct vtable_s scalar_vtable = 
 {
     scalar_free,
     scalar_size,
@@ -92,42 +97,180 @@ static const struct vtable_s scalar_vtable =
 
 Scalar *make_scalar_node(const uint8_t *value, size_t length, ScalarKind kind)
 {
-    if(NULL == value && 0 != length)
+    return make_scalar_node_in(NULL, value, length, kind);
+}
+
+static Scalar *scalar_make(Arena *arena, size_t size, const uint8_t *value, size_t length, ScalarKind kind)
+{
+    if((NULL == value && 0 != length) || SCALAR_MAX_LENGTH < length)
     {
         errno = EINVAL;
         return NULL;
     }
 
-    Scalar *result = calloc(1, sizeof(Scalar));
+    Scalar *result = node_allocate(arena, size);
     if(NULL != result)
     {
-        node_init((Node *)result, SCALAR);
-        result->length = length;
-        result->kind = kind;
-        result->value = (uint8_t *)calloc(1, length);
-        if(NULL == result->value)
+        node_init((Node *)result, SCALAR, arena);
+        result->length = (uint32_t)length;
+        result->kind = (uint8_t)kind;
+        // N.B. - most values are short enough to keep in the node, which also keeps empty values from being NULL
+        result->inlined = SCALAR_INLINE_CAPACITY >= length;
+        if(!result->inlined)
+        {
+            result->storage.value = (uint8_t *)node_allocate(arena, length);
+            if(NULL == result->storage.value)
+            {
+                node_release(arena, result);
+                result = NULL;
+                return NULL;
+            }
+        }
+        if(0 != length)
         {
-            free(result);
-            result = NULL;
-            return NULL;
+            memcpy(scalar_bytes(result), value, length);
         }
-        memcpy(result->value, value, length);
-        result->base.vtable = &scalar_vtable;
     }
 
     return result;
 }
 
+Scalar *make_scalar_node_in(Arena *arena, const uint8_t *value, size_t length, ScalarKind kind)
+{
+    return scalar_make(arena, sizeof(Scalar), value, length, kind);
+}
+
+Symbol *make_symbol_in(Arena *arena, const uint8_t *value, size_t length, hashcode hash)
+{
+    Symbol *result = (Symbol *)scalar_make(arena, sizeof(Symbol), value, length, SCALAR_STRING);
+    if(NULL != result)
+    {
+        result->scalar.interned = true;
+        result->hash = hash;
+    }
+
+    return result;
+}
+
+Scalar *make_borrowed_scalar_node(uint8_t *value, size_t length, ScalarKind kind)
+{
+    return make_borrowed_scalar_node_in(NULL, value, length, kind);
+}
+
+Scalar *make_borrowed_scalar_node_in(Arena *arena, uint8_t *value, size_t length, ScalarKind kind)
+{
+    PRECOND_NONNULL_ELSE_NULL(value);
+    if(SCALAR_MAX_LENGTH < length)
+    {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    Scalar *result = node_allocate(arena, sizeof(Scalar));
+    if(NULL != result)
+    {
+        node_init((Node *)result, SCALAR, arena);
+        result->length = (uint32_t)length;
+        result->kind = (uint8_t)kind;
+        result->borrowed = true;
+        result->storage.value = value;
+    }
+
+    return result;
+}
+
+void scalar_init_probe(Scalar *self, uint8_t *value, size_t length)
+{
+    memset(self, 0, sizeof(Scalar));
+    node_init((Node *)self, SCALAR, NULL);
+    self->length = (uint32_t)length;
+    self->kind = SCALAR_STRING;
+    self->borrowed = true;
+    self->storage.value = value;
+}
+
 uint8_t *scalar_value(const Scalar *self)
 {
     PRECOND_NONNULL_ELSE_NULL(self);
 
-    return self->value;
+    return scalar_bytes(self);
 }
 
+/*
+ * The kind of a plain scalar and the value of a numeric one are cached in the
+ * node the first time they are asked for, so the node is only logically
+ * const.  Evaluations on several threads can ask for the same node at once,
+ * through aliases or separate queries over one model, so the caches are read
+ * and written atomically.  Racing writers store the same values.
+ */
 ScalarKind scalar_kind(const Scalar *self)
 {
-    return self->kind;
+    uint8_t kind = __atomic_load_n(&self->kind, __ATOMIC_RELAXED);
+    if(SCALAR_UNRESOLVED == kind)
+    {
+        ScalarKind resolved = classify_scalar_value(scalar_bytes(self), self->length);
+        kind = (uint8_t)resolved;
+        __atomic_store_n(&((Scalar *)self)->kind, kind, __ATOMIC_RELAXED);
+    }
+    return (ScalarKind)kind;
+}
+
+static enum scalar_number_state scalar_parse(const Scalar *self)
+{
+    uint8_t parsed = __atomic_load_n(&self->parsed, __ATOMIC_ACQUIRE);
+    if(NUMBER_UNPARSED == parsed)
+    {
+        ScalarKind kind = scalar_kind(self);
+        enum scalar_number_state state = NUMBER_INVALID;
+        int64_t integer = 0;
+        double real = 0.0;
+        if(SCALAR_INTEGER == kind || SCALAR_REAL == kind)
+        {
+            state = parse_scalar_number(scalar_bytes(self), self->length, &integer, &real);
+        }
+        if(NUMBER_REAL == state)
+        {
+            memcpy(&integer, &real, sizeof(integer));
+        }
+        Scalar *cache = (Scalar *)self;
+        __atomic_store_n(&cache->number.integer, integer, __ATOMIC_RELAXED);
+        parsed = (uint8_t)state;
+        __atomic_store_n(&cache->parsed, parsed, __ATOMIC_RELEASE);
+    }
+    return (enum scalar_number_state)parsed;
+}
+
+bool scalar_integer(const Scalar *self, int64_t *result)
+{
+    PRECOND_NONNULL_ELSE_FALSE(self, result);
+
+    if(NUMBER_INTEGER != scalar_parse(self))
+    {
+        return false;
+    }
+    *result = __atomic_load_n(&self->number.integer, __ATOMIC_RELAXED);
+    return true;
+}
+
+bool scalar_number(const Scalar *self, double *result)
+{
+    PRECOND_NONNULL_ELSE_FALSE(self, result);
+
+    enum scalar_number_state state = scalar_parse(self);
+    int64_t bits = __atomic_load_n(&self->number.integer, __ATOMIC_RELAXED);
+    switch(state)
+    {
+        case NUMBER_INTEGER:
+            *result = (double)bits;
+            return true;
+        case NUMBER_REAL:
+            memcpy(result, &bits, sizeof(*result));
+            return true;
+        case NUMBER_UNPARSED:
+        case NUMBER_INVALID:
+            break;
+    }
+    return false;
 }
 
 bool scalar_boolean_is_true(const Scalar *self)
@@ -72,7 +72,7 @@ static void sequence_free(Node *value)
     self->values = NULL;
 }
 
-static const struct vtable_s sequence_vtable = 
+const struct vtable_s sequence_vtable = 
 {
     sequence_free,
     sequence_size,
@@ -81,18 +81,22 @@ static const struct vtable_s sequence_vtable =
 
 Sequence *make_sequence_node(void)
 {
-    Sequence *self = calloc(1, sizeof(Sequence));
+    return make_sequence_node_in(NULL);
+}
+
+Sequence *make_sequence_node_in(Arena *arena)
+{
+    Sequence *self = node_allocate(arena, sizeof(Sequence));
     if(NULL != self)
     {
-        node_init(self, SEQUENCE);
-        self->values = make_vector();
+        node_init(self, SEQUENCE, arena);
+        self->values = NULL == arena ? make_vector() : make_vector_in(arena, 4);
         if(NULL == self->values)
         {
-            free(self);
+            node_release(arena, self);
             self = NULL;
             return NULL;
         }
-        self->base.vtable = &sequence_vtable;
     }
 
     return self;
@@ -0,0 +1,162 @@
+/*
+ * 金棒 (kanabō)
+ * Copyright (c) 2012 Kevin Birch <kmb@pobox.com>.  All rights reserved.
+ * 
+ * 金棒 is a tool to bludgeon YAML and JSON files from the shell: the strong
+ * made stronger.
+ *
+ * For more information, consult the README file in the project root.
+ *
+ * Distributed under an [MIT-style][license] license.
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal with
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * - Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimers.
+ * - Redistributions in binary form must reproduce the above copyright notice, this
+ *   list of conditions and the following disclaimers in the documentation and/or
+ *   other materials provided with the distribution.
+ * - Neither the names of the copyright holders, nor the names of the authors, nor
+ *   the names of other contributors may be used to endorse or promote products
+ *   derived from this Software without specific prior written permission.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE CONTRIBUTORS
+ * OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS WITH THE SOFTWARE.
+ *
+ * [license]: http://www.opensource.org/licenses/ncsa
+ */
+
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <errno.h>
+#include <pthread.h>
+#include <time.h>
+
+#include "reload.h"
+#include "log.h"
+#include "conditions.h"
+
+#define component "reload"
+
+/*
+ * Epoch based reclamation.  The epochs count up from one as models are
+ * published.  A reader entering records the current epoch, and zero when it
+ * leaves.  Publishing swaps the model before starting the next epoch, so a
+ * reader that records the new epoch also sees the new model, and the old
+ * model can go once every reader is either outside or in a later epoch.
+ */
+
+struct epoch_reader
+{
+    epochs              *domain;
+    _Atomic uint64_t     epoch;
+    struct epoch_reader *next;
+};
+
+struct epochs
+{
+    _Atomic uint64_t     current;
+    /** guards the list of readers, which only ever grows */
+    pthread_mutex_t      lock;
+    struct epoch_reader *readers;
+};
+
+epochs *make_epochs(void)
+{
+    epochs *self = calloc(1, sizeof(epochs));
+    if(NULL == self)
+    {
+        return NULL;
+    }
+    atomic_init(&self->current, 1);
+    pthread_mutex_init(&self->lock, NULL);
+    return self;
+}
+
+void epochs_free(epochs *self)
+{
+    if(NULL == self)
+    {
+        return;
+    }
+    for(struct epoch_reader *each = self->readers; NULL != each; each = self->readers)
+    {
+        self->readers = each->next;
+        free(each);
+    }
+    pthread_mutex_destroy(&self->lock);
+    free(self);
+}
+
+epoch_reader *epochs_join(epochs *self)
+{
+    PRECOND_NONNULL_ELSE_NULL(self);
+
+    epoch_reader *reader = calloc(1, sizeof(epoch_reader));
+    if(NULL == reader)
+    {
+        return NULL;
+    }
+    reader->domain = self;
+    atomic_init(&reader->epoch, 0);
+
+    pthread_mutex_lock(&self->lock);
+    reader->next = self->readers;
+    self->readers = reader;
+    pthread_mutex_unlock(&self->lock);
+    return reader;
+}
+
+void epoch_enter(epoch_reader *reader)
+{
+    atomic_store(&reader->epoch, atomic_load(&reader->domain->current));
+}
+
+void epoch_leave(epoch_reader *reader)
+{
+    atomic_store(&reader->epoch, 0);
+}
+
+/* wait until every reader that entered before now has left */
+static void synchronize(epochs *self)
+{
+    uint64_t started = atomic_fetch_add(&self->current, 1) + 1;
+    // N.B. - a reader only stays for one query, so polling costs less than making every reader signal on its way out
+    const struct timespec pause = {0, 100000};
+    pthread_mutex_lock(&self->lock);
+    for(struct epoch_reader *each = self->readers; NULL != each; each = each->next)
+    {
+        uint64_t epoch;
+        while(0 != (epoch = atomic_load(&each->epoch)) && started > epoch)
+        {
+            nanosleep(&pause, NULL);
+        }
+    }
+    pthread_mutex_unlock(&self->lock);
+}
+
+void model_publish(atomic_model *target, DocumentModel *model, epochs *readers)
+{
+    PRECOND_NONNULL_ELSE_VOID(target, readers);
+
+    DocumentModel *replaced = atomic_exchange(target, model);
+    if(NULL == replaced)
+    {
+        return;
+    }
+    synchronize(readers);
+    log_debug(component, "no reader is left using the replaced model, freeing it");
+    model_free(replaced);
+}
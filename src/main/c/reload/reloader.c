@@ -0,0 +1,488 @@
+/*
+ * 金棒 (kanabō)
+ * Copyright (c) 2012 Kevin Birch <kmb@pobox.com>.  All rights reserved.
+ * 
+ * 金棒 is a tool to bludgeon YAML and JSON files from the shell: the strong
+ * made stronger.
+ *
+ * For more information, consult the README file in the project root.
+ *
+ * Distributed under an [MIT-style][license] license.
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal with
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * - Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimers.
+ * - Redistributions in binary form must reproduce the above copyright notice, this
+ *   list of conditions and the following disclaimers in the documentation and/or
+ *   other materials provided with the distribution.
+ * - Neither the names of the copyright holders, nor the names of the authors, nor
+ *   the names of other contributors may be used to endorse or promote products
+ *   derived from this Software without specific prior written permission.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE CONTRIBUTORS
+ * OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS WITH THE SOFTWARE.
+ *
+ * [license]: http://www.opensource.org/licenses/ncsa
+ */
+
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#endif
+
+#include "reload.h"
+#include "log.h"
+#include "conditions.h"
+
+#define component "reload"
+
+/*
+ * The reloader's thread waits with poll on a pipe, written to whenever a
+ * reload is asked for, and on Linux on an inotify descriptor watching the
+ * directory of each watched file.  Reloads are done one at a time in the
+ * order they were asked for, so the last one asked for is the one left in
+ * place.
+ */
+
+struct job
+{
+    atomic_model                       *target;
+    char                               *path;
+    enum loader_duplicate_key_strategy  strategy;
+    enum loader_input_format            format;
+    struct job                         *next;
+};
+
+struct watch
+{
+    /** the file's own reload, with its name in the watched directory */
+    struct job  job;
+    const char *name;
+    int         descriptor;
+};
+
+struct reloader
+{
+    epochs          *readers;
+    reload_report    report;
+    void            *context;
+    pthread_t        thread;
+    bool             started;
+    int              wakeup[2];
+
+    /** guards everything below */
+    pthread_mutex_t  lock;
+    pthread_cond_t   settled;
+    struct job      *queued;
+    bool             busy;
+    bool             closing;
+    int              notify;
+    struct watch    *watches;
+    size_t           watch_count;
+};
+
+static void free_jobs(struct job *each)
+{
+    while(NULL != each)
+    {
+        struct job *next = each->next;
+        free(each->path);
+        free(each);
+        each = next;
+    }
+}
+
+static void wake(reloader *self)
+{
+    char nudge = 0;
+    // N.B. - a full pipe already holds a wake up, so a failed write loses nothing
+    ssize_t written = write(self->wakeup[1], &nudge, 1);
+    (void)written;
+}
+
+/* queue a copy of `model' unless the same reload is already queued, with the lock held */
+static bool enqueue(reloader *self, const struct job *model)
+{
+    struct job **tail = &self->queued;
+    for(; NULL != *tail; tail = &(*tail)->next)
+    {
+        if((*tail)->target == model->target && 0 == strcmp((*tail)->path, model->path))
+        {
+            return true;
+        }
+    }
+    struct job *job = calloc(1, sizeof(struct job));
+    char *path = strdup(model->path);
+    if(NULL == job || NULL == path)
+    {
+        free(job);
+        free(path);
+        errno = ENOMEM;
+        return false;
+    }
+    *job = *model;
+    job->path = path;
+    job->next = NULL;
+    *tail = job;
+    return true;
+}
+
+static void load(reloader *self, const struct job *job)
+{
+    log_debug(component, "reloading '%s'", job->path);
+    FILE *input = fopen(job->path, "r");
+    if(NULL == input)
+    {
+        self->report(job->path, strerror(errno), self->context);
+        return;
+    }
+    MaybeDocument maybe = load_file(input, job->strategy, job->format);
+    fclose(input);
+    if(NOTHING == maybe.tag)
+    {
+        self->report(job->path, maybe.nothing.message, self->context);
+        free(maybe.nothing.message);
+        return;
+    }
+    // N.B. - indexing before publishing means that no reader ever writes to the model
+    model_index_names(maybe.just);
+    model_publish(job->target, maybe.just, self->readers);
+    self->report(job->path, NULL, self->context);
+}
+
+#ifdef __linux__
+
+/* queue a reload of each watched file that has been written or replaced */
+static void notice_changes(reloader *self)
+{
+    char buffer[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+    ssize_t length;
+    while(0 < (length = read(self->notify, buffer, sizeof(buffer))))
+    {
+        for(char *cursor = buffer; cursor < buffer + length;)
+        {
+            const struct inotify_event *event = (const struct inotify_event *)(void *)cursor;
+            cursor += sizeof(struct inotify_event) + event->len;
+            bool overflowed = event->mask & IN_Q_OVERFLOW;
+            for(size_t i = 0; i < self->watch_count; i++)
+            {
+                struct watch *each = self->watches + i;
+                if(overflowed || (each->descriptor == event->wd && 0 != event->len && 0 == strcmp(each->name, event->name)))
+                {
+                    enqueue(self, &each->job);
+                }
+            }
+        }
+    }
+}
+
+static bool start_watching(reloader *self, struct watch *watch)
+{
+    if(-1 == self->notify)
+    {
+        self->notify = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        if(-1 == self->notify)
+        {
+            return false;
+        }
+    }
+    char *directory = strdup(watch->job.path);
+    if(NULL == directory)
+    {
+        errno = ENOMEM;
+        return false;
+    }
+    char *slash = strrchr(directory, '/');
+    watch->name = NULL == slash ? watch->job.path : watch->job.path + (slash - directory) + 1;
+    if(NULL == slash)
+    {
+        strcpy(directory, ".");
+    }
+    else if(slash == directory)
+    {
+        slash[1] = '\0';
+    }
+    else
+    {
+        slash[0] = '\0';
+    }
+    // N.B. - the directory is watched because a file replaced by renaming another over it is a new file
+    watch->descriptor = inotify_add_watch(self->notify, directory, IN_CLOSE_WRITE | IN_MOVED_TO | IN_ONLYDIR);
+    free(directory);
+    return -1 != watch->descriptor;
+}
+
+/*
+ * Stop watching the directory of the watch at the index, unless its
+ * replacement or another watch still watches it: inotify gives each directory
+ * one descriptor, however many of its files are watched.
+ */
+static void stop_watching(reloader *self, size_t index, int replacement)
+{
+    int descriptor = self->watches[index].descriptor;
+    if(-1 == descriptor || replacement == descriptor)
+    {
+        return;
+    }
+    for(size_t i = 0; i < self->watch_count; i++)
+    {
+        if(i != index && descriptor == self->watches[i].descriptor)
+        {
+            return;
+        }
+    }
+    inotify_rm_watch(self->notify, descriptor);
+}
+
+#else
+
+static void notice_changes(reloader *self __attribute__((unused)))
+{
+}
+
+static bool start_watching(reloader *self __attribute__((unused)), struct watch *watch __attribute__((unused)))
+{
+    errno = ENOSYS;
+    return false;
+}
+
+static void stop_watching(reloader *self __attribute__((unused)), size_t index __attribute__((unused)),
+                          int replacement __attribute__((unused)))
+{
+}
+
+#endif
+
+static void *run_reloads(void *argument)
+{
+    reloader *self = (reloader *)argument;
+    pthread_mutex_lock(&self->lock);
+    while(!self->closing)
+    {
+        struct job *job = self->queued;
+        if(NULL != job)
+        {
+            self->queued = job->next;
+            self->busy = true;
+            pthread_mutex_unlock(&self->lock);
+            job->next = NULL;
+            load(self, job);
+            free_jobs(job);
+            pthread_mutex_lock(&self->lock);
+            self->busy = false;
+            continue;
+        }
+        pthread_cond_broadcast(&self->settled);
+
+        struct pollfd waiting[2] = {{self->wakeup[0], POLLIN, 0}, {self->notify, POLLIN, 0}};
+        pthread_mutex_unlock(&self->lock);
+        int ready = poll(waiting, 2, -1);
+        if(-1 == ready && EINTR != errno)
+        {
+            log_error(component, "uh oh! unable to wait for reloads: %s", strerror(errno));
+            pthread_mutex_lock(&self->lock);
+            break;
+        }
+        char drained[64];
+        while(0 < read(self->wakeup[0], drained, sizeof(drained)))
+        {
+        }
+        pthread_mutex_lock(&self->lock);
+        if(0 < ready && (waiting[1].revents & POLLIN))
+        {
+            notice_changes(self);
+        }
+    }
+    // N.B. - nothing waiting to settle is left waiting on a thread that has gone
+    self->closing = true;
+    pthread_cond_broadcast(&self->settled);
+    pthread_mutex_unlock(&self->lock);
+    return NULL;
+}
+
+reloader *make_reloader(epochs *readers, reload_report report, void *context)
+{
+    PRECOND_NONNULL_ELSE_NULL(readers, report);
+
+    reloader *self = calloc(1, sizeof(reloader));
+    if(NULL == self)
+    {
+        return NULL;
+    }
+    self->readers = readers;
+    self->report = report;
+    self->context = context;
+    self->notify = -1;
+    pthread_mutex_init(&self->lock, NULL);
+    pthread_cond_init(&self->settled, NULL);
+
+    if(-1 == pipe(self->wakeup))
+    {
+        self->wakeup[0] = self->wakeup[1] = -1;
+        goto failed;
+    }
+    for(size_t i = 0; i < 2; i++)
+    {
+        int flags = fcntl(self->wakeup[i], F_GETFL);
+        if(-1 == flags || -1 == fcntl(self->wakeup[i], F_SETFL, flags | O_NONBLOCK))
+        {
+            goto failed;
+        }
+    }
+    int error = pthread_create(&self->thread, NULL, run_reloads, self);
+    if(0 != error)
+    {
+        errno = error;
+        goto failed;
+    }
+    self->started = true;
+    return self;
+
+  failed:
+    error = errno;
+    reloader_free(self);
+    errno = error;
+    return NULL;
+}
+
+void reloader_free(reloader *self)
+{
+    if(NULL == self)
+    {
+        return;
+    }
+    if(self->started)
+    {
+        pthread_mutex_lock(&self->lock);
+        self->closing = true;
+        pthread_mutex_unlock(&self->lock);
+        wake(self);
+        pthread_join(self->thread, NULL);
+    }
+    free_jobs(self->queued);
+    for(size_t i = 0; i < self->watch_count; i++)
+    {
+        free(self->watches[i].job.path);
+    }
+    free(self->watches);
+    for(size_t i = 0; i < 2; i++)
+    {
+        if(-1 != self->wakeup[i])
+        {
+            close(self->wakeup[i]);
+        }
+    }
+    if(-1 != self->notify)
+    {
+        close(self->notify);
+    }
+    pthread_cond_destroy(&self->settled);
+    pthread_mutex_destroy(&self->lock);
+    free(self);
+}
+
+bool reload(reloader *self, atomic_model *target, const char *path,
+            enum loader_duplicate_key_strategy strategy, enum loader_input_format format)
+{
+    PRECOND_NONNULL_ELSE_FALSE(self, target, path);
+
+    struct job job = {target, (char *)path, strategy, format, NULL};
+    pthread_mutex_lock(&self->lock);
+    bool result = enqueue(self, &job);
+    pthread_mutex_unlock(&self->lock);
+    if(result)
+    {
+        wake(self);
+    }
+    return result;
+}
+
+bool reloader_watch(reloader *self, atomic_model *target, const char *path,
+                    enum loader_duplicate_key_strategy strategy, enum loader_input_format format)
+{
+    PRECOND_NONNULL_ELSE_FALSE(self, target, path);
+
+    struct watch watch = {{target, strdup(path), strategy, format, NULL}, NULL, -1};
+    if(NULL == watch.job.path)
+    {
+        errno = ENOMEM;
+        return false;
+    }
+
+    pthread_mutex_lock(&self->lock);
+    size_t index = 0;
+    while(index < self->watch_count && target != self->watches[index].job.target)
+    {
+        index++;
+    }
+    bool replacing = index < self->watch_count;
+    bool result = start_watching(self, &watch);
+    if(result && !replacing)
+    {
+        struct watch *watches = realloc(self->watches, (self->watch_count + 1) * sizeof(struct watch));
+        if(NULL == watches)
+        {
+            errno = ENOMEM;
+            result = false;
+        }
+        else
+        {
+            self->watches = watches;
+            self->watch_count++;
+        }
+    }
+    if(result)
+    {
+        if(replacing)
+        {
+            // N.B. - the new directory is watched first, so a failure leaves the old watch in place
+            stop_watching(self, index, watch.descriptor);
+            free(self->watches[index].job.path);
+        }
+        self->watches[index] = watch;
+    }
+    else
+    {
+        free(watch.job.path);
+    }
+    int error = errno;
+    pthread_mutex_unlock(&self->lock);
+
+    // N.B. - the thread may be waiting without the inotify descriptor that was just opened
+    wake(self);
+    errno = error;
+    return result;
+}
+
+void reloader_settle(reloader *self)
+{
+    PRECOND_NONNULL_ELSE_VOID(self);
+
+    pthread_mutex_lock(&self->lock);
+    while((NULL != self->queued || self->busy) && !self->closing)
+    {
+        pthread_cond_wait(&self->settled, &self->lock);
+    }
+    pthread_mutex_unlock(&self->lock);
+}
@@ -0,0 +1,195 @@
+/*
+ * 金棒 (kanabō)
+ * Copyright (c) 2012 Kevin Birch <kmb@pobox.com>.  All rights reserved.
+ * 
+ * 金棒 is a tool to bludgeon YAML and JSON files from the shell: the strong
+ * made stronger.
+ *
+ * For more information, consult the README file in the project root.
+ *
+ * Distributed under an [MIT-style][license] license.
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal with
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * - Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimers.
+ * - Redistributions in binary form must reproduce the above copyright notice, this
+ *   list of conditions and the following disclaimers in the documentation and/or
+ *   other materials provided with the distribution.
+ * - Neither the names of the copyright holders, nor the names of the authors, nor
+ *   the names of other contributors may be used to endorse or promote products
+ *   derived from this Software without specific prior written permission.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE CONTRIBUTORS
+ * OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS WITH THE SOFTWARE.
+ *
+ * [license]: http://www.opensource.org/licenses/ncsa
+ */
+
+#ifdef __linux__
+#define _POSIX_C_SOURCE 200809L
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "server.h"
+#include "log.h"
+
+#define component "client"
+
+static int connect_to(const char *path)
+{
+    struct sockaddr_un address = {.sun_family = AF_UNIX};
+    if(sizeof(address.sun_path) <= strlen(path))
+    {
+        errno = ENAMETOOLONG;
+        return -1;
+    }
+    strcpy(address.sun_path, path);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if(-1 == fd)
+    {
+        return -1;
+    }
+    if(-1 == connect(fd, (struct sockaddr *)&address, sizeof(address)))
+    {
+        int error = errno;
+        close(fd);
+        errno = error;
+        return -1;
+    }
+    return fd;
+}
+
+static bool send_all(int fd, const char *data, size_t length)
+{
+    while(0 != length)
+    {
+        ssize_t written = write(fd, data, length);
+        if(-1 == written && EINTR == errno)
+        {
+            continue;
+        }
+        if(-1 == written)
+        {
+            return false;
+        }
+        data += written;
+        length -= (size_t)written;
+    }
+    return true;
+}
+
+static bool send_query(int fd, const query *each)
+{
+    // N.B. - the server names its models canonically, so a name is resolved here, where it is relative to
+    char *canonical = NULL == each->model ? NULL : canonical_model_name(each->model);
+    if(NULL != each->model && NULL == canonical)
+    {
+        return false;
+    }
+    const char *model = NULL == canonical ? "" : canonical;
+    int length = snprintf(NULL, 0, "%s\t%zu\t%s\t%s\t%s\n", emit_mode_name(each->emit_mode), each->limit,
+                          each->all_documents ? "all" : "first", model, each->expression);
+    char *request = malloc((size_t)length + 1);
+    if(NULL == request)
+    {
+        free(canonical);
+        return false;
+    }
+    snprintf(request, (size_t)length + 1, "%s\t%zu\t%s\t%s\t%s\n", emit_mode_name(each->emit_mode), each->limit,
+             each->all_documents ? "all" : "first", model, each->expression);
+    bool result = send_all(fd, request, (size_t)length);
+    free(request);
+    free(canonical);
+    return result;
+}
+
+/* copy the body of one response to the output or the errors, false if the connection failed */
+static bool receive_answer(FILE *responses, FILE *output, FILE *errors, bool *answered)
+{
+    char status[8];
+    size_t length = 0;
+    if(2 != fscanf(responses, "%7s %zu", status, &length) || '\n' != fgetc(responses))
+    {
+        return false;
+    }
+    *answered = 0 == strcmp("ok", status);
+    FILE *target = *answered ? output : errors;
+    char buffer[4096];
+    while(0 != length)
+    {
+        size_t count = fread(buffer, 1, length < sizeof(buffer) ? length : sizeof(buffer), responses);
+        if(0 == count)
+        {
+            return false;
+        }
+        fwrite(buffer, 1, count, target);
+        length -= count;
+    }
+    return true;
+}
+
+int query_server(const char *path, const query *queries, size_t count, bool batch, FILE *output, FILE *errors)
+{
+    int fd = connect_to(path);
+    if(-1 == fd)
+    {
+        fprintf(errors, "while connecting to '%s': %s\n", path, strerror(errno));
+        return EXIT_FAILURE;
+    }
+    FILE *responses = fdopen(fd, "r");
+    if(NULL == responses)
+    {
+        fprintf(errors, "while connecting to '%s': %s\n", path, strerror(errno));
+        close(fd);
+        return EXIT_FAILURE;
+    }
+
+    int result = EXIT_SUCCESS;
+    for(size_t i = 0; i < count; i++)
+    {
+        log_debug(component, "sending expression: \"%s\"", queries[i].expression);
+        // N.B. - a request is a line of tab separated fields, of which only the expression, at the end, may hold a tab
+        if(NULL != strchr(queries[i].expression, '\n')
+           || (NULL != queries[i].model && NULL != strpbrk(queries[i].model, "\t\n")))
+        {
+            fprintf(errors, "while querying '%s': a query can't hold a line break, nor a model name a tab\n", path);
+            result = EXIT_FAILURE;
+            break;
+        }
+        bool answered = false;
+        if(!send_query(fd, queries + i) || !receive_answer(responses, output, errors, &answered))
+        {
+            fprintf(errors, "while querying '%s': the connection was lost\n", path);
+            result = EXIT_FAILURE;
+            break;
+        }
+        if(!answered)
+        {
+            result = EXIT_FAILURE;
+        }
+        if(batch)
+        {
+            fputs("EOD\n", output);
+        }
+    }
+    fflush(output);
+    fclose(responses);
+    return result;
+}
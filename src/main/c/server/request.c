@@ -0,0 +1,242 @@
+/*
+ * 金棒 (kanabō)
+ * Copyright (c) 2012 Kevin Birch <kmb@pobox.com>.  All rights reserved.
+ * 
+ * 金棒 is a tool to bludgeon YAML and JSON files from the shell: the strong
+ * made stronger.
+ *
+ * For more information, consult the README file in the project root.
+ *
+ * Distributed under an [MIT-style][license] license.
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal with
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * - Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimers.
+ * - Redistributions in binary form must reproduce the above copyright notice, this
+ *   list of conditions and the following disclaimers in the documentation and/or
+ *   other materials provided with the distribution.
+ * - Neither the names of the copyright holders, nor the names of the authors, nor
+ *   the names of other contributors may be used to endorse or promote products
+ *   derived from this Software without specific prior written permission.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE CONTRIBUTORS
+ * OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS WITH THE SOFTWARE.
+ *
+ * [license]: http://www.opensource.org/licenses/ncsa
+ */
+
+#ifdef __linux__
+#define _GNU_SOURCE
+#endif
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdarg.h>
+#include <string.h>
+#include <errno.h>
+
+#include "server.h"
+#include "jsonpath.h"
+#include "evaluator.h"
+#include "emit.h"
+#include "log.h"
+
+#define component "server"
+
+#define REQUEST_FIELDS 5
+
+static char *frame(const char *status, const char *body, size_t length, size_t *response_length)
+{
+    int header = snprintf(NULL, 0, "%s %zu\n", status, length);
+    char *result = malloc((size_t)header + length + 1);
+    if(NULL == result)
+    {
+        return NULL;
+    }
+    snprintf(result, (size_t)header + 1, "%s %zu\n", status, length);
+    if(0 != length)
+    {
+        memcpy(result + header, body, length);
+    }
+    *response_length = (size_t)header + length;
+    return result;
+}
+
+__attribute__((__format__ (__printf__, 2, 3)))
+static char *refuse(size_t *response_length, const char *format, ...)
+{
+    va_list rest;
+    va_start(rest, format);
+    int length = vsnprintf(NULL, 0, format, rest);
+    va_end(rest);
+
+    char *message = malloc((size_t)length + 2);
+    if(NULL == message)
+    {
+        return NULL;
+    }
+    va_start(rest, format);
+    vsnprintf(message, (size_t)length + 1, format, rest);
+    va_end(rest);
+    message[length] = '\n';
+
+    log_debug(component, "refusing request: %s", message);
+    char *result = frame("error", message, (size_t)length + 1, response_length);
+    free(message);
+    return result;
+}
+
+char *canonical_model_name(const char *name)
+{
+    char *result = realpath(name, NULL);
+    return NULL == result ? strdup(name) : result;
+}
+
+static const served_model *find_model(const served_model *models, size_t count, const char *name)
+{
+    if('\0' == name[0])
+    {
+        return 0 == count ? NULL : models;
+    }
+    for(size_t i = 0; i < count; i++)
+    {
+        if(0 == strcmp(name, models[i].name))
+        {
+            return models + i;
+        }
+    }
+    return NULL;
+}
+
+static bool parse_limit(const char *value, size_t *limit)
+{
+    char *end = NULL;
+    errno = 0;
+    unsigned long long result = strtoull(value, &end, 10);
+    if(0 != errno || end == value || '\0' != *end || '-' == value[0] || SIZE_MAX < result)
+    {
+        return false;
+    }
+    *limit = (size_t)result;
+    return true;
+}
+
+static char *evaluate_request(const DocumentModel *model, const char *expression, emit_function emitter,
+                              const query *request, size_t *response_length)
+{
+    parser_context *parser = make_parser((const uint8_t *)expression, strlen(expression));
+    if(NULL == parser)
+    {
+        return refuse(response_length, "while parsing the expression '%s': %s", expression, strerror(errno));
+    }
+    jsonpath *path = parse(parser);
+    if(parser_status(parser))
+    {
+        char *message = parser_status_message(parser);
+        char *result = NULL == message ? NULL
+            : refuse(response_length, "while parsing the expression '%s': %s", expression, message);
+        free(message);
+        path_free(path);
+        parser_free(parser);
+        return result;
+    }
+    parser_free(parser);
+
+    char *output = NULL;
+    size_t length = 0;
+    FILE *stream = open_memstream(&output, &length);
+    if(NULL == stream)
+    {
+        path_free(path);
+        return NULL;
+    }
+
+    // N.B. - the server's workers already keep the processors busy, so each evaluation has one thread
+    Evaluation results = make_evaluation(model, path);
+    results.limit = request->limit;
+    results.all_documents = request->all_documents;
+    results.threads = 1;
+    emit_to(stream);
+    bool emitted = emitter(&results);
+    emit_to(NULL);
+    bool written = 0 == fclose(stream);
+
+    char *result = NULL;
+    if(!emitted && EVALUATOR_SUCCESS != results.code && ERR_EVALUATION_STOPPED != results.code)
+    {
+        result = refuse(response_length, "while evaluating the expression '%s': %s", expression, evaluator_status_message(results.code));
+    }
+    else if(!emitted || !written)
+    {
+        result = refuse(response_length, "unable to emit results");
+    }
+    else
+    {
+        result = frame("ok", output, length, response_length);
+    }
+    free(output);
+    path_free(path);
+    return result;
+}
+
+char *answer_request(const served_model *models, size_t count, const char *request, size_t length, size_t *response_length)
+{
+    char *text = malloc(length + 1);
+    if(NULL == text)
+    {
+        return NULL;
+    }
+    memcpy(text, request, length);
+    text[length] = '\0';
+
+    // N.B. - the expression is the last field, so it may hold tabs itself
+    char *fields[REQUEST_FIELDS];
+    size_t found = 0;
+    char *cursor = text;
+    for(; found < REQUEST_FIELDS - 1 && NULL != cursor; found++)
+    {
+        fields[found] = cursor;
+        cursor = strchr(cursor, '\t');
+        if(NULL != cursor)
+        {
+            *cursor++ = '\0';
+        }
+    }
+    if(NULL != cursor)
+    {
+        fields[found++] = cursor;
+    }
+
+    char *result = NULL;
+    query parsed = {NULL, NULL, BASH, 0, false};
+    const served_model *target = NULL;
+    int32_t mode = REQUEST_FIELDS == found ? parse_emit_mode(fields[0]) : -1;
+    if(REQUEST_FIELDS != found || -1 == mode || !parse_limit(fields[1], &parsed.limit)
+       || (0 != strcmp("all", fields[2]) && 0 != strcmp("first", fields[2])))
+    {
+        result = refuse(response_length, "malformed request");
+    }
+    else if(NULL == (target = find_model(models, count, fields[3])))
+    {
+        result = refuse(response_length, "no model named '%s' is served", fields[3]);
+    }
+    else
+    {
+        parsed.emit_mode = (enum emit_mode)mode;
+        parsed.all_documents = 0 == strcmp("all", fields[2]);
+        log_debug(component, "evaluating expression: \"%s\"", fields[4]);
+        result = evaluate_request(atomic_load(&target->model), fields[4], emitter_for(parsed.emit_mode), &parsed, response_length);
+    }
+    free(text);
+    return result;
+}
@@ -0,0 +1,747 @@
+/*
+ * 金棒 (kanabō)
+ * Copyright (c) 2012 Kevin Birch <kmb@pobox.com>.  All rights reserved.
+ * 
+ * 金棒 is a tool to bludgeon YAML and JSON files from the shell: the strong
+ * made stronger.
+ *
+ * For more information, consult the README file in the project root.
+ *
+ * Distributed under an [MIT-style][license] license.
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal with
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * - Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimers.
+ * - Redistributions in binary form must reproduce the above copyright notice, this
+ *   list of conditions and the following disclaimers in the documentation and/or
+ *   other materials provided with the distribution.
+ * - Neither the names of the copyright holders, nor the names of the authors, nor
+ *   the names of other contributors may be used to endorse or promote products
+ *   derived from this Software without specific prior written permission.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE CONTRIBUTORS
+ * OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS WITH THE SOFTWARE.
+ *
+ * [license]: http://www.opensource.org/licenses/ncsa
+ */
+
+#ifdef __linux__
+#define _GNU_SOURCE
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include "server.h"
+#include "log.h"
+#include "conditions.h"
+
+#define component "server"
+
+#ifdef __linux__
+
+#include <stdatomic.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+/*
+ * One thread waits on every socket with epoll, reading requests and writing
+ * responses without blocking, while a pool of workers answers the requests.
+ * A connection hands its workers one request at a time, which keeps its
+ * responses in order; a finished answer is passed back to the event loop and
+ * an eventfd wakes it to write the response.
+ *
+ * A connection closed while the loop works through a batch of events may
+ * still have an event later in the batch, so closing one only retires it, and
+ * the retired connections are freed once the whole batch is done.
+ *
+ * A client may shut down its end once it has sent its requests.  The
+ * connection is then no longer read, but stays open until every request it
+ * sent has been answered.
+ */
+
+#define MAX_EVENTS 64
+#define READ_SIZE  4096
+
+struct connection
+{
+    int                fd;
+    /** bytes read that haven't been handed to a worker yet */
+    char              *input;
+    size_t             input_length;
+    size_t             input_capacity;
+    /** the response being written, and how much of it has been */
+    char              *output;
+    size_t             output_length;
+    size_t             written;
+    /** a request of this connection is with the workers */
+    bool               answering;
+    /** the client has sent all it will, so the connection closes once the last response is written */
+    bool               read_closed;
+    /** the client is gone, so the connection goes as soon as no worker holds it */
+    bool               hung_up;
+    struct connection *previous;
+    struct connection *next;
+};
+
+struct job
+{
+    struct connection *connection;
+    char              *request;
+    size_t             length;
+    char              *response;
+    size_t             response_length;
+    struct job        *next;
+};
+
+struct worker
+{
+    server       *server;
+    epoch_reader *reader;
+    pthread_t     thread;
+};
+
+struct server
+{
+    char                *path;
+    const served_model  *models;
+    size_t               count;
+    size_t               threads;
+    struct worker       *workers;
+    size_t               started;
+    int                  listener;
+    int                  events;
+    int                  wakeup;
+    atomic_bool          stopping;
+    struct connection   *connections;
+    /** connections closed during the current batch of events, freed after it */
+    struct connection   *retired;
+
+    /** guards the jobs waiting for a worker, the finished ones and `closing' */
+    pthread_mutex_t      lock;
+    pthread_cond_t       work;
+    struct job          *waiting;
+    struct job          *waiting_tail;
+    struct job          *finished;
+    bool                 closing;
+};
+
+static void free_job(struct job *self)
+{
+    free(self->request);
+    free(self->response);
+    free(self);
+}
+
+static void free_jobs(struct job *each)
+{
+    while(NULL != each)
+    {
+        struct job *next = each->next;
+        free_job(each);
+        each = next;
+    }
+}
+
+static void wake(const server *self)
+{
+    uint64_t one = 1;
+    // N.B. - the count can only fail to grow when it is already huge, which wakes the loop just as well
+    ssize_t written = write(self->wakeup, &one, sizeof(one));
+    (void)written;
+}
+
+static struct job *next_job(server *self)
+{
+    pthread_mutex_lock(&self->lock);
+    while(NULL == self->waiting && !self->closing)
+    {
+        pthread_cond_wait(&self->work, &self->lock);
+    }
+    struct job *result = self->waiting;
+    if(NULL != result)
+    {
+        self->waiting = result->next;
+        if(NULL == self->waiting)
+        {
+            self->waiting_tail = NULL;
+        }
+        result->next = NULL;
+    }
+    pthread_mutex_unlock(&self->lock);
+    return result;
+}
+
+static void *answer_requests(void *argument)
+{
+    struct worker *worker = (struct worker *)argument;
+    server *self = worker->server;
+    struct job *each;
+    while(NULL != (each = next_job(self)))
+    {
+        if(NULL != worker->reader)
+        {
+            epoch_enter(worker->reader);
+        }
+        each->response = answer_request(self->models, self->count, each->request, each->length, &each->response_length);
+        if(NULL != worker->reader)
+        {
+            epoch_leave(worker->reader);
+        }
+        pthread_mutex_lock(&self->lock);
+        each->next = self->finished;
+        self->finished = each;
+        pthread_mutex_unlock(&self->lock);
+        wake(self);
+    }
+    return NULL;
+}
+
+static bool watch(server *self, struct connection *each)
+{
+    struct epoll_event event = {.events = 0, .data.ptr = each};
+    // N.B. - a connection with a full buffer isn't read until a worker has taken a request from it
+    if(!each->read_closed && MAX_REQUEST_LENGTH > each->input_length)
+    {
+        event.events |= EPOLLIN;
+    }
+    if(NULL != each->output)
+    {
+        event.events |= EPOLLOUT;
+    }
+    return 0 == epoll_ctl(self->events, EPOLL_CTL_MOD, each->fd, &event);
+}
+
+static void free_connection(struct connection *each)
+{
+    if(-1 != each->fd)
+    {
+        close(each->fd);
+    }
+    free(each->input);
+    free(each->output);
+    free(each);
+}
+
+static void free_connections(struct connection *each)
+{
+    while(NULL != each)
+    {
+        struct connection *next = each->next;
+        free_connection(each);
+        each = next;
+    }
+}
+
+/*
+ * Move the connection from the live list to the retired one, which is freed
+ * after the current batch of events.
+ */
+static void retire(server *self, struct connection *each)
+{
+    if(NULL != each->previous)
+    {
+        each->previous->next = each->next;
+    }
+    else
+    {
+        self->connections = each->next;
+    }
+    if(NULL != each->next)
+    {
+        each->next->previous = each->previous;
+    }
+    each->previous = NULL;
+    each->next = self->retired;
+    self->retired = each;
+}
+
+static void hang_up(server *self, struct connection *each)
+{
+    log_debug(component, "closing connection %d", each->fd);
+    epoll_ctl(self->events, EPOLL_CTL_DEL, each->fd, NULL);
+    close(each->fd);
+    each->fd = -1;
+    each->hung_up = true;
+    if(!each->answering)
+    {
+        retire(self, each);
+    }
+}
+
+/*
+ * Hand the connection's next request to the workers, if it has a whole one
+ * and none is with them already, and watch for whatever it waits on next.
+ * False if the connection had to be closed.
+ */
+static bool dispatch(server *self, struct connection *each)
+{
+    char *end = NULL == each->input ? NULL : memchr(each->input, '\n', each->input_length);
+    if(each->read_closed && !each->answering && NULL == each->output && NULL == end)
+    {
+        log_debug(component, "every request on connection %d is answered", each->fd);
+        hang_up(self, each);
+        return false;
+    }
+    if(!each->answering && NULL == each->output && NULL == end && MAX_REQUEST_LENGTH <= each->input_length)
+    {
+        log_debug(component, "request of over %d bytes on connection %d", MAX_REQUEST_LENGTH, each->fd);
+        hang_up(self, each);
+        return false;
+    }
+    if(each->answering || NULL != each->output || NULL == end)
+    {
+        if(!watch(self, each))
+        {
+            hang_up(self, each);
+            return false;
+        }
+        return true;
+    }
+
+    size_t length = (size_t)(end - each->input);
+    struct job *job = calloc(1, sizeof(struct job));
+    char *request = malloc(length + 1);
+    if(NULL == job || NULL == request)
+    {
+        free(job);
+        free(request);
+        hang_up(self, each);
+        return false;
+    }
+    memcpy(request, each->input, length);
+    request[length] = '\0';
+    each->input_length -= length + 1;
+    memmove(each->input, end + 1, each->input_length);
+    *job = (struct job){each, request, length, NULL, 0, NULL};
+    each->answering = true;
+
+    pthread_mutex_lock(&self->lock);
+    if(NULL == self->waiting_tail)
+    {
+        self->waiting = job;
+    }
+    else
+    {
+        self->waiting_tail->next = job;
+    }
+    self->waiting_tail = job;
+    pthread_cond_signal(&self->work);
+    pthread_mutex_unlock(&self->lock);
+
+    if(!watch(self, each))
+    {
+        hang_up(self, each);
+        return false;
+    }
+    return true;
+}
+
+static void write_output(server *self, struct connection *each)
+{
+    while(each->written < each->output_length)
+    {
+        ssize_t written = send(each->fd, each->output + each->written, each->output_length - each->written, MSG_NOSIGNAL);
+        if(-1 == written && EINTR == errno)
+        {
+            continue;
+        }
+        if(-1 == written && (EAGAIN == errno || EWOULDBLOCK == errno))
+        {
+            if(!watch(self, each))
+            {
+                hang_up(self, each);
+            }
+            return;
+        }
+        if(-1 == written)
+        {
+            hang_up(self, each);
+            return;
+        }
+        each->written += (size_t)written;
+    }
+    free(each->output);
+    each->output = NULL;
+    dispatch(self, each);
+}
+
+static void read_input(server *self, struct connection *each)
+{
+    if(each->input_capacity - each->input_length < READ_SIZE)
+    {
+        size_t capacity = 0 == each->input_capacity ? READ_SIZE * 2 : each->input_capacity * 2;
+        char *input = realloc(each->input, capacity);
+        if(NULL == input)
+        {
+            hang_up(self, each);
+            return;
+        }
+        each->input = input;
+        each->input_capacity = capacity;
+    }
+    ssize_t count = read(each->fd, each->input + each->input_length, each->input_capacity - each->input_length);
+    if(-1 == count && (EINTR == errno || EAGAIN == errno || EWOULDBLOCK == errno))
+    {
+        return;
+    }
+    if(-1 == count)
+    {
+        hang_up(self, each);
+        return;
+    }
+    if(0 == count)
+    {
+        // N.B. - the requests already read are still answered, see above
+        log_debug(component, "end of requests on connection %d", each->fd);
+        each->read_closed = true;
+    }
+    each->input_length += (size_t)count;
+    dispatch(self, each);
+}
+
+static void accept_connections(server *self)
+{
+    int fd;
+    while(-1 != (fd = accept4(self->listener, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC)))
+    {
+        struct connection *each = calloc(1, sizeof(struct connection));
+        struct epoll_event event = {.events = EPOLLIN, .data.ptr = each};
+        if(NULL == each || -1 == epoll_ctl(self->events, EPOLL_CTL_ADD, fd, &event))
+        {
+            free(each);
+            close(fd);
+            continue;
+        }
+        log_debug(component, "accepted connection %d", fd);
+        each->fd = fd;
+        each->next = self->connections;
+        if(NULL != self->connections)
+        {
+            self->connections->previous = each;
+        }
+        self->connections = each;
+    }
+}
+
+static void collect_responses(server *self)
+{
+    uint64_t count;
+    ssize_t drained = read(self->wakeup, &count, sizeof(count));
+    (void)drained;
+
+    pthread_mutex_lock(&self->lock);
+    struct job *each = self->finished;
+    self->finished = NULL;
+    pthread_mutex_unlock(&self->lock);
+
+    while(NULL != each)
+    {
+        struct job *next = each->next;
+        struct connection *target = each->connection;
+        target->answering = false;
+        if(target->hung_up)
+        {
+            retire(self, target);
+        }
+        else if(NULL == each->response)
+        {
+            log_error(component, "uh oh! out of memory answering a request on connection %d", target->fd);
+            hang_up(self, target);
+        }
+        else
+        {
+            target->output = each->response;
+            target->output_length = each->response_length;
+            target->written = 0;
+            each->response = NULL;
+            write_output(self, target);
+        }
+        free_job(each);
+        each = next;
+    }
+}
+
+static bool answered_at(const struct sockaddr_un *address)
+{
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if(-1 == fd)
+    {
+        return false;
+    }
+    bool result = 0 == connect(fd, (const struct sockaddr *)address, sizeof(*address));
+    close(fd);
+    return result;
+}
+
+/*
+ * Listen at the path.  A socket left there by a server that has gone away is
+ * replaced, but one that a server still answers on, or any other file, is not.
+ */
+static int listen_at(const char *path)
+{
+    struct sockaddr_un address = {.sun_family = AF_UNIX};
+    if(sizeof(address.sun_path) <= strlen(path))
+    {
+        errno = ENAMETOOLONG;
+        return -1;
+    }
+    strcpy(address.sun_path, path);
+
+    struct stat info;
+    if(0 == lstat(path, &info) && S_ISSOCK(info.st_mode))
+    {
+        if(answered_at(&address))
+        {
+            errno = EADDRINUSE;
+            return -1;
+        }
+        unlink(path);
+    }
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if(-1 == fd)
+    {
+        return -1;
+    }
+    if(-1 == bind(fd, (struct sockaddr *)&address, sizeof(address)) || -1 == listen(fd, SOMAXCONN))
+    {
+        int error = errno;
+        close(fd);
+        errno = error;
+        return -1;
+    }
+    return fd;
+}
+
+static size_t online_processors(void)
+{
+    long count = sysconf(_SC_NPROCESSORS_ONLN);
+    return 0 < count ? (size_t)count : 1;
+}
+
+server *make_server(const char *path, const served_model *models, size_t count, size_t threads, epochs *readers)
+{
+    PRECOND_NONNULL_ELSE_NULL(path, models);
+    PRECOND_ELSE_NULL(0 != count);
+
+    server *self = calloc(1, sizeof(server));
+    if(NULL == self)
+    {
+        return NULL;
+    }
+    self->listener = self->events = self->wakeup = -1;
+    self->models = models;
+    self->count = count;
+    self->threads = 0 == threads ? online_processors() : threads;
+    atomic_init(&self->stopping, false);
+    pthread_mutex_init(&self->lock, NULL);
+    pthread_cond_init(&self->work, NULL);
+
+    self->path = strdup(path);
+    self->workers = calloc(self->threads, sizeof(struct worker));
+    if(NULL == self->path || NULL == self->workers)
+    {
+        server_free(self);
+        errno = ENOMEM;
+        return NULL;
+    }
+    for(size_t i = 0; i < self->threads; i++)
+    {
+        self->workers[i].server = self;
+        if(NULL != readers && NULL == (self->workers[i].reader = epochs_join(readers)))
+        {
+            server_free(self);
+            errno = ENOMEM;
+            return NULL;
+        }
+    }
+    self->listener = listen_at(path);
+    if(-1 == self->listener)
+    {
+        int error = errno;
+        server_free(self);
+        errno = error;
+        return NULL;
+    }
+    self->events = epoll_create1(EPOLL_CLOEXEC);
+    self->wakeup = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    struct epoll_event listening = {.events = EPOLLIN, .data.ptr = &self->listener};
+    struct epoll_event waking = {.events = EPOLLIN, .data.ptr = &self->wakeup};
+    if(-1 == self->events || -1 == self->wakeup
+       || -1 == epoll_ctl(self->events, EPOLL_CTL_ADD, self->listener, &listening)
+       || -1 == epoll_ctl(self->events, EPOLL_CTL_ADD, self->wakeup, &waking))
+    {
+        int error = errno;
+        server_free(self);
+        errno = error;
+        return NULL;
+    }
+    return self;
+}
+
+static void stop_workers(server *self)
+{
+    pthread_mutex_lock(&self->lock);
+    self->closing = true;
+    pthread_cond_broadcast(&self->work);
+    pthread_mutex_unlock(&self->lock);
+    for(size_t i = 0; i < self->started; i++)
+    {
+        pthread_join(self->workers[i].thread, NULL);
+    }
+    self->started = 0;
+}
+
+bool server_run(server *self)
+{
+    PRECOND_NONNULL_ELSE_FALSE(self);
+
+    for(; self->started < self->threads; self->started++)
+    {
+        struct worker *worker = self->workers + self->started;
+        if(0 != pthread_create(&worker->thread, NULL, answer_requests, worker))
+        {
+            break;
+        }
+    }
+    if(0 == self->started)
+    {
+        log_error(component, "uh oh! unable to start any workers");
+        return false;
+    }
+    log_info(component, "answering on '%s' with %zd workers", self->path, self->started);
+
+    bool result = true;
+    struct epoll_event events[MAX_EVENTS];
+    while(!atomic_load(&self->stopping))
+    {
+        int ready = epoll_wait(self->events, events, MAX_EVENTS, -1);
+        if(-1 == ready && EINTR == errno)
+        {
+            continue;
+        }
+        if(-1 == ready)
+        {
+            log_error(component, "uh oh! unable to wait for events: %s", strerror(errno));
+            result = false;
+            break;
+        }
+        for(int i = 0; i < ready; i++)
+        {
+            void *target = events[i].data.ptr;
+            if(&self->listener != target && &self->wakeup != target && ((struct connection *)target)->hung_up)
+            {
+                // N.B. - closed earlier in this batch, so it is no longer watched
+                continue;
+            }
+            if(&self->listener == target)
+            {
+                accept_connections(self);
+            }
+            else if(&self->wakeup == target)
+            {
+                collect_responses(self);
+            }
+            else if(events[i].events & (EPOLLHUP | EPOLLERR))
+            {
+                // N.B. - a client that has closed both ways can't be answered
+                hang_up(self, (struct connection *)target);
+            }
+            else if(events[i].events & EPOLLOUT)
+            {
+                write_output(self, (struct connection *)target);
+            }
+            else
+            {
+                // N.B. - the end of the requests is found by reading, after any requests sent before it
+                read_input(self, (struct connection *)target);
+            }
+        }
+        free_connections(self->retired);
+        self->retired = NULL;
+    }
+    log_info(component, "stopping");
+    stop_workers(self);
+    return result;
+}
+
+void server_stop(server *self)
+{
+    atomic_store(&self->stopping, true);
+    wake(self);
+}
+
+void server_free(server *self)
+{
+    if(NULL == self)
+    {
+        return;
+    }
+    stop_workers(self);
+    free_jobs(self->waiting);
+    free_jobs(self->finished);
+    free_connections(self->connections);
+    free_connections(self->retired);
+    if(-1 != self->listener)
+    {
+        close(self->listener);
+        unlink(self->path);
+    }
+    if(-1 != self->events)
+    {
+        close(self->events);
+    }
+    if(-1 != self->wakeup)
+    {
+        close(self->wakeup);
+    }
+    pthread_cond_destroy(&self->work);
+    pthread_mutex_destroy(&self->lock);
+    free(self->workers);
+    free(self->path);
+    free(self);
+}
+
+#else
+
+/* the server waits on its sockets with epoll, so it is only built for Linux */
+
+server *make_server(const char *path __attribute__((unused)), const served_model *models __attribute__((unused)),
+                    size_t count __attribute__((unused)), size_t threads __attribute__((unused)),
+                    epochs *readers __attribute__((unused)))
+{
+    errno = ENOSYS;
+    return NULL;
+}
+
+bool server_run(server *self __attribute__((unused)))
+{
+    errno = ENOSYS;
+    return false;
+}
+
+void server_stop(server *self __attribute__((unused)))
+{
+}
+
+void server_free(server *self __attribute__((unused)))
+{
+}
+
+#endif
@@ -0,0 +1,479 @@
+/*
+ * 金棒 (kanabō)
+ * Copyright (c) 2012 Kevin Birch <kmb@pobox.com>.  All rights reserved.
+ * 
+ * 金棒 is a tool to bludgeon YAML and JSON files from the shell: the strong
+ * made stronger.
+ *
+ * For more information, consult the README file in the project root.
+ *
+ * Distributed under an [MIT-style][license] license.
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal with
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * - Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimers.
+ * - Redistributions in binary form must reproduce the above copyright notice, this
+ *   list of conditions and the following disclaimers in the documentation and/or
+ *   other materials provided with the distribution.
+ * - Neither the names of the copyright holders, nor the names of the authors, nor
+ *   the names of other contributors may be used to endorse or promote products
+ *   derived from this Software without specific prior written permission.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE CONTRIBUTORS
+ * OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS WITH THE SOFTWARE.
+ *
+ * [license]: http://www.opensource.org/licenses/ncsa
+ */
+
+#include <string.h>
+#include <errno.h>
+
+#include "cursor.h"
+#include "model/private.h"
+#include "conditions.h"
+
+/*
+ * Each function reads a cursor's node from the model when the cursor has no
+ * tape, and otherwise reads its record.
+ */
+
+#define NONE(TAPE) cursor_at((TAPE), TAPE_NONE)
+
+static inline bool on_tape(Cursor cursor)
+{
+    return NULL != cursor.tape;
+}
+
+static inline bool is_valid(Cursor cursor)
+{
+    return on_tape(cursor) ? cursor.index < cursor.tape->length : NULL != cursor.node;
+}
+
+#define PRECOND_VALID_ELSE(RESULT, CURSOR) ENSURE_THAT((RESULT), EINVAL, is_valid((CURSOR)))
+
+static inline const TapeRecord *record(Cursor cursor)
+{
+    return cursor.tape->records + cursor.index;
+}
+
+/* the first key from `key' on that isn't shadowed, or the end of the mapping */
+static inline size_t live_entry(const Tape *tape, size_t key, size_t end)
+{
+    while(key < end && (tape->records[key].flags & TAPE_SHADOWED))
+    {
+        key = tape->records[key + 1].next;
+    }
+    return key;
+}
+
+/* the key of the entry after that of `key' */
+static inline size_t next_entry(const Tape *tape, size_t key, size_t end)
+{
+    return live_entry(tape, tape->records[key + 1].next, end);
+}
+
+bool cursor_is_none(Cursor cursor)
+{
+    return on_tape(cursor) ? TAPE_NONE == cursor.index : NULL == cursor.node;
+}
+
+Cursor tape_document(const Tape *tape, size_t index)
+{
+    if(NULL == tape || index >= tape->document_count)
+    {
+        errno = EINVAL;
+        return NONE(tape);
+    }
+
+    return cursor_at(tape, tape->documents[index]);
+}
+
+Cursor tape_document_root(const Tape *tape, size_t index)
+{
+    Cursor document = tape_document(tape, index);
+    if(cursor_is_none(document))
+    {
+        return document;
+    }
+
+    return cursor_document_root(document);
+}
+
+NodeKind cursor_kind(Cursor cursor)
+{
+    // N.B. - a node's kind is read directly, since this is asked of every node visited
+    return on_tape(cursor) ? (NodeKind)record(cursor)->kind : cursor.node->kind;
+}
+
+size_t cursor_size(Cursor cursor)
+{
+    PRECOND_VALID_ELSE(0, cursor);
+    if(!on_tape(cursor))
+    {
+        return node_size(cursor.node);
+    }
+
+    return ALIAS == cursor_kind(cursor) ? 0 : record(cursor)->size;
+}
+
+const uint8_t *cursor_tag(Cursor cursor)
+{
+    PRECOND_VALID_ELSE(NULL, cursor);
+    if(!on_tape(cursor))
+    {
+        return node_name(cursor.node);
+    }
+    if(!(record(cursor)->flags & TAPE_TAGGED))
+    {
+        return NULL;
+    }
+
+    const Tape *tape = cursor.tape;
+    size_t low = 0, high = tape->tag_count;
+    while(low < high)
+    {
+        size_t middle = low + (high - low) / 2;
+        if(tape->tags[middle].record < cursor.index)
+        {
+            low = middle + 1;
+        }
+        else
+        {
+            high = middle;
+        }
+    }
+    return tape->pool + tape->tags[low].at;
+}
+
+Cursor cursor_document_root(Cursor document)
+{
+    PRECOND_VALID_ELSE(cursor_none_like(document), document);
+    if(DOCUMENT != cursor_kind(document))
+    {
+        return cursor_none_like(document);
+    }
+    if(!on_tape(document))
+    {
+        return cursor_of(document_root(document(document.node)));
+    }
+    if(0 == record(document)->size)
+    {
+        return NONE(document.tape);
+    }
+
+    return cursor_at(document.tape, document.index + 1);
+}
+
+const uint8_t *cursor_value(Cursor scalar)
+{
+    PRECOND_VALID_ELSE(NULL, scalar);
+    if(!on_tape(scalar))
+    {
+        return scalar_value(scalar(scalar.node));
+    }
+
+    const TapeRecord *each = record(scalar);
+    if(each->flags & TAPE_BORROWED)
+    {
+        return scalar.tape->input.data + each->at;
+    }
+    // N.B. - empty values take no room, and a tape without any other has no pool
+    return NULL == scalar.tape->pool ? (const uint8_t *)"" : scalar.tape->pool + each->at;
+}
+
+ScalarKind cursor_scalar_kind(Cursor scalar)
+{
+    return on_tape(scalar) ? (ScalarKind)record(scalar)->scalar_kind : scalar_kind(scalar(scalar.node));
+}
+
+bool cursor_boolean_is_true(Cursor scalar)
+{
+    if(!on_tape(scalar))
+    {
+        return scalar_boolean_is_true(scalar(scalar.node));
+    }
+    return 4 == cursor_size(scalar) && 0 == memcmp("true", cursor_value(scalar), 4);
+}
+
+static enum scalar_number_state cursor_parse(Cursor scalar, int64_t *integer, double *real)
+{
+    ScalarKind kind = cursor_scalar_kind(scalar);
+    if(SCALAR_INTEGER != kind && SCALAR_REAL != kind)
+    {
+        return NUMBER_INVALID;
+    }
+    return parse_scalar_number(cursor_value(scalar), cursor_size(scalar), integer, real);
+}
+
+bool cursor_integer(Cursor scalar, int64_t *result)
+{
+    PRECOND_NONNULL_ELSE_FALSE(result);
+    PRECOND_VALID_ELSE(false, scalar);
+    if(!on_tape(scalar))
+    {
+        return scalar_integer(scalar(scalar.node), result);
+    }
+
+    double real;
+    return NUMBER_INTEGER == cursor_parse(scalar, result, &real);
+}
+
+bool cursor_number(Cursor scalar, double *result)
+{
+    PRECOND_NONNULL_ELSE_FALSE(result);
+    PRECOND_VALID_ELSE(false, scalar);
+    if(!on_tape(scalar))
+    {
+        return scalar_number(scalar(scalar.node), result);
+    }
+
+    int64_t integer = 0;
+    switch(cursor_parse(scalar, &integer, result))
+    {
+        case NUMBER_INTEGER:
+            *result = (double)integer;
+            return true;
+        case NUMBER_REAL:
+            return true;
+        case NUMBER_UNPARSED:
+        case NUMBER_INVALID:
+            break;
+    }
+    return false;
+}
+
+Cursor cursor_alias_target(Cursor alias)
+{
+    PRECOND_VALID_ELSE(cursor_none_like(alias), alias);
+    if(ALIAS != cursor_kind(alias))
+    {
+        errno = EINVAL;
+        return cursor_none_like(alias);
+    }
+
+    return on_tape(alias) ? cursor_at(alias.tape, record(alias)->at) : cursor_of(alias_target(alias(alias.node)));
+}
+
+Cursor cursor_resolve(Cursor cursor)
+{
+    return ALIAS == cursor_kind(cursor) ? cursor_alias_target(cursor) : cursor;
+}
+
+Cursor cursor_sequence_get(Cursor sequence, size_t index)
+{
+    PRECOND_VALID_ELSE(cursor_none_like(sequence), sequence);
+    if(SEQUENCE != cursor_kind(sequence) || index >= cursor_size(sequence))
+    {
+        return cursor_none_like(sequence);
+    }
+    if(!on_tape(sequence))
+    {
+        return cursor_of(sequence_get(sequence(sequence.node), index));
+    }
+
+    const TapeRecord *records = sequence.tape->records;
+    size_t item = sequence.index + 1;
+    for(size_t i = 0; i < index; i++)
+    {
+        item = records[item].next;
+    }
+    return cursor_at(sequence.tape, item);
+}
+
+/* hands the nodes of a model's collection on to an iterator of cursors */
+struct node_adapter
+{
+    union
+    {
+        cursor_iterator       item;
+        cursor_entry_iterator entry;
+    } iterator;
+    void *context;
+};
+
+static bool node_item_adapter(void *each, void *context)
+{
+    struct node_adapter *adapter = (struct node_adapter *)context;
+    return adapter->iterator.item(cursor_of(each), adapter->context);
+}
+
+static bool node_entry_adapter(void *key, void *value, void *context)
+{
+    struct node_adapter *adapter = (struct node_adapter *)context;
+    return adapter->iterator.entry(cursor_of(key), cursor_of(value), adapter->context);
+}
+
+bool cursor_sequence_iterate(Cursor sequence, cursor_iterator iterator, void *context)
+{
+    PRECOND_NONNULL_ELSE_FALSE(iterator);
+    PRECOND_VALID_ELSE(false, sequence);
+    PRECOND_ELSE_FALSE(SEQUENCE == cursor_kind(sequence));
+    if(!on_tape(sequence))
+    {
+        struct node_adapter adapter = {.iterator.item=iterator, .context=context};
+        return vector_iterate(sequence(sequence.node)->values, node_item_adapter, &adapter);
+    }
+
+    const TapeRecord *records = sequence.tape->records;
+    size_t end = records[sequence.index].next;
+    for(size_t item = sequence.index + 1; item < end; item = records[item].next)
+    {
+        if(!iterator(cursor_at(sequence.tape, item), context))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+static Cursor find_entry(Cursor mapping, const uint8_t *key, size_t length)
+{
+    const Tape *tape = mapping.tape;
+    size_t end = tape->records[mapping.index].next;
+    for(size_t each = live_entry(tape, mapping.index + 1, end); each < end; each = next_entry(tape, each, end))
+    {
+        Cursor candidate = cursor_at(tape, each);
+        if(length == record(candidate)->size && 0 == memcmp(key, cursor_value(candidate), length))
+        {
+            return cursor_at(tape, tape->records[each].next);
+        }
+    }
+    return NONE(tape);
+}
+
+Cursor cursor_mapping_get(Cursor mapping, const uint8_t *key, size_t length)
+{
+    if(NULL == key || !is_valid(mapping))
+    {
+        errno = EINVAL;
+        return cursor_none_like(mapping);
+    }
+    if(MAPPING != cursor_kind(mapping))
+    {
+        return cursor_none_like(mapping);
+    }
+
+    return on_tape(mapping) ? find_entry(mapping, key, length) : cursor_of(mapping_get(mapping(mapping.node), (uint8_t *)key, length));
+}
+
+Cursor cursor_mapping_get_key(Cursor mapping, const Scalar *key)
+{
+    if(NULL == key || !is_valid(mapping))
+    {
+        errno = EINVAL;
+        return cursor_none_like(mapping);
+    }
+    if(MAPPING != cursor_kind(mapping))
+    {
+        return cursor_none_like(mapping);
+    }
+
+    return on_tape(mapping) ? find_entry(mapping, scalar_bytes(key), key->length) : cursor_of(mapping_get_key(mapping(mapping.node), key));
+}
+
+bool cursor_mapping_iterate(Cursor mapping, cursor_entry_iterator iterator, void *context)
+{
+    PRECOND_NONNULL_ELSE_FALSE(iterator);
+    PRECOND_VALID_ELSE(false, mapping);
+    PRECOND_ELSE_FALSE(MAPPING == cursor_kind(mapping));
+    if(!on_tape(mapping))
+    {
+        struct node_adapter adapter = {.iterator.entry=iterator, .context=context};
+        return hashtable_iterate(mapping(mapping.node)->values, node_entry_adapter, &adapter);
+    }
+
+    const Tape *tape = mapping.tape;
+    size_t end = tape->records[mapping.index].next;
+    for(size_t each = live_entry(tape, mapping.index + 1, end); each < end; each = next_entry(tape, each, end))
+    {
+        if(!iterator(cursor_at(tape, each), cursor_at(tape, tape->records[each].next), context))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool tag_equals(const uint8_t *one, const uint8_t *two)
+{
+    if(NULL == one || NULL == two)
+    {
+        return one == two;
+    }
+    // N.B. - as with nodes, a tag equals any tag it is a prefix of
+    size_t n1 = strlen((const char *)one);
+    size_t n2 = strlen((const char *)two);
+    return 0 == memcmp(one, two, n1 > n2 ? n2 : n1);
+}
+
+static bool sequence_equals(Cursor one, Cursor two)
+{
+    const TapeRecord *records1 = one.tape->records;
+    const TapeRecord *records2 = two.tape->records;
+    size_t end = records1[one.index].next;
+    for(size_t x = one.index + 1, y = two.index + 1; x < end; x = records1[x].next, y = records2[y].next)
+    {
+        if(!cursor_equals(cursor_at(one.tape, x), cursor_at(two.tape, y)))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool contains_entry(Cursor key, Cursor value, void *context)
+{
+    Cursor other = *(Cursor *)context;
+    Cursor found = cursor_mapping_get(other, cursor_value(key), cursor_size(key));
+    return !cursor_is_none(found) && cursor_equals(value, found);
+}
+
+bool cursor_equals(Cursor one, Cursor two)
+{
+    if(cursor_is_none(one) || cursor_is_none(two))
+    {
+        return cursor_is_none(one) && cursor_is_none(two);
+    }
+    if(!on_tape(one) || !on_tape(two))
+    {
+        // N.B. - a model's node is never equal to a tape's record, as two models' nodes never are
+        return !on_tape(one) && !on_tape(two) && node_equals(one.node, two.node);
+    }
+    if(one.tape == two.tape && one.index == two.index)
+    {
+        return true;
+    }
+    if(cursor_kind(one) != cursor_kind(two) || !tag_equals(cursor_tag(one), cursor_tag(two)))
+    {
+        return false;
+    }
+    if(cursor_size(one) != cursor_size(two))
+    {
+        return false;
+    }
+
+    switch(cursor_kind(one))
+    {
+        case DOCUMENT:
+            return cursor_equals(cursor_document_root(one), cursor_document_root(two));
+        case SCALAR:
+            return 0 == memcmp(cursor_value(one), cursor_value(two), cursor_size(one));
+        case SEQUENCE:
+            return sequence_equals(one, two);
+        case MAPPING:
+            return cursor_mapping_iterate(one, contains_entry, &two);
+        case ALIAS:
+            return cursor_equals(cursor_alias_target(one), cursor_alias_target(two));
+    }
+    return false;
+}
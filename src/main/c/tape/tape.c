@@ -0,0 +1,263 @@
+/*
+ * 金棒 (kanabō)
+ * Copyright (c) 2012 Kevin Birch <kmb@pobox.com>.  All rights reserved.
+ * 
+ * 金棒 is a tool to bludgeon YAML and JSON files from the shell: the strong
+ * made stronger.
+ *
+ * For more information, consult the README file in the project root.
+ *
+ * Distributed under an [MIT-style][license] license.
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal with
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * - Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimers.
+ * - Redistributions in binary form must reproduce the above copyright notice, this
+ *   list of conditions and the following disclaimers in the documentation and/or
+ *   other materials provided with the distribution.
+ * - Neither the names of the copyright holders, nor the names of the authors, nor
+ *   the names of other contributors may be used to endorse or promote products
+ *   derived from this Software without specific prior written permission.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE CONTRIBUTORS
+ * OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS WITH THE SOFTWARE.
+ *
+ * [license]: http://www.opensource.org/licenses/ncsa
+ */
+
+#include <string.h>
+#include <errno.h>
+#include <sys/mman.h>
+
+#include "tape.h"
+#include "conditions.h"
+
+
+#define INITIAL_RECORDS 256
+#define INITIAL_POOL 4096
+
+/*
+ * The array with room for at least `needed' elements of `width' bytes, its
+ * capacity doubled as often as it takes so that appending stays amortized
+ * constant time, or NULL when it can't grow, leaving it as it was.
+ */
+static void *reserve(void *array, size_t *capacity, size_t needed, size_t width, size_t initial)
+{
+    if(needed <= *capacity)
+    {
+        return array;
+    }
+    if(TAPE_MAX_LENGTH < needed)
+    {
+        errno = ENOMEM;
+        return NULL;
+    }
+    size_t size = 0 == *capacity ? initial : *capacity;
+    while(size < needed)
+    {
+        size *= 2;
+    }
+    size = TAPE_MAX_LENGTH < size ? TAPE_MAX_LENGTH : size;
+    void *larger = realloc(array, size * width);
+    if(NULL != larger)
+    {
+        *capacity = size;
+    }
+    return larger;
+}
+
+static void *shrink(void *array, size_t *capacity, size_t length, size_t width)
+{
+    if(0 == length || length == *capacity)
+    {
+        return array;
+    }
+    void *smaller = realloc(array, length * width);
+    if(NULL == smaller)
+    {
+        return array;
+    }
+    *capacity = length;
+    return smaller;
+}
+
+Tape *make_tape(void)
+{
+    Tape *result = calloc(1, sizeof(Tape));
+    if(NULL == result)
+    {
+        return NULL;
+    }
+    result->records = reserve(NULL, &result->capacity.records, 1, sizeof(TapeRecord), INITIAL_RECORDS);
+    if(NULL == result->records)
+    {
+        free(result);
+        return NULL;
+    }
+
+    return result;
+}
+
+void tape_free(Tape *self)
+{
+    if(NULL == self)
+    {
+        return;
+    }
+    free(self->records);
+    free(self->documents);
+    free(self->pool);
+    free(self->tags);
+    if(NULL != self->input.data)
+    {
+        munmap(self->input.data, self->input.length);
+    }
+    free(self);
+}
+
+bool tape_append(Tape *self, NodeKind kind, size_t *index)
+{
+    PRECOND_NONNULL_ELSE_FALSE(self, index);
+
+    TapeRecord *records = reserve(self->records, &self->capacity.records, self->length + 1, sizeof(TapeRecord), INITIAL_RECORDS);
+    if(NULL == records)
+    {
+        return false;
+    }
+    self->records = records;
+    *index = self->length++;
+    self->records[*index] = (TapeRecord){.kind=(uint8_t)kind, .next=(uint32_t)self->length};
+    return true;
+}
+
+static bool pool_add(Tape *self, const uint8_t *value, size_t length, bool terminated, uint32_t *at)
+{
+    size_t needed = self->pool_length + length + (terminated ? 1 : 0);
+    uint8_t *pool = reserve(self->pool, &self->capacity.pool, needed, 1, INITIAL_POOL);
+    if(NULL == pool)
+    {
+        return false;
+    }
+    self->pool = pool;
+    *at = (uint32_t)self->pool_length;
+    memcpy(self->pool + self->pool_length, value, length);
+    if(terminated)
+    {
+        self->pool[self->pool_length + length] = '\0';
+    }
+    self->pool_length = needed;
+    return true;
+}
+
+bool tape_set_value(Tape *self, size_t index, const uint8_t *value, size_t length)
+{
+    PRECOND_NONNULL_ELSE_FALSE(self, value);
+    PRECOND_ELSE_FALSE(index < self->length);
+
+    TapeRecord *record = self->records + index;
+    if(!pool_add(self, value, length, false, &record->at))
+    {
+        return false;
+    }
+    record->size = (uint32_t)length;
+    return true;
+}
+
+bool tape_set_borrowed_value(Tape *self, size_t index, size_t offset, size_t length)
+{
+    PRECOND_NONNULL_ELSE_FALSE(self);
+    PRECOND_ELSE_FALSE(index < self->length);
+    if(TAPE_MAX_LENGTH < offset || TAPE_MAX_LENGTH - offset < length)
+    {
+        errno = ENOMEM;
+        return false;
+    }
+
+    TapeRecord *record = self->records + index;
+    record->size = (uint32_t)length;
+    record->at = (uint32_t)offset;
+    record->flags |= TAPE_BORROWED;
+    return true;
+}
+
+bool tape_set_tag(Tape *self, size_t index, const uint8_t *tag)
+{
+    PRECOND_NONNULL_ELSE_FALSE(self, tag);
+    PRECOND_ELSE_FALSE(index < self->length, 0 == self->tag_count || self->tags[self->tag_count - 1].record < index);
+
+    struct tape_tag_s *tags = reserve(self->tags, &self->capacity.tags, self->tag_count + 1, sizeof(struct tape_tag_s), 16);
+    if(NULL == tags)
+    {
+        return false;
+    }
+    self->tags = tags;
+    struct tape_tag_s *each = self->tags + self->tag_count;
+    if(!pool_add(self, tag, strlen((const char *)tag), true, &each->at))
+    {
+        return false;
+    }
+    each->record = (uint32_t)index;
+    self->tag_count++;
+    self->records[index].flags |= TAPE_TAGGED;
+    return true;
+}
+
+bool tape_add_document(Tape *self, size_t index)
+{
+    PRECOND_NONNULL_ELSE_FALSE(self);
+    PRECOND_ELSE_FALSE(index < self->length);
+
+    uint32_t *documents = reserve(self->documents, &self->capacity.documents, self->document_count + 1, sizeof(uint32_t), 4);
+    if(NULL == documents)
+    {
+        return false;
+    }
+    self->documents = documents;
+    self->documents[self->document_count++] = (uint32_t)index;
+    return true;
+}
+
+void tape_set_input(Tape *self, uint8_t *data, size_t length)
+{
+    PRECOND_NONNULL_ELSE_VOID(self);
+
+    self->input.data = data;
+    self->input.length = length;
+}
+
+void tape_trim(Tape *self)
+{
+    PRECOND_NONNULL_ELSE_VOID(self);
+
+    self->records = shrink(self->records, &self->capacity.records, self->length, sizeof(TapeRecord));
+    self->documents = shrink(self->documents, &self->capacity.documents, self->document_count, sizeof(uint32_t));
+    self->pool = shrink(self->pool, &self->capacity.pool, self->pool_length, 1);
+    self->tags = shrink(self->tags, &self->capacity.tags, self->tag_count, sizeof(struct tape_tag_s));
+}
+
+size_t tape_size(const Tape *self)
+{
+    PRECOND_NONNULL_ELSE_ZERO(self);
+
+    return self->document_count;
+}
+
+size_t tape_footprint(const Tape *self)
+{
+    PRECOND_NONNULL_ELSE_ZERO(self);
+
+    return self->capacity.records * sizeof(TapeRecord)
+        + self->capacity.documents * sizeof(uint32_t)
+        + self->capacity.pool
+        + self->capacity.tags * sizeof(struct tape_tag_s);
+}
@@ -0,0 +1,232 @@
+/*
+ * Copyright (c) 2014 Kevin Birch <kmb@pobox.com>.  All rights reserved.
+ *
+ * Distributed under an [MIT-style][license] license.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal with
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * - Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimers.
+ * - Redistributions in binary form must reproduce the above copyright notice, this
+ *   list of conditions and the following disclaimers in the documentation and/or
+ *   other materials provided with the distribution.
+ * - Neither the names of the copyright holders, nor the names of the authors, nor
+ *   the names of other contributors may be used to endorse or promote products
+ *   derived from this Software without specific prior written permission.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE CONTRIBUTORS
+ * OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS WITH THE SOFTWARE.
+ *
+ * [license]: http://www.opensource.org/licenses/ncsa
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+
+#include "arena.h"
+
+static const size_t DEFAULT_CHUNK_SIZE = 64ul * 1024ul;
+static const size_t MAXIMUM_CHUNK_SIZE = 8ul * 1024ul * 1024ul;
+
+#define ALIGNMENT _Alignof(max_align_t)
+
+struct chunk_s
+{
+    struct chunk_s *next;
+    size_t          capacity;
+    size_t          used;
+    uint8_t        *data;
+};
+
+typedef struct chunk_s Chunk;
+
+struct arena_s
+{
+    /** the chunk allocations are currently bumped from */
+    Chunk      *head;
+    /** the capacity of the next regular chunk */
+    size_t      chunk_size;
+    ArenaStats  stats;
+};
+
+static Chunk *make_chunk(Arena *arena, size_t capacity);
+static inline size_t padding(const Chunk *chunk);
+
+Arena *make_arena(void)
+{
+    return make_arena_with_chunk_size(DEFAULT_CHUNK_SIZE);
+}
+
+Arena *make_arena_with_chunk_size(size_t chunk_size)
+{
+    if(0 == chunk_size)
+    {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    Arena *result = calloc(1, sizeof(Arena));
+    if(NULL == result)
+    {
+        return NULL;
+    }
+    result->chunk_size = chunk_size;
+
+    return result;
+}
+
+void arena_free(Arena *arena)
+{
+    if(NULL == arena)
+    {
+        return;
+    }
+
+    Chunk *chunk = arena->head;
+    while(NULL != chunk)
+    {
+        Chunk *next = chunk->next;
+        free(chunk);
+        chunk = next;
+    }
+    free(arena);
+}
+
+void *arena_alloc(Arena *arena, size_t size)
+{
+    if(NULL == arena || 0 == size)
+    {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    Chunk *chunk = arena->head;
+    size_t pad = NULL == chunk ? 0 : padding(chunk);
+    if(NULL == chunk || chunk->capacity - chunk->used < pad + size)
+    {
+        if(size > arena->chunk_size / 4)
+        {
+            // N.B. - large blocks get a chunk of their own, placed behind the head so bumping continues where it was
+            Chunk *single = make_chunk(arena, size);
+            if(NULL == single)
+            {
+                return NULL;
+            }
+            single->used = size;
+            if(NULL != chunk)
+            {
+                single->next = chunk->next;
+                chunk->next = single;
+            }
+            else
+            {
+                arena->head = single;
+            }
+            arena->stats.used += size;
+            arena->stats.allocations++;
+            return single->data;
+        }
+
+        chunk = make_chunk(arena, arena->chunk_size);
+        if(NULL == chunk)
+        {
+            return NULL;
+        }
+        chunk->next = arena->head;
+        arena->head = chunk;
+        if(arena->chunk_size < MAXIMUM_CHUNK_SIZE)
+        {
+            arena->chunk_size <<= 1;
+        }
+        pad = 0;
+    }
+
+    void *result = chunk->data + chunk->used + pad;
+    chunk->used += pad + size;
+    arena->stats.used += pad + size;
+    arena->stats.allocations++;
+
+    return result;
+}
+
+void *arena_resize(Arena *arena, void *block, size_t old_size, size_t new_size)
+{
+    if(NULL == block)
+    {
+        return arena_alloc(arena, new_size);
+    }
+    if(NULL == arena || 0 == new_size)
+    {
+        errno = EINVAL;
+        return NULL;
+    }
+    if(new_size <= old_size)
+    {
+        return block;
+    }
+
+    Chunk *chunk = arena->head;
+    size_t growth = new_size - old_size;
+    if(NULL != chunk && (uint8_t *)block + old_size == chunk->data + chunk->used &&
+       chunk->capacity - chunk->used >= growth)
+    {
+        // the most recent allocation can simply be extended, the memory beyond it is still zeroed
+        chunk->used += growth;
+        arena->stats.used += growth;
+        return block;
+    }
+
+    void *result = arena_alloc(arena, new_size);
+    if(NULL != result)
+    {
+        memcpy(result, block, old_size);
+    }
+    return result;
+}
+
+ArenaStats arena_stats(const Arena *arena)
+{
+    if(NULL == arena)
+    {
+        errno = EINVAL;
+        return (ArenaStats){0, 0, 0, 0};
+    }
+
+    return arena->stats;
+}
+
+static Chunk *make_chunk(Arena *arena, size_t capacity)
+{
+    // N.B. - calloc lets large chunks come straight from zeroed pages
+    Chunk *chunk = calloc(1, sizeof(Chunk) + ALIGNMENT + capacity);
+    if(NULL == chunk)
+    {
+        return NULL;
+    }
+    uintptr_t start = (uintptr_t)(chunk + 1);
+    chunk->data = (uint8_t *)((start + ALIGNMENT - 1) & ~(uintptr_t)(ALIGNMENT - 1));
+    chunk->capacity = capacity;
+    chunk->used = 0;
+    chunk->next = NULL;
+
+    arena->stats.chunks++;
+    arena->stats.reserved += capacity;
+
+    return chunk;
+}
+
+static inline size_t padding(const Chunk *chunk)
+{
+    return (ALIGNMENT - (chunk->used & (ALIGNMENT - 1))) & (ALIGNMENT - 1);
+}
@@ -29,7 +29,12 @@
  * [license]: http://www.opensource.org/licenses/ncsa
  */
 
+#define _POSIX_C_SOURCE 200809L
+
 #include <string.h>
+#include <stdio.h>
+#include <time.h>
+#include <unistd.h>
 
 #include "hash.h"
 
@@ -148,6 +153,167 @@ hashcode djb_string_buffer_hash(const uint8_t *key, size_t length)
     return result;
 }
 
+static const uint64_t WYHASH_SECRET[4] =
+{
+    0x2d358dccaa6c78a5ull, 0x8bb84b93962eacc9ull, 0x4b33a62ed433d4a3ull, 0x4d5a2da51de1aa47ull
+};
+
+static uint64_t process_seed = 0;
+/** the process seed premixed with the secret, as every hash starts from it */
+static uint64_t initial_state = 0;
+
+static inline uint64_t mix(uint64_t a, uint64_t b);
+static inline void multiply(uint64_t *a, uint64_t *b);
+static inline uint64_t read64(const uint8_t *p);
+static inline uint64_t read32(const uint8_t *p);
+static inline uint64_t read_tail(const uint8_t *p, size_t length);
+
+__attribute__((constructor))
+static void seed_process(void)
+{
+    uint64_t seed = 0;
+    FILE *random = fopen("/dev/urandom", "rb");
+    if(NULL != random)
+    {
+        if(1 != fread(&seed, sizeof(seed), 1, random))
+        {
+            seed = 0;
+        }
+        fclose(random);
+    }
+    if(0 == seed)
+    {
+        // N.B. - no entropy source, so fall back to what differs from run to run
+        struct timespec now;
+        clock_gettime(CLOCK_REALTIME, &now);
+        seed = mix((uint64_t)now.tv_sec ^ WYHASH_SECRET[0], (uint64_t)now.tv_nsec ^ WYHASH_SECRET[1]);
+        pid_t pid = getpid();
+        seed = mix(seed ^ (uint64_t)pid, (uint64_t)(uintptr_t)&now);
+    }
+    hash_set_seed(seed);
+}
+
+uint64_t hash_seed(void)
+{
+    return process_seed;
+}
+
+void hash_set_seed(uint64_t seed)
+{
+    process_seed = seed;
+    initial_state = seed ^ mix(seed ^ WYHASH_SECRET[0], WYHASH_SECRET[1]);
+}
+
+static inline void multiply(uint64_t *a, uint64_t *b)
+{
+#ifdef __SIZEOF_INT128__
+    unsigned __int128 product = (unsigned __int128)*a * *b;
+    *a = (uint64_t)product;
+    *b = (uint64_t)(product >> 64);
+#else
+    uint64_t ha = *a >> 32, hb = *b >> 32, la = (uint32_t)*a, lb = (uint32_t)*b;
+    uint64_t rh = ha * hb, rm0 = ha * lb, rm1 = hb * la, rl = la * lb;
+    uint64_t t = rl + (rm0 << 32);
+    uint64_t carry = t < rl;
+    uint64_t lo = t + (rm1 << 32);
+    carry += lo < t;
+    uint64_t hi = rh + (rm0 >> 32) + (rm1 >> 32) + carry;
+    *a = lo;
+    *b = hi;
+#endif
+}
+
+static inline uint64_t mix(uint64_t a, uint64_t b)
+{
+    multiply(&a, &b);
+    return a ^ b;
+}
+
+// N.B. - keys are read in host byte order, the hash codes never leave the process
+static inline uint64_t read64(const uint8_t *p)
+{
+    uint64_t result;
+    memcpy(&result, p, sizeof(result));
+    return result;
+}
+
+static inline uint64_t read32(const uint8_t *p)
+{
+    uint32_t result;
+    memcpy(&result, p, sizeof(result));
+    return result;
+}
+
+static inline uint64_t read_tail(const uint8_t *p, size_t length)
+{
+    return ((uint64_t)p[0] << 16) | ((uint64_t)p[length >> 1] << 8) | p[length - 1];
+}
+
+hashcode wyhash_string_hash(const void *key)
+{
+    uint8_t *string = (uint8_t *)key;
+    size_t length = strlen((char *)string);
+    return wyhash_string_buffer_hash(string, length);
+}
+
+hashcode wyhash_string_buffer_hash(const uint8_t *key, size_t length)
+{
+    const uint8_t *p = key;
+    uint64_t seed = initial_state;
+    uint64_t a, b;
+
+    if(16 >= length)
+    {
+        if(4 <= length)
+        {
+            // N.B. - two overlapping pairs of 32 bit reads cover every length from 4 to 16
+            size_t middle = (length >> 3) << 2;
+            a = (read32(p) << 32) | read32(p + middle);
+            b = (read32(p + length - 4) << 32) | read32(p + length - 4 - middle);
+        }
+        else if(0 < length)
+        {
+            a = read_tail(p, length);
+            b = 0;
+        }
+        else
+        {
+            a = b = 0;
+        }
+    }
+    else
+    {
+        size_t remaining = length;
+        if(48 < remaining)
+        {
+            uint64_t see1 = seed, see2 = seed;
+            do
+            {
+                seed = mix(read64(p) ^ WYHASH_SECRET[1], read64(p + 8) ^ seed);
+                see1 = mix(read64(p + 16) ^ WYHASH_SECRET[2], read64(p + 24) ^ see1);
+                see2 = mix(read64(p + 32) ^ WYHASH_SECRET[3], read64(p + 40) ^ see2);
+                p += 48;
+                remaining -= 48;
+            }
+            while(48 < remaining);
+            seed ^= see1 ^ see2;
+        }
+        while(16 < remaining)
+        {
+            seed = mix(read64(p) ^ WYHASH_SECRET[1], read64(p + 8) ^ seed);
+            p += 16;
+            remaining -= 16;
+        }
+        a = read64(p + remaining - 16);
+        b = read64(p + remaining - 8);
+    }
+
+    a ^= WYHASH_SECRET[1];
+    b ^= seed;
+    multiply(&a, &b);
+    return (hashcode)mix(a ^ WYHASH_SECRET[0] ^ length, b ^ WYHASH_SECRET[1]);
+}
+
 bool string_comparitor(const void *key1, const void *key2)
 {
     return 0 == strcmp((char *)key1, (char *)key2);
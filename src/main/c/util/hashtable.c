@@ -29,6 +29,7 @@
  * [license]: http://www.opensource.org/licenses/ncsa
  */
 
+
 #include <tgmath.h>
 #include <stdlib.h>
 #include <stdio.h>
@@ -36,20 +37,72 @@
 #include <string.h>
 
 #include "hashtable.h"
+#include "arena.h"
+
+/*
+ * A compact, insertion ordered hashtable.  Keys and values live in a dense
+ * entries array in the order they were first put, and a separate table of
+ * slots indexes them with Robin Hood insertion and backward shift deletion.
+ * Iteration walks the entries array, so it visits keys in insertion order
+ * and touches only contiguous memory.  Each slot keeps some of the high bits
+ * of its key's mixed hash code as a tag, so probing only calls the comparison
+ * function for slots whose tags match.  Tables of up to 256 slots use two
+ * byte slots, which keeps the many small mappings in a document compact.
+ * Lookups never modify the table, so any number of readers may share one.
+ */
 
-static const float  DEFAULT_LOAD_FACTOR = 0.75f;
+// N.B. - robin hood probing keeps probe sequences short at high load, so tables can run fuller than a chained table
+static const float  DEFAULT_LOAD_FACTOR = 0.875f;
 static const size_t DEFAULT_CAPACITY = 8ul;
+// N.B. - slots address entries with 32 bits and derive their home from a 32 bit tag
+static const size_t MAXIMUM_LENGTH = (size_t)1 << 31;
+static const size_t MAXIMUM_NARROW_LENGTH = 256ul;
+static const uint32_t NARROW_TAG_MASK = 0xff000000u;
 
-static const uint8_t * const CHAINED_KEY = (uint8_t *)"CHAINED_KEY_SENTINEL";
+struct entry_s
+{
+    uint8_t  *key;
+    uint8_t  *value;
+};
+
+typedef struct entry_s Entry;
+
+/*
+ * A slot holds one more than the index of its key's entry, so empty slots
+ * are 0, and the high bits of the key's mixed hash code.
+ */
+struct narrow_slot_s
+{
+    uint8_t  tag;
+    uint8_t  entry;
+};
+
+typedef struct narrow_slot_s NarrowSlot;
+
+struct wide_slot_s
+{
+    uint32_t  tag;
+    uint32_t  entry;
+};
+
+typedef struct wide_slot_s WideSlot;
 
 struct hashtable_s
 {
     /** count of keys stored in the table */
-    size_t        occupied;
-    /** the number of keys that can be stored at the current table size */
-    size_t        capacity;
+    uint32_t      occupied;
+    /** count of entries in use, including those whose keys were removed */
+    uint32_t      used;
+    /** the number of entries that can be used at the current table size */
+    uint32_t      capacity;
+    /** the number of slots in the table, always a power of two */
+    uint32_t      length;
     /** the hashing overhead to accommodate */
     float         load_factor;
+    /** the right shift that takes a tag to an index into the slots */
+    uint8_t       shift;
+    /** are the slots narrow or wide? */
+    bool          narrow;
     /** can this hashtable be modified? */
     bool          mutable;
 
@@ -58,20 +111,14 @@ struct hashtable_s
     /** the key comparison function */
     compare_function compare;
 
-    /** the length of the entries table */
-    size_t    length;
-    /** the keys and values table */
-    uint8_t **entries;
+    /** the slots table, the entries follow it in the same block */
+    void     *slots;
+    /** the entries, in insertion order, removed entries have a NULL key */
+    Entry    *entries;
+    /** when not NULL, the tables and this struct live in this arena */
+    Arena    *arena;
 };
 
-struct chain_s
-{
-    size_t   length;
-    uint8_t *entries[];
-};
-
-typedef struct chain_s Chain;
-
 struct item_adapter_s
 {
     hashtable_item_iterator iterator;
@@ -88,27 +135,30 @@ struct equality_adapter_s
 
 typedef struct equality_adapter_s equality_adapter;
 
-static Hashtable *alloc(size_t size);
-static inline void alloc_table(Hashtable *hashtable, size_t size);
-static void init(Hashtable *hashtable, compare_function comparitor, size_t size, float load_factor, hash_function function);
+static Hashtable *alloc(Arena *arena, size_t length, float load_factor);
+static inline bool alloc_table(Hashtable *hashtable, size_t length, float load_factor);
+static inline void *allocate(const Hashtable *hashtable, size_t size);
+static inline void release(const Hashtable *hashtable, void *block);
+static void init(Hashtable *hashtable, compare_function comparitor, size_t length, float load_factor, hash_function function);
 static inline size_t normalize_capacity(size_t hint);
+static inline size_t entries_for(size_t length, float load_factor);
 
-static bool chained_contains(const Hashtable *hashtable, size_t index, const void *key);
-static void *chained_get(const Hashtable *hashtable, size_t index, const void *key);
-
-static void *add_to_chain(Hashtable *hashtable, size_t index, void *key, void *value);
-static void expand_chain(Hashtable *hashtable, size_t index, void *key, void *value);
-static void *chained_put(Hashtable *hashtable, size_t index, void *key, void *value);
-static void *chained_remove(Hashtable *hashtable, size_t index, void *key);
-
-static void rehash(Hashtable *hashtable);
+static bool find(const Hashtable *hashtable, const void *key, uint32_t tag, size_t *index);
+static void insert(Hashtable *hashtable, uint32_t tag, uint32_t entry);
+static bool rehash(Hashtable *hashtable);
 
 static bool key_item_iterator(void *key, void *value __attribute__((unused)), void *context);
 static bool value_item_iterator(void *key __attribute__((unused)), void *value, void *context);
 static bool map_into(void *key, void *value, void *context);
 static bool contains_key_value(void *key, void *value, void *context);
 
-static inline size_t hash_index(const Hashtable *hashtable, const void *key);
+static inline uint32_t tag_of(const Hashtable *hashtable, const void *key);
+static inline size_t home_index(const Hashtable *hashtable, uint32_t tag);
+static inline size_t probe_distance(const Hashtable *hashtable, uint32_t tag, size_t index);
+static inline size_t slots_size(size_t length);
+static inline uint32_t slot_tag(const Hashtable *hashtable, size_t index);
+static inline uint32_t slot_entry(const Hashtable *hashtable, size_t index);
+static inline void set_slot(Hashtable *hashtable, size_t index, uint32_t tag, uint32_t entry);
 
 Hashtable *make_hashtable(compare_function comparitor)
 {
@@ -152,13 +202,36 @@ Hashtable *make_hashtable_with_capacity_factor_function(compare_function compari
         return NULL;
     }
 
-    size_t capacity = normalize_capacity(capacity_hint);
-    Hashtable *result = alloc(capacity);
+    size_t length = normalize_capacity(capacity_hint);
+    if(MAXIMUM_LENGTH < length)
+    {
+        errno = EINVAL;
+        return NULL;
+    }
+    Hashtable *result = alloc(NULL, length, load_factor);
+    if(NULL == result)
+    {
+        return NULL;
+    }
+    init(result, comparitor, length, load_factor, function);
+
+    return result;
+}
+
+Hashtable *make_hashtable_in(Arena *arena, compare_function comparitor, hash_function function)
+{
+    if(NULL == arena || NULL == comparitor || NULL == function)
+    {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    Hashtable *result = alloc(arena, DEFAULT_CAPACITY, DEFAULT_LOAD_FACTOR);
     if(NULL == result)
     {
         return NULL;
     }
-    init(result, comparitor, capacity, load_factor, function);
+    init(result, comparitor, DEFAULT_CAPACITY, DEFAULT_LOAD_FACTOR, function);
 
     return result;
 }
@@ -178,63 +251,99 @@ static inline size_t normalize_capacity(size_t hint)
     return capacity;
 }
 
-static Hashtable *alloc(size_t capacity)
+static inline size_t entries_for(size_t length, float load_factor)
 {
-    Hashtable *result = (Hashtable *)calloc(1, sizeof(Hashtable));
+    size_t capacity = (size_t)lround((float)length * load_factor);
+    if(capacity >= length)
+    {
+        // N.B. - always leave one slot empty so that a probe for a missing key terminates
+        capacity = length - 1;
+    }
+    return capacity;
+}
+
+static Hashtable *alloc(Arena *arena, size_t length, float load_factor)
+{
+    Hashtable *result = NULL == arena ? calloc(1, sizeof(Hashtable)) : arena_alloc(arena, sizeof(Hashtable));
     if(NULL == result)
     {
         return NULL;
     }
+    result->arena = arena;
 
-    alloc_table(result, capacity);
-    if(NULL == result->entries)
+    if(!alloc_table(result, length, load_factor))
     {
-        free(result);
+        release(result, result);
         return NULL;
     }
 
     return result;
 }
 
-static inline void alloc_table(Hashtable *hashtable, size_t capacity)
+static inline bool alloc_table(Hashtable *hashtable, size_t length, float load_factor)
+{
+    size_t slots = slots_size(length);
+    uint8_t *block = allocate(hashtable, slots + entries_for(length, load_factor) * sizeof(Entry));
+    if(NULL == block)
+    {
+        return false;
+    }
+    hashtable->slots = block;
+    // N.B. - the slots table is a multiple of 16 bytes long, so the entries are aligned
+    hashtable->entries = (Entry *)(void *)(block + slots);
+    return true;
+}
+
+static inline size_t slots_size(size_t length)
 {
-    // the number of table cells allocated is 2x capacity to hold both keys and values
-    hashtable->entries = calloc(capacity << 1, sizeof(uint8_t *));
+    return length * (MAXIMUM_NARROW_LENGTH >= length ? sizeof(NarrowSlot) : sizeof(WideSlot));
+}
+
+static inline void *allocate(const Hashtable *hashtable, size_t size)
+{
+    if(NULL == hashtable->arena)
+    {
+        return calloc(1, size);
+    }
+    return arena_alloc(hashtable->arena, size);
+}
+
+static inline void release(const Hashtable *hashtable, void *block)
+{
+    // N.B. - arena storage is only released with the arena itself
+    if(NULL == hashtable->arena)
+    {
+        free(block);
+    }
 }
 
 static void init(Hashtable *hashtable,
                  compare_function comparitor,
-                 size_t capacity,
+                 size_t length,
                  float load_factor,
                  hash_function function)
 {
-    hashtable->occupied = 0ul;
-    hashtable->capacity = (size_t)lround((float)capacity * load_factor);
+    hashtable->occupied = 0u;
+    hashtable->used = 0u;
+    hashtable->capacity = (uint32_t)entries_for(length, load_factor);
     hashtable->load_factor = load_factor;
     hashtable->mutable = true;
-    hashtable->length = capacity << 1;
+    hashtable->length = (uint32_t)length;
+    hashtable->shift = (uint8_t)(32 - __builtin_ctzll((unsigned long long)length));
+    hashtable->narrow = MAXIMUM_NARROW_LENGTH >= length;
     hashtable->hash = function;
     hashtable->compare = comparitor;
 }
 
 void hashtable_free(Hashtable *hashtable)
 {
-    if(NULL == hashtable)
+    if(NULL == hashtable || NULL != hashtable->arena)
     {
         return;
     }
 
-    for(size_t i = 0; i < hashtable->length; i += 2)
-    {
-        if(CHAINED_KEY == hashtable->entries[i])
-        {
-            Chain *chain = (Chain *)hashtable->entries[i + 1];
-            free(chain);
-            hashtable->entries[i] = NULL;
-            hashtable->entries[i + 1] = NULL;
-        }
-    }
-    free(hashtable->entries);
+    free(hashtable->slots);
+    hashtable->slots = NULL;
     hashtable->entries = NULL;
     free(hashtable);
 }
@@ -281,22 +390,15 @@ bool hashtable_is_empty(const Hashtable *hashtable)
 
 void hashtable_clear(Hashtable *hashtable)
 {
-    if(NULL == hashtable || 0 == hashtable->occupied)
+    if(NULL == hashtable || 0 == hashtable->used)
     {
         return;
     }
 
-    for(size_t i = 0; i < hashtable->length; i += 2)
-    {
-        if(CHAINED_KEY == hashtable->entries[i])
-        {
-            Chain *chain = (Chain *)hashtable->entries[i + 1];
-            free(chain);
-        }
-        hashtable->entries[i] = NULL;
-        hashtable->entries[i + 1] = NULL;
-    }
+    memset(hashtable->slots, 0, slots_size(hashtable->length));
+    memset(hashtable->entries, 0, hashtable->used * sizeof(Entry));
     hashtable->occupied = 0;
+    hashtable->used = 0;
 }
 
 static bool contains_key_value(void *key, void *value, void *context)
@@ -345,39 +447,8 @@ bool hashtable_contains(const Hashtable *hashtable, const void *key)
     {
         return false;
     }
-
-    size_t index = hash_index(hashtable, key);
-    uint8_t *cur = hashtable->entries[index];
-    if(NULL != cur)
-    {
-        if(CHAINED_KEY != cur && hashtable->compare(key, cur))
-        {
-            return true;
-        }
-        if(CHAINED_KEY == cur)
-        {
-            return chained_contains(hashtable, index, key);
-        }
-    }
-
-    return false;
-}
-
-static bool chained_contains(const Hashtable *hashtable, size_t index, const void *key)
-{
-    Chain *chain = (Chain *)hashtable->entries[index + 1];
-    for(size_t i = 0; i < chain->length; i += 2)
-    {
-        if(NULL == chain->entries[i])
-        {
-            return false;
-        }
-        if(hashtable->compare(chain->entries[i], key))
-        {
-            return true;
-        }
-    }
-    return false;
+    size_t index;
+    return find(hashtable, key, tag_of(hashtable, key), &index);
 }
 
 void *hashtable_get(const Hashtable *hashtable, const void *key)
@@ -392,51 +463,35 @@ void *hashtable_get(const Hashtable *hashtable, const void *key)
     {
         return NULL;
     }
-
-    size_t index = hash_index(hashtable, key);
-    uint8_t *cur = hashtable->entries[index];
-    if(NULL != cur)
+    size_t index;
+    if(!find(hashtable, key, tag_of(hashtable, key), &index))
     {
-        if(CHAINED_KEY != cur && hashtable->compare(key, cur))
-        {
-            void *result = hashtable->entries[index + 1];
-            return result;
-        }
-        if(CHAINED_KEY == cur)
-        {
-            return chained_get(hashtable, index, key);
-        }
+        return NULL;
     }
-
-    return NULL;
+    return hashtable->entries[slot_entry(hashtable, index) - 1].value;
 }
 
-static void *chained_get(const Hashtable *hashtable, size_t index, const void *key)
+static bool find(const Hashtable *hashtable, const void *key, uint32_t tag, size_t *index)
 {
-    Chain *chain = (Chain *)hashtable->entries[index + 1];
-    for(size_t i = 0; i < chain->length; i += 2)
+    size_t mask = hashtable->length - 1;
+    size_t current = home_index(hashtable, tag);
+    for(size_t distance = 0; distance < hashtable->length; distance++)
     {
-        if(NULL == chain->entries[i])
+        uint32_t entry = slot_entry(hashtable, current);
+        uint32_t resident = slot_tag(hashtable, current);
+        // N.B. - an empty slot, or one closer to its home than we are to ours, means the key is absent
+        if(0 == entry || probe_distance(hashtable, resident, current) < distance)
         {
-            return NULL;
+            return false;
         }
-        if(hashtable->compare(chain->entries[i], key))
+        if(tag == resident && hashtable->compare(key, hashtable->entries[entry - 1].key))
         {
-            void *result = chain->entries[i + 1];
-            if(0 != i)
-            {
-                // N.B. - move most recent fetch to front
-                uint8_t *tmp = chain->entries[0];
-                chain->entries[0] = chain->entries[i];
-                chain->entries[i] = tmp;
-                tmp = chain->entries[1];
-                chain->entries[1] = chain->entries[i + 1];
-                chain->entries[i + 1] = tmp;
-            }
-            return result;
+            *index = current;
+            return true;
         }
+        current = (current + 1) & mask;
     }
-    return NULL;
+    return false;
 }
 
 void *hashtable_get_if_absent(Hashtable *hashtable, void *key, void *value)
@@ -509,103 +564,61 @@ void *hashtable_put(Hashtable *hashtable, void *key, void *value)
         return NULL;
     }
 
-    size_t index = hash_index(hashtable, key);
-    uint8_t *cur = hashtable->entries[index];
-    if(NULL == cur)
-    {
-        hashtable->entries[index] = key;
-        hashtable->entries[index + 1] = value;
-        if(++hashtable->occupied > hashtable->capacity)
-        {
-            rehash(hashtable);
-        }
-        return NULL;
-    }
-    if(CHAINED_KEY != cur && hashtable->compare(key, cur))
+    uint32_t tag = tag_of(hashtable, key);
+    size_t index;
+    if(0 != hashtable->occupied && find(hashtable, key, tag, &index))
     {
-        void *previous = hashtable->entries[index + 1];
-        hashtable->entries[index + 1] = value;
+        // N.B. - replacing a value keeps the key's original position in the iteration order
+        Entry *entry = hashtable->entries + slot_entry(hashtable, index) - 1;
+        void *previous = entry->value;
+        entry->value = value;
         return previous;
     }
-    if(CHAINED_KEY == hashtable->entries[index])
-    {
-        return add_to_chain(hashtable, index, key, value);
-    }
-    return chained_put(hashtable, index, key, value);
-}
 
-static void *add_to_chain(Hashtable *hashtable, size_t index, void *key, void *value)
-{
-    Chain *chain = (Chain *)hashtable->entries[index + 1];
-    for(size_t i = 0; i < chain->length; i += 2)
+    while(hashtable->used >= hashtable->capacity)
     {
-        if(NULL == chain->entries[i])
+        if(!rehash(hashtable))
         {
-            chain->entries[i] = chain->entries[0];
-            chain->entries[i + 1] = chain->entries[1];
-            chain->entries[0] = key;
-            chain->entries[1] = value;
-            if(++hashtable->occupied > hashtable->capacity)
-            {
-                rehash(hashtable);
-            }
+            errno = ENOMEM;
             return NULL;
         }
-        if(hashtable->compare(chain->entries[i], key))
-        {
-            void *previous = chain->entries[i + 1];
-            uint8_t *tmp = chain->entries[0];
-            chain->entries[0] = chain->entries[i];
-            chain->entries[i] = tmp;
-            chain->entries[i + 1] = chain->entries[1];
-            chain->entries[1] = value;
-            return previous;
-        }
+        // N.B. - the table may have widened, which keeps more of the tag
+        tag = tag_of(hashtable, key);
     }
-    expand_chain(hashtable, index, key, value);
-    return NULL;
-}
+    Entry *entry = hashtable->entries + hashtable->used;
+    entry->key = key;
+    entry->value = value;
+    hashtable->used++;
+    insert(hashtable, tag, hashtable->used);
+    hashtable->occupied++;
 
-static void expand_chain(Hashtable *hashtable, size_t index, void *key, void *value)
-{
-    Chain *chain = (Chain *)hashtable->entries[index + 1];
-    Chain *expansion = calloc(1, sizeof(Chain) + (sizeof(uint8_t *) * (chain->length + 2)));
-    if(NULL == expansion)
-    {
-        return;
-    }
-    expansion->length = chain->length + 2;
-    memcpy(expansion->entries + 2, chain->entries, sizeof(uint8_t *) * chain->length);
-    expansion->entries[0] = key;
-    expansion->entries[1] = value;
-    hashtable->entries[index + 1] = (uint8_t *)expansion;
-    free(chain);
-    if(++hashtable->occupied > hashtable->capacity)
-    {
-        rehash(hashtable);
-    }
+    return NULL;
 }
 
-static void *chained_put(Hashtable *hashtable, size_t index, void *key, void *value)
+static void insert(Hashtable *hashtable, uint32_t tag, uint32_t entry)
 {
-    Chain *chain = malloc(sizeof(Chain) + sizeof(uint8_t *) * 4);
-    if(NULL == chain)
+    size_t mask = hashtable->length - 1;
+    size_t index = home_index(hashtable, tag);
+    for(size_t distance = 0; ; distance++)
     {
-        return NULL;
-    }
-    chain->length = 4;
-    // N.B. - last in is moved to the front
-    chain->entries[0] = key;
-    chain->entries[1] = value;
-    chain->entries[2] = hashtable->entries[index];
-    chain->entries[3] = hashtable->entries[index + 1];
-    hashtable->entries[index] = (uint8_t *)CHAINED_KEY;
-    hashtable->entries[index + 1] = (uint8_t *)chain;
-    if(++hashtable->occupied > hashtable->capacity)
-    {
-        rehash(hashtable);
+        uint32_t resident_entry = slot_entry(hashtable, index);
+        if(0 == resident_entry)
+        {
+            set_slot(hashtable, index, tag, entry);
+            return;
+        }
+        uint32_t resident_tag = slot_tag(hashtable, index);
+        size_t resident = probe_distance(hashtable, resident_tag, index);
+        if(resident < distance)
+        {
+            // N.B. - take from the rich: the resident is nearer its home, so it moves on instead
+            set_slot(hashtable, index, tag, entry);
+            tag = resident_tag;
+            entry = resident_entry;
+            distance = resident;
+        }
+        index = (index + 1) & mask;
     }
-    return NULL;
 }
 
 static bool map_into(void *key, void *value, void *context)
@@ -658,71 +671,36 @@ void *hashtable_remove(Hashtable *hashtable, void *key)
     {
         return NULL;
     }
-
-    size_t index = hash_index(hashtable, key);
-    uint8_t *cur = hashtable->entries[index];
-    if(NULL != cur)
+    size_t index;
+    if(!find(hashtable, key, tag_of(hashtable, key), &index))
     {
-        if(CHAINED_KEY != cur && hashtable->compare(key, cur))
-        {
-            hashtable->entries[index] = NULL;
-            void *previous = hashtable->entries[index + 1];
-            hashtable->entries[index + 1] = NULL;
-            hashtable->occupied--;
-            return previous;
-        }
-        if(CHAINED_KEY == cur)
-        {
-            return chained_remove(hashtable, index, key);
-        }
+        return NULL;
+    }
+    // N.B. - the entry is left behind as a hole so that the others keep their order, rehash squeezes it out
+    uint32_t found = slot_entry(hashtable, index);
+    Entry *entry = hashtable->entries + found - 1;
+    void *previous = entry->value;
+    entry->key = NULL;
+    entry->value = NULL;
+    if(found == hashtable->used)
+    {
+        hashtable->used--;
     }
 
-    return NULL;
-}
-
-static void *chained_remove(Hashtable *hashtable, size_t index, void *key)
-{
-    Chain *chain = (Chain *)hashtable->entries[index + 1];
-    for(size_t i = 0; i < chain->length; i += 2)
+    // N.B. - shift the following slots back until one is empty or already at home
+    size_t mask = hashtable->length - 1;
+    size_t next = (index + 1) & mask;
+    while(0 != slot_entry(hashtable, next) &&
+          0 != probe_distance(hashtable, slot_tag(hashtable, next), next))
     {
-        if(NULL == chain->entries[i])
-        {
-            return NULL;
-        }
-        if(hashtable->compare(chain->entries[i], key))
-        {
-            void *previous = chain->entries[i + 1];
-            if(chain->length - 2 == i)
-            {
-                chain->entries[i] = NULL;
-                chain->entries[i + 1] = NULL;
-            }
-            else
-            {
-                // N.B. - preserve any move-to-front ordering
-                memcpy(chain->entries + i, chain->entries + i + 2, sizeof(uint8_t *) * (chain->length - (i + 2)));
-                chain->entries[chain->length - 1] = NULL;
-                chain->entries[chain->length - 2] = NULL;
-            }
-            if(NULL == chain->entries[0])
-            {
-                // N.B. - empty chains can be removed and the bucket can be freed
-                hashtable->entries[index] = NULL;
-                hashtable->entries[index + 1] = NULL;
-                free(chain);
-            }
-            else if(NULL == chain->entries[2])
-            {
-                // N.B. - chains with only one entry can be collapsed into a bucket
-                hashtable->entries[index] = chain->entries[0];
-                hashtable->entries[index + 1] = chain->entries[1];
-                free(chain);
-            }
-            hashtable->occupied--;
-            return previous;
-        }
+        set_slot(hashtable, index, slot_tag(hashtable, next), slot_entry(hashtable, next));
+        index = next;
+        next = (next + 1) & mask;
     }
-    return NULL;
+    set_slot(hashtable, index, 0, 0);
+    hashtable->occupied--;
+
+    return previous;
 }
 
 bool hashtable_iterate(const Hashtable *hashtable, hashtable_iterator iterator, void *context)
@@ -733,25 +711,12 @@ bool hashtable_iterate(const Hashtable *hashtable, hashtable_iterator iterator,
         return false;
     }
 
-    for(size_t i = 0; i < hashtable->length; i += 2)
+    for(size_t i = 0; i < hashtable->used; i++)
     {
-        if(CHAINED_KEY == hashtable->entries[i])
+        const Entry *entry = hashtable->entries + i;
+        if(NULL != entry->key && !iterator(entry->key, entry->value, context))
         {
-            Chain *chain = (Chain *)hashtable->entries[i + 1];
-            for(size_t j = 0; j < chain->length && NULL != chain->entries[j]; j += 2)
-            {
-                if(!iterator(chain->entries[j], chain->entries[j + 1], context))
-                {
-                    return false;
-                }
-            }
-        }
-        else if(NULL != hashtable->entries[i])
-        {
-            if(!iterator(hashtable->entries[i], hashtable->entries[i + 1], context))
-            {
-                return false;
-            }
+            return false;
         }
     }
 
@@ -780,81 +745,154 @@ bool hashtable_iterate_values(const Hashtable *hashtable, hashtable_item_iterato
     return hashtable_iterate(hashtable, value_item_iterator, &(item_adapter){iterator, context});
 }
 
-static inline size_t hash_index(const Hashtable *hashtable, const void * key)
+static inline uint32_t tag_of(const Hashtable *hashtable, const void *key)
+{
+    // N.B. - fibonacci hashing spreads the weak low bits of the simple string hashes across the whole table
+    uint32_t tag = (uint32_t)(((uint64_t)hashtable->hash(key) * UINT64_C(0x9e3779b97f4a7c15)) >> 32);
+    return hashtable->narrow ? tag & NARROW_TAG_MASK : tag;
+}
+
+static inline uint32_t slot_tag(const Hashtable *hashtable, size_t index)
 {
-    hashcode h = hashtable->hash(key);
-    return (h & ((hashtable->length >> 1) - 1)) << 1;
+    if(hashtable->narrow)
+    {
+        return (uint32_t)((const NarrowSlot *)hashtable->slots)[index].tag << 24;
+    }
+    return ((const WideSlot *)hashtable->slots)[index].tag;
 }
 
-static void rehash(Hashtable *hashtable)
+static inline uint32_t slot_entry(const Hashtable *hashtable, size_t index)
 {
-    size_t capacity = normalize_capacity((hashtable->length >> 1) + 1);
-    uint8_t **table = hashtable->entries;
-    size_t length = hashtable->length;
-    alloc_table(hashtable, capacity);
-    init(hashtable, hashtable->compare, capacity, hashtable->load_factor, hashtable->hash);
-    for(size_t i = 0; i < length; i += 2)
+    if(hashtable->narrow)
     {
-        if(CHAINED_KEY == table[i])
+        return ((const NarrowSlot *)hashtable->slots)[index].entry;
+    }
+    return ((const WideSlot *)hashtable->slots)[index].entry;
+}
+
+static inline void set_slot(Hashtable *hashtable, size_t index, uint32_t tag, uint32_t entry)
+{
+    if(hashtable->narrow)
+    {
+        ((NarrowSlot *)hashtable->slots)[index] = (NarrowSlot){(uint8_t)(tag >> 24), (uint8_t)entry};
+    }
+    else
+    {
+        ((WideSlot *)hashtable->slots)[index] = (WideSlot){tag, entry};
+    }
+}
+
+static inline size_t home_index(const Hashtable *hashtable, uint32_t tag)
+{
+    return (size_t)(tag >> hashtable->shift);
+}
+
+static inline size_t probe_distance(const Hashtable *hashtable, uint32_t tag, size_t index)
+{
+    return (index - home_index(hashtable, tag)) & (hashtable->length - 1);
+}
+
+static bool rehash(Hashtable *hashtable)
+{
+    Hashtable previous = *hashtable;
+    size_t occupied = previous.occupied;
+    size_t used = previous.used;
+
+    // N.B. - when removals have left at most half of the entries live, squeeze out the holes without growing
+    size_t target = occupied >= previous.capacity / 2 ? (size_t)previous.length << 1 : previous.length;
+    if(MAXIMUM_LENGTH < target)
+    {
+        return false;
+    }
+
+    uint32_t *position = NULL;
+    if(occupied != used)
+    {
+        position = calloc(used, sizeof(uint32_t));
+        if(NULL == position)
+        {
+            return false;
+        }
+    }
+    if(!alloc_table(hashtable, target, hashtable->load_factor))
+    {
+        free(position);
+        return false;
+    }
+    init(hashtable, hashtable->compare, target, hashtable->load_factor, hashtable->hash);
+
+    if(NULL == position)
+    {
+        memcpy(hashtable->entries, previous.entries, used * sizeof(Entry));
+    }
+    else
+    {
+        size_t next = 0;
+        for(size_t i = 0; i < used; i++)
         {
-            Chain *chain = (Chain *)table[i + 1];
-            for(size_t j = 0; j < chain->length; j += 2)
+            if(NULL != previous.entries[i].key)
             {
-                if(NULL == chain->entries[j])
-                {
-                    break;
-                }
-                hashtable_put(hashtable, chain->entries[j], chain->entries[j + 1]);
+                hashtable->entries[next++] = previous.entries[i];
+                position[i] = (uint32_t)next;
             }
-            free(chain);
-            table[i] = NULL;
-            table[i + 1] = NULL;
         }
-        else if(NULL != table[i])
+    }
+    if(previous.narrow && !hashtable->narrow)
+    {
+        // N.B. - narrow slots keep only 8 bits of each tag, so the keys are rehashed once as the table widens
+        for(size_t i = 0; i < occupied; i++)
+        {
+            insert(hashtable, tag_of(hashtable, hashtable->entries[i].key), (uint32_t)i + 1);
+        }
+    }
+    else
+    {
+        for(size_t i = 0; i < previous.length; i++)
         {
-            hashtable_put(hashtable, table[i], table[i + 1]);
+            uint32_t entry = slot_entry(&previous, i);
+            if(0 != entry)
+            {
+                // N.B. - the stored tags are reused, keys are never rehashed
+                insert(hashtable, slot_tag(&previous, i), NULL == position ? entry : position[entry - 1]);
+            }
         }
     }
-    free(table);
+    hashtable->occupied = (uint32_t)occupied;
+    hashtable->used = (uint32_t)occupied;
+    free(position);
+    release(hashtable, previous.slots);
+
+    return true;
 }
 
 void hashtable_summary(const Hashtable *hashtable, FILE *stream)
 {
     fputs("hashtable summary:\n", stream);
     fprintf(stream, "mutable: %s\n", hashtable_is_mutable(hashtable) ? "yes" : "no");
-    fprintf(stream, "occupied: %zd of %zd\n", hashtable->occupied, hashtable->capacity);
-    fprintf(stream, "capacity: %zd (%zd * %g)\n", hashtable->capacity, hashtable->length >> 1, hashtable->load_factor);
-    fprintf(stream, "table length: %zd\n", hashtable->length);
+    fprintf(stream, "occupied: %u of %u\n", hashtable->occupied, hashtable->capacity);
+    fprintf(stream, "entries used: %u (%u removed)\n", hashtable->used, hashtable->used - hashtable->occupied);
+    fprintf(stream, "capacity: %u (%u * %g)\n", hashtable->capacity, hashtable->length, hashtable->load_factor);
+    fprintf(stream, "table length: %u (%s slots)\n", hashtable->length, hashtable->narrow ? "narrow" : "wide");
     fprintf(stream, "load factor: %g\n", hashtable->load_factor);
-    fputs("bucket report:\n", stream);
-    size_t count = 0ul, min = 0ul, max = 0ul, total = 0ul;
-    float avg = 0.0f;
-    for(size_t i = 0; i < hashtable->length; i += 2)
+    fputs("slot report:\n", stream);
+    size_t count = 0ul, max = 0ul, total = 0ul;
+    for(size_t i = 0; i < hashtable->length; i++)
     {
-        if(CHAINED_KEY == hashtable->entries[i])
+        uint32_t entry = slot_entry(hashtable, i);
+        if(0 == entry)
         {
-            count++;
-            Chain *chain = (Chain *)hashtable->entries[i + 1];
-            fprintf(stream, "[%zd]: chain (length: %zd, hash: 0x%zx)\n", i, chain->length, hashtable->hash(chain->entries[0]));
-            for(size_t j = 0; j < chain->length && NULL != chain->entries[j]; j += 2)
-            {
-                fprintf(stream, "  [%zd]: chained key: \"%s\"\n", j, chain->entries[j]);
-            }
-            if(max < chain->length)
-            {
-                max = chain->length;
-            }
-            if(0 == min || min > chain->length)
-            {
-                min = chain->length;
-            }
-            total += chain->length;
-            avg = (float)total / (float)count;
+            continue;
         }
-        else if(NULL != hashtable->entries[i])
+        uint32_t tag = slot_tag(hashtable, i);
+        size_t distance = probe_distance(hashtable, tag, i);
+        fprintf(stream, "[%zd]: key: \"%s\" entry: %u tag: 0x%x distance: %zd\n",
+                i, hashtable->entries[entry - 1].key, entry - 1, tag, distance);
+        count++;
+        total += distance;
+        if(max < distance)
         {
-            fprintf(stream, "[%zd]: key: \"%s\" hash: 0x%zx\n", i, hashtable->entries[i], hashtable->hash(hashtable->entries[i]));
+            max = distance;
         }
     }
-    fprintf(stream, "chains: %zd (length min: %zd, max: %zd, avg: %g)\n", count, min, max, avg);
+    fprintf(stream, "probe distance (max: %zd, avg: %g)\n", max, 0 == count ? 0.0 : (double)total / (double)count);
 }
@@ -39,6 +39,8 @@
 #include <stdlib.h>
 #include <stdbool.h>
 #include <string.h>
+#include <stdint.h>
+#include <errno.h>
 #include <sys/param.h>
 #include <getopt.h>
 
@@ -62,9 +64,17 @@ static argument arguments[] =
     {"help",        no_argument,       NULL, 'h'}, // print help and exit
     // operating modes:
     {"query",       required_argument, NULL, 'q'}, // evaluate given expression and exit
+    {"queries-file", required_argument, NULL, 'f'}, // evaluate each expression in the given file and exit
+    {"serve",       required_argument, NULL, 's'}, // answer queries on the given socket
     // optional arguments:
+    {"client",      required_argument, NULL, 'c'}, // send queries to the server on the given socket
     {"output",      required_argument, NULL, 'o'}, // emit expressions for the given shell
     {"duplicate",   required_argument, NULL, 'd'}, // how to respond to duplicate mapping keys
+    {"input-format", required_argument, NULL, 'i'}, // how to read the input
+    {"limit",       required_argument, NULL, 'l'}, // stop after this many results
+    {"all-documents", no_argument,     NULL, 'a'}, // evaluate against every document of the input
+    {"reload",      no_argument,       NULL, 'r'}, // load the input again when it changes
+    {"framed",      no_argument,       NULL, 'F'}, // prefix each interactive response with its length
     {0, 0, 0, 0}
 };
 
@@ -113,10 +123,22 @@ enum command process_options(const int argc, char * const *argv, struct options
 
     options->emit_mode = BASH;
     options->duplicate_strategy = DUPE_CLOBBER;
+    options->input_format = INPUT_AUTO;
     options->input_file_name = NULL;
+    options->expressions = NULL;
+    options->expression_count = 0;
+    options->queries_file_name = NULL;
+    options->input_file_names = NULL;
+    options->input_file_count = 0;
+    options->socket_name = NULL;
+    options->client = false;
     options->mode = INTERACTIVE_MODE;
+    options->limit = 0;
+    options->all_documents = false;
+    options->reload = false;
+    options->framed = false;
 
-    while(!done && (opt = getopt_long(argc, argv, "vwhq:o:d:", arguments, NULL)) != -1)
+    while(!done && (opt = getopt_long(argc, argv, "vwhq:f:s:c:o:d:i:l:arF", arguments, NULL)) != -1)
     {
         switch(opt)
         {
@@ -136,9 +158,49 @@ enum command process_options(const int argc, char * const *argv, struct options
                 done = true;
                 break;
             case 'q':
-                command = EXPRESSION_MODE;
-                options->expression = optarg;
-                options->mode = EXPRESSION_MODE;
+                if(NULL == options->expressions)
+                {
+                    // N.B. - there can't be more expressions than arguments
+                    options->expressions = calloc((size_t)argc, sizeof(char *));
+                    if(NULL == options->expressions)
+                    {
+                        perror(argv[0]);
+                        command = SHOW_HELP;
+                        done = true;
+                        break;
+                    }
+                }
+                options->expressions[options->expression_count++] = optarg;
+                if(SERVE_MODE != options->mode)
+                {
+                    command = EXPRESSION_MODE;
+                    options->mode = EXPRESSION_MODE;
+                }
+                break;
+            case 'f':
+                options->queries_file_name = optarg;
+                if(SERVE_MODE != options->mode)
+                {
+                    command = EXPRESSION_MODE;
+                    options->mode = EXPRESSION_MODE;
+                }
+                break;
+            case 's':
+            case 'c':
+                if(NULL != options->socket_name)
+                {
+                    fprintf(stderr, "error: %s: only one of `--serve' and `--client' can be given, once\n", argv[0]);
+                    command = SHOW_HELP;
+                    done = true;
+                    break;
+                }
+                options->socket_name = optarg;
+                options->client = 'c' == opt;
+                if('s' == opt)
+                {
+                    command = SERVE_MODE;
+                    options->mode = SERVE_MODE;
+                }
                 break;
             case 'o':
             {
@@ -166,6 +228,43 @@ enum command process_options(const int argc, char * const *argv, struct options
                 options->duplicate_strategy = (enum loader_duplicate_key_strategy)strategy;
                 break;
             }
+            case 'i':
+            {
+                int32_t format = parse_input_format(optarg);
+                if(-1 == format)
+                {
+                    fprintf(stderr, "error: %s: unsupported input format `%s'\n", argv[0], optarg);
+                    command = SHOW_HELP;
+                    done = true;
+                    break;
+                }
+                options->input_format = (enum loader_input_format)format;
+                break;
+            }
+            case 'l':
+            {
+                char *end = NULL;
+                errno = 0;
+                unsigned long long limit = strtoull(optarg, &end, 10);
+                if(0 != errno || end == optarg || '\0' != *end || '-' == optarg[0] || SIZE_MAX < limit)
+                {
+                    fprintf(stderr, "error: %s: invalid result limit `%s'\n", argv[0], optarg);
+                    command = SHOW_HELP;
+                    done = true;
+                    break;
+                }
+                options->limit = (size_t)limit;
+                break;
+            }
+            case 'a':
+                options->all_documents = true;
+                break;
+            case 'r':
+                options->reload = true;
+                break;
+            case 'F':
+                options->framed = true;
+                break;
             case ':':
             case '?':
             default:
@@ -182,6 +281,38 @@ enum command process_options(const int argc, char * const *argv, struct options
     if(argc - optind)
     {
         options->input_file_name = argv[optind];
+        options->input_file_names = argv + optind;
+        options->input_file_count = (size_t)(argc - optind);
+    }
+    if(options->client && EXPRESSION_MODE == command)
+    {
+        command = CLIENT_MODE;
+        options->mode = CLIENT_MODE;
+    }
+    else if(options->client && SHOW_HELP != command)
+    {
+        fputs("error: the client needs a query to send, given with `-q' or `-f'\n", stderr);
+        command = SHOW_HELP;
+    }
+    if(SERVE_MODE == options->mode && (0 != options->expression_count || NULL != options->queries_file_name))
+    {
+        fputs("error: a server doesn't take queries on the command line\n", stderr);
+        command = SHOW_HELP;
+    }
+    if(SERVE_MODE == options->mode && 0 == options->input_file_count)
+    {
+        fputs("error: a server needs at least one file to serve\n", stderr);
+        command = SHOW_HELP;
+    }
+    if(options->reload && (EXPRESSION_MODE == command || CLIENT_MODE == command))
+    {
+        fputs("error: only a server or an interactive session reloads its input\n", stderr);
+        command = SHOW_HELP;
+    }
+    if(options->framed && (EXPRESSION_MODE == command || CLIENT_MODE == command || SERVE_MODE == command))
+    {
+        fputs("error: only an interactive session frames its responses\n", stderr);
+        command = SHOW_HELP;
     }
     if(INTERACTIVE_MODE == options->mode &&
        options->input_file_name &&
@@ -192,3 +323,10 @@ enum command process_options(const int argc, char * const *argv, struct options
     }
     return command;
 }
+
+void options_free(struct options *options)
+{
+    free(options->expressions);
+    options->expressions = NULL;
+    options->expression_count = 0;
+}
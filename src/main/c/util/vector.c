@@ -35,6 +35,7 @@
 #include <errno.h>
 
 #include "vector.h"
+#include "arena.h"
 
 static const size_t DEFAULT_CAPACITY = 4;
 
@@ -43,11 +44,15 @@ struct vector_s
     size_t    length;
     size_t    capacity;
     uint8_t **items;
+    /** when not NULL, the vector and its items live in this arena */
+    Arena    *arena;
 };
 
 static inline bool ensure_capacity(Vector *vector, size_t min_capacity);
 static inline size_t calculate_new_capacity(size_t capacity);
 static inline bool reallocate(Vector *vector, size_t capacity);
+static inline uint8_t **allocate_items(const Vector *vector, size_t capacity);
+static inline void release_items(const Vector *vector, uint8_t **items);
 
 
 static bool add_to_vector_iterator(void *each, void *context);
@@ -58,22 +63,31 @@ Vector *make_vector(void)
 }
 
 Vector *make_vector_with_capacity(size_t capacity)
+{
+    return make_vector_in(NULL, capacity);
+}
+
+Vector *make_vector_in(Arena *arena, size_t capacity)
 {
     if(0 == capacity)
     {
         errno = EINVAL;
         return NULL;
     }
-    Vector *result = (Vector *)calloc(1, sizeof(Vector));
+    Vector *result = NULL == arena ? calloc(1, sizeof(Vector)) : arena_alloc(arena, sizeof(Vector));
     if(NULL == result)
     {
         return NULL;
     }
+    result->arena = arena;
 
-    result->items = (uint8_t **)calloc(1, sizeof(uint8_t *) * capacity);
+    result->items = allocate_items(result, capacity);
     if(NULL == result->items)
     {
-        free(result);
+        if(NULL == arena)
+        {
+            free(result);
+        }
         return NULL;
     }
 
@@ -173,8 +187,9 @@ Vector *vector_with_all(const Vector *vector, const Vector *from)
 
 void vector_free(Vector *vector)
 {
-    if(NULL == vector)
+    if(NULL == vector || NULL != vector->arena)
     {
+        // N.B. - arena storage is only released with the arena itself
         return;
     }
 
@@ -301,8 +316,8 @@ bool vector_insert(Vector *vector, void *value, size_t index)
     if(vector->capacity < vector->length + 1)
     {
         size_t new_capacity = calculate_new_capacity(vector->capacity);
-        target = calloc(1, sizeof(uint8_t *) * new_capacity);
-        if(NULL == vector->items)
+        target = allocate_items(vector, new_capacity);
+        if(NULL == target)
         {
             return false;
         }
@@ -327,7 +342,7 @@ bool vector_insert(Vector *vector, void *value, size_t index)
 
     if(target != vector->items)
     {
-        free(vector->items);
+        release_items(vector, vector->items);
         vector->items = target;
     }
     vector->length++;
@@ -716,6 +731,23 @@ static inline bool ensure_capacity(Vector *vector, size_t min_capacity)
 
 static inline bool reallocate(Vector *vector, size_t capacity)
 {
+    if(NULL != vector->arena)
+    {
+        if(capacity > vector->capacity)
+        {
+            uint8_t **items = arena_resize(vector->arena, vector->items,
+                                           sizeof(uint8_t *) * vector->capacity,
+                                           sizeof(uint8_t *) * capacity);
+            if(NULL == items)
+            {
+                return false;
+            }
+            vector->items = items;
+        }
+        vector->capacity = capacity;
+        return true;
+    }
+
     uint8_t **cache = vector->items;
     vector->items = realloc(vector->items, sizeof(uint8_t *) * capacity);
     if(NULL == vector->items)
@@ -726,3 +758,20 @@ static inline bool reallocate(Vector *vector, size_t capacity)
     vector->capacity = capacity;
     return true;
 }
+
+static inline uint8_t **allocate_items(const Vector *vector, size_t capacity)
+{
+    if(NULL == vector->arena)
+    {
+        return calloc(1, sizeof(uint8_t *) * capacity);
+    }
+    return arena_alloc(vector->arena, sizeof(uint8_t *) * capacity);
+}
+
+static inline void release_items(const Vector *vector, uint8_t **items)
+{
+    if(NULL == vector->arena)
+    {
+        free(items);
+    }
+}
@@ -36,6 +36,7 @@
  */
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <errno.h>
 #include <check.h>
 
@@ -66,7 +67,7 @@ static DocumentModel *load_document(const char *filename)
     assert_not_null(input);
 
     reset_errno();
-    MaybeDocument maybe = load_file(input, DUPE_CLOBBER);
+    MaybeDocument maybe = load_file(input, DUPE_CLOBBER, INPUT_AUTO);
     assert_noerr();
     int result = fclose(input);
     assert_int_eq(0, result);
@@ -87,6 +88,95 @@ static void invoice_setup(void)
     model_fixture = load_document("invoice.yaml");
 }
 
+static void manifests_setup(void)
+{
+    model_fixture = load_document("manifests.yaml");
+}
+
+/*
+ * A sequence long enough to span several comparison blocks, whose `value`
+ * fields cycle through numbers, numeric strings, nulls, booleans, nested
+ * mappings and missing keys.
+ */
+static void readings_setup(void)
+{
+    size_t capacity = 64 * 1024;
+    char *input = calloc(1, capacity);
+    assert_not_null(input);
+    size_t length = (size_t)snprintf(input, capacity, "{\"readings\": [");
+    for(size_t i = 0; i < 1000; i++)
+    {
+        char value[32];
+        if(6 == i % 7)
+        {
+            snprintf(value, sizeof(value), "missing");
+        }
+        else if(5 == i % 7)
+        {
+            snprintf(value, sizeof(value), "\"%zu\"", i % 100);
+        }
+        else if(0 == i % 11)
+        {
+            snprintf(value, sizeof(value), "null");
+        }
+        else if(0 == i % 13)
+        {
+            snprintf(value, sizeof(value), "true");
+        }
+        else if(0 == i % 17)
+        {
+            snprintf(value, sizeof(value), "{\"value\": 1}");
+        }
+        else
+        {
+            snprintf(value, sizeof(value), "%g", (double)(i % 100) - 49.5);
+        }
+        length += (size_t)snprintf(input + length, capacity - length, "%s{\"%s\": %s}", 0 == i ? "" : ", ",
+                                   6 == i % 7 ? "other" : "value", value);
+    }
+    length += (size_t)snprintf(input + length, capacity - length, "]}");
+    assert_true(length < capacity);
+
+    reset_errno();
+    MaybeDocument maybe = load_string((const unsigned char *)input, length, DUPE_CLOBBER, INPUT_AUTO);
+    assert_noerr();
+    assert_int_eq(JUST, maybe.tag);
+    model_fixture = maybe.just;
+    free(input);
+}
+
+/*
+ * A document whose sequence and mapping are wide enough for a recursive
+ * descent to be split across a pool, with every third part sharing an
+ * aliased mapping so that several tasks reach the same nodes.
+ */
+static void catalogue_setup(void)
+{
+    size_t capacity = 256 * 1024;
+    char *input = calloc(1, capacity);
+    assert_not_null(input);
+    size_t length = (size_t)snprintf(input, capacity, "defaults: &defaults\n  colour: red\n  weight: 1.5\nparts:\n");
+    for(size_t i = 0; i < 3000; i++)
+    {
+        length += (size_t)snprintf(input + length, capacity - length,
+                                   "  - {id: %zu, price: %zu.5, tags: [t%zu, u%zu], spec: %s}\n",
+                                   i, i % 20, i % 5, i % 3, 0 == i % 3 ? "*defaults" : "{colour: blue}");
+    }
+    length += (size_t)snprintf(input + length, capacity - length, "index:\n");
+    for(size_t i = 0; i < 1500; i++)
+    {
+        length += (size_t)snprintf(input + length, capacity - length, "  k%zu: [%zu, {price: %zu}]\n", i, i, i % 7);
+    }
+    assert_true(length < capacity);
+
+    reset_errno();
+    MaybeDocument maybe = load_string((const unsigned char *)input, length, DUPE_CLOBBER, INPUT_AUTO);
+    assert_noerr();
+    assert_int_eq(JUST, maybe.tag);
+    model_fixture = maybe.just;
+    free(input);
+}
+
 static void evaluator_teardown(void)
 {
     model_free(model_fixture);
@@ -246,6 +336,462 @@ static nodelist *evaluate_expression(const char *expression)
     return maybe.just;
 }
 
+struct stream_context
+{
+    nodelist *seen;
+    size_t    limit;
+};
+
+static bool stream_iterator(Cursor each, void *context)
+{
+    struct stream_context *stream = (struct stream_context *)context;
+    if(nodelist_length(stream->seen) == stream->limit)
+    {
+        return false;
+    }
+    return nodelist_add(stream->seen, each.node);
+}
+
+START_TEST (streamed_evaluation)
+{
+    parser_context *parser = make_parser((const uint8_t *)"$.store.book[*].price", 21);
+    assert_not_null(parser);
+    jsonpath *path = parse(parser);
+    assert_not_null(path);
+    parser_free(parser);
+
+    // results arrive in the same order a nodelist holds them
+    nodelist *expected = evaluate_expression("$.store.book[*].price");
+    struct stream_context stream = {make_nodelist(), SIZE_MAX};
+    Evaluation results = make_evaluation(model_fixture, path);
+    assert_true(evaluation_iterate(&results, stream_iterator, &stream));
+    assert_int_eq(EVALUATOR_SUCCESS, results.code);
+    assert_nodelist_length(stream.seen, nodelist_length(expected));
+    assert_uint_eq(nodelist_length(expected), results.count);
+    for(size_t i = 0; i < nodelist_length(expected); i++)
+    {
+        assert_ptr_eq(nodelist_get(expected, i), nodelist_get(stream.seen, i));
+    }
+    nodelist_free(stream.seen);
+
+    // the consumer can stop the evaluation early
+    stream = (struct stream_context){make_nodelist(), 2};
+    assert_false(evaluation_iterate(&results, stream_iterator, &stream));
+    assert_int_eq(ERR_EVALUATION_STOPPED, results.code);
+    assert_nodelist_length(stream.seen, 2);
+    assert_uint_eq(2, results.count);
+    nodelist_free(stream.seen);
+
+    reset_errno();
+    Evaluation bad = make_evaluation(NULL, path);
+    assert_false(evaluation_iterate(&bad, stream_iterator, &stream));
+    assert_int_eq(ERR_MODEL_IS_NULL, bad.code);
+    assert_errno(EINVAL);
+
+    nodelist_free(expected);
+    path_free(path);
+}
+END_TEST
+
+START_TEST (limited_evaluation)
+{
+    parser_context *parser = make_parser((const uint8_t *)"$..price", 8);
+    assert_not_null(parser);
+    jsonpath *path = parse(parser);
+    assert_not_null(path);
+    parser_free(parser);
+    nodelist *expected = evaluate_expression("$..price");
+    assert_uint_eq(6, nodelist_length(expected));
+
+    for(int interpret = 0; interpret < 2; interpret++)
+    {
+        // the evaluation stops after the first results, and that isn't an error
+        Evaluation results = make_evaluation(model_fixture, path);
+        results.interpret = interpret;
+        results.limit = 3;
+        struct stream_context stream = {make_nodelist(), SIZE_MAX};
+        assert_true(evaluation_iterate(&results, stream_iterator, &stream));
+        assert_int_eq(EVALUATOR_SUCCESS, results.code);
+        assert_nodelist_length(stream.seen, 3);
+        assert_uint_eq(3, results.count);
+        for(size_t i = 0; i < 3; i++)
+        {
+            assert_ptr_eq(nodelist_get(expected, i), nodelist_get(stream.seen, i));
+        }
+        nodelist_free(stream.seen);
+
+        // a limit beyond the results changes nothing
+        results.limit = 10;
+        stream = (struct stream_context){make_nodelist(), SIZE_MAX};
+        assert_true(evaluation_iterate(&results, stream_iterator, &stream));
+        assert_nodelist_length(stream.seen, 6);
+        assert_uint_eq(6, results.count);
+        nodelist_free(stream.seen);
+
+        // the consumer stopping first is still reported
+        results.limit = 3;
+        stream = (struct stream_context){make_nodelist(), 2};
+        assert_false(evaluation_iterate(&results, stream_iterator, &stream));
+        assert_int_eq(ERR_EVALUATION_STOPPED, results.code);
+        assert_nodelist_length(stream.seen, 2);
+        nodelist_free(stream.seen);
+    }
+
+    nodelist_free(expected);
+    path_free(path);
+}
+END_TEST
+
+static nodelist *evaluate_with(const char *expression, bool interpret, evaluator_status_code *code)
+{
+    parser_context *parser = make_parser((const uint8_t *)expression, strlen(expression));
+    assert_not_null(parser);
+    jsonpath *path = parse(parser);
+    assert_not_null(path);
+    parser_free(parser);
+
+    nodelist *list = make_nodelist();
+    assert_not_null(list);
+    struct stream_context stream = {list, SIZE_MAX};
+    Evaluation results = make_evaluation(model_fixture, path);
+    results.interpret = interpret;
+    evaluation_iterate(&results, stream_iterator, &stream);
+    *code = results.code;
+    path_free(path);
+    return list;
+}
+
+static const char * const DIFFERENTIAL_EXPRESSIONS[] =
+{
+    "$", "$.*", "$..*", "$.store", "$.store.*", "$.store.book[*]", "$.store.book[*].author",
+    "$..author", "$..price", "$..book[0]", "$..book[2].title", "$..book[-1:]", "$..book[:2]",
+    "$.store.book[1:3]", "$.store.book[::2]", "$.store.book[::-1].title", "$.store.book[-2::-1]",
+    "$.store.book[7]", "$.store.book[4]", "$.store..price.number()", "$..object()", "$..array()",
+    "$..string()", "$..boolean()", "$..null()", "$..*.number()", "$.store.bicycle[*]",
+    "$..*[0]", "$.bogus", "$..bogus", "$.store.book.*", "$.items[*].price",
+    "$.customer.name", "$.payment.billing-address.name", "$..name", "$..lines[1:]", "$.items.*",
+    "$..items[*]", "$.payment.*", "$..total.number()", "$.shipments[*].ship-to.*",
+    "$.store..price", "$.store.book..author", "$.store.book[1]..price", "$..book..title", "$.store.bicycle..color",
+    "$..book[*]..isbn", "$.store..book..price.number()", "$..ship-to..name",
+    "$.store.book[?(@.price < 10)]", "$..book[?(@.isbn)].title", "$.store.book[?(10 > @.price)].author",
+    "$.store.book[?(@.price >= 8.99 && @.category == 'fiction')]", "$.store.book[?(!@.isbn || @.price > 20)]",
+    "$.store.book[?(@.price != 8.95)]", "$.store.bicycle[?(@.color == 'red')]", "$.items[?(@.price > 100)]",
+    "$..lines[?(@.quantity <= 1)]", "$.store.book[?(@.author == @.title)]"
+};
+
+START_TEST (compiled_matches_interpreter)
+{
+    for(size_t i = 0; i < sizeof(DIFFERENTIAL_EXPRESSIONS) / sizeof(char *); i++)
+    {
+        evaluator_status_code interpreted_code, compiled_code;
+        nodelist *interpreted = evaluate_with(DIFFERENTIAL_EXPRESSIONS[i], true, &interpreted_code);
+        nodelist *compiled = evaluate_with(DIFFERENTIAL_EXPRESSIONS[i], false, &compiled_code);
+
+        ck_assert_msg(interpreted_code == compiled_code, "%s: interpreter code %d, compiled code %d",
+                      DIFFERENTIAL_EXPRESSIONS[i], interpreted_code, compiled_code);
+        ck_assert_msg(nodelist_length(interpreted) == nodelist_length(compiled), "%s: interpreter found %zu, compiled found %zu",
+                      DIFFERENTIAL_EXPRESSIONS[i], nodelist_length(interpreted), nodelist_length(compiled));
+        for(size_t j = 0; j < nodelist_length(interpreted); j++)
+        {
+            ck_assert_msg(nodelist_get(interpreted, j) == nodelist_get(compiled, j), "%s: results differ at %zu",
+                          DIFFERENTIAL_EXPRESSIONS[i], j);
+        }
+        nodelist_free(interpreted);
+        nodelist_free(compiled);
+    }
+}
+END_TEST
+
+static jsonpath *parse_path(const char *expression)
+{
+    parser_context *parser = make_parser((const uint8_t *)expression, strlen(expression));
+    assert_not_null(parser);
+    jsonpath *path = parse(parser);
+    assert_not_null(path);
+    parser_free(parser);
+    return path;
+}
+
+START_TEST (filter_predicate)
+{
+    nodelist *list = evaluate_expression("$.store.book[?(@.price < 10)].title");
+
+    assert_nodelist_length(list, 2);
+    assert_scalar_value(nodelist_get(list, 0), "Sayings of the Century");
+    assert_scalar_value(nodelist_get(list, 1), "Moby Dick");
+
+    nodelist_free(list);
+}
+END_TEST
+
+START_TEST (filter_predicate_exists)
+{
+    nodelist *list = evaluate_expression("$.store.book[?(@.isbn)].author");
+
+    assert_nodelist_length(list, 3);
+    assert_scalar_value(nodelist_get(list, 0), "Herman Melville");
+    assert_scalar_value(nodelist_get(list, 1), "J. R. R. Tolkien");
+
+    nodelist_free(list);
+}
+END_TEST
+
+START_TEST (filter_predicate_on_mapping)
+{
+    nodelist *list = evaluate_expression("$.store.bicycle[?(@.price > 19)]");
+
+    assert_nodelist_length(list, 1);
+    assert_node_kind(nodelist_get(list, 0), MAPPING);
+    assert_mapping_has_key(nodelist_get(list, 0), "color");
+    nodelist_free(list);
+
+    list = evaluate_expression("$.store.bicycle[?(@.price > 20)]");
+    assert_nodelist_length(list, 0);
+    nodelist_free(list);
+}
+END_TEST
+
+static const char * const BLOCK_EXPRESSIONS[] =
+{
+    "$.readings[?(@.value < 0)]", "$.readings[?(@.value <= -0.5)]", "$.readings[?(@.value > 10)]",
+    "$.readings[?(@.value >= 49.5)]", "$.readings[?(@.value == 0.5)]", "$.readings[?(@.value != 0.5)]",
+    "$.readings[?(3 < @.value)]", "$.readings[?(@.value == '5')]", "$.readings[?(@.value == null)]",
+    "$.readings[?(@.value)]", "$.readings[?(@.value.value == 1)]", "$.readings[?(@.value > 0 && @.value < 10)]"
+};
+
+START_TEST (filter_blocks_match_interpreter)
+{
+    for(size_t i = 0; i < sizeof(BLOCK_EXPRESSIONS) / sizeof(char *); i++)
+    {
+        evaluator_status_code interpreted_code, compiled_code;
+        nodelist *interpreted = evaluate_with(BLOCK_EXPRESSIONS[i], true, &interpreted_code);
+        nodelist *compiled = evaluate_with(BLOCK_EXPRESSIONS[i], false, &compiled_code);
+
+        assert_int_eq(EVALUATOR_SUCCESS, interpreted_code);
+        assert_int_eq(EVALUATOR_SUCCESS, compiled_code);
+        ck_assert_msg(0 < nodelist_length(interpreted), "%s: no results", BLOCK_EXPRESSIONS[i]);
+        ck_assert_msg(nodelist_length(interpreted) == nodelist_length(compiled), "%s: interpreter found %zu, compiled found %zu",
+                      BLOCK_EXPRESSIONS[i], nodelist_length(interpreted), nodelist_length(compiled));
+        for(size_t j = 0; j < nodelist_length(interpreted); j++)
+        {
+            ck_assert_msg(nodelist_get(interpreted, j) == nodelist_get(compiled, j), "%s: results differ at %zu",
+                          BLOCK_EXPRESSIONS[i], j);
+        }
+        nodelist_free(interpreted);
+        nodelist_free(compiled);
+    }
+}
+END_TEST
+
+static nodelist *evaluate_documents_with(const char *expression, bool interpret, size_t threads, size_t limit, bool all_documents)
+{
+    jsonpath *path = parse_path(expression);
+
+    nodelist *list = make_nodelist();
+    assert_not_null(list);
+    struct stream_context stream = {list, SIZE_MAX};
+    Evaluation results = make_evaluation(model_fixture, path);
+    results.interpret = interpret;
+    results.all_documents = all_documents;
+    results.threads = threads;
+    results.limit = limit;
+    assert_true(evaluation_iterate(&results, stream_iterator, &stream));
+    assert_int_eq(EVALUATOR_SUCCESS, results.code);
+    path_free(path);
+    return list;
+}
+
+START_TEST (first_document_only)
+{
+    nodelist *list = evaluate_expression("$.kind");
+
+    assert_nodelist_length(list, 1);
+    assert_scalar_value(nodelist_get(list, 0), "Namespace");
+
+    nodelist_free(list);
+}
+END_TEST
+
+START_TEST (all_documents)
+{
+    static const char * const KINDS[] = {"Namespace", "Deployment", "Service", "Deployment", "ConfigMap"};
+    nodelist *list = evaluate_documents_with("$.kind", false, 4, 0, true);
+
+    assert_nodelist_length(list, 5);
+    for(size_t i = 0; i < 5; i++)
+    {
+        assert_scalar_value(nodelist_get(list, i), KINDS[i]);
+    }
+    nodelist_free(list);
+
+    list = evaluate_documents_with("$..image", false, 4, 0, true);
+    assert_nodelist_length(list, 3);
+    assert_scalar_value(nodelist_get(list, 0), "storefront:1.4");
+    assert_scalar_value(nodelist_get(list, 1), "exporter:0.9");
+    assert_scalar_value(nodelist_get(list, 2), "checkout:2.1");
+    nodelist_free(list);
+}
+END_TEST
+
+START_TEST (all_documents_limit)
+{
+    nodelist *list = evaluate_documents_with("$..name", false, 4, 3, true);
+
+    assert_nodelist_length(list, 3);
+    assert_scalar_value(nodelist_get(list, 0), "shop");
+    assert_scalar_value(nodelist_get(list, 1), "storefront");
+    assert_scalar_value(nodelist_get(list, 2), "web");
+
+    nodelist_free(list);
+}
+END_TEST
+
+static const char * const DOCUMENT_EXPRESSIONS[] =
+{
+    "$.kind", "$.metadata.name", "$..name", "$..containers[*].image", "$..ports[0]", "$.spec.replicas",
+    "$..*", "$..containers[?(@.name == 'web')].image", "$.data.*", "$.bogus"
+};
+
+START_TEST (parallel_matches_serial)
+{
+    for(size_t i = 0; i < sizeof(DOCUMENT_EXPRESSIONS) / sizeof(char *); i++)
+    {
+        nodelist *serial = evaluate_documents_with(DOCUMENT_EXPRESSIONS[i], true, 1, 0, true);
+        nodelist *parallel = evaluate_documents_with(DOCUMENT_EXPRESSIONS[i], false, 3, 0, true);
+
+        ck_assert_msg(nodelist_length(serial) == nodelist_length(parallel), "%s: serial found %zu, parallel found %zu",
+                      DOCUMENT_EXPRESSIONS[i], nodelist_length(serial), nodelist_length(parallel));
+        for(size_t j = 0; j < nodelist_length(serial); j++)
+        {
+            ck_assert_msg(nodelist_get(serial, j) == nodelist_get(parallel, j), "%s: results differ at %zu",
+                          DOCUMENT_EXPRESSIONS[i], j);
+        }
+        nodelist_free(serial);
+        nodelist_free(parallel);
+    }
+}
+END_TEST
+
+static void assert_batch_matches(const char * const *expressions, size_t count, bool all_documents, size_t limit)
+{
+    jsonpath *paths[count];
+    Selection found[count];
+    for(size_t i = 0; i < count; i++)
+    {
+        paths[i] = parse_path(expressions[i]);
+    }
+    assert_int_eq(EVALUATOR_SUCCESS, evaluate_batch(model_fixture, (const jsonpath * const *)paths, count, all_documents, limit, found));
+
+    for(size_t i = 0; i < count; i++)
+    {
+        nodelist *single = evaluate_documents_with(expressions[i], false, 1, limit, all_documents);
+        ck_assert_msg(nodelist_length(single) == found[i].length, "%s: alone found %zu, in a batch found %zu",
+                      expressions[i], nodelist_length(single), found[i].length);
+        for(size_t j = 0; j < nodelist_length(single); j++)
+        {
+            ck_assert_msg(nodelist_get(single, j) == found[i].cursors[j].node, "%s: results differ at %zu", expressions[i], j);
+        }
+        nodelist_free(single);
+        selection_release(found + i);
+        path_free(paths[i]);
+    }
+}
+
+START_TEST (batch_matches_single)
+{
+    size_t count = sizeof(DIFFERENTIAL_EXPRESSIONS) / sizeof(char *);
+    assert_batch_matches(DIFFERENTIAL_EXPRESSIONS, count, false, 0);
+    assert_batch_matches(DIFFERENTIAL_EXPRESSIONS, count, false, 2);
+}
+END_TEST
+
+START_TEST (batch_all_documents)
+{
+    size_t count = sizeof(DOCUMENT_EXPRESSIONS) / sizeof(char *);
+    assert_batch_matches(DOCUMENT_EXPRESSIONS, count, true, 0);
+    assert_batch_matches(DOCUMENT_EXPRESSIONS, count, true, 1);
+    assert_batch_matches(DOCUMENT_EXPRESSIONS, count, false, 0);
+}
+END_TEST
+
+START_TEST (batch_shares_prefixes)
+{
+    static const char * const EXPRESSIONS[] = {"$.store.book[*].title", "$.store.book[*].price", "$.store.bicycle.color"};
+    jsonpath *paths[3];
+    for(size_t i = 0; i < 3; i++)
+    {
+        paths[i] = parse_path(EXPRESSIONS[i]);
+    }
+    program *code = compile_batch(model_fixture, (const jsonpath * const *)paths, 3);
+    assert_not_null(code);
+
+    static const enum opcode EXPECTED[] =
+    {
+        OP_ROOT, OP_NAME, OP_BRANCH, OP_NAME, OP_ITEMS, OP_BRANCH, OP_NAME, OP_COLLECT, OP_NAME, OP_COLLECT,
+        OP_NAME, OP_NAME, OP_COLLECT
+    };
+    assert_uint_eq(sizeof(EXPECTED) / sizeof(enum opcode), code->length);
+    for(size_t i = 0; i < code->length; i++)
+    {
+        ck_assert_msg(EXPECTED[i] == code->code[i].opcode, "instruction %zu: expected %d, found %d", i, EXPECTED[i], code->code[i].opcode);
+    }
+    assert_uint_eq(8, code->code[2].operand.offset);
+    assert_uint_eq(3, code->code[5].operand.offset);
+
+    Selection found[3];
+    assert_int_eq(EVALUATOR_SUCCESS, evaluate_batch(model_fixture, (const jsonpath * const *)paths, 3, false, 0, found));
+    assert_uint_eq(5, found[0].length);
+    assert_uint_eq(5, found[1].length);
+    assert_uint_eq(1, found[2].length);
+    assert_scalar_value(found[2].cursors[0].node, "red");
+
+    for(size_t i = 0; i < 3; i++)
+    {
+        selection_release(found + i);
+        path_free(paths[i]);
+    }
+    program_free(code);
+}
+END_TEST
+
+static const char * const DESCENT_EXPRESSIONS[] =
+{
+    "$..*", "$..price", "$..colour", "$..*[0]", "$..tags[1]", "$.parts..id", "$.index..price", "$..spec.*",
+    "$..*.number()", "$..*[?(@.price > 10)].id", "$..bogus"
+};
+
+START_TEST (split_descent_matches_interpreter)
+{
+    for(size_t i = 0; i < sizeof(DESCENT_EXPRESSIONS) / sizeof(char *); i++)
+    {
+        nodelist *serial = evaluate_documents_with(DESCENT_EXPRESSIONS[i], true, 1, 0, true);
+        nodelist *split = evaluate_documents_with(DESCENT_EXPRESSIONS[i], false, 4, 0, true);
+
+        ck_assert_msg(nodelist_length(serial) == nodelist_length(split), "%s: serial found %zu, split found %zu",
+                      DESCENT_EXPRESSIONS[i], nodelist_length(serial), nodelist_length(split));
+        for(size_t j = 0; j < nodelist_length(serial); j++)
+        {
+            ck_assert_msg(nodelist_get(serial, j) == nodelist_get(split, j), "%s: results differ at %zu",
+                          DESCENT_EXPRESSIONS[i], j);
+        }
+        nodelist_free(serial);
+        nodelist_free(split);
+    }
+}
+END_TEST
+
+START_TEST (split_descent_limit)
+{
+    nodelist *list = evaluate_documents_with("$..id", false, 4, 2, true);
+
+    assert_nodelist_length(list, 2);
+    assert_scalar_value(nodelist_get(list, 0), "0");
+    assert_scalar_value(nodelist_get(list, 1), "1");
+
+    nodelist_free(list);
+}
+END_TEST
+
 START_TEST (dollar_only)
 {
     nodelist *list = evaluate_expression("$");
@@ -458,6 +1004,11 @@ START_TEST (subscript_predicate)
     assert_scalar_value((author), "Herman Melville");
 
     nodelist_free(list);
+
+    // an index one past the end selects nothing
+    list = evaluate_expression("$.store.book[5]");
+    assert_nodelist_length(list, 0);
+    nodelist_free(list);
 }
 END_TEST
 
@@ -772,6 +1323,11 @@ Suite *evaluator_suite(void)
     tcase_add_test(basic_case, object_test);
     tcase_add_test(basic_case, array_test);
     tcase_add_test(basic_case, number_test);
+    tcase_add_test(basic_case, streamed_evaluation);
+    tcase_add_test(basic_case, limited_evaluation);
+    tcase_add_test(basic_case, compiled_matches_interpreter);
+    tcase_add_test(basic_case, batch_matches_single);
+    tcase_add_test(basic_case, batch_shares_prefixes);
 
     TCase *predicate_case = tcase_create("predicate");
     tcase_add_unchecked_fixture(predicate_case, inventory_setup, evaluator_teardown);
@@ -785,6 +1341,13 @@ Suite *evaluator_suite(void)
     tcase_add_test(predicate_case, slice_predicate_negative_from);
     tcase_add_test(predicate_case, slice_predicate_copy);
     tcase_add_test(predicate_case, slice_predicate_reverse);
+    tcase_add_test(predicate_case, filter_predicate);
+    tcase_add_test(predicate_case, filter_predicate_exists);
+    tcase_add_test(predicate_case, filter_predicate_on_mapping);
+
+    TCase *filter_case = tcase_create("filter");
+    tcase_add_unchecked_fixture(filter_case, readings_setup, evaluator_teardown);
+    tcase_add_test(filter_case, filter_blocks_match_interpreter);
 
     TCase *recursive_case = tcase_create("recursive");
     tcase_add_unchecked_fixture(recursive_case, inventory_setup, evaluator_teardown);
@@ -803,13 +1366,30 @@ Suite *evaluator_suite(void)
     tcase_add_test(alias_case, recursive_alias);
     tcase_add_test(alias_case, wildcard_predicate_alias);
     tcase_add_test(alias_case, recursive_wildcard_alias);
+    tcase_add_test(alias_case, compiled_matches_interpreter);
+
+    TCase *documents_case = tcase_create("documents");
+    tcase_add_unchecked_fixture(documents_case, manifests_setup, evaluator_teardown);
+    tcase_add_test(documents_case, first_document_only);
+    tcase_add_test(documents_case, all_documents);
+    tcase_add_test(documents_case, all_documents_limit);
+    tcase_add_test(documents_case, parallel_matches_serial);
+    tcase_add_test(documents_case, batch_all_documents);
+
+    TCase *descent_case = tcase_create("descent");
+    tcase_add_unchecked_fixture(descent_case, catalogue_setup, evaluator_teardown);
+    tcase_add_test(descent_case, split_descent_matches_interpreter);
+    tcase_add_test(descent_case, split_descent_limit);
 
     Suite *evaluator = suite_create("Evaluator");
     suite_add_tcase(evaluator, bad_input_case);
     suite_add_tcase(evaluator, basic_case);
     suite_add_tcase(evaluator, predicate_case);
+    suite_add_tcase(evaluator, filter_case);
     suite_add_tcase(evaluator, recursive_case);
     suite_add_tcase(evaluator, alias_case);
+    suite_add_tcase(evaluator, documents_case);
+    suite_add_tcase(evaluator, descent_case);
 
     return evaluator;
 }
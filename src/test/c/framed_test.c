@@ -0,0 +1,95 @@
+/*
+ * 金棒 (kanabō)
+ * Copyright (c) 2012 Kevin Birch <kmb@pobox.com>.  All rights reserved.
+ * 
+ * 金棒 is a tool to bludgeon YAML and JSON files from the shell: the strong
+ * made stronger.
+ *
+ * For more information, consult the README file in the project root.
+ *
+ * Distributed under an [MIT-style][license] license.
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal with
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * - Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimers.
+ * - Redistributions in binary form must reproduce the above copyright notice, this
+ *   list of conditions and the following disclaimers in the documentation and/or
+ *   other materials provided with the distribution.
+ * - Neither the names of the copyright holders, nor the names of the authors, nor
+ *   the names of other contributors may be used to endorse or promote products
+ *   derived from this Software without specific prior written permission.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE CONTRIBUTORS
+ * OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS WITH THE SOFTWARE.
+ *
+ * [license]: http://www.opensource.org/licenses/ncsa
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <check.h>
+
+#include "framed.h"
+#include "test.h"
+
+START_TEST (split_id)
+{
+    char line[] = "titles\t$.store.book[*].title";
+    char *command = NULL;
+    char *id = split_request_id(line, &command);
+    assert_not_null(id);
+    ck_assert_str_eq("titles", id);
+    ck_assert_str_eq("$.store.book[*].title", command);
+
+    char dashed[] = "a_1-b\t:output json";
+    id = split_request_id(dashed, &command);
+    assert_not_null(id);
+    ck_assert_str_eq("a_1-b", id);
+    ck_assert_str_eq(":output json", command);
+}
+END_TEST
+
+START_TEST (split_no_id)
+{
+    char *command = NULL;
+
+    char plain[] = "$.store.book[*].title";
+    assert_null(split_request_id(plain, &command));
+    ck_assert_str_eq("$.store.book[*].title", command);
+
+    // N.B. - a tab inside an expression doesn't make what precedes it an id
+    char quoted[] = "$.x['a\tb']";
+    assert_null(split_request_id(quoted, &command));
+    ck_assert_str_eq("$.x['a\tb']", command);
+
+    char spaced[] = "my id\t$.store";
+    assert_null(split_request_id(spaced, &command));
+    ck_assert_str_eq("my id\t$.store", command);
+
+    char empty[] = "\t$.store";
+    assert_null(split_request_id(empty, &command));
+    ck_assert_str_eq("\t$.store", command);
+}
+END_TEST
+
+Suite *framed_suite(void)
+{
+    TCase *split_case = tcase_create("split");
+    tcase_add_test(split_case, split_id);
+    tcase_add_test(split_case, split_no_id);
+
+    Suite *suite = suite_create("Framed");
+    suite_add_tcase(suite, split_case);
+
+    return suite;
+}
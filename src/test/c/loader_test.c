@@ -35,9 +35,15 @@
  * [license]: http://www.opensource.org/licenses/ncsa
  */
 
+#ifdef __linux__
+#define _POSIX_C_SOURCE 200809L /* for mkstemp() */
+#endif
+
 #include <stdio.h>
 #include <string.h>
 #include <errno.h>
+#include <stdlib.h>
+#include <unistd.h>
 
 #include <check.h>
 
@@ -90,6 +96,28 @@ static const unsigned char * const YAML = (unsigned char *)
     "  - 42\n"
     "  - 1978-07-26 10:15";
 
+static const unsigned char * const ESCAPED_YAML = (unsigned char *)
+    "plain: foo\n"
+    "escaped: \"foo\\tbar\"\n"
+    "folded: >\n"
+    "  foo\n"
+    "  bar\n";
+
+static const unsigned char * const JSON = (unsigned char *)
+    "{\n"
+    "  \"one\": [\"foo1\", \"bar1\"],\n"
+    "  \"two\": \"foo\\\"2\\u00e9\",\n"
+    "  \"three\": null,\n"
+    "  \"four\": [true, false],\n"
+    "  \"five\": [1.5, 42, -3e10, {}, []]\n"
+    "}\n";
+
+static const unsigned char * const FLOW_YAML = (unsigned char *)
+    "{one: [foo1, bar1], two: 42}\n";
+
+static const unsigned char * const JSON_DUPLICATE_KEY = (unsigned char *)
+    "{\"one\": 1, \"two\": 2, \"one\": 3}";
+
 static const unsigned char * const TAGGED_YAML = (unsigned char *)
     "%TAG !squid! tag:vampire-squid.com,2008:\n"
     "--- !squid!instrument\n"
@@ -138,7 +166,7 @@ static Node *root_node_fixture = NULL;
 
 static void model_setup(const unsigned char *data, size_t length, enum loader_duplicate_key_strategy value)
 {
-    MaybeDocument maybe = load_string(data, length, value);
+    MaybeDocument maybe = load_string(data, length, value, INPUT_AUTO);
     assert_not_null(maybe.just);
     model_fixture = maybe.just;
 
@@ -161,7 +189,7 @@ static void model_teardown(void)
 START_TEST (null_string_input)
 {
     reset_errno();
-    MaybeDocument maybe = load_string(NULL, 50, DUPE_CLOBBER);
+    MaybeDocument maybe = load_string(NULL, 50, DUPE_CLOBBER, INPUT_AUTO);
     assert_errno(EINVAL);
 
     assert_loader_failure(maybe, ERR_INPUT_IS_NULL);
@@ -171,7 +199,7 @@ END_TEST
 START_TEST (zero_string_input_length)
 {
     reset_errno();
-    MaybeDocument maybe = load_string((unsigned char *)"", 0, DUPE_CLOBBER);
+    MaybeDocument maybe = load_string((unsigned char *)"", 0, DUPE_CLOBBER, INPUT_AUTO);
     assert_errno(EINVAL);
 
     assert_loader_failure(maybe, ERR_INPUT_SIZE_IS_ZERO);
@@ -181,7 +209,7 @@ END_TEST
 START_TEST (null_file_input)
 {
     reset_errno();
-    MaybeDocument maybe = load_file(NULL, DUPE_CLOBBER);
+    MaybeDocument maybe = load_file(NULL, DUPE_CLOBBER, INPUT_AUTO);
     assert_errno(EINVAL);
 
     assert_loader_failure(maybe, ERR_INPUT_IS_NULL);
@@ -194,7 +222,7 @@ START_TEST (eof_file_input)
     fseek(input, 0, SEEK_END);
 
     reset_errno();
-    MaybeDocument maybe = load_file(input, DUPE_CLOBBER);
+    MaybeDocument maybe = load_file(input, DUPE_CLOBBER, INPUT_AUTO);
     assert_errno(EINVAL);
 
     assert_loader_failure(maybe, ERR_INPUT_SIZE_IS_ZERO);
@@ -203,11 +231,31 @@ START_TEST (eof_file_input)
 }
 END_TEST
 
+START_TEST (null_mapped_input)
+{
+    reset_errno();
+    MaybeDocument maybe = load_mapped(NULL, DUPE_CLOBBER, INPUT_AUTO);
+    assert_errno(EINVAL);
+
+    assert_loader_failure(maybe, ERR_INPUT_IS_NULL);
+}
+END_TEST
+
+START_TEST (missing_mapped_input)
+{
+    reset_errno();
+    MaybeDocument maybe = load_mapped("/nonexistent/kanabo/input.yaml", DUPE_CLOBBER, INPUT_AUTO);
+    assert_errno(ENOENT);
+
+    assert_loader_failure(maybe, ERR_READER_FAILED);
+}
+END_TEST
+
 START_TEST (non_scalar_key)
 {
     size_t yaml_size = strlen((char *)NON_SCALAR_KEY_YAML);
 
-    MaybeDocument maybe = load_string(NON_SCALAR_KEY_YAML, yaml_size, DUPE_CLOBBER);
+    MaybeDocument maybe = load_string(NON_SCALAR_KEY_YAML, yaml_size, DUPE_CLOBBER, INPUT_AUTO);
     assert_loader_failure(maybe, ERR_NON_SCALAR_KEY);
 }
 END_TEST
@@ -216,7 +264,7 @@ START_TEST (alias_loop)
 {
     size_t yaml_size = strlen((char *)ALIAS_LOOP_YAML);
 
-    MaybeDocument maybe = load_string(ALIAS_LOOP_YAML, yaml_size, DUPE_CLOBBER);
+    MaybeDocument maybe = load_string(ALIAS_LOOP_YAML, yaml_size, DUPE_CLOBBER, INPUT_AUTO);
     assert_loader_failure(maybe, ERR_ALIAS_LOOP);
 }
 END_TEST
@@ -225,7 +273,7 @@ START_TEST (missing_anchor)
 {
     size_t yaml_size = strlen((char *)MISSING_ANCHOR_YAML);
 
-    MaybeDocument maybe = load_string(MISSING_ANCHOR_YAML, yaml_size, DUPE_CLOBBER);
+    MaybeDocument maybe = load_string(MISSING_ANCHOR_YAML, yaml_size, DUPE_CLOBBER, INPUT_AUTO);
     assert_loader_failure(maybe, ERR_NO_ANCHOR_FOR_ALIAS);
 }
 END_TEST
@@ -339,7 +387,7 @@ START_TEST (load_from_file)
 
     rewind(input);
 
-    MaybeDocument maybe = load_file(input, DUPE_CLOBBER);
+    MaybeDocument maybe = load_file(input, DUPE_CLOBBER, INPUT_AUTO);
     assert_int_eq(JUST, maybe.tag);
     assert_not_null(maybe.just);
 
@@ -350,16 +398,119 @@ START_TEST (load_from_file)
 }
 END_TEST
 
+static void write_temporary_file(char *filename, const unsigned char *data)
+{
+    int descriptor = mkstemp(filename);
+    assert_int_ne(-1, descriptor);
+    FILE *output = fdopen(descriptor, "w");
+    assert_not_null(output);
+
+    size_t size = strlen((char *)data);
+    size_t written = fwrite(data, sizeof(char), size, output);
+    assert_uint_eq(written, size);
+    int ret = fclose(output);
+    assert_int_eq(0, ret);
+}
+
+#define assert_borrowed(MODEL, NODE)                                        \
+    do                                                                      \
+    {                                                                       \
+        uint8_t *value = scalar_value(scalar(NODE));                        \
+        assert_true(scalar(NODE)->borrowed);                                \
+        assert_true(value >= (MODEL)->input.data);                          \
+        assert_true(value < (MODEL)->input.data + (MODEL)->input.length);   \
+    } while(0)
+
+START_TEST (load_from_mapped_file)
+{
+    char filename[] = "/tmp/kanabo_loader_test_XXXXXX";
+    write_temporary_file(filename, YAML);
+
+    MaybeDocument maybe = load_mapped(filename, DUPE_CLOBBER, INPUT_AUTO);
+    unlink(filename);
+    assert_int_eq(JUST, maybe.tag);
+    assert_not_null(maybe.just);
+
+    assert_model_state(maybe.just);
+
+    Node *root = model_document_root(maybe.just, 0);
+    assert_borrowed(maybe.just, mapping_get(mapping(root), (uint8_t *)"two", 3ul));
+    assert_borrowed(maybe.just, sequence_get(sequence(mapping_get(mapping(root), (uint8_t *)"five", 4ul)), 2));
+
+    model_free(maybe.just);
+}
+END_TEST
+
+START_TEST (mapped_file_copies_transformed_scalars)
+{
+    char filename[] = "/tmp/kanabo_loader_test_XXXXXX";
+    write_temporary_file(filename, ESCAPED_YAML);
+
+    MaybeDocument maybe = load_mapped(filename, DUPE_CLOBBER, INPUT_AUTO);
+    unlink(filename);
+    assert_int_eq(JUST, maybe.tag);
+    assert_not_null(maybe.just);
+
+    Node *root = model_document_root(maybe.just, 0);
+    assert_node_kind(root, MAPPING);
+
+    Node *plain = mapping_get(mapping(root), (uint8_t *)"plain", 5ul);
+    assert_scalar_value(plain, "foo");
+    assert_borrowed(maybe.just, plain);
+
+    Node *escaped = mapping_get(mapping(root), (uint8_t *)"escaped", 7ul);
+    assert_scalar_value(escaped, "foo\tbar");
+    assert_false(scalar(escaped)->borrowed);
+
+    Node *folded = mapping_get(mapping(root), (uint8_t *)"folded", 6ul);
+    assert_scalar_value(folded, "foo bar\n");
+    assert_false(scalar(folded)->borrowed);
+
+    model_free(maybe.just);
+}
+END_TEST
+
 START_TEST (load_from_string)
 {
     size_t yaml_size = strlen((char *)YAML);
 
-    MaybeDocument maybe = load_string(YAML, yaml_size, DUPE_CLOBBER);
+    MaybeDocument maybe = load_string(YAML, yaml_size, DUPE_CLOBBER, INPUT_AUTO);
     assert_int_eq(JUST, maybe.tag);
     assert_not_null(maybe.just);
 
     assert_model_state(maybe.just);
 
+    ArenaStats stats = model_arena_stats(maybe.just);
+    assert_uint_ne(0, stats.chunks);
+    assert_uint_ne(0, stats.used);
+    assert_true(stats.used <= stats.reserved);
+
+    model_free(maybe.just);
+}
+END_TEST
+
+START_TEST (plain_scalar_kinds_are_deferred)
+{
+    size_t yaml_size = strlen((char *)YAML);
+
+    MaybeDocument maybe = load_string(YAML, yaml_size, DUPE_CLOBBER, INPUT_YAML);
+    assert_int_eq(JUST, maybe.tag);
+
+    Node *root = model_document_root(maybe.just, 0);
+    Node *two = mapping_get(mapping(root), (uint8_t *)"two", 3ul);
+    assert_int_eq(SCALAR_STRING, scalar(two)->kind);
+
+    Node *five = mapping_get(mapping(root), (uint8_t *)"five", 4ul);
+    Node *real = sequence_get(sequence(five), 0);
+    assert_int_eq(SCALAR_UNRESOLVED, scalar(real)->kind);
+    assert_int_eq(SCALAR_REAL, scalar_kind(scalar(real)));
+    assert_int_eq(SCALAR_REAL, scalar(real)->kind);
+
+    Node *timestamp = sequence_get(sequence(five), 2);
+    assert_int_eq(SCALAR_UNRESOLVED, scalar(timestamp)->kind);
+    assert_true(is_timestamp(timestamp));
+    assert_int_eq(SCALAR_TIMESTAMP, scalar(timestamp)->kind);
+
     model_free(maybe.just);
 }
 END_TEST
@@ -566,11 +717,233 @@ START_TEST (duplicate_fail)
 {
     size_t yaml_size = strlen((char *)DUPLICATE_KEY_YAML);
 
-    MaybeDocument maybe = load_string(DUPLICATE_KEY_YAML, yaml_size, DUPE_FAIL);
+    MaybeDocument maybe = load_string(DUPLICATE_KEY_YAML, yaml_size, DUPE_FAIL, INPUT_AUTO);
+    assert_loader_failure(maybe, ERR_DUPLICATE_KEY);
+}
+END_TEST
+
+START_TEST (load_json)
+{
+    size_t json_size = strlen((char *)JSON);
+
+    MaybeDocument maybe = load_string(JSON, json_size, DUPE_CLOBBER, INPUT_JSON);
+    assert_int_eq(JUST, maybe.tag);
+    assert_uint_eq(1, model_size(maybe.just));
+
+    Node *root = model_document_root(maybe.just, 0);
+    assert_node_kind(root, MAPPING);
+    assert_node_size(root, 5);
+
+    Node *one = mapping_get(mapping(root), (uint8_t *)"one", 3ul);
+    assert_node_kind(one, SEQUENCE);
+    assert_node_size(one, 2);
+    assert_scalar_value(sequence_get(sequence(one), 0), "foo1");
+    assert_scalar_kind(sequence_get(sequence(one), 1), SCALAR_STRING);
+
+    Node *two = mapping_get(mapping(root), (uint8_t *)"two", 3ul);
+    assert_scalar_value(two, "foo\"2\xC3\xA9");
+    assert_scalar_kind(two, SCALAR_STRING);
+
+    Node *three = mapping_get(mapping(root), (uint8_t *)"three", 5ul);
+    assert_scalar_value(three, "null");
+    assert_scalar_kind(three, SCALAR_NULL);
+
+    Node *four = mapping_get(mapping(root), (uint8_t *)"four", 4ul);
+    assert_true(scalar_boolean_is_true(scalar(sequence_get(sequence(four), 0))));
+    assert_true(scalar_boolean_is_false(scalar(sequence_get(sequence(four), 1))));
+    assert_scalar_kind(sequence_get(sequence(four), 1), SCALAR_BOOLEAN);
+
+    Node *five = mapping_get(mapping(root), (uint8_t *)"five", 4ul);
+    assert_node_size(five, 5);
+    assert_scalar_value(sequence_get(sequence(five), 0), "1.5");
+    assert_scalar_kind(sequence_get(sequence(five), 0), SCALAR_REAL);
+    assert_scalar_value(sequence_get(sequence(five), 1), "42");
+    assert_scalar_kind(sequence_get(sequence(five), 1), SCALAR_INTEGER);
+    assert_scalar_value(sequence_get(sequence(five), 2), "-3e10");
+    assert_scalar_kind(sequence_get(sequence(five), 2), SCALAR_REAL);
+    assert_node_kind(sequence_get(sequence(five), 3), MAPPING);
+    assert_node_size(sequence_get(sequence(five), 3), 0);
+    assert_node_kind(sequence_get(sequence(five), 4), SEQUENCE);
+    assert_node_size(sequence_get(sequence(five), 4), 0);
+
+    model_free(maybe.just);
+}
+END_TEST
+
+START_TEST (sniffed_json_equals_yaml)
+{
+    size_t json_size = strlen((char *)JSON);
+
+    MaybeDocument json = load_string(JSON, json_size, DUPE_CLOBBER, INPUT_AUTO);
+    assert_int_eq(JUST, json.tag);
+    MaybeDocument yaml = load_string(JSON, json_size, DUPE_CLOBBER, INPUT_YAML);
+    assert_int_eq(JUST, yaml.tag);
+
+    assert_true(node_equals(model_document(json.just, 0), model_document(yaml.just, 0)));
+
+    model_free(json.just);
+    model_free(yaml.just);
+}
+END_TEST
+
+START_TEST (flow_yaml_fallback)
+{
+    size_t yaml_size = strlen((char *)FLOW_YAML);
+
+    MaybeDocument maybe = load_string(FLOW_YAML, yaml_size, DUPE_CLOBBER, INPUT_AUTO);
+    assert_int_eq(JUST, maybe.tag);
+    Node *root = model_document_root(maybe.just, 0);
+    assert_node_kind(root, MAPPING);
+    assert_node_size(root, 2);
+    model_free(maybe.just);
+
+    maybe = load_string(FLOW_YAML, yaml_size, DUPE_CLOBBER, INPUT_JSON);
+    assert_loader_failure(maybe, ERR_PARSER_FAILED);
+}
+END_TEST
+
+START_TEST (json_scalar_document)
+{
+    MaybeDocument maybe = load_string((unsigned char *)" \"\\ud83d\\ude00\" ", 16, DUPE_CLOBBER, INPUT_JSON);
+    assert_int_eq(JUST, maybe.tag);
+    Node *root = model_document_root(maybe.just, 0);
+    assert_scalar_value(root, "\xF0\x9F\x98\x80");
+    model_free(maybe.just);
+}
+END_TEST
+
+START_TEST (json_failures)
+{
+    MaybeDocument maybe = load_string((unsigned char *)"  \n ", 4, DUPE_CLOBBER, INPUT_JSON);
+    assert_loader_failure(maybe, ERR_NO_DOCUMENTS_FOUND);
+
+    maybe = load_string((unsigned char *)"{[1]: 2}", 8, DUPE_CLOBBER, INPUT_JSON);
+    assert_loader_failure(maybe, ERR_NON_SCALAR_KEY);
+
+    maybe = load_string((unsigned char *)"[\"a\\qb\"]", 8, DUPE_CLOBBER, INPUT_JSON);
+    assert_loader_failure(maybe, ERR_SCANNER_FAILED);
+
+    maybe = load_string((unsigned char *)"[\"\xC3\x28\"]", 6, DUPE_CLOBBER, INPUT_JSON);
+    assert_loader_failure(maybe, ERR_READER_FAILED);
+
+    maybe = load_string((unsigned char *)"[1, 2", 5, DUPE_CLOBBER, INPUT_JSON);
+    assert_loader_failure(maybe, ERR_PARSER_FAILED);
+
+    maybe = load_string((unsigned char *)"[01]", 4, DUPE_CLOBBER, INPUT_JSON);
+    assert_loader_failure(maybe, ERR_SCANNER_FAILED);
+
+    maybe = load_string((unsigned char *)"[truex]", 7, DUPE_CLOBBER, INPUT_JSON);
+    assert_loader_failure(maybe, ERR_SCANNER_FAILED);
+
+    maybe = load_string((unsigned char *)"[\"a\"x]", 6, DUPE_CLOBBER, INPUT_JSON);
+    assert_loader_failure(maybe, ERR_PARSER_FAILED);
+
+    size_t json_size = strlen((char *)JSON_DUPLICATE_KEY);
+    maybe = load_string(JSON_DUPLICATE_KEY, json_size, DUPE_FAIL, INPUT_AUTO);
     assert_loader_failure(maybe, ERR_DUPLICATE_KEY);
 }
 END_TEST
 
+START_TEST (json_deep_nesting)
+{
+    size_t depth = 1000;
+    unsigned char *input = calloc(1, depth * 2);
+    assert_not_null(input);
+    memset(input, '[', depth);
+    memset(input + depth, ']', depth);
+
+    MaybeDocument maybe = load_string(input, depth * 2, DUPE_CLOBBER, INPUT_JSON);
+    free(input);
+    assert_int_eq(JUST, maybe.tag);
+    model_free(maybe.just);
+}
+END_TEST
+
+static bool collect_key(Node *key, Node *value __attribute__((unused)), void *context)
+{
+    *(Node **)context = key;
+    return true;
+}
+
+START_TEST (interned_mapping_keys)
+{
+    static const unsigned char input[] = "[{\"name\": 1}, {\"name\": 2}, {\"other\": 3}]";
+    enum loader_input_format formats[] = {INPUT_JSON, INPUT_YAML};
+
+    for(size_t i = 0; i < 2; i++)
+    {
+        MaybeDocument maybe = load_string(input, sizeof(input) - 1, DUPE_CLOBBER, formats[i]);
+        assert_int_eq(JUST, maybe.tag);
+        Node *root = model_document_root(maybe.just, 0);
+        assert_node_size(root, 3);
+
+        // every mapping with the key shares the model's one copy of it
+        Scalar *name = model_symbol(maybe.just, (uint8_t *)"name", 4);
+        assert_not_null(name);
+        Node *first = NULL, *second = NULL;
+        assert_true(mapping_iterate(mapping(sequence_get(sequence(root), 0)), collect_key, &first));
+        assert_true(mapping_iterate(mapping(sequence_get(sequence(root), 1)), collect_key, &second));
+        assert_ptr_eq(node(name), first);
+        assert_ptr_eq(node(name), second);
+        assert_not_null(model_symbol(maybe.just, (uint8_t *)"other", 5));
+        assert_null(model_symbol(maybe.just, (uint8_t *)"bogus", 5));
+
+        model_free(maybe.just);
+    }
+}
+END_TEST
+
+START_TEST (structural_index)
+{
+    // the escaped quote and the structurals inside strings are not tokens
+    const char *input = " {\"a\\\"b\": [12, true,\"x,y\\\\\"] }";
+    uint32_t expected[] = {1, 2, 8, 10, 11, 13, 15, 19, 20, 27, 29};
+    size_t count = sizeof(expected) / sizeof(uint32_t);
+
+    struct structural_index index;
+    assert_true(build_structural_index(&index, (const uint8_t *)input, strlen(input), KERNEL_SCALAR));
+    assert_uint_eq(count, index.length);
+    for(size_t i = 0; i < count; i++)
+    {
+        assert_uint_eq(expected[i], index.positions[i]);
+    }
+    structural_index_free(&index);
+}
+END_TEST
+
+START_TEST (structural_kernels_agree)
+{
+    static const char alphabet[] = "\"\\{}[]:, \n\tax1";
+    size_t length = 64 * 97 + 13;
+    uint8_t *input = malloc(length);
+    assert_not_null(input);
+    uint32_t seed = 42;
+    for(size_t i = 0; i < length; i++)
+    {
+        seed = seed * 1103515245u + 12345u;
+        input[i] = (uint8_t)alphabet[(seed >> 16) % (sizeof(alphabet) - 1)];
+    }
+
+    struct structural_index reference;
+    assert_true(build_structural_index(&reference, input, length, KERNEL_SCALAR));
+    for(enum structural_kernel kernel = KERNEL_SSE2; kernel <= KERNEL_AVX2; kernel++)
+    {
+        if(!structural_kernel_supported(kernel))
+        {
+            continue;
+        }
+        struct structural_index index;
+        assert_true(build_structural_index(&index, input, length, kernel));
+        assert_uint_eq(reference.length, index.length);
+        assert_int_eq(0, memcmp(reference.positions, index.positions, reference.length * sizeof(uint32_t)));
+        structural_index_free(&index);
+    }
+
+    structural_index_free(&reference);
+    free(input);
+}
+END_TEST
+
 Suite *loader_suite(void)
 {
     TCase *bad_input_case = tcase_create("bad input");
@@ -578,15 +951,31 @@ Suite *loader_suite(void)
     tcase_add_test(bad_input_case, zero_string_input_length);
     tcase_add_test(bad_input_case, null_file_input);
     tcase_add_test(bad_input_case, eof_file_input);
+    tcase_add_test(bad_input_case, null_mapped_input);
+    tcase_add_test(bad_input_case, missing_mapped_input);
     tcase_add_test(bad_input_case, non_scalar_key);
     tcase_add_test(bad_input_case, alias_loop);
     tcase_add_test(bad_input_case, missing_anchor);
 
     TCase *file_case = tcase_create("file");
     tcase_add_test(file_case, load_from_file);
+    tcase_add_test(file_case, load_from_mapped_file);
+    tcase_add_test(file_case, mapped_file_copies_transformed_scalars);
 
     TCase *string_case = tcase_create("string");
     tcase_add_test(string_case, load_from_string);
+    tcase_add_test(string_case, plain_scalar_kinds_are_deferred);
+
+    TCase *json_case = tcase_create("json");
+    tcase_add_test(json_case, load_json);
+    tcase_add_test(json_case, sniffed_json_equals_yaml);
+    tcase_add_test(json_case, flow_yaml_fallback);
+    tcase_add_test(json_case, json_scalar_document);
+    tcase_add_test(json_case, json_failures);
+    tcase_add_test(json_case, json_deep_nesting);
+    tcase_add_test(json_case, interned_mapping_keys);
+    tcase_add_test(json_case, structural_index);
+    tcase_add_test(json_case, structural_kernels_agree);
 
     TCase *tag_case = tcase_create("tag");
     tcase_add_unchecked_fixture(tag_case, tagged_yaml_setup, model_teardown);
@@ -616,6 +1005,7 @@ Suite *loader_suite(void)
     suite_add_tcase(loader, bad_input_case);
     suite_add_tcase(loader, file_case);
     suite_add_tcase(loader, string_case);
+    suite_add_tcase(loader, json_case);
     suite_add_tcase(loader, tag_case);
     suite_add_tcase(loader, anchor_case);
     suite_add_tcase(loader, duplicate_clobber_case);
@@ -36,7 +36,10 @@
  */
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <errno.h>
+#include <string.h>
+#include <regex.h>
 
 #include <check.h>
 
@@ -105,6 +108,16 @@ START_TEST (null_scalar)
     reset_errno();
     assert_null(scalar_value(NULL));
     assert_errno(EINVAL);
+
+    int64_t integer;
+    reset_errno();
+    assert_false(scalar_integer(NULL, &integer));
+    assert_errno(EINVAL);
+
+    double number;
+    reset_errno();
+    assert_false(scalar_number(NULL, &number));
+    assert_errno(EINVAL);
 }
 END_TEST
 
@@ -216,6 +229,68 @@ START_TEST (constructors)
     assert_noerr();
     assert_not_null(d);
     node_free(node(d)); // N.B. - this will also free `s'
+
+    // short values are stored in the node, longer ones are allocated, either way callers see the same bytes
+    const char *short_value = "us-east-1";
+    const char *long_value = "a value longer than the inline storage";
+    Scalar *inlined = make_scalar_node((uint8_t *)short_value, strlen(short_value), SCALAR_STRING);
+    Scalar *allocated = make_scalar_node((uint8_t *)long_value, strlen(long_value), SCALAR_STRING);
+    assert_not_null(inlined);
+    assert_not_null(allocated);
+    assert_true(inlined->inlined);
+    assert_false(allocated->inlined);
+    assert_ptr_eq(inlined->storage.bytes, scalar_value(inlined));
+    assert_uint_eq(strlen(short_value), node_size(node(inlined)));
+    assert_buf_eq(short_value, strlen(short_value), scalar_value(inlined), node_size(node(inlined)));
+    assert_uint_eq(strlen(long_value), node_size(node(allocated)));
+    assert_buf_eq(long_value, strlen(long_value), scalar_value(allocated), node_size(node(allocated)));
+    Scalar *empty = make_scalar_node(NULL, 0, SCALAR_STRING);
+    assert_not_null(scalar_value(empty));
+    node_free(node(inlined));
+    node_free(node(allocated));
+    node_free(node(empty));
+}
+END_TEST
+
+START_TEST (arena_constructors)
+{
+    DocumentModel *m = make_model();
+    assert_not_null(m);
+    Arena *arena = model_arena(m);
+    assert_not_null(arena);
+    assert_uint_eq(0, model_arena_stats(m).chunks);
+
+    reset_errno();
+    Document *d = make_document_node_in(arena);
+    Mapping *map = make_mapping_node_in(arena);
+    Sequence *seq = make_sequence_node_in(arena);
+    assert_noerr();
+    assert_true(model_add(m, d));
+    assert_true(document_set_root(d, node(map)));
+    assert_true(mapping_put(map, (uint8_t *)"items", 5, node(seq)));
+    for(size_t i = 0; i < 100; i++)
+    {
+        assert_true(sequence_add(seq, node(make_scalar_node_in(arena, (uint8_t *)"item", 4, SCALAR_STRING))));
+    }
+    node_set_tag(seq, (uint8_t *)"!list", 5);
+
+    assert_node_size(seq, 100);
+    assert_node_tag(node(seq), "!list");
+    assert_scalar_value(sequence_get(seq, 99), "item");
+    assert_ptr_eq(node(seq), mapping_get(map, (uint8_t *)"items", 5));
+
+    ArenaStats stats = model_arena_stats(m);
+    assert_uint_eq(1, stats.chunks);
+    assert_true(stats.used <= stats.reserved);
+    // N.B. - short values live in their scalar nodes, so each scalar is a single allocation
+    assert_true(stats.allocations > 100);
+    assert_true(stats.allocations < 200);
+
+    // N.B. - arena nodes are left for the arena to release
+    node_free(seq);
+    assert_node_size(seq, 100);
+
+    model_free(m);
 }
 END_TEST
 
@@ -232,7 +307,7 @@ START_TEST (document_type)
     assert_not_null(d);
     
     reset_errno();
-    Node *bogus = model_document(model, 1);
+    Document *bogus = model_document(model, 1);
     assert_errno(EINVAL);
     assert_null(bogus);
     
@@ -267,6 +342,18 @@ START_TEST (nodes)
     size_t s = node_size(r);
     assert_noerr();
     assert_uint_eq(4, s);
+
+    // tags and anchors are set independently, and only cost space when present
+    Scalar *tagged = make_scalar_node((uint8_t *)"x", 1, SCALAR_STRING);
+    assert_not_null(tagged);
+    assert_null(node(tagged)->properties);
+    node_set_anchor(tagged, (uint8_t *)"anchor", 6);
+    assert_buf_eq("anchor", 7, node_anchor(tagged), 7);
+    assert_null(node_name(tagged));
+    node_set_tag(tagged, (uint8_t *)"!custom", 7);
+    assert_buf_eq("!custom", 8, node_name(tagged), 8);
+    assert_buf_eq("anchor", 7, node_anchor(tagged), 7);
+    node_free(tagged);
 }
 END_TEST
 
@@ -313,6 +400,48 @@ START_TEST (scalar_boolean)
 }
 END_TEST
 
+START_TEST (scalar_numbers)
+{
+    int64_t integer;
+    double number;
+
+    Scalar *answer = make_scalar_node((uint8_t *)"-42", 3, SCALAR_INTEGER);
+    assert_true(scalar_integer(answer, &integer));
+    assert_int_eq(-42, integer);
+    assert_true(scalar_number(answer, &number));
+    assert_true(-42.0 <= number && -42.0 >= number);
+    node_free(node(answer));
+
+    Scalar *plain = make_scalar_node((uint8_t *)"0.125", 5, SCALAR_UNRESOLVED);
+    assert_false(scalar_integer(plain, &integer));
+    assert_true(scalar_number(plain, &number));
+    assert_true(0.125 <= number && 0.125 >= number);
+    assert_int_eq(SCALAR_REAL, scalar_kind(plain));
+    node_free(node(plain));
+
+    Scalar *huge = make_scalar_node((uint8_t *)"123456789012345678901", 21, SCALAR_INTEGER);
+    assert_false(scalar_integer(huge, &integer));
+    assert_true(scalar_number(huge, &number));
+    assert_true(1.23456789012345678901e20 <= number && 1.23456789012345678901e20 >= number);
+    node_free(node(huge));
+
+    Scalar *extreme = make_scalar_node((uint8_t *)"-9223372036854775808", 20, SCALAR_INTEGER);
+    assert_true(scalar_integer(extreme, &integer));
+    assert_true(INT64_MIN == integer);
+    node_free(node(extreme));
+
+    Scalar *tagged = make_scalar_node((uint8_t *)"0x1F", 4, SCALAR_INTEGER);
+    assert_false(scalar_integer(tagged, &integer));
+    assert_false(scalar_number(tagged, &number));
+    node_free(node(tagged));
+
+    Scalar *text = make_scalar_node((uint8_t *)"12", 2, SCALAR_STRING);
+    assert_false(scalar_integer(text, &integer));
+    assert_false(scalar_number(text, &number));
+    node_free(node(text));
+}
+END_TEST
+
 START_TEST (sequence_type)
 {
     reset_errno();
@@ -394,6 +523,163 @@ START_TEST (mapping_type)
     assert_noerr();
     assert_not_null(scalar_value);
     assert_node_kind(scalar_value, SCALAR);
+
+    // keys are borrowed for the lookup, they need not be terminated
+    uint8_t *buffer = (uint8_t *)"threefour";
+    assert_ptr_eq(mapping_get(mapping(r), (uint8_t *)"three", 5), mapping_get(mapping(r), buffer, 5));
+    assert_ptr_eq(mapping_get(mapping(r), (uint8_t *)"four", 4), mapping_get(mapping(r), buffer + 5, 4));
+    assert_true(mapping_contains(mapping(r), buffer, 5));
+    assert_false(mapping_contains(mapping(r), buffer, 4));
+
+    // tagged keys only match tagged keys, as before
+    Mapping *tagged = make_mapping_node();
+    Scalar *key = make_scalar_node((uint8_t *)"key", 3, SCALAR_STRING);
+    node_set_tag(key, (uint8_t *)"!custom", 7);
+    hashtable_put(tagged->values, key, make_scalar_node((uint8_t *)"value", 5, SCALAR_STRING));
+    assert_false(mapping_contains(tagged, (uint8_t *)"key", 3));
+    node_free(tagged);
+}
+END_TEST
+
+START_TEST (interned_keys)
+{
+    DocumentModel *symbols = make_model();
+    assert_not_null(symbols);
+    assert_null(model_symbol(symbols, (uint8_t *)"name", 4));
+
+    reset_errno();
+    Scalar *name = model_intern(symbols, (uint8_t *)"name", 4);
+    assert_noerr();
+    assert_not_null(name);
+    assert_true(name->interned);
+    assert_ptr_eq(name, model_intern(symbols, (uint8_t *)"names", 4));
+    assert_ptr_eq(name, model_symbol(symbols, (uint8_t *)"name", 4));
+    Scalar *long_name = model_intern(symbols, (uint8_t *)"a key longer than the inline capacity", 37);
+    assert_not_null(long_name);
+    assert_ptr_ne(name, long_name);
+
+    // the key is shared, and still found by its bytes
+    Mapping *one = make_mapping_node_in(model_arena(symbols));
+    Mapping *two = make_mapping_node_in(model_arena(symbols));
+    assert_true(mapping_put_key(one, name, node(make_scalar_node_in(model_arena(symbols), (uint8_t *)"x", 1, SCALAR_STRING))));
+    assert_true(mapping_put_key(two, name, node(make_scalar_node_in(model_arena(symbols), (uint8_t *)"y", 1, SCALAR_STRING))));
+    assert_true(mapping_put_key(two, long_name, node(make_scalar_node_in(model_arena(symbols), (uint8_t *)"z", 1, SCALAR_STRING))));
+    assert_scalar_value(mapping_get_key(one, name), "x");
+    assert_scalar_value(mapping_get_key(two, name), "y");
+    assert_null(mapping_get_key(one, long_name));
+    assert_scalar_value(mapping_get(two, (uint8_t *)"name", 4), "y");
+    assert_scalar_value(mapping_get(two, (uint8_t *)"a key longer than the inline capacity", 37), "z");
+
+    // only the model's own mappings may share its keys
+    Mapping *heap = make_mapping_node();
+    reset_errno();
+    assert_false(mapping_put_key(heap, name, node(make_scalar_node_in(model_arena(symbols), (uint8_t *)"x", 1, SCALAR_STRING))));
+    assert_errno(EINVAL);
+    reset_errno();
+    Scalar *plain = make_scalar_node_in(model_arena(symbols), (uint8_t *)"name", 4, SCALAR_STRING);
+    assert_false(mapping_put_key(one, plain, node(plain)));
+    assert_errno(EINVAL);
+    node_free(heap);
+
+    // keys interned by another model are equal by value
+    DocumentModel *other = make_model();
+    assert_not_null(other);
+    Scalar *other_name = model_intern(other, (uint8_t *)"name", 4);
+    assert_ptr_ne(name, other_name);
+    assert_scalar_value(mapping_get_key(one, other_name), "x");
+    model_free(other);
+
+    model_free(symbols);
+}
+END_TEST
+
+struct found_keys
+{
+    size_t count;
+    Node  *values[4];
+};
+
+static bool found_key_iterator(Node *key __attribute__((unused)), Node *value, void *context)
+{
+    struct found_keys *found = (struct found_keys *)context;
+    if(4 == found->count)
+    {
+        return false;
+    }
+    found->values[found->count++] = value;
+    return true;
+}
+
+START_TEST (name_index)
+{
+    // the fixture's keys weren't interned
+    assert_false(model_index_names(model));
+
+    DocumentModel *indexed = make_model();
+    assert_not_null(indexed);
+    Arena *arena = model_arena(indexed);
+    Scalar *name = model_intern(indexed, (uint8_t *)"name", 4);
+    Scalar *inner = model_intern(indexed, (uint8_t *)"inner", 5);
+    Scalar *list = model_intern(indexed, (uint8_t *)"list", 4);
+    Scalar *unused = model_intern(indexed, (uint8_t *)"unused", 6);
+
+    // {inner: {name: x, list: [{name: y}]}, name: z}
+    Mapping *root = make_mapping_node_in(arena);
+    Mapping *middle = make_mapping_node_in(arena);
+    Mapping *item = make_mapping_node_in(arena);
+    Sequence *items = make_sequence_node_in(arena);
+    Scalar *x = make_scalar_node_in(arena, (uint8_t *)"x", 1, SCALAR_STRING);
+    Scalar *y = make_scalar_node_in(arena, (uint8_t *)"y", 1, SCALAR_STRING);
+    Scalar *z = make_scalar_node_in(arena, (uint8_t *)"z", 1, SCALAR_STRING);
+    assert_true(mapping_put_key(item, name, node(y)));
+    assert_true(sequence_add(items, node(item)));
+    assert_true(mapping_put_key(middle, name, node(x)));
+    assert_true(mapping_put_key(middle, list, node(items)));
+    assert_true(mapping_put_key(root, inner, node(middle)));
+    assert_true(mapping_put_key(root, name, node(z)));
+    Document *doc = make_document_node_in(arena);
+    assert_true(document_set_root(doc, node(root)));
+    assert_true(model_add(indexed, doc));
+
+    reset_errno();
+    assert_false(model_find_key(indexed, node(root), name, found_key_iterator, &(struct found_keys){0}));
+    assert_errno(EINVAL);
+
+    reset_errno();
+    assert_true(model_index_names(indexed));
+    assert_noerr();
+
+    // holders are found in document order, and only below the given node
+    struct found_keys found = {0};
+    assert_true(model_find_key(indexed, node(doc), name, found_key_iterator, &found));
+    assert_uint_eq(3, found.count);
+    assert_ptr_eq(node(z), found.values[0]);
+    assert_ptr_eq(node(x), found.values[1]);
+    assert_ptr_eq(node(y), found.values[2]);
+
+    found.count = 0;
+    assert_true(model_find_key(indexed, node(middle), name, found_key_iterator, &found));
+    assert_uint_eq(2, found.count);
+    assert_ptr_eq(node(x), found.values[0]);
+    assert_ptr_eq(node(y), found.values[1]);
+
+    found.count = 0;
+    assert_true(model_find_key(indexed, node(items), name, found_key_iterator, &found));
+    assert_uint_eq(1, found.count);
+    assert_ptr_eq(node(y), found.values[0]);
+
+    found.count = 0;
+    assert_true(model_find_key(indexed, node(z), name, found_key_iterator, &found));
+    assert_true(model_find_key(indexed, node(root), unused, found_key_iterator, &found));
+    assert_uint_eq(0, found.count);
+
+    // nodes below an alias aren't below it in document order, so a model with one can't be indexed
+    Document *aliased = make_document_node_in(arena);
+    assert_true(document_set_root(aliased, node(make_alias_node_in(arena, node(middle)))));
+    assert_true(model_add(indexed, aliased));
+    assert_false(model_index_names(indexed));
+
+    model_free(indexed);
 }
 END_TEST
 
@@ -522,6 +808,334 @@ bool fail_mapping(Node *key, Node *value, void *context)
     }
 }
 
+static bool collect_keys(Node *key, Node *value __attribute__((unused)), void *context)
+{
+    return vector_add((Vector *)context, key);
+}
+
+static void assert_key_order(const Mapping *map, const char * const *expected, size_t count)
+{
+    Vector *keys = make_vector();
+    assert_not_null(keys);
+    assert_true(mapping_iterate(map, collect_keys, keys));
+    assert_uint_eq(count, vector_length(keys));
+    for(size_t i = 0; i < count; i++)
+    {
+        Node *key = vector_get(keys, i);
+        assert_uint_eq(strlen(expected[i]), node_size(key));
+        assert_buf_eq(expected[i], strlen(expected[i]), scalar_value(scalar(key)), node_size(key));
+    }
+    vector_free(keys);
+}
+
+START_TEST (mapping_iteration_order)
+{
+    reset_errno();
+    Node *r = model_document_root(model, 0);
+    assert_not_null(r);
+    static const char * const fixture_keys[] = {"one", "two", "three", "four"};
+    assert_key_order(mapping(r), fixture_keys, 4);
+
+    // enough keys to grow the table past its narrow slots, then replace a value and remove every other key
+    Mapping *map = make_mapping_node();
+    assert_not_null(map);
+    char names[300][5];
+    for(size_t i = 0; i < 300; i++)
+    {
+        snprintf(names[i], sizeof(names[i]), "k%03zu", 299 - i);
+        assert_true(mapping_put(map, (uint8_t *)names[i], 4, node(make_scalar_node((uint8_t *)"v", 1, SCALAR_STRING))));
+    }
+    Vector *keys = make_vector();
+    assert_not_null(keys);
+    assert_true(mapping_iterate(map, collect_keys, keys));
+    assert_uint_eq(300, vector_length(keys));
+
+    node_free(hashtable_put(map->values, vector_get(keys, 1), make_scalar_node((uint8_t *)"w", 1, SCALAR_STRING)));
+    for(size_t i = 0; i < 300; i += 2)
+    {
+        Node *key = vector_get(keys, i);
+        node_free(hashtable_remove(map->values, key));
+        node_free(key);
+    }
+    vector_free(keys);
+
+    const char *expected[300];
+    for(size_t i = 0; i < 150; i++)
+    {
+        expected[i] = names[i * 2 + 1];
+        assert_not_null(mapping_get(map, (uint8_t *)names[i * 2 + 1], 4));
+        assert_null(mapping_get(map, (uint8_t *)names[i * 2], 4));
+    }
+    assert_key_order(map, expected, 150);
+
+    // refilling squeezes the removed entries out, the survivors keep their order ahead of the new keys
+    char more[150][5];
+    for(size_t i = 0; i < 150; i++)
+    {
+        snprintf(more[i], sizeof(more[i]), "m%03zu", i);
+        expected[150 + i] = more[i];
+        assert_true(mapping_put(map, (uint8_t *)more[i], 4, node(make_scalar_node((uint8_t *)"v", 1, SCALAR_STRING))));
+    }
+    assert_key_order(map, expected, 300);
+    node_free(node(map));
+}
+END_TEST
+
+/*
+ * The regular expressions the loader used to type plain scalars before the
+ * classifier replaced them, kept here as the reference for the differential
+ * tests below.
+ */
+static const char * const DECIMAL_PATTERN = "^-?(0|([1-9][[:digit:]]*))([.][[:digit:]]+)?([eE][+-]?[[:digit:]]+)?$";
+static const char * const INTEGER_PATTERN = "^-?(0|([1-9][[:digit:]]*))$";
+static const char * const TIMESTAMP_PATTERN = "^[0-9][0-9][0-9][0-9]-[0-9][0-9]?-[0-9][0-9]?(([Tt]|[ \t]+)[0-9][0-9]?:[0-9][0-9](:[0-9][0-9])?([.][0-9]+)?([ \t]*(Z|([-+][0-9][0-9]?(:[0-9][0-9])?)))?)?$";
+
+static regex_t integer_regex;
+static regex_t decimal_regex;
+static regex_t timestamp_regex;
+
+static void classifier_setup(void)
+{
+    ck_assert_int_eq(0, regcomp(&integer_regex, INTEGER_PATTERN, REG_EXTENDED | REG_NOSUB));
+    ck_assert_int_eq(0, regcomp(&decimal_regex, DECIMAL_PATTERN, REG_EXTENDED | REG_NOSUB));
+    ck_assert_int_eq(0, regcomp(&timestamp_regex, TIMESTAMP_PATTERN, REG_EXTENDED | REG_NOSUB));
+}
+
+static void classifier_teardown(void)
+{
+    regfree(&integer_regex);
+    regfree(&decimal_regex);
+    regfree(&timestamp_regex);
+}
+
+static ScalarKind regex_scalar_kind(const char *value)
+{
+    if(0 == regexec(&integer_regex, value, 0, NULL, 0))
+    {
+        return SCALAR_INTEGER;
+    }
+    if(0 == regexec(&decimal_regex, value, 0, NULL, 0))
+    {
+        return SCALAR_REAL;
+    }
+    if(0 == regexec(&timestamp_regex, value, 0, NULL, 0))
+    {
+        return SCALAR_TIMESTAMP;
+    }
+    return SCALAR_STRING;
+}
+
+#define assert_same_kind(VALUE, LENGTH)                                 \
+    ck_assert_msg(regex_scalar_kind((VALUE)) == classify_scalar_value((const uint8_t *)(VALUE), (LENGTH)), \
+                  "classifier disagrees with the regular expressions on \"%s\"", (VALUE))
+
+#define assert_classified(VALUE, KIND) assert_int_eq((KIND), classify_scalar_value((const uint8_t *)(VALUE), strlen((VALUE))))
+
+START_TEST (classify_scalars)
+{
+    assert_classified("", SCALAR_STRING);
+    assert_classified("null", SCALAR_NULL);
+    assert_classified("true", SCALAR_BOOLEAN);
+    assert_classified("false", SCALAR_BOOLEAN);
+    assert_classified("nul", SCALAR_STRING);
+    assert_classified("fals", SCALAR_STRING);
+    assert_classified("0", SCALAR_INTEGER);
+    assert_classified("-0", SCALAR_INTEGER);
+    assert_classified("1234", SCALAR_INTEGER);
+    assert_classified("-98765", SCALAR_INTEGER);
+    assert_classified("0123", SCALAR_STRING);
+    assert_classified("1.5", SCALAR_REAL);
+    assert_classified("-0.5e-10", SCALAR_REAL);
+    assert_classified("6e23", SCALAR_REAL);
+    assert_classified("1.", SCALAR_STRING);
+    assert_classified(".5", SCALAR_STRING);
+    assert_classified("2001-12-14", SCALAR_TIMESTAMP);
+    assert_classified("0123-4-5", SCALAR_TIMESTAMP);
+    assert_classified("2001-12-14t21:59:43.10-05:00", SCALAR_TIMESTAMP);
+    assert_classified("2001-12-14 21:59:43.10 -5", SCALAR_TIMESTAMP);
+    assert_classified("2001-12-15T02:59:43.1Z", SCALAR_TIMESTAMP);
+    assert_classified("2001-12-15 2:59", SCALAR_TIMESTAMP);
+    assert_classified("2001-12-15 2:59 ", SCALAR_STRING);
+    assert_classified("2001-12-15T", SCALAR_STRING);
+    assert_classified("12345-01-01", SCALAR_STRING);
+
+    // values are classified by length, not by a terminator
+    assert_int_eq(SCALAR_INTEGER, classify_scalar_value((const uint8_t *)"12ab", 2));
+}
+END_TEST
+
+static const char EXHAUSTIVE_ALPHABET[] = "019-+.eETt \t:Zx";
+
+START_TEST (classifier_matches_regex_exhaustively)
+{
+    // every string of up to five characters drawn from the characters that drive the patterns
+    size_t radix = sizeof(EXHAUSTIVE_ALPHABET) - 1;
+    char value[6];
+    for(size_t length = 0; length <= 5; length++)
+    {
+        size_t total = 1;
+        for(size_t i = 0; i < length; i++)
+        {
+            total *= radix;
+        }
+        for(size_t n = 0; n < total; n++)
+        {
+            size_t digits = n;
+            for(size_t i = 0; i < length; i++)
+            {
+                value[i] = EXHAUSTIVE_ALPHABET[digits % radix];
+                digits /= radix;
+            }
+            value[length] = '\0';
+            assert_same_kind(value, length);
+        }
+    }
+}
+END_TEST
+
+static const char * const MUTATION_SEEDS[] =
+{
+    "-0.5e+10",
+    "123456789.000001E-7",
+    "2001-12-14",
+    "2001-1-4t1:59:43.10-05:00",
+    "2001-12-14 \t21:59:43.10 \t-5",
+    "2001-12-15T02:59:43.1Z",
+    "2002-12-14 21:59 +05:30"
+};
+
+static const char MUTATION_ALPHABET[] = "0123456789-+.eETt \t:Zz";
+
+START_TEST (classifier_matches_regex_on_mutations)
+{
+    // random substitutions, insertions and deletions applied to valid numbers and timestamps
+    uint32_t state = 0x9e3779b9u;
+    char value[64];
+    for(size_t seed = 0; seed < sizeof(MUTATION_SEEDS) / sizeof(MUTATION_SEEDS[0]); seed++)
+    {
+        for(size_t round = 0; round < 20000; round++)
+        {
+            size_t length = strlen(MUTATION_SEEDS[seed]);
+            memcpy(value, MUTATION_SEEDS[seed], length + 1);
+            assert_same_kind(value, length);
+
+            size_t edits = 1 + round % 3;
+            for(size_t edit = 0; edit < edits && 0 < length; edit++)
+            {
+                state ^= state << 13;
+                state ^= state >> 17;
+                state ^= state << 5;
+                size_t at = state % length;
+                char c = MUTATION_ALPHABET[(state >> 8) % (sizeof(MUTATION_ALPHABET) - 1)];
+                switch((state >> 16) % 3)
+                {
+                    case 0:
+                        value[at] = c;
+                        break;
+                    case 1:
+                        memmove(value + at + 1, value + at, length - at + 1);
+                        value[at] = c;
+                        length++;
+                        break;
+                    default:
+                        memmove(value + at, value + at + 1, length - at);
+                        length--;
+                        break;
+                }
+            }
+            assert_same_kind(value, length);
+        }
+    }
+}
+END_TEST
+
+static void assert_same_number(const char *value)
+{
+    size_t length = strlen(value);
+    int64_t integer = 0;
+    double real = 0.0;
+    enum scalar_number_state state = parse_scalar_number((const uint8_t *)value, length, &integer, &real);
+
+    char *end;
+    double expected = strtod(value, &end);
+    if(NUMBER_INTEGER == state)
+    {
+        long long exact = strtoll(value, NULL, 10);
+        ck_assert_msg(exact == integer, "\"%s\" parsed as %lld, not %lld", value, (long long)integer, exact);
+        real = (double)integer;
+    }
+    ck_assert_msg(NUMBER_INVALID != state, "\"%s\" was not parsed", value);
+    ck_assert_msg(0 == memcmp(&expected, &real, sizeof(double)) || (0.0 == expected && 0.0 == real),
+                  "\"%s\" parsed as %.17g, not %.17g", value, real, expected);
+}
+
+START_TEST (parse_numbers)
+{
+    int64_t integer;
+    double real;
+    assert_int_eq(NUMBER_INVALID, parse_scalar_number((const uint8_t *)"", 0, &integer, &real));
+    assert_int_eq(NUMBER_INVALID, parse_scalar_number((const uint8_t *)"-", 1, &integer, &real));
+    assert_int_eq(NUMBER_INVALID, parse_scalar_number((const uint8_t *)"1e", 2, &integer, &real));
+    assert_int_eq(NUMBER_INVALID, parse_scalar_number((const uint8_t *)"1.2.3", 5, &integer, &real));
+    assert_int_eq(NUMBER_INVALID, parse_scalar_number((const uint8_t *)"inf", 3, &integer, &real));
+    assert_int_eq(NUMBER_INTEGER, parse_scalar_number((const uint8_t *)"9223372036854775807", 19, &integer, &real));
+    assert_true(INT64_MAX == integer);
+    assert_int_eq(NUMBER_REAL, parse_scalar_number((const uint8_t *)"9223372036854775808", 19, &integer, &real));
+
+    // values are parsed by length, not by a terminator
+    assert_int_eq(NUMBER_INTEGER, parse_scalar_number((const uint8_t *)"12.5", 2, &integer, &real));
+    assert_int_eq(12, integer);
+
+    assert_same_number("0");
+    assert_same_number("-0.0");
+    assert_same_number("8.95");
+    assert_same_number("0.1");
+    assert_same_number("0.000123");
+    assert_same_number("-1.5e-7");
+    assert_same_number("6e23");
+    assert_same_number("9007199254740993");
+    assert_same_number("9007199254740993.0");
+    assert_same_number("2.2250738585072011e-308");
+    assert_same_number("4.9e-324");
+    assert_same_number("1.7976931348623157e308");
+    assert_same_number("1e400");
+    assert_same_number("0.30000000000000000000000000000000000001");
+    assert_same_number("123456789012345678901234567890e-10");
+}
+END_TEST
+
+START_TEST (number_parser_matches_strtod)
+{
+    // random significands and exponents, on and off the exact fast path
+    uint64_t state = 0x9e3779b97f4a7c15u;
+    char value[64];
+    for(size_t round = 0; round < 200000; round++)
+    {
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+        uint64_t significand = state >> (state % 60);
+        int exponent = (int)((state >> 8) % 80) - 40;
+        switch(round % 4)
+        {
+            case 0:
+                snprintf(value, sizeof(value), "%llu", (unsigned long long)significand);
+                break;
+            case 1:
+                snprintf(value, sizeof(value), "-%llue%d", (unsigned long long)significand, exponent);
+                break;
+            case 2:
+                snprintf(value, sizeof(value), "%llu.%03u", (unsigned long long)(significand >> 20), (unsigned)(state % 1000));
+                break;
+            default:
+                snprintf(value, sizeof(value), "0.%llu", (unsigned long long)significand);
+                break;
+        }
+        assert_same_number(value);
+    }
+}
+END_TEST
+
 Suite *model_suite(void)
 {
     TCase *bad_input = tcase_create("bad input");
@@ -535,12 +1149,16 @@ Suite *model_suite(void)
     TCase *basic = tcase_create("basic");
     tcase_add_checked_fixture(basic, model_setup, model_teardown);
     tcase_add_test(basic, constructors);
+    tcase_add_test(basic, arena_constructors);
     tcase_add_test(basic, document_type);
     tcase_add_test(basic, nodes);
     tcase_add_test(basic, scalar_type);
     tcase_add_test(basic, scalar_boolean);
+    tcase_add_test(basic, scalar_numbers);
     tcase_add_test(basic, sequence_type);
     tcase_add_test(basic, mapping_type);
+    tcase_add_test(basic, interned_keys);
+    tcase_add_test(basic, name_index);
 
     TCase *iteration = tcase_create("iteration");
     tcase_add_checked_fixture(iteration, model_setup, model_teardown);
@@ -548,11 +1166,21 @@ Suite *model_suite(void)
     tcase_add_test(iteration, mapping_iteration);
     tcase_add_test(iteration, fail_sequence_iteration);
     tcase_add_test(iteration, fail_mapping_iteration);
+    tcase_add_test(iteration, mapping_iteration_order);
+
+    TCase *classifier = tcase_create("classifier");
+    tcase_add_unchecked_fixture(classifier, classifier_setup, classifier_teardown);
+    tcase_add_test(classifier, classify_scalars);
+    tcase_add_test(classifier, classifier_matches_regex_exhaustively);
+    tcase_add_test(classifier, classifier_matches_regex_on_mutations);
+    tcase_add_test(classifier, parse_numbers);
+    tcase_add_test(classifier, number_parser_matches_strtod);
 
     Suite *suite = suite_create("Model");
     suite_add_tcase(suite, bad_input);
     suite_add_tcase(suite, basic);
     suite_add_tcase(suite, iteration);
+    suite_add_tcase(suite, classifier);
     
     return suite;
 }
@@ -366,6 +366,38 @@ START_TEST (bogus_predicate)
 }
 END_TEST
 
+START_TEST (filter_predicate_missing_operand)
+{
+    char *expression = "$.foo[?(@.bar < )]";
+    reset_errno();
+    parser_context *context = make_parser((uint8_t *)expression, strlen(expression));
+    assert_not_null(context);
+    assert_noerr();
+
+    jsonpath *path = parse(context);
+
+    assert_parser_failure(expression, context, path, ERR_EXPECTED_FILTER_OPERAND, 16);
+    parser_free(context);
+    path_free(path);
+}
+END_TEST
+
+START_TEST (filter_predicate_lone_literal)
+{
+    char *expression = "$.foo[?(42)]";
+    reset_errno();
+    parser_context *context = make_parser((uint8_t *)expression, strlen(expression));
+    assert_not_null(context);
+    assert_noerr();
+
+    jsonpath *path = parse(context);
+
+    assert_parser_failure(expression, context, path, ERR_EXPECTED_COMPARISON, 10);
+    parser_free(context);
+    path_free(path);
+}
+END_TEST
+
 START_TEST (bogus_type_test_name)
 {
     char *expression = "$.foo.monkey()";
@@ -959,6 +991,108 @@ START_TEST (subscript_predicate)
 }
 END_TEST
 
+START_TEST (filter_predicate)
+{
+    char *expression = "$.store.book[?(@.price < 10)].title";
+    reset_errno();
+    parser_context *context = make_parser((uint8_t *)expression, strlen(expression));
+    assert_not_null(context);
+    assert_noerr();
+
+    jsonpath *path = parse(context);
+
+    assert_parser_success(expression, context, path, ABSOLUTE_PATH, 4);
+    assert_root_step(path);
+    assert_single_name_step(path, 1, "store");
+    assert_single_name_step(path, 2, "book");
+    assert_predicate(path, 2, FILTER);
+    assert_single_name_step(path, 3, "title");
+    assert_no_predicate(path, 3);
+
+    filter *value = filter_predicate_expression(step_predicate(path_get(path, 2)));
+    assert_not_null(value);
+    assert_int_eq(COMPARISON_FILTER, filter_kind(value));
+    assert_int_eq(LESS_THAN, comparison_filter_operator(value));
+
+    operand *left = comparison_filter_left(value);
+    assert_int_eq(PATH_OPERAND, operand_kind(left));
+    jsonpath *field = path_operand(left);
+    assert_int_eq(RELATIVE_PATH, path_kind(field));
+    assert_path_length(field, 1);
+    assert_single_name_step(field, 0, "price");
+
+    operand *right = comparison_filter_right(value);
+    assert_int_eq(NUMBER_OPERAND, operand_kind(right));
+    assert_true(10.0 <= number_operand(right) && 10.0 >= number_operand(right));
+
+    path_free(path);
+    parser_free(context);
+}
+END_TEST
+
+START_TEST (filter_predicate_precedence)
+{
+    char *expression = "$.foo[?( @.a || @.b == 'x' && !(@.c != null) )]";
+    reset_errno();
+    parser_context *context = make_parser((uint8_t *)expression, strlen(expression));
+    assert_not_null(context);
+    assert_noerr();
+
+    jsonpath *path = parse(context);
+
+    assert_parser_success(expression, context, path, ABSOLUTE_PATH, 2);
+    assert_predicate(path, 1, FILTER);
+
+    filter *value = filter_predicate_expression(step_predicate(path_get(path, 1)));
+    assert_int_eq(OR_FILTER, filter_kind(value));
+    assert_int_eq(EXISTS_FILTER, filter_kind(filter_left(value)));
+    assert_int_eq(PATH_OPERAND, operand_kind(exists_filter_operand(filter_left(value))));
+
+    filter *conjunction = filter_right(value);
+    assert_int_eq(AND_FILTER, filter_kind(conjunction));
+    filter *equality = filter_left(conjunction);
+    assert_int_eq(COMPARISON_FILTER, filter_kind(equality));
+    assert_int_eq(EQUAL_TO, comparison_filter_operator(equality));
+    operand *literal = comparison_filter_right(equality);
+    assert_int_eq(STRING_OPERAND, operand_kind(literal));
+    assert_uint_eq(1, string_operand_length(literal));
+    assert_buf_eq("x", 1, string_operand(literal), 1);
+
+    filter *negation = filter_right(conjunction);
+    assert_int_eq(NOT_FILTER, filter_kind(negation));
+    filter *inequality = filter_negated(negation);
+    assert_int_eq(NOT_EQUAL_TO, comparison_filter_operator(inequality));
+    assert_int_eq(NULL_OPERAND, operand_kind(comparison_filter_right(inequality)));
+
+    path_free(path);
+    parser_free(context);
+}
+END_TEST
+
+START_TEST (filter_predicate_literal_on_left)
+{
+    char *expression = "$.foo[?(true == @.flag)]";
+    reset_errno();
+    parser_context *context = make_parser((uint8_t *)expression, strlen(expression));
+    assert_not_null(context);
+    assert_noerr();
+
+    jsonpath *path = parse(context);
+
+    assert_parser_success(expression, context, path, ABSOLUTE_PATH, 2);
+    assert_predicate(path, 1, FILTER);
+
+    filter *value = filter_predicate_expression(step_predicate(path_get(path, 1)));
+    assert_int_eq(COMPARISON_FILTER, filter_kind(value));
+    assert_int_eq(BOOLEAN_OPERAND, operand_kind(comparison_filter_left(value)));
+    assert_true(boolean_operand(comparison_filter_left(value)));
+    assert_int_eq(PATH_OPERAND, operand_kind(comparison_filter_right(value)));
+
+    path_free(path);
+    parser_free(context);
+}
+END_TEST
+
 START_TEST (subscript_predicate_with_whitespace)
 {
     char *expression = "$.foo  [\t42\r]\n.bar";
@@ -1427,6 +1561,8 @@ Suite *jsonpath_suite(void)
     tcase_add_test(bad_input_case, whitespace_predicate);
     tcase_add_test(bad_input_case, extra_junk_in_predicate);
     tcase_add_test(bad_input_case, bogus_predicate);
+    tcase_add_test(bad_input_case, filter_predicate_missing_operand);
+    tcase_add_test(bad_input_case, filter_predicate_lone_literal);
 
     TCase *basic_case = tcase_create("basic");
     tcase_add_test(basic_case, dollar_only);
@@ -1466,6 +1602,9 @@ Suite *jsonpath_suite(void)
     tcase_add_test(predicate_case, slice_predicate_with_whitespace);
     tcase_add_test(predicate_case, negative_step_slice_predicate);
     tcase_add_test(predicate_case, zero_step_slice_predicate);
+    tcase_add_test(predicate_case, filter_predicate);
+    tcase_add_test(predicate_case, filter_predicate_precedence);
+    tcase_add_test(predicate_case, filter_predicate_literal_on_left);
 
     TCase *api_case = tcase_create("api");
     tcase_add_test(api_case, bad_path_input);
@@ -0,0 +1,350 @@
+/*
+ * 金棒 (kanabō)
+ * Copyright (c) 2012 Kevin Birch <kmb@pobox.com>.  All rights reserved.
+ * 
+ * 金棒 is a tool to bludgeon YAML and JSON files from the shell: the strong
+ * made stronger.
+ *
+ * For more information, consult the README file in the project root.
+ *
+ * Distributed under an [MIT-style][license] license.
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal with
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * - Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimers.
+ * - Redistributions in binary form must reproduce the above copyright notice, this
+ *   list of conditions and the following disclaimers in the documentation and/or
+ *   other materials provided with the distribution.
+ * - Neither the names of the copyright holders, nor the names of the authors, nor
+ *   the names of other contributors may be used to endorse or promote products
+ *   derived from this Software without specific prior written permission.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE CONTRIBUTORS
+ * OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS WITH THE SOFTWARE.
+ *
+ * [license]: http://www.opensource.org/licenses/ncsa
+ */
+
+
+#ifdef __linux__
+#define _POSIX_C_SOURCE 200809L
+#define _GNU_SOURCE
+#endif
+
+#ifdef __APPLE__
+#define _DARWIN_SOURCE
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <check.h>
+
+#ifdef __linux__
+#include <dirent.h>
+#endif
+
+#include "reload.h"
+#include "loader.h"
+#include "test.h"
+#include "test_model.h"
+
+struct reports
+{
+    atomic_int published;
+    atomic_int failed;
+};
+
+static char directory[64];
+static char path[128];
+static epochs *readers = NULL;
+static atomic_model current;
+static struct reports reports;
+
+static void write_file(const char *name, const char *text)
+{
+    FILE *output = fopen(name, "w");
+    assert_not_null(output);
+    fputs(text, output);
+    assert_int_eq(0, fclose(output));
+}
+
+static DocumentModel *load_text(const char *text)
+{
+    MaybeDocument maybe = load_string((const unsigned char *)text, strlen(text), DUPE_CLOBBER, INPUT_AUTO);
+    assert_int_eq(JUST, maybe.tag);
+    return maybe.just;
+}
+
+static Node *version_of(DocumentModel *model)
+{
+    assert_not_null(model);
+    Node *root = model_document_root(model, 0);
+    assert_not_null(root);
+    return mapping_get(mapping(root), (uint8_t *)"version", 7);
+}
+
+static void record(const char *name __attribute__((unused)), const char *failure, void *context)
+{
+    struct reports *counts = (struct reports *)context;
+    atomic_fetch_add(NULL == failure ? &counts->published : &counts->failed, 1);
+}
+
+/* wait up to five seconds for the current model to be replaced */
+static bool replaced(DocumentModel *previous)
+{
+    const struct timespec pause = {0, 10000000};
+    for(size_t i = 0; i < 500 && previous == atomic_load(&current); i++)
+    {
+        nanosleep(&pause, NULL);
+    }
+    return previous != atomic_load(&current);
+}
+
+static void reload_setup(void)
+{
+    strcpy(directory, "/tmp/kanabo_reload_XXXXXX");
+    assert_not_null(mkdtemp(directory));
+    snprintf(path, sizeof(path), "%s/input.json", directory);
+    readers = make_epochs();
+    assert_not_null(readers);
+    atomic_init(&current, NULL);
+    atomic_init(&reports.published, 0);
+    atomic_init(&reports.failed, 0);
+}
+
+static void reload_teardown(void)
+{
+    model_free(atomic_load(&current));
+    epochs_free(readers);
+    unlink(path);
+    rmdir(directory);
+}
+
+struct publication
+{
+    DocumentModel *model;
+    atomic_bool    done;
+};
+
+static void *publish(void *context)
+{
+    struct publication *publication = (struct publication *)context;
+    model_publish(&current, publication->model, readers);
+    atomic_store(&publication->done, true);
+    return NULL;
+}
+
+START_TEST (publish_waits_for_readers)
+{
+    atomic_store(&current, load_text("{\"version\": 1}"));
+    epoch_reader *reader = epochs_join(readers);
+    assert_not_null(reader);
+
+    epoch_enter(reader);
+    DocumentModel *seen = atomic_load(&current);
+    struct publication publication = {load_text("{\"version\": 2}"), false};
+    pthread_t thread;
+    assert_int_eq(0, pthread_create(&thread, NULL, publish, &publication));
+
+    assert_true(replaced(seen));
+    const struct timespec pause = {0, 50000000};
+    nanosleep(&pause, NULL);
+    assert_false(atomic_load(&publication.done));
+    // N.B. - the replaced model is still whole while the reader is inside its epoch
+    assert_scalar_value(version_of(seen), "1");
+    epoch_leave(reader);
+
+    assert_int_eq(0, pthread_join(thread, NULL));
+    assert_true(atomic_load(&publication.done));
+    assert_scalar_value(version_of(atomic_load(&current)), "2");
+}
+END_TEST
+
+START_TEST (publish_after_readers_leave)
+{
+    epoch_reader *reader = epochs_join(readers);
+    assert_not_null(reader);
+    epoch_enter(reader);
+    epoch_leave(reader);
+
+    model_publish(&current, load_text("{\"version\": 1}"), readers);
+    model_publish(&current, load_text("{\"version\": 2}"), readers);
+    assert_scalar_value(version_of(atomic_load(&current)), "2");
+}
+END_TEST
+
+START_TEST (reload_publishes)
+{
+    reloader *reloads = make_reloader(readers, record, &reports);
+    assert_not_null(reloads);
+
+    write_file(path, "{\"version\": 1}");
+    assert_true(reload(reloads, &current, path, DUPE_CLOBBER, INPUT_AUTO));
+    reloader_settle(reloads);
+    assert_scalar_value(version_of(atomic_load(&current)), "1");
+
+    write_file(path, "version: 2\n");
+    assert_true(reload(reloads, &current, path, DUPE_CLOBBER, INPUT_AUTO));
+    reloader_settle(reloads);
+    assert_scalar_value(version_of(atomic_load(&current)), "2");
+
+    reloader_free(reloads);
+    assert_int_eq(2, atomic_load(&reports.published));
+    assert_int_eq(0, atomic_load(&reports.failed));
+}
+END_TEST
+
+START_TEST (reload_keeps_model_on_failure)
+{
+    reloader *reloads = make_reloader(readers, record, &reports);
+    assert_not_null(reloads);
+
+    write_file(path, "{\"version\": 1}");
+    assert_true(reload(reloads, &current, path, DUPE_CLOBBER, INPUT_AUTO));
+    reloader_settle(reloads);
+    DocumentModel *loaded = atomic_load(&current);
+
+    write_file(path, "{\"version\": ");
+    assert_true(reload(reloads, &current, path, DUPE_CLOBBER, INPUT_AUTO));
+    assert_true(reload(reloads, &current, "/nonexistent/input.json", DUPE_CLOBBER, INPUT_AUTO));
+    reloader_settle(reloads);
+
+    reloader_free(reloads);
+    assert_ptr_eq(loaded, atomic_load(&current));
+    assert_int_eq(1, atomic_load(&reports.published));
+    assert_int_eq(2, atomic_load(&reports.failed));
+}
+END_TEST
+
+#ifdef __linux__
+
+START_TEST (watch_reloads_changes)
+{
+    reloader *reloads = make_reloader(readers, record, &reports);
+    assert_not_null(reloads);
+
+    write_file(path, "{\"version\": 1}");
+    assert_true(reload(reloads, &current, path, DUPE_CLOBBER, INPUT_AUTO));
+    reloader_settle(reloads);
+    assert_true(reloader_watch(reloads, &current, path, DUPE_CLOBBER, INPUT_AUTO));
+    epoch_reader *reader = epochs_join(readers);
+    assert_not_null(reader);
+
+    // rewritten in place
+    DocumentModel *previous = atomic_load(&current);
+    write_file(path, "{\"version\": 2}");
+    assert_true(replaced(previous));
+    // N.B. - the reloader frees each model it replaces, so like any reader this one only looks inside an epoch
+    epoch_enter(reader);
+    assert_scalar_value(version_of(atomic_load(&current)), "2");
+    epoch_leave(reader);
+
+    // replaced by renaming another file over it
+    char sibling[160];
+    snprintf(sibling, sizeof(sibling), "%s/input.json.new", directory);
+    write_file(sibling, "{\"version\": 3}");
+    previous = atomic_load(&current);
+    assert_int_eq(0, rename(sibling, path));
+    assert_true(replaced(previous));
+    epoch_enter(reader);
+    assert_scalar_value(version_of(atomic_load(&current)), "3");
+    epoch_leave(reader);
+
+    reloader_free(reloads);
+}
+END_TEST
+
+/* how many inotify watches the process holds, as the kernel reports them */
+static size_t count_watches(void)
+{
+    DIR *descriptors = opendir("/proc/self/fdinfo");
+    assert_not_null(descriptors);
+    size_t count = 0;
+    struct dirent *each;
+    while(NULL != (each = readdir(descriptors)))
+    {
+        char name[300];
+        snprintf(name, sizeof(name), "/proc/self/fdinfo/%s", each->d_name);
+        FILE *info = fopen(name, "r");
+        if(NULL == info)
+        {
+            continue;
+        }
+        char line[512];
+        while(NULL != fgets(line, sizeof(line), info))
+        {
+            count += 0 == strncmp("inotify wd:", line, 11);
+        }
+        fclose(info);
+    }
+    closedir(descriptors);
+    return count;
+}
+
+START_TEST (watch_replaces_directory)
+{
+    char elsewhere[64];
+    strcpy(elsewhere, "/tmp/kanabo_reload_XXXXXX");
+    assert_not_null(mkdtemp(elsewhere));
+    char other[128];
+    snprintf(other, sizeof(other), "%s/other.json", elsewhere);
+    write_file(path, "{\"version\": 1}");
+    write_file(other, "{\"version\": 2}");
+
+    reloader *reloads = make_reloader(readers, record, &reports);
+    assert_not_null(reloads);
+    assert_true(reloader_watch(reloads, &current, path, DUPE_CLOBBER, INPUT_AUTO));
+    assert_uint_eq(1, count_watches());
+
+    // N.B. - inotify gives the directory the same descriptor again, which must stay watched
+    assert_true(reloader_watch(reloads, &current, path, DUPE_CLOBBER, INPUT_AUTO));
+    assert_uint_eq(1, count_watches());
+
+    assert_true(reloader_watch(reloads, &current, other, DUPE_CLOBBER, INPUT_AUTO));
+    assert_uint_eq(1, count_watches());
+
+    reloader_free(reloads);
+    unlink(other);
+    rmdir(elsewhere);
+}
+END_TEST
+
+#endif
+
+Suite *reload_suite(void)
+{
+    TCase *publish_case = tcase_create("publish");
+    tcase_add_checked_fixture(publish_case, reload_setup, reload_teardown);
+    tcase_add_test(publish_case, publish_waits_for_readers);
+    tcase_add_test(publish_case, publish_after_readers_leave);
+
+    TCase *reload_case = tcase_create("reload");
+    tcase_add_checked_fixture(reload_case, reload_setup, reload_teardown);
+    tcase_add_test(reload_case, reload_publishes);
+    tcase_add_test(reload_case, reload_keeps_model_on_failure);
+#ifdef __linux__
+    tcase_add_test(reload_case, watch_reloads_changes);
+    tcase_add_test(reload_case, watch_replaces_directory);
+#endif
+
+    Suite *suite = suite_create("Reload");
+    suite_add_tcase(suite, publish_case);
+    suite_add_tcase(suite, reload_case);
+
+    return suite;
+}
@@ -0,0 +1,398 @@
+/*
+ * 金棒 (kanabō)
+ * Copyright (c) 2012 Kevin Birch <kmb@pobox.com>.  All rights reserved.
+ * 
+ * 金棒 is a tool to bludgeon YAML and JSON files from the shell: the strong
+ * made stronger.
+ *
+ * For more information, consult the README file in the project root.
+ *
+ * Distributed under an [MIT-style][license] license.
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal with
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * - Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimers.
+ * - Redistributions in binary form must reproduce the above copyright notice, this
+ *   list of conditions and the following disclaimers in the documentation and/or
+ *   other materials provided with the distribution.
+ * - Neither the names of the copyright holders, nor the names of the authors, nor
+ *   the names of other contributors may be used to endorse or promote products
+ *   derived from this Software without specific prior written permission.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE CONTRIBUTORS
+ * OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS WITH THE SOFTWARE.
+ *
+ * [license]: http://www.opensource.org/licenses/ncsa
+ */
+
+
+#ifdef __linux__
+#define _POSIX_C_SOURCE 200809L
+#define _GNU_SOURCE
+#endif
+
+#ifdef __APPLE__
+#define _DARWIN_SOURCE
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <limits.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <check.h>
+
+#include "server.h"
+#include "loader.h"
+#include "test.h"
+
+static served_model models[2];
+
+#define assert_response(REQUEST, EXPECTED)                              \
+    do                                                                  \
+    {                                                                   \
+        size_t length = 0;                                              \
+        char *response = answer_request(models, 2, (REQUEST), strlen((REQUEST)), &length); \
+        assert_not_null(response);                                      \
+        assert_uint_eq(strlen((EXPECTED)), length);                     \
+        assert_buf_eq((EXPECTED), strlen((EXPECTED)), response, length); \
+        free(response);                                                 \
+    } while(0)
+
+#define assert_refused(REQUEST)                                         \
+    do                                                                  \
+    {                                                                   \
+        size_t length = 0;                                              \
+        char *response = answer_request(models, 2, (REQUEST), strlen((REQUEST)), &length); \
+        assert_not_null(response);                                      \
+        ck_assert_msg(0 == strncmp("error ", response, 6), "expected an error response, but got: %.*s", (int)length, response); \
+        free(response);                                                 \
+    } while(0)
+
+static DocumentModel *load_model(const char *filename)
+{
+    FILE *input = fopen(filename, "r");
+    assert_not_null(input);
+
+    MaybeDocument maybe = load_file(input, DUPE_CLOBBER, INPUT_AUTO);
+    fclose(input);
+    assert_int_eq(JUST, maybe.tag);
+    model_index_names(maybe.just);
+
+    return maybe.just;
+}
+
+static void server_setup(void)
+{
+    models[0].name = canonical_model_name("inventory.json");
+    atomic_init(&models[0].model, load_model("inventory.json"));
+    models[1].name = canonical_model_name("invoice.yaml");
+    atomic_init(&models[1].model, load_model("invoice.yaml"));
+}
+
+static void server_teardown(void)
+{
+    model_free(atomic_load(&models[0].model));
+    free((char *)models[0].name);
+    model_free(atomic_load(&models[1].model));
+    free((char *)models[1].name);
+}
+
+/* a request for the model served from the file, by its canonical name */
+static char *request_for(char *buffer, size_t size, const char *format, const char *file)
+{
+    char *name = canonical_model_name(file);
+    assert_not_null(name);
+    snprintf(buffer, size, format, name);
+    free(name);
+    return buffer;
+}
+
+START_TEST (answer)
+{
+    char request[PATH_MAX + 64];
+    assert_response(request_for(request, sizeof(request), "json\t0\tfirst\t%s\t$.store.book[0].author", "inventory.json"),
+                    "ok 15\n[\"Nigel Rees\"]\n");
+}
+END_TEST
+
+START_TEST (answer_first_model)
+{
+    assert_response("json\t0\tfirst\t\t$.store.bicycle.color",
+                    "ok 8\n[\"red\"]\n");
+}
+END_TEST
+
+START_TEST (answer_named_model)
+{
+    char request[PATH_MAX + 64];
+    assert_response(request_for(request, sizeof(request), "bash\t0\tfirst\t%s\t$.customer.given", "invoice.yaml"),
+                    "ok 8\nRaymond\n");
+    // N.B. - the client resolves a name, the server doesn't
+    assert_refused("bash\t0\tfirst\tinvoice.yaml\t$.customer.given");
+}
+END_TEST
+
+START_TEST (answer_limit)
+{
+    assert_response("bash\t2\tfirst\t\t$.store.book[*].category",
+                    "ok 18\nreference\nfiction\n");
+}
+END_TEST
+
+START_TEST (refuse_malformed)
+{
+    assert_refused("json\t0\tfirst");
+    assert_refused("nonsense\t0\tfirst\t\t$.store");
+    assert_refused("json\tmany\tfirst\t\t$.store");
+    assert_refused("json\t0\tsome\t\t$.store");
+}
+END_TEST
+
+START_TEST (refuse_unknown_model)
+{
+    assert_refused("json\t0\tfirst\tnope.json\t$.store");
+}
+END_TEST
+
+START_TEST (refuse_bad_expression)
+{
+    assert_refused("json\t0\tfirst\t\t$.[");
+}
+END_TEST
+
+#ifdef __linux__
+
+static void *run_server(void *context)
+{
+    server_run((server *)context);
+    return NULL;
+}
+
+START_TEST (round_trip)
+{
+    char path[64];
+    snprintf(path, sizeof(path), "/tmp/kanabo_test_%ld.sock", (long)getpid());
+    server *instance = make_server(path, models, 2, 2, NULL);
+    assert_not_null(instance);
+
+    pthread_t thread;
+    assert_int_eq(0, pthread_create(&thread, NULL, run_server, instance));
+
+    query queries[] =
+    {
+        {"$.store.book[0].author", NULL, JSON, 0, false},
+        {"$.customer.given", "invoice.yaml", BASH, 0, false},
+        {"$.[", NULL, JSON, 0, false},
+    };
+    char *out = NULL, *err = NULL;
+    size_t out_length = 0, err_length = 0;
+    FILE *output = open_memstream(&out, &out_length);
+    FILE *errors = open_memstream(&err, &err_length);
+    assert_not_null(output);
+    assert_not_null(errors);
+
+    int result = query_server(path, queries, 3, true, output, errors);
+    fclose(output);
+    fclose(errors);
+    server_stop(instance);
+    assert_int_eq(0, pthread_join(thread, NULL));
+    server_free(instance);
+
+    assert_int_eq(EXIT_FAILURE, result);
+    ck_assert_str_eq("[\"Nigel Rees\"]\nEOD\nRaymond\nEOD\nEOD\n", out);
+    ck_assert_msg(NULL != strstr(err, "'$.['"), "unexpected errors: %s", err);
+    assert_int_eq(-1, access(path, F_OK));
+    free(out);
+    free(err);
+}
+END_TEST
+
+/*
+ * A model is asked for by its canonical name, however the client spells it.
+ */
+START_TEST (canonical_names)
+{
+    assert_int_eq('/', models[1].name[0]);
+
+    char path[64];
+    snprintf(path, sizeof(path), "/tmp/kanabo_test_%ld.sock", (long)getpid());
+    server *instance = make_server(path, models, 2, 2, NULL);
+    assert_not_null(instance);
+
+    pthread_t thread;
+    assert_int_eq(0, pthread_create(&thread, NULL, run_server, instance));
+
+    query queries[] =
+    {
+        {"$.customer.given", "invoice.yaml", BASH, 0, false},
+        {"$.customer.given", "./invoice.yaml", BASH, 0, false},
+        {"$.customer.given", models[1].name, BASH, 0, false},
+        {"$.store.bicycle.color", NULL, BASH, 0, false},
+    };
+    char *out = NULL;
+    size_t out_length = 0;
+    FILE *output = open_memstream(&out, &out_length);
+    assert_not_null(output);
+
+    int result = query_server(path, queries, 4, true, output, stderr);
+    fclose(output);
+    server_stop(instance);
+    assert_int_eq(0, pthread_join(thread, NULL));
+    server_free(instance);
+
+    assert_int_eq(EXIT_SUCCESS, result);
+    ck_assert_str_eq("Raymond\nEOD\nRaymond\nEOD\nRaymond\nEOD\nred\nEOD\n", out);
+    free(out);
+}
+END_TEST
+
+/*
+ * Clients that hang up while their responses are pending must not take the
+ * server down with them.
+ */
+START_TEST (reset_pending)
+{
+    char path[64];
+    snprintf(path, sizeof(path), "/tmp/kanabo_test_%ld.sock", (long)getpid());
+    server *instance = make_server(path, models, 2, 2, NULL);
+    assert_not_null(instance);
+
+    pthread_t thread;
+    assert_int_eq(0, pthread_create(&thread, NULL, run_server, instance));
+
+    struct sockaddr_un address = {.sun_family = AF_UNIX};
+    strcpy(address.sun_path, path);
+    static const char request[] = "bash\t0\tfirst\t\t$..*\n";
+    struct linger abort = {.l_onoff = 1, .l_linger = 0};
+    for(size_t i = 0; i < 3000; i++)
+    {
+        int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        assert_int_ne(-1, fd);
+        assert_int_eq(0, connect(fd, (struct sockaddr *)&address, sizeof(address)));
+        assert_int_eq((long)sizeof(request) - 1, (long)write(fd, request, sizeof(request) - 1));
+        setsockopt(fd, SOL_SOCKET, SO_LINGER, &abort, sizeof(abort));
+        close(fd);
+    }
+
+    query queries[] =
+    {
+        {"$.store.book[0].author", NULL, JSON, 0, false},
+    };
+    char *out = NULL;
+    size_t out_length = 0;
+    FILE *output = open_memstream(&out, &out_length);
+    assert_not_null(output);
+
+    int result = query_server(path, queries, 1, true, output, stderr);
+    fclose(output);
+    server_stop(instance);
+    assert_int_eq(0, pthread_join(thread, NULL));
+    server_free(instance);
+
+    assert_int_eq(EXIT_SUCCESS, result);
+    ck_assert_str_eq("[\"Nigel Rees\"]\nEOD\n", out);
+    free(out);
+}
+END_TEST
+
+/*
+ * A client that shuts down its end after sending its requests is still
+ * answered, and the server closes the connection once it has been.
+ */
+START_TEST (shutdown_after_requests)
+{
+    char path[64];
+    snprintf(path, sizeof(path), "/tmp/kanabo_test_%ld.sock", (long)getpid());
+    server *instance = make_server(path, models, 2, 2, NULL);
+    assert_not_null(instance);
+
+    pthread_t thread;
+    assert_int_eq(0, pthread_create(&thread, NULL, run_server, instance));
+
+    static const char first[] = "json\t0\tfirst\t\t$.store.book[0].author";
+    static const char second[] = "bash\t0\tfirst\t\t$..*";
+    size_t first_length = 0, second_length = 0;
+    char *expected_first = answer_request(models, 2, first, strlen(first), &first_length);
+    char *expected_second = answer_request(models, 2, second, strlen(second), &second_length);
+    assert_not_null(expected_first);
+    assert_not_null(expected_second);
+
+    struct sockaddr_un address = {.sun_family = AF_UNIX};
+    strcpy(address.sun_path, path);
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    assert_int_ne(-1, fd);
+    assert_int_eq(0, connect(fd, (struct sockaddr *)&address, sizeof(address)));
+    char requests[128];
+    int length = snprintf(requests, sizeof(requests), "%s\n%s\n", first, second);
+    assert_int_eq(length, (long)write(fd, requests, (size_t)length));
+    assert_int_eq(0, shutdown(fd, SHUT_WR));
+
+    size_t received = 0, capacity = first_length + second_length + 1;
+    char *response = malloc(capacity);
+    assert_not_null(response);
+    ssize_t count;
+    while(0 < (count = read(fd, response + received, capacity - received)))
+    {
+        received += (size_t)count;
+        assert_uint_lt(received, capacity);
+    }
+    assert_int_eq(0, count);
+    close(fd);
+
+    server_stop(instance);
+    assert_int_eq(0, pthread_join(thread, NULL));
+    server_free(instance);
+
+    assert_uint_eq(first_length + second_length, received);
+    assert_buf_eq(expected_first, first_length, response, first_length);
+    assert_buf_eq(expected_second, second_length, response + first_length, second_length);
+    free(response);
+    free(expected_first);
+    free(expected_second);
+}
+END_TEST
+
+#endif
+
+Suite *server_suite(void)
+{
+    TCase *answer_case = tcase_create("answer");
+    tcase_add_unchecked_fixture(answer_case, server_setup, server_teardown);
+    tcase_add_test(answer_case, answer);
+    tcase_add_test(answer_case, answer_first_model);
+    tcase_add_test(answer_case, answer_named_model);
+    tcase_add_test(answer_case, answer_limit);
+    tcase_add_test(answer_case, refuse_malformed);
+    tcase_add_test(answer_case, refuse_unknown_model);
+    tcase_add_test(answer_case, refuse_bad_expression);
+
+    Suite *suite = suite_create("Server");
+    suite_add_tcase(suite, answer_case);
+
+#ifdef __linux__
+    TCase *socket_case = tcase_create("socket");
+    tcase_add_unchecked_fixture(socket_case, server_setup, server_teardown);
+    tcase_add_test(socket_case, round_trip);
+    tcase_add_test(socket_case, canonical_names);
+    tcase_add_test(socket_case, reset_pending);
+    tcase_add_test(socket_case, shutdown_after_requests);
+    suite_add_tcase(suite, socket_case);
+#endif
+
+    return suite;
+}
@@ -0,0 +1,532 @@
+/*
+ * 金棒 (kanabō)
+ * Copyright (c) 2012 Kevin Birch <kmb@pobox.com>.  All rights reserved.
+ * 
+ * 金棒 is a tool to bludgeon YAML and JSON files from the shell: the strong
+ * made stronger.
+ *
+ * For more information, consult the README file in the project root.
+ *
+ * Distributed under an [MIT-style][license] license.
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal with
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * - Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimers.
+ * - Redistributions in binary form must reproduce the above copyright notice, this
+ *   list of conditions and the following disclaimers in the documentation and/or
+ *   other materials provided with the distribution.
+ * - Neither the names of the copyright holders, nor the names of the authors, nor
+ *   the names of other contributors may be used to endorse or promote products
+ *   derived from this Software without specific prior written permission.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE CONTRIBUTORS
+ * OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS WITH THE SOFTWARE.
+ *
+ * [license]: http://www.opensource.org/licenses/ncsa
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <check.h>
+
+#include "loader.h"
+#include "evaluator.h"
+#undef component_name
+#include "jsonpath/private.h"
+#undef component_name
+#include "test.h"
+
+
+static Tape *tape_fixture = NULL;
+
+static const unsigned char * const NAVIGATION_YAML = (unsigned char *)
+    "one:\n"
+    "  - foo1\n"
+    "  - bar1\n"
+    "two: !!str 42\n"
+    "three: &base\n"
+    "  n: 3\n"
+    "four: *base\n";
+
+static const unsigned char * const MULTIPLE_DOCUMENT_YAML = (unsigned char *)
+    "--- a\n"
+    "--- [1, 2]\n";
+
+static const unsigned char * const DUPLICATE_KEY_YAML = (unsigned char *)
+    "one: foo\n"
+    "two:\n"
+    "  - foo\n"
+    "  - bar\n"
+    "one: bar\n"
+    "three: baz\n";
+
+static const unsigned char * const WIDE_DUPLICATE_KEY_YAML = (unsigned char *)
+    "k0: 0\nk1: 1\nk2: 2\nk3: 3\nk4: 4\nk5: 5\n"
+    "k6: 6\nk7: 7\nk8: 8\nk9: 9\nk10: 10\nk11: 11\n"
+    "k3: three\n"
+    "k12: 12\n";
+
+static const unsigned char * const NON_SCALAR_KEY_YAML = (unsigned char *)
+    "foo: 1\n"
+    "? - one\n"
+    "  - two\n"
+    ":\n"
+    "  - foo1\n"
+    "  - bar1\n";
+
+static const unsigned char * const ALIAS_LOOP_YAML = (unsigned char *)
+    "level1: &id001\n"
+    "  key1-1: foo\n"
+    "  level2:\n"
+    "    key2-1: *id001\n";
+
+static const unsigned char * const MISSING_ANCHOR_YAML = (unsigned char *)
+    "one:\n"
+    "  - foo1\n"
+    "two: *value\n";
+
+static const unsigned char * const JSON = (unsigned char *)
+    "{\"a\": \"x\\\"y\", \"b\": [1, 2.5, true, null, {}]}";
+
+#define assert_loader_failure(MAYBE, EXPECTED_RESULT)                   \
+    do                                                                  \
+    {                                                                   \
+        assert_int_eq(NOTHING, (MAYBE).tag);                            \
+        assert_int_eq((EXPECTED_RESULT), (MAYBE).nothing.code);         \
+        assert_not_null((MAYBE).nothing.message);                       \
+        free((MAYBE).nothing.message);                                  \
+    } while(0)
+
+#define assert_cursor_value(CURSOR, VALUE)                              \
+    do                                                                  \
+    {                                                                   \
+        assert_true(cursor_is_scalar((CURSOR)));                        \
+        assert_uint_eq(strlen((VALUE)), cursor_size((CURSOR)));         \
+        assert_buf_eq((VALUE), strlen((VALUE)), cursor_value((CURSOR)), cursor_size((CURSOR))); \
+    } while(0)
+
+static Tape *load_tape(const unsigned char *data, enum loader_duplicate_key_strategy strategy, enum loader_input_format format)
+{
+    reset_errno();
+    MaybeTape maybe = load_tape_string(data, strlen((char *)data), strategy, format);
+    assert_noerr();
+    assert_int_eq(JUST, maybe.tag);
+    assert_not_null(maybe.just);
+
+    return maybe.just;
+}
+
+static void tape_teardown(void)
+{
+    tape_free(tape_fixture);
+    tape_fixture = NULL;
+}
+
+static jsonpath *path_for(const char *expression)
+{
+    parser_context *parser = make_parser((const uint8_t *)expression, strlen(expression));
+    assert_not_null(parser);
+
+    jsonpath *path = parse(parser);
+    assert_not_null(path);
+    assert_int_eq(JSONPATH_SUCCESS, parser_status(parser));
+    parser_free(parser);
+
+    return path;
+}
+
+START_TEST (null_string_input)
+{
+    reset_errno();
+    MaybeTape maybe = load_tape_string(NULL, 50, DUPE_CLOBBER, INPUT_AUTO);
+    assert_errno(EINVAL);
+
+    assert_loader_failure(maybe, ERR_INPUT_IS_NULL);
+}
+END_TEST
+
+START_TEST (null_file_input)
+{
+    reset_errno();
+    MaybeTape maybe = load_tape_file(NULL, DUPE_CLOBBER, INPUT_AUTO);
+    assert_errno(EINVAL);
+
+    assert_loader_failure(maybe, ERR_INPUT_IS_NULL);
+}
+END_TEST
+
+START_TEST (non_scalar_key)
+{
+    MaybeTape maybe = load_tape_string(NON_SCALAR_KEY_YAML, strlen((char *)NON_SCALAR_KEY_YAML), DUPE_CLOBBER, INPUT_AUTO);
+    assert_loader_failure(maybe, ERR_NON_SCALAR_KEY);
+}
+END_TEST
+
+START_TEST (alias_loop)
+{
+    MaybeTape maybe = load_tape_string(ALIAS_LOOP_YAML, strlen((char *)ALIAS_LOOP_YAML), DUPE_CLOBBER, INPUT_AUTO);
+    assert_loader_failure(maybe, ERR_ALIAS_LOOP);
+}
+END_TEST
+
+START_TEST (missing_anchor)
+{
+    MaybeTape maybe = load_tape_string(MISSING_ANCHOR_YAML, strlen((char *)MISSING_ANCHOR_YAML), DUPE_CLOBBER, INPUT_AUTO);
+    assert_loader_failure(maybe, ERR_NO_ANCHOR_FOR_ALIAS);
+}
+END_TEST
+
+START_TEST (duplicate_fail)
+{
+    MaybeTape maybe = load_tape_string(DUPLICATE_KEY_YAML, strlen((char *)DUPLICATE_KEY_YAML), DUPE_FAIL, INPUT_AUTO);
+    assert_loader_failure(maybe, ERR_DUPLICATE_KEY);
+}
+END_TEST
+
+static void navigation_setup(void)
+{
+    tape_fixture = load_tape(NAVIGATION_YAML, DUPE_CLOBBER, INPUT_AUTO);
+}
+
+START_TEST (navigation)
+{
+    assert_uint_eq(1, tape_size(tape_fixture));
+    assert_true(cursor_is_document(tape_document(tape_fixture, 0)));
+    assert_true(cursor_is_none(tape_document(tape_fixture, 1)));
+
+    Cursor root = tape_document_root(tape_fixture, 0);
+    assert_true(cursor_is_mapping(root));
+    assert_uint_eq(4, cursor_size(root));
+
+    Cursor one = cursor_mapping_get(root, (uint8_t *)"one", 3);
+    assert_true(cursor_is_sequence(one));
+    assert_uint_eq(2, cursor_size(one));
+    assert_cursor_value(cursor_sequence_get(one, 0), "foo1");
+    assert_cursor_value(cursor_sequence_get(one, 1), "bar1");
+    assert_true(cursor_is_none(cursor_sequence_get(one, 2)));
+
+    Cursor two = cursor_mapping_get(root, (uint8_t *)"two", 3);
+    assert_cursor_value(two, "42");
+    assert_not_null(cursor_tag(two));
+    assert_buf_eq("tag:yaml.org,2002:str", 21, cursor_tag(two), strlen((char *)cursor_tag(two)));
+    assert_null(cursor_tag(one));
+
+    assert_true(cursor_is_none(cursor_mapping_get(root, (uint8_t *)"five", 4)));
+}
+END_TEST
+
+START_TEST (follow_alias)
+{
+    Cursor root = tape_document_root(tape_fixture, 0);
+    Cursor three = cursor_mapping_get(root, (uint8_t *)"three", 5);
+    Cursor four = cursor_mapping_get(root, (uint8_t *)"four", 4);
+    assert_true(cursor_is_alias(four));
+    assert_uint_eq(0, cursor_size(four));
+
+    Cursor target = cursor_resolve(four);
+    assert_true(cursor_is_mapping(target));
+    assert_uint_eq(three.index, target.index);
+    assert_true(cursor_equals(three, target));
+
+    int64_t n = 0;
+    Cursor value = cursor_mapping_get(target, (uint8_t *)"n", 1);
+    assert_true(cursor_is_integer(value));
+    assert_true(cursor_integer(value, &n));
+    assert_int_eq(3, n);
+}
+END_TEST
+
+static void multiple_document_setup(void)
+{
+    tape_fixture = load_tape(MULTIPLE_DOCUMENT_YAML, DUPE_CLOBBER, INPUT_AUTO);
+}
+
+START_TEST (multiple_documents)
+{
+    assert_uint_eq(2, tape_size(tape_fixture));
+    assert_cursor_value(tape_document_root(tape_fixture, 0), "a");
+
+    Cursor second = tape_document_root(tape_fixture, 1);
+    assert_true(cursor_is_sequence(second));
+    assert_uint_eq(2, cursor_size(second));
+    assert_true(cursor_is_integer(cursor_sequence_get(second, 1)));
+}
+END_TEST
+
+static void duplicate_clobber_setup(void)
+{
+    tape_fixture = load_tape(DUPLICATE_KEY_YAML, DUPE_CLOBBER, INPUT_AUTO);
+}
+
+static void duplicate_warn_setup(void)
+{
+    tape_fixture = load_tape(DUPLICATE_KEY_YAML, DUPE_WARN, INPUT_AUTO);
+}
+
+static bool count_entry(Cursor key, Cursor value, void *context)
+{
+    assert_true(cursor_is_string(key));
+    assert_false(cursor_is_none(value));
+    (*(size_t *)context)++;
+    return true;
+}
+
+START_TEST (duplicate_clobber)
+{
+    Cursor root = tape_document_root(tape_fixture, 0);
+    assert_uint_eq(3, cursor_size(root));
+    assert_cursor_value(cursor_mapping_get(root, (uint8_t *)"one", 3), "bar");
+    assert_cursor_value(cursor_mapping_get(root, (uint8_t *)"three", 5), "baz");
+
+    size_t count = 0;
+    assert_true(cursor_mapping_iterate(root, count_entry, &count));
+    assert_uint_eq(3, count);
+}
+END_TEST
+
+static void wide_duplicate_setup(void)
+{
+    tape_fixture = load_tape(WIDE_DUPLICATE_KEY_YAML, DUPE_CLOBBER, INPUT_AUTO);
+}
+
+START_TEST (wide_duplicate)
+{
+    Cursor root = tape_document_root(tape_fixture, 0);
+    assert_uint_eq(13, cursor_size(root));
+    assert_cursor_value(cursor_mapping_get(root, (uint8_t *)"k3", 2), "three");
+    assert_cursor_value(cursor_mapping_get(root, (uint8_t *)"k11", 3), "11");
+    assert_cursor_value(cursor_mapping_get(root, (uint8_t *)"k12", 3), "12");
+
+    size_t count = 0;
+    assert_true(cursor_mapping_iterate(root, count_entry, &count));
+    assert_uint_eq(13, count);
+}
+END_TEST
+
+static void json_setup(void)
+{
+    tape_fixture = load_tape(JSON, DUPE_CLOBBER, INPUT_JSON);
+}
+
+START_TEST (load_json)
+{
+    Cursor root = tape_document_root(tape_fixture, 0);
+    assert_true(cursor_is_mapping(root));
+    assert_uint_eq(2, cursor_size(root));
+
+    Cursor a = cursor_mapping_get(root, (uint8_t *)"a", 1);
+    assert_true(cursor_is_string(a));
+    assert_cursor_value(a, "x\"y");
+
+    Cursor b = cursor_mapping_get(root, (uint8_t *)"b", 1);
+    assert_true(cursor_is_sequence(b));
+    assert_uint_eq(5, cursor_size(b));
+    assert_true(cursor_is_integer(cursor_sequence_get(b, 0)));
+    assert_true(cursor_is_real(cursor_sequence_get(b, 1)));
+    assert_true(cursor_is_boolean(cursor_sequence_get(b, 2)));
+    assert_true(cursor_boolean_is_true(cursor_sequence_get(b, 2)));
+    assert_true(cursor_is_null(cursor_sequence_get(b, 3)));
+    assert_true(cursor_is_mapping(cursor_sequence_get(b, 4)));
+    assert_uint_eq(0, cursor_size(cursor_sequence_get(b, 4)));
+}
+END_TEST
+
+static DocumentModel *model_fixture = NULL;
+
+static void inventory_setup(void)
+{
+    FILE *input = fopen("inventory.json", "r");
+    assert_not_null(input);
+    reset_errno();
+    MaybeTape maybe_tape = load_tape_file(input, DUPE_CLOBBER, INPUT_AUTO);
+    assert_noerr();
+    assert_int_eq(JUST, maybe_tape.tag);
+    tape_fixture = maybe_tape.just;
+
+    rewind(input);
+    MaybeDocument maybe_model = load_file(input, DUPE_CLOBBER, INPUT_AUTO);
+    assert_int_eq(JUST, maybe_model.tag);
+    model_fixture = maybe_model.just;
+    fclose(input);
+}
+
+static void inventory_teardown(void)
+{
+    tape_teardown();
+    model_free(model_fixture);
+    model_fixture = NULL;
+}
+
+struct comparison
+{
+    nodelist *expected;
+    size_t    seen;
+};
+
+static bool compare_result(Cursor each, void *context)
+{
+    struct comparison *comparison = (struct comparison *)context;
+    assert_uint_lt(comparison->seen, nodelist_length(comparison->expected));
+
+    Node *expected = nodelist_get(comparison->expected, comparison->seen++);
+    assert_int_eq(node_kind(expected), cursor_kind(each));
+    assert_uint_eq(node_size(expected), cursor_size(each));
+    if(SCALAR == node_kind(expected))
+    {
+        assert_buf_eq(scalar_value(scalar(expected)), node_size(expected), cursor_value(each), cursor_size(each));
+    }
+    return true;
+}
+
+static const char * const EXPRESSIONS[] =
+{
+    "$",
+    "$.store.book[*].author",
+    "$..author",
+    "$.store..price",
+    "$.store.book[::-1].title",
+    "$.store.book[-2:]",
+    "$..book[?(@.price < 10)].title",
+    "$..book[?(@.isbn && @.category == \"fiction\")].price",
+    "$..*",
+    "$..number()"
+};
+
+START_TEST (evaluation)
+{
+    for(size_t i = 0; i < sizeof(EXPRESSIONS) / sizeof(EXPRESSIONS[0]); i++)
+    {
+        jsonpath *path = path_for(EXPRESSIONS[i]);
+
+        reset_errno();
+        MaybeNodelist maybe = evaluate(model_fixture, path);
+        assert_int_eq(JUST, maybe.tag);
+
+        struct comparison comparison = {maybe.just, 0};
+        Evaluation results = make_tape_evaluation(tape_fixture, path);
+        assert_true(evaluation_iterate(&results, compare_result, &comparison));
+        assert_int_eq(EVALUATOR_SUCCESS, results.code);
+        assert_uint_eq(nodelist_length(maybe.just), comparison.seen);
+        assert_uint_eq(comparison.seen, results.count);
+
+        nodelist_free(maybe.just);
+        path_free(path);
+    }
+}
+END_TEST
+
+static bool count_result(Cursor each, void *context)
+{
+    assert_false(cursor_is_none(each));
+    (*(size_t *)context)++;
+    return true;
+}
+
+START_TEST (limit)
+{
+    jsonpath *path = path_for("$..*");
+    size_t count = 0;
+
+    Evaluation results = make_tape_evaluation(tape_fixture, path);
+    results.limit = 3;
+    assert_true(evaluation_iterate(&results, count_result, &count));
+    assert_uint_eq(3, count);
+    assert_uint_eq(3, results.count);
+
+    path_free(path);
+}
+END_TEST
+
+START_TEST (batch)
+{
+    jsonpath *paths[] = {path_for("$..price"), path_for("$.store.book[*].title")};
+    Selection found[2] = {{NULL, 0, 0}, {NULL, 0, 0}};
+
+    evaluator_status_code code = evaluate_tape_batch(tape_fixture, (const jsonpath * const *)paths, 2, false, 0, found);
+    assert_int_eq(EVALUATOR_SUCCESS, code);
+
+    for(size_t i = 0; i < 2; i++)
+    {
+        MaybeNodelist maybe = evaluate(model_fixture, paths[i]);
+        assert_int_eq(JUST, maybe.tag);
+        assert_uint_eq(nodelist_length(maybe.just), found[i].length);
+
+        struct comparison comparison = {maybe.just, 0};
+        Evaluation results = make_tape_evaluation(tape_fixture, paths[i]);
+        results.found = found + i;
+        assert_true(evaluation_iterate(&results, compare_result, &comparison));
+        assert_uint_eq(found[i].length, comparison.seen);
+
+        nodelist_free(maybe.just);
+        selection_release(found + i);
+        path_free(paths[i]);
+    }
+}
+END_TEST
+
+Suite *tape_suite(void)
+{
+    TCase *bad_input_case = tcase_create("bad input");
+    tcase_add_test(bad_input_case, null_string_input);
+    tcase_add_test(bad_input_case, null_file_input);
+    tcase_add_test(bad_input_case, non_scalar_key);
+    tcase_add_test(bad_input_case, alias_loop);
+    tcase_add_test(bad_input_case, missing_anchor);
+    tcase_add_test(bad_input_case, duplicate_fail);
+
+    TCase *navigation_case = tcase_create("navigation");
+    tcase_add_unchecked_fixture(navigation_case, navigation_setup, tape_teardown);
+    tcase_add_test(navigation_case, navigation);
+    tcase_add_test(navigation_case, follow_alias);
+
+    TCase *multiple_document_case = tcase_create("multiple documents");
+    tcase_add_unchecked_fixture(multiple_document_case, multiple_document_setup, tape_teardown);
+    tcase_add_test(multiple_document_case, multiple_documents);
+
+    TCase *duplicate_clobber_case = tcase_create("duplicate_clobber");
+    tcase_add_unchecked_fixture(duplicate_clobber_case, duplicate_clobber_setup, tape_teardown);
+    tcase_add_test(duplicate_clobber_case, duplicate_clobber);
+
+    TCase *duplicate_warn_case = tcase_create("duplicate_warn");
+    tcase_add_unchecked_fixture(duplicate_warn_case, duplicate_warn_setup, tape_teardown);
+    tcase_add_test(duplicate_warn_case, duplicate_clobber);
+
+    TCase *wide_duplicate_case = tcase_create("wide_duplicate");
+    tcase_add_unchecked_fixture(wide_duplicate_case, wide_duplicate_setup, tape_teardown);
+    tcase_add_test(wide_duplicate_case, wide_duplicate);
+
+    TCase *json_case = tcase_create("json");
+    tcase_add_unchecked_fixture(json_case, json_setup, tape_teardown);
+    tcase_add_test(json_case, load_json);
+
+    TCase *evaluation_case = tcase_create("evaluation");
+    tcase_add_unchecked_fixture(evaluation_case, inventory_setup, inventory_teardown);
+    tcase_add_test(evaluation_case, evaluation);
+    tcase_add_test(evaluation_case, limit);
+    tcase_add_test(evaluation_case, batch);
+
+    Suite *tape = suite_create("Tape");
+    suite_add_tcase(tape, bad_input_case);
+    suite_add_tcase(tape, navigation_case);
+    suite_add_tcase(tape, multiple_document_case);
+    suite_add_tcase(tape, duplicate_clobber_case);
+    suite_add_tcase(tape, duplicate_warn_case);
+    suite_add_tcase(tape, wide_duplicate_case);
+    suite_add_tcase(tape, json_case);
+    suite_add_tcase(tape, evaluation_case);
+
+    return tape;
+}
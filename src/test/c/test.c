@@ -89,6 +89,10 @@ int main(int argc, char **argv)
     srunner_add_suite(runner, model_suite());
     srunner_add_suite(runner, nodelist_suite());
     srunner_add_suite(runner, evaluator_suite());
+    srunner_add_suite(runner, server_suite());
+    srunner_add_suite(runner, reload_suite());
+    srunner_add_suite(runner, tape_suite());
+    srunner_add_suite(runner, framed_suite());
 
     switch(argc)
     {